@@ -0,0 +1,400 @@
+#define _GNU_SOURCE /* lgamma_r */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "analyze.h"
+#include "pool.h"
+#include "bufpool.h"
+#include "common.h"
+#include "types.h"
+#include "color.h"
+
+/* 16 samples per operation; GCC lowers these to SSE2 on x86-64 and NEON on ARM */
+typedef unsigned char SampleVector __attribute__((vector_size(16)));
+typedef signed char MaskVector __attribute__((vector_size(16)));
+
+/* One image of the corpus */
+typedef struct _AnalyzeJob
+{
+    const char *image_fname; /*Store the image name*/
+    double chi_score; /*Store the chi-square probability*/
+    double rate; /*Store the sample pair embedding rate*/
+    Status status; /*Store whether the image could be analyzed*/
+} AnalyzeJob;
+
+/* Function Definitions */
+
+/* Histogram Kernel
+ * Description: Four interleaved histograms, so runs of equal samples don't wait
+ * on the previous increment of the same counter
+ */
+static void histogram_kernel(unsigned long *histogram, const unsigned char *data, long size)
+{
+    uint counts[4][256] = {{0}};
+    long i = 0;
+    for(; i + 4 <= size; i += 4)
+    {
+        counts[0][data[i]]++;
+        counts[1][data[i + 1]]++;
+        counts[2][data[i + 2]]++;
+        counts[3][data[i + 3]]++;
+    }
+    for(; i < size; i++)
+    {
+        counts[0][data[i]]++;
+    }
+    for(int value = 0; value < 256; value++)
+    {
+        histogram[value] += counts[0][value] + counts[1][value] + counts[2][value] + counts[3][value];
+    }
+}
+
+static unsigned long vector_sum(SampleVector counts)
+{
+    unsigned long sum = 0;
+    for(int lane = 0; lane < 16; lane++)
+    {
+        sum += counts[lane];
+    }
+    return sum;
+}
+
+/* Sample Pair Kernel
+ * Input: First and second samples of count pairs
+ * Description: Classify 16 pairs per step into byte counters, which are
+ * drained before they can wrap
+ */
+static void sample_pair_kernel(LsbStats *stats, const unsigned char *first, const unsigned char *second, long count)
+{
+    long i = 0;
+    while(i + 16 <= count)
+    {
+        SampleVector count_x = {0}, count_z = {0}, count_w = {0};
+        for(int step = 0; step < 255 && i + 16 <= count; step++, i += 16)
+        {
+            SampleVector u, v;
+            memcpy(&u, first + i, sizeof(u));
+            memcpy(&v, second + i, sizeof(v));
+            MaskVector v_odd = (v & 1) != 0, equal = u == v;
+            MaskVector x = (~v_odd & (u < v)) | (v_odd & (u > v));
+            MaskVector w = ((u >> 1) == (v >> 1)) & ~equal;
+            count_x -= (SampleVector) x; // Masks are -1, subtracting counts one
+            count_z -= (SampleVector) equal;
+            count_w -= (SampleVector) w;
+        }
+        stats->pairs_x += vector_sum(count_x);
+        stats->pairs_z += vector_sum(count_z);
+        stats->pairs_w += vector_sum(count_w);
+    }
+    for(; i < count; i++)
+    {
+        int u = first[i], v = second[i];
+        stats->pairs_x += (v % 2 == 0 && u < v) || (v % 2 == 1 && u > v);
+        stats->pairs_z += u == v;
+        stats->pairs_w += u != v && u / 2 == v / 2;
+    }
+    stats->pairs += count;
+}
+/* Function Definitions */
+
+/* Update LSB Statistics
+ * Input: Samples, the number of leading samples already counted (the end of the
+ * previous block, so pairs can cross blocks), channels per pixel
+ * Output: Histogram and pair counts updated
+ */
+void lsb_stats_update(LsbStats *stats, const unsigned char *data, long size, long counted, int channels)
+{
+    histogram_kernel(stats->histogram, data + counted, size - counted);
+    if(size > channels)
+    {
+        sample_pair_kernel(stats, data, data + channels, size - channels);
+    }
+}
+/* Function Definitions */
+
+/* Upper regularized incomplete gamma Q(s, x), series below s + 1, continued fraction above */
+static double gamma_q(double s, double x)
+{
+    int sign;
+    if(x <= 0)
+    {
+        return 1;
+    }
+    double scale = exp(-x + s * log(x) - lgamma_r(s, &sign));
+    if(x < s + 1)
+    {
+        double term = 1 / s, sum = term;
+        for(int n = 1; n < 1000 && term > sum * 1e-12; n++)
+        {
+            term *= x / (s + n);
+            sum += term;
+        }
+        return 1 - sum * scale;
+    }
+    double b = x + 1 - s, c = 1e300, d = 1 / b, h = d;
+    for(int n = 1; n < 1000; n++)
+    {
+        double a = -n * (n - s);
+        b += 2;
+        d = a * d + b;
+        c = b + a / c;
+        d = fabs(d) < 1e-300 ? 1e300 : 1 / d;
+        c = fabs(c) < 1e-300 ? 1e-300 : c;
+        h *= d * c;
+        if(fabs(d * c - 1) < 1e-12)
+        {
+            break;
+        }
+    }
+    return scale * h;
+}
+
+/* Chi-Square Score
+ * Description: Compare the count of every even value with the mean of its pair;
+ * the score is the probability of a chi-square this small, near 1 when embedding
+ * has equalized the pairs
+ */
+double lsb_chi_square_score(const LsbStats *stats)
+{
+    double chi_square = 0;
+    int categories = 0;
+    for(int value = 0; value < 256; value += 2)
+    {
+        double expected = (stats->histogram[value] + stats->histogram[value + 1]) / 2.0;
+        if(expected >= ANALYZE_CHI_MIN_EXPECTED)
+        {
+            double delta = stats->histogram[value] - expected;
+            chi_square += delta * delta / expected;
+            categories++;
+        }
+    }
+    return categories > 1 ? gamma_q((categories - 1) / 2.0, chi_square / 2.0) : 0;
+}
+
+/* Sample Pair Rate
+ * Description: Smaller root of (W + Z) / 2 p^2 + (2X - P) p + Y - X = 0
+ */
+double lsb_sample_pair_rate(const LsbStats *stats)
+{
+    double p = stats->pairs, x = stats->pairs_x, z = stats->pairs_z, w = stats->pairs_w, y = p - x - z;
+    double a = (w + z) / 2, b = 2 * x - p, c = y - x, rate;
+    if(a == 0)
+    {
+        rate = b != 0 ? -c / b : 0;
+    }
+    else
+    {
+        double discriminant = b * b - 4 * a * c;
+        rate = (-b - sqrt(discriminant > 0 ? discriminant : 0)) / (2 * a);
+    }
+    return rate < 0 ? 0 : rate > 1 ? 1 : rate;
+}
+/* Function Definitions */
+
+/* Scan a raw pixel region through a read only mapping of the image */
+static Status analyze_mapped(int fd_image, const CoverInfo *cover, LsbStats *stats)
+{
+    long length = cover->data_offset + cover->data_size;
+    unsigned char *image = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd_image, 0);
+    if(image == MAP_FAILED)
+    {
+        return e_failure;
+    }
+    buf_advise_mapping(image, length);
+    for(long offset = 0; offset < cover->data_size; offset += ANALYZE_BLOCK_SIZE)
+    {
+        long carry = offset > 0 ? cover->channels : 0; // Pairs continue from the previous block
+        long size = cover->data_size - offset < ANALYZE_BLOCK_SIZE ? cover->data_size - offset : ANALYZE_BLOCK_SIZE;
+        lsb_stats_update(stats, image + cover->data_offset + offset - carry, size + carry, carry, cover->channels);
+    }
+    munmap(image, length);
+    return e_success;
+}
+
+/* Scan a pixel stream block by block */
+static Status analyze_stream(FILE *fptr_pixels, const CoverInfo *cover, LsbStats *stats)
+{
+    size_t buffer_size = ANALYZE_BLOCK_SIZE + cover->channels;
+    unsigned char *buffer = buf_alloc(buffer_size);
+    if(buffer == NULL)
+    {
+        return e_failure;
+    }
+    long carry = 0, read;
+    while((read = fread(buffer + carry, sizeof(char), ANALYZE_BLOCK_SIZE, fptr_pixels)) > 0)
+    {
+        lsb_stats_update(stats, buffer, carry + read, carry, cover->channels);
+        if(carry + read >= cover->channels)
+        {
+            memmove(buffer, buffer + carry + read - cover->channels, cover->channels);
+            carry = cover->channels;
+        }
+    }
+    Status status = ferror(fptr_pixels) ? e_failure : e_success;
+    buf_free(buffer, buffer_size);
+    return status;
+}
+
+/* Analyze Footprint
+ * Description: A raw image is mapped whole and the pages scanned stay resident
+ * until it is unmapped; other images are streamed a block at a time
+ */
+static long analyze_footprint(const char *image_fname)
+{
+    CoverInfo cover = {0};
+    long footprint = cover_file_footprint(image_fname, 0, &cover);
+    if(footprint > 0 && cover.format->open_reader == NULL)
+    {
+        footprint += cover.data_offset + cover.data_size;
+    }
+    return footprint;
+}
+
+/* Analyze Image (worker job) */
+static Status analyze_job(void *arg)
+{
+    AnalyzeJob *job = arg;
+    CoverInfo cover = {0};
+    LsbStats stats = {{0}};
+    job->status = e_failure;
+    FILE *fptr_image = fopen(job->image_fname, "r");
+    if(fptr_image == NULL)
+    {
+        printf(RED "Error: Unable to open file %s\n" RESET, job->image_fname);
+        return e_failure;
+    }
+    if(cover_open(fptr_image, &cover) == e_success)
+    {
+        if(cover.format->open_reader == NULL)
+        {
+            job->status = analyze_mapped(fileno(fptr_image), &cover, &stats);
+        }
+        else if(cover_open_pixels(&fptr_image, &cover) == e_success)
+        {
+            job->status = analyze_stream(fptr_image, &cover, &stats);
+        }
+    }
+    fclose(fptr_image);
+    if(job->status == e_failure)
+    {
+        printf(RED "Error: Unable to analyze %s\n" RESET, job->image_fname);
+        return e_failure;
+    }
+    job->chi_score = lsb_chi_square_score(&stats);
+    job->rate = lsb_sample_pair_rate(&stats);
+    return e_success;
+}
+/* Function Definitions */
+
+/*
+ * Validate Analyze Command Line Arguments
+ * Inputs: Command line arguments: -A <image>...
+ * Return Values: e_success or e_failure
+ */
+Status read_and_validate_analyze_args(int argc, char *argv[], AnalyzeInfo *analyzeInfo)
+{
+    analyzeInfo->image_fnames = &argv[2];
+    analyzeInfo->image_count = argc - 2;
+    for(int i = 0; i < analyzeInfo->image_count; i++)
+    {
+        if(cover_format_for_name(analyzeInfo->image_fnames[i]) == NULL)
+        {
+            printf(RED "Image %s is not of a supported type (%s)\n" RESET, analyzeInfo->image_fnames[i], cover_supported_extns());
+            return e_failure;
+        }
+    }
+    return e_success;
+}
+/* Function Definitions */
+
+/*
+ * Validate Analyze Options
+ * Inputs: Options separated from the positional command line arguments
+ * Output: Worker thread count when --threads N is passed
+ * Return Values: e_success or e_failure
+ */
+Status read_and_validate_analyze_options(char *options[], AnalyzeInfo *analyzeInfo)
+{
+    for(int i = 0; options[i] != NULL; i++)
+    {
+        if(strcmp(options[i], "--threads") == 0 && options[i + 1] != NULL)
+        {
+            analyzeInfo->thread_count = atoi(options[++i]);
+            if(analyzeInfo->thread_count <= 0)
+            {
+                printf(RED "Invalid Thread Count %s\n" RESET, options[i]);
+                return e_failure;
+            }
+        }
+        else
+        {
+            printf(RED "Unsupported Analyze Option %s\n" RESET, options[i]);
+            return e_failure;
+        }
+    }
+    return e_success;
+}
+/* Function Definitions */
+
+/*
+ * Analyze Images
+ * Inputs: AnalyzeInfo with the image names
+ * Output: One line per image with its chi-square score and embedding rate,
+ * printed in command line order batch by batch
+ * Return Value: e_success, or e_failure when an image could not be analyzed
+ */
+Status analyze_images(AnalyzeInfo *analyzeInfo)
+{
+    int batch_size = analyzeInfo->image_count < ANALYZE_BATCH_SIZE ? analyzeInfo->image_count : ANALYZE_BATCH_SIZE;
+    AnalyzeJob *jobs = calloc(batch_size, sizeof(AnalyzeJob));
+    WorkerPool *pool = pool_create(analyzeInfo->thread_count);
+    if(jobs == NULL || pool == NULL)
+    {
+        printf(RED "Error: Unable to start the analysis workers\n" RESET);
+        free(jobs);
+        if(pool != NULL)
+        {
+            pool_destroy(pool);
+        }
+        return e_failure;
+    }
+    Status status = e_success;
+    int flagged = 0;
+    for(int first = 0; first < analyzeInfo->image_count; first += batch_size)
+    {
+        int count = analyzeInfo->image_count - first < batch_size ? analyzeInfo->image_count - first : batch_size;
+        for(int i = 0; i < count; i++)
+        {
+            jobs[i].image_fname = analyzeInfo->image_fnames[first + i];
+            long footprint = pool->budget > 0 ? analyze_footprint(jobs[i].image_fname) : 0; // Gigapixel images wait for room, small ones backfill
+            if(pool_submit_sized(pool, pool_job_node(pool, i), footprint, analyze_job, &jobs[i]) == e_failure)
+            {
+                jobs[i].status = e_failure;
+            }
+        }
+        if(pool_wait(pool) == e_failure)
+        {
+            status = e_failure;
+        }
+        for(int i = 0; i < count; i++)
+        {
+            if(jobs[i].status == e_failure)
+            {
+                status = e_failure;
+                continue;
+            }
+            int suspicious = jobs[i].rate >= ANALYZE_RATE_THRESHOLD || jobs[i].chi_score >= ANALYZE_CHI_THRESHOLD;
+            flagged += suspicious;
+            printf("%s: chi-square %.4f, sample pair rate %.4f %s\n" RESET, jobs[i].image_fname, jobs[i].chi_score, jobs[i].rate,
+                   suspicious ? RED "SUSPICIOUS" : GRN "clean");
+        }
+    }
+    pool_destroy(pool);
+    free(jobs);
+    info_printf(YEL "INFO: %d of %d images flagged\n" RESET, flagged, analyzeInfo->image_count);
+    return status;
+}
@@ -0,0 +1,60 @@
+#ifndef ANALYZE_H
+#define ANALYZE_H
+
+#include "types.h"
+#include "cover.h"
+
+/*
+ * LSB steganalysis (-A). Flags images carrying an LSB payload of any tool,
+ * not just our own "#*" format, with two classic statistics over the samples
+ * of the pixel region:
+ * - Westfeld's chi-square test: embedding equalizes the counts of the value
+ *   pairs (2k, 2k+1); the score is the probability the pairs are equalized.
+ * - Sample pair analysis (Dumitrescu, Wu, Wang): adjacent samples of the same
+ *   channel give a quadratic whose smaller root estimates the embedding rate.
+ * Raw images are mapped and scanned once; compressed and video covers are
+ * scanned once through their pixel streams. Images run in parallel on the pool,
+ * a raw image counted at the size of its mapping against the --memory budget
+ */
+
+#define ANALYZE_BLOCK_SIZE 65536 /* Samples per kernel pass, stays in L2 */
+#define ANALYZE_BATCH_SIZE 1024 /* Images analyzed before their results are printed */
+#define ANALYZE_CHI_MIN_EXPECTED 5.0 /* Pairs with fewer expected samples are left out of the test */
+#define ANALYZE_RATE_THRESHOLD 0.1 /* Embedding rate flagged as suspicious */
+#define ANALYZE_CHI_THRESHOLD 0.95 /* Chi-square probability flagged as suspicious */
+
+typedef struct _AnalyzeInfo
+{
+    char **image_fnames; /*Store the image names*/
+    int image_count; /*Store the number of images*/
+    int thread_count; /*Store the number of worker threads, 0 for one per CPU*/
+} AnalyzeInfo;
+
+typedef struct _LsbStats
+{
+    unsigned long histogram[256]; /*Store the count of every sample value*/
+    unsigned long pairs; /*Store the number of adjacent sample pairs*/
+    unsigned long pairs_x; /*Store the pairs with v even and u < v, or v odd and u > v*/
+    unsigned long pairs_z; /*Store the pairs with u == v*/
+    unsigned long pairs_w; /*Store the pairs (2k, 2k + 1) and (2k + 1, 2k)*/
+} LsbStats;
+
+/* Read and validate analyze args: <image>... */
+Status read_and_validate_analyze_args(int argc, char *argv[], AnalyzeInfo *analyzeInfo);
+
+/* Read and validate analyze options (--threads N) */
+Status read_and_validate_analyze_options(char *options[], AnalyzeInfo *analyzeInfo);
+
+/* Analyze every image in parallel and print a score per image */
+Status analyze_images(AnalyzeInfo *analyzeInfo);
+
+/* Add the histogram of the samples after the first counted ones and the pairs of samples channels apart */
+void lsb_stats_update(LsbStats *stats, const unsigned char *data, long size, long counted, int channels);
+
+/* Probability that the value pairs are equalized, 0 to 1 */
+double lsb_chi_square_score(const LsbStats *stats);
+
+/* Estimated fraction of samples carrying payload, 0 to 1 */
+double lsb_sample_pair_rate(const LsbStats *stats);
+
+#endif
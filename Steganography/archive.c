@@ -0,0 +1,349 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "archive.h"
+#include "checksum.h"
+#include "bufpool.h"
+#include "common.h"
+#include "types.h"
+#include "color.h"
+
+#define ARCHIVE_COPY_BUF_SIZE 4096
+
+/* Function Definitions */
+
+/* Archive Entry Name Check
+ * Description: Entries are plain file names, extracted into the working directory,
+ * so a name must not be empty, contain a slash or be a dot directory
+ * Return Values : Nonzero when name is one
+ */
+static int archive_name_valid(const char *name)
+{
+    return name[0] != '\0' && strchr(name, '/') == NULL && strcmp(name, ".") != 0 && strcmp(name, "..") != 0;
+}
+/* Function Definitions */
+
+/* Write the table of contents at the start of the archive
+ * Input: Archive file ptr, entries and their count
+ * Output: Preamble and one record per entry written at offset 0
+ * Return Values : e_success and e_failure
+ */
+static Status write_archive_toc(FILE *fptr_archive, ArchiveEntry *entries, uint count, uint toc_size)
+{
+    char record[2 + MAX_ARCHIVE_NAME_SIZE + 12];
+    rewind(fptr_archive);
+    put_le(record, count, 4);
+    put_le(record + 4, toc_size, 4);
+    if(fwrite(record, sizeof(char), ARCHIVE_PREAMBLE_SIZE, fptr_archive) < ARCHIVE_PREAMBLE_SIZE)
+    {
+        return e_failure;
+    }
+    for(uint i = 0; i < count; i++)
+    {
+        uint name_len = strlen(entries[i].name);
+        put_le(record, name_len, 2);
+        memcpy(record + 2, entries[i].name, name_len);
+        put_le(record + 2 + name_len, entries[i].offset, 4);
+        put_le(record + 6 + name_len, entries[i].length, 4);
+        put_le(record + 10 + name_len, entries[i].checksum, 4);
+        if(fwrite(record, sizeof(char), 14 + name_len, fptr_archive) < 14 + name_len)
+        {
+            return e_failure;
+        }
+    }
+    return e_success;
+}
+/* Function Definitions */
+
+/*
+ * Validate Archive Command Line Arguments
+ * Inputs: Command line arguments: -a <image> <output image> <file>...
+ * Output: source image name and output image name
+ * Return Values: e_success or e_failure
+ */
+Status read_and_validate_archive_args(char *argv[], EncodeInfo *encInfo)
+{
+    const CoverFormat *format = cover_format_for_name(argv[2]);
+    if(format == NULL)
+    {
+        printf(RED "Source Image File is not of a supported type (%s)\n" RESET, cover_supported_extns());
+        return e_failure;
+    }
+    if(cover_format_for_name(argv[3]) != format)
+    {
+        printf(RED "Output File name is not of type %s\n" RESET, strrchr(argv[2], '.'));
+        return e_failure;
+    }
+    encInfo->src_image_fname = argv[2];
+    encInfo->stego_image_fname = argv[3];
+    return e_success;
+}
+/* Function Definitions */
+
+/* Build Archive
+ * Input: NULL terminated list of files to pack
+ * Output: Temporary archive set as the secret file of encInfo
+ * Description: Write the table of contents with every entry's offset and length,
+ * copy the file bodies after it while computing their CRC32C, then rewrite
+ * the table with the checksums. The archive is embedded like any other secret file
+ * with the extension .arc
+ * Return Values : e_success and e_failure
+ */
+Status build_archive(char *files[], EncodeInfo *encInfo)
+{
+    uint count = 0;
+    while(files[count] != NULL)
+    {
+        count++;
+    }
+    ArchiveEntry *entries = calloc(count, sizeof(ArchiveEntry));
+    FILE *fptr_archive = tmpfile();
+    if(entries == NULL || fptr_archive == NULL)
+    {
+        printf(RED "Error: Unable to create archive\n" RESET);
+        free(entries);
+        return e_failure;
+    }
+    info_pause();
+    info_printf(YEL "INFO: Packing %u Files into Archive\n" RESET, count);
+    /* Size the table of contents from the entry names */
+    uint toc_size = ARCHIVE_PREAMBLE_SIZE;
+    for(uint i = 0; i < count; i++)
+    {
+        const char *name = strrchr(files[i], '/') ? strrchr(files[i], '/') + 1 : files[i];
+        if(!archive_name_valid(name) || strlen(name) > MAX_ARCHIVE_NAME_SIZE)
+        {
+            printf(RED "Error: Invalid Archive Entry Name %s\n" RESET, files[i]);
+            free(entries);
+            fclose(fptr_archive);
+            return e_failure;
+        }
+        strcpy(entries[i].name, name);
+        toc_size += 14 + strlen(name);
+    }
+    if(write_archive_toc(fptr_archive, entries, count, toc_size) == e_failure)
+    {
+        printf(RED "Error Writing Archive Table of Contents\n" RESET);
+        free(entries);
+        fclose(fptr_archive);
+        return e_failure;
+    }
+    /* Copy the bodies, recording where each one landed */
+    char buffer[ARCHIVE_COPY_BUF_SIZE];
+    uint offset = toc_size;
+    for(uint i = 0; i < count; i++)
+    {
+        FILE *fptr_file = fopen(files[i], "r");
+        if(fptr_file == NULL)
+        {
+            printf(RED "Error: Unable to open file %s\n" RESET, files[i]);
+            free(entries);
+            fclose(fptr_archive);
+            return e_failure;
+        }
+        entries[i].offset = offset;
+        size_t read;
+        while((read = fread(buffer, sizeof(char), ARCHIVE_COPY_BUF_SIZE, fptr_file)) > 0)
+        {
+            if(fwrite(buffer, sizeof(char), read, fptr_archive) < read)
+            {
+                break;
+            }
+            entries[i].checksum = crc32c_update(entries[i].checksum, buffer, read);
+            entries[i].length += read;
+        }
+        if(ferror(fptr_file) || ferror(fptr_archive))
+        {
+            printf(RED "Error: Unable to pack %s into the archive\n" RESET, files[i]);
+            fclose(fptr_file);
+            free(entries);
+            fclose(fptr_archive);
+            return e_failure;
+        }
+        fclose(fptr_file);
+        offset += entries[i].length;
+    }
+    if(write_archive_toc(fptr_archive, entries, count, toc_size) == e_failure || fflush(fptr_archive) != 0)
+    {
+        printf(RED "Error Writing Archive Table of Contents\n" RESET);
+        free(entries);
+        fclose(fptr_archive);
+        return e_failure;
+    }
+    free(entries);
+    encInfo->fptr_secret = fptr_archive;
+    encInfo->secret_fname = "archive";
+    strcpy(encInfo->extn_secret_file, ARCHIVE_EXTN);
+    encInfo->binary_payload = 1;
+    return e_success;
+}
+/* Function Definitions */
+
+/* Open Archive
+ * Input: DecodeInfo with the stego image name
+ * Output: Image opened and payload header decoded
+ * Description: The payload must carry the .arc extension
+ * Return Values : e_success and e_failure
+ */
+static Status open_archive(DecodeInfo *decInfo)
+{
+    decInfo->secret_fname = NULL; // Only the header is needed, no secret file is created
+    if(open_image_file(decInfo) == e_failure || decode_secret_file_header(decInfo) == e_failure)
+    {
+        return e_failure;
+    }
+    if(strcmp(decInfo->extn_secret_file, ARCHIVE_EXTN) != 0)
+    {
+        printf(RED "Error: %s does not contain an archive\n" RESET, decInfo->src_image_fname);
+        return e_failure;
+    }
+    return e_success;
+}
+/* Function Definitions */
+
+/* Read Archive Table of Contents
+ * Input: DecodeInfo with the archive payload header decoded
+ * Output: Array of entries in the decoder arena and its count
+ * Description: Decode only the preamble and the table, leaving the bodies untouched
+ * Return Values : e_success and e_failure
+ */
+Status read_archive_toc(DecodeInfo *decInfo, ArchiveEntry **entries, uint *count)
+{
+    char preamble[ARCHIVE_PREAMBLE_SIZE];
+    if(decInfo->size_secret_file < ARCHIVE_PREAMBLE_SIZE ||
+       decode_secret_file_range(decInfo, 0, ARCHIVE_PREAMBLE_SIZE, preamble) == e_failure)
+    {
+        printf(RED "Error Decoding Archive Preamble\n" RESET);
+        return e_failure;
+    }
+    *count = get_le(preamble, 4);
+    uint toc_size = get_le(preamble + 4, 4);
+    if(toc_size < ARCHIVE_PREAMBLE_SIZE || toc_size > decInfo->size_secret_file ||
+       *count > (toc_size - ARCHIVE_PREAMBLE_SIZE) / 14)
+    {
+        printf(RED "Error: Corrupted Archive Table of Contents\n" RESET);
+        return e_failure;
+    }
+    char *toc = arena_alloc(&decInfo->arena, toc_size);
+    *entries = arena_alloc(&decInfo->arena, (*count + 1) * sizeof(ArchiveEntry));
+    if(toc == NULL || *entries == NULL)
+    {
+        printf(RED "Error: Memory Allocation Failed\n" RESET);
+        return e_failure;
+    }
+    Status status = decode_secret_file_range(decInfo, 0, toc_size, toc);
+    uint pos = ARCHIVE_PREAMBLE_SIZE;
+    for(uint i = 0; status == e_success && i < *count; i++)
+    {
+        uint name_len = pos + 2 <= toc_size ? get_le(toc + pos, 2) : 0;
+        if(name_len == 0 || name_len > MAX_ARCHIVE_NAME_SIZE || pos + 14 + name_len > toc_size)
+        {
+            printf(RED "Error: Corrupted Archive Table of Contents\n" RESET);
+            status = e_failure;
+            break;
+        }
+        memcpy((*entries)[i].name, toc + pos + 2, name_len);
+        (*entries)[i].name[name_len] = '\0';
+        if(strlen((*entries)[i].name) != name_len || !archive_name_valid((*entries)[i].name)) // Extraction must stay in the working directory
+        {
+            printf(RED "Error: Invalid Archive Entry Name in Table of Contents\n" RESET);
+            status = e_failure;
+            break;
+        }
+        (*entries)[i].offset = get_le(toc + pos + 2 + name_len, 4);
+        (*entries)[i].length = get_le(toc + pos + 6 + name_len, 4);
+        (*entries)[i].checksum = get_le(toc + pos + 10 + name_len, 4);
+        if((long) (*entries)[i].offset + (*entries)[i].length > decInfo->size_secret_file)
+        {
+            printf(RED "Error: Archive Entry %s is out of bounds\n" RESET, (*entries)[i].name);
+            status = e_failure;
+        }
+        pos += 14 + name_len;
+    }
+    if(status == e_failure)
+    {
+        *entries = NULL;
+    }
+    return status;
+}
+/* Function Definitions */
+
+/* List Archive
+ * Input: DecodeInfo with the stego image name
+ * Output: One line per entry with its size, offset and checksum
+ * Return Values : e_success and e_failure
+ */
+Status list_archive(DecodeInfo *decInfo)
+{
+    ArchiveEntry *entries;
+    uint count;
+    if(open_archive(decInfo) == e_failure || read_archive_toc(decInfo, &entries, &count) == e_failure)
+    {
+        return e_failure;
+    }
+    printf(BOLD "%10s %10s %10s  %s\n" RESET, "SIZE", "OFFSET", "CRC32C", "NAME");
+    for(uint i = 0; i < count; i++)
+    {
+        printf("%10u %10u   %08x  %s\n", entries[i].length, entries[i].offset, entries[i].checksum, entries[i].name);
+    }
+    return e_success;
+}
+/* Function Definitions */
+
+/* Extract Archive Entry
+ * Input: DecodeInfo with the stego image name, entry name, output file name (NULL for the entry name)
+ * Output: Entry body written to the output file
+ * Description: Look the entry up in the table of contents and decode just its
+ * byte range, then verify it against the stored CRC32C
+ * Return Values : e_success and e_failure
+ */
+Status extract_archive_entry(DecodeInfo *decInfo, const char *name, const char *output_fname)
+{
+    ArchiveEntry *entries;
+    uint count;
+    if(open_archive(decInfo) == e_failure || read_archive_toc(decInfo, &entries, &count) == e_failure)
+    {
+        return e_failure;
+    }
+    ArchiveEntry *entry = NULL;
+    for(uint i = 0; i < count && entry == NULL; i++)
+    {
+        if(strcmp(entries[i].name, name) == 0)
+        {
+            entry = &entries[i];
+        }
+    }
+    if(entry == NULL)
+    {
+        printf(RED "Error: %s not found in archive\n" RESET, name);
+        return e_failure;
+    }
+    char *data = buf_alloc(entry->length + 1);
+    if(data == NULL)
+    {
+        printf(RED "Error: Memory Allocation Failed\n" RESET);
+        return e_failure;
+    }
+    Status status = decode_secret_file_range(decInfo, entry->offset, entry->length, data);
+    if(status == e_success && crc32c_update(0, data, entry->length) != entry->checksum)
+    {
+        printf(RED "Error: Checksum Mismatch for %s\n" RESET, name);
+        status = e_failure;
+    }
+    if(status == e_success)
+    {
+        FILE *fptr_output = fopen(output_fname ? output_fname : entry->name, "w");
+        if(fptr_output == NULL || fwrite(data, sizeof(char), entry->length, fptr_output) < entry->length)
+        {
+            printf(RED "Error: Unable to write %s\n" RESET, output_fname ? output_fname : entry->name);
+            status = e_failure;
+        }
+        if(fptr_output != NULL)
+        {
+            fclose(fptr_output);
+        }
+    }
+    buf_free(data, entry->length + 1);
+    return status;
+}
@@ -0,0 +1,44 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <stdio.h>
+#include "types.h"
+#include "encode.h"
+#include "decode.h"
+
+/*
+ * Archive payload layout (all integers little endian)
+ * [entry count : 4][toc size : 4]
+ * per entry: [name length : 2][name][offset : 4][length : 4][crc32c : 4]
+ * followed by the file bodies. Offsets are from the start of the payload,
+ * so a single entry can be decoded with decode_secret_file_range
+ */
+
+#define ARCHIVE_EXTN ".arc"
+#define ARCHIVE_PREAMBLE_SIZE 8
+#define MAX_ARCHIVE_NAME_SIZE 255
+
+typedef struct _ArchiveEntry
+{
+    char name[MAX_ARCHIVE_NAME_SIZE + 1]; /*Store the entry name (base name of the packed file)*/
+    uint offset; /*Store the offset of the entry body inside the payload*/
+    uint length; /*Store the size of the entry body*/
+    uint checksum; /*Store the CRC32C of the entry body*/
+} ArchiveEntry;
+
+/* Read and validate archive args: <image> <output image> <file>... */
+Status read_and_validate_archive_args(char *argv[], EncodeInfo *encInfo);
+
+/* Pack the files into a temporary archive used as the secret file */
+Status build_archive(char *files[], EncodeInfo *encInfo);
+
+/* Decode the table of contents of an archive payload, entries live until arena_release(&decInfo->arena) */
+Status read_archive_toc(DecodeInfo *decInfo, ArchiveEntry **entries, uint *count);
+
+/* Print the archive entries */
+Status list_archive(DecodeInfo *decInfo);
+
+/* Decode a single named entry without decoding the others */
+Status extract_archive_entry(DecodeInfo *decInfo, const char *name, const char *output_fname);
+
+#endif
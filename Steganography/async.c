@@ -0,0 +1,280 @@
+#include <stdio.h>
+#include <string.h>
+#include "async.h"
+#include "bufpool.h"
+#include "trace.h"
+#include "types.h"
+#include "common.h"
+#include "color.h"
+
+/* Steps of an asynchronous encoding, in pipeline order */
+typedef enum
+{
+    async_encode_open,
+    async_encode_capacity,
+    async_encode_header,
+    async_encode_magic,
+    async_encode_extn_size,
+    async_encode_extn,
+    async_encode_size,
+    async_encode_data_start,
+    async_encode_data,
+    async_encode_data_finish,
+    async_encode_tail,
+    async_encode_close,
+    async_encode_done
+} AsyncEncodeStage;
+
+/* Steps of an asynchronous decoding, in pipeline order */
+typedef enum
+{
+    async_decode_open,
+    async_decode_magic,
+    async_decode_extn_size,
+    async_decode_extn,
+    async_decode_open_secret,
+    async_decode_size,
+    async_decode_data_start,
+    async_decode_data,
+    async_decode_data_finish,
+    async_decode_done
+} AsyncDecodeStage;
+
+/* Function Definitions */
+
+/* Copy One Block of the Tail
+ * Input: Job at the tail stage
+ * Output: One buffer of the cover copied to the stego image, the buffer released at the end
+ * Return Values : e_success and e_failure
+ */
+static Status async_encode_tail_step(AsyncJob *job)
+{
+    EncodeInfo *encInfo = job->encInfo;
+    if(job->buffer == NULL)
+    {
+        info_printf(YEL "INFO: Copying Left Over Data\n" RESET);
+        job->buffer_size = tune_config.chunk_size * MAX_IMAGE_BUF_SIZE;
+        job->buffer = buf_alloc(job->buffer_size);
+        if(job->buffer == NULL)
+        {
+            return e_failure;
+        }
+    }
+    long copied = copy_remaining_img_block(encInfo->fptr_src_image, encInfo->fptr_stego_image, job->buffer, job->buffer_size, &encInfo->progress);
+    if(copied > 0)
+    {
+        return e_success; // More to copy, stay at this stage
+    }
+    buf_free(job->buffer, job->buffer_size);
+    job->buffer = NULL;
+    job->stage = async_encode_close;
+    return copied == 0 ? e_success : e_failure;
+}
+
+/* Run One Step of an Encoding
+ * Input: Job with encInfo
+ * Output: job->stage moved to the next step (kept for chunked stages with work left)
+ * Return Values : e_success and e_failure
+ */
+static Status async_encode_step(AsyncJob *job)
+{
+    EncodeInfo *encInfo = job->encInfo;
+    Status status = e_success;
+    switch(job->stage)
+    {
+        case async_encode_open:
+            status = open_files(encInfo);
+            break;
+        case async_encode_capacity:
+            status = check_capacity(encInfo);
+            break;
+        case async_encode_header:
+            status = copy_image_header(encInfo);
+            break;
+        case async_encode_magic:
+            status = encode_magic_string(MAGIC_STRING, encInfo);
+            break;
+        case async_encode_extn_size:
+            status = encode_secret_file_extn_size(strlen(encInfo->extn_secret_file), encInfo);
+            break;
+        case async_encode_extn:
+            status = encode_secret_file_extn(encInfo->extn_secret_file, encInfo);
+            break;
+        case async_encode_size:
+            status = encode_secret_file_size(encInfo->size_secret_file, encInfo);
+            break;
+        case async_encode_data_start:
+            status = encode_secret_data_start(encInfo);
+            break;
+        case async_encode_data:
+            if(encInfo->data_remaining > 0)
+            {
+                status = encode_secret_data_step(encInfo);
+                if(encInfo->data_remaining > 0)
+                {
+                    return status;
+                }
+            }
+            break;
+        case async_encode_data_finish:
+            status = encode_secret_data_finish(encInfo);
+            if(encInfo->update_in_place) // Past the payload an updated image is left as it is
+            {
+                job->stage = async_encode_close;
+                return status;
+            }
+            break;
+        case async_encode_tail:
+            return async_encode_tail_step(job);
+        case async_encode_close:
+            status = close_stego_image(encInfo);
+            break;
+    }
+    job->stage++;
+    return status;
+}
+
+/* Run One Step of a Decoding
+ * Input: Job with decInfo
+ * Output: job->stage moved to the next step (kept for the data stage with work left)
+ * Return Values : e_success and e_failure
+ */
+static Status async_decode_step(AsyncJob *job)
+{
+    DecodeInfo *decInfo = job->decInfo;
+    Status status = e_success;
+    switch(job->stage)
+    {
+        case async_decode_open:
+            status = open_image_file(decInfo);
+            break;
+        case async_decode_magic:
+            status = decode_magic_string(MAGIC_STRING, decInfo);
+            break;
+        case async_decode_extn_size:
+            status = decode_secret_file_extn_size(decInfo);
+            break;
+        case async_decode_extn:
+            status = decode_secret_file_extn(decInfo);
+            break;
+        case async_decode_open_secret:
+            status = open_secret_file(decInfo);
+            break;
+        case async_decode_size:
+            status = decode_secret_file_size(decInfo);
+            break;
+        case async_decode_data_start:
+            status = decode_secret_data_start(decInfo);
+            break;
+        case async_decode_data:
+            if(decInfo->payload_remaining > 0)
+            {
+                status = decode_secret_data_step(decInfo);
+                if(decInfo->payload_remaining > 0)
+                {
+                    return status;
+                }
+            }
+            break;
+        case async_decode_data_finish:
+            status = decode_secret_data_finish(decInfo);
+            break;
+    }
+    job->stage++;
+    return status;
+}
+/* Function Definitions */
+
+/* Start a Job
+ * Description: The first step is scheduled like every other, so nothing runs on the caller's thread.
+ * The process goes quiet first, a step must not hold its thread in a banner's pause
+ * Return Values : e_success, e_failure when the reactor refused the job (complete is not called then)
+ */
+static Status async_start(AsyncJob *job, AsyncReactor *reactor, AsyncComplete complete, void *data)
+{
+    job->reactor = reactor;
+    job->complete = complete;
+    job->data = data;
+    job->stage = 0;
+    job->status = e_success;
+    job->buffer = NULL;
+    job->buffer_size = 0;
+    quiet_mode = 1;
+    return reactor->schedule(reactor->context, job);
+}
+
+Status async_encode(AsyncJob *job, EncodeInfo *encInfo, AsyncReactor *reactor, AsyncComplete complete, void *data)
+{
+    job->encInfo = encInfo;
+    job->decInfo = NULL;
+    return async_start(job, reactor, complete, data);
+}
+
+Status async_decode(AsyncJob *job, DecodeInfo *decInfo, AsyncReactor *reactor, AsyncComplete complete, void *data)
+{
+    job->encInfo = NULL;
+    job->decInfo = decInfo;
+    return async_start(job, reactor, complete, data);
+}
+/* Function Definitions */
+
+/* Step a Job
+ * Input: A started job which has not completed
+ * Description: A job whose reactor cannot take it back fails. The job is not
+ * touched after complete, which may free it
+ */
+void async_step(AsyncJob *job)
+{
+    Status status;
+    int done;
+    TRACE_BEGIN("async", "step");
+    if(job->encInfo != NULL)
+    {
+        status = async_encode_step(job);
+        done = job->stage == async_encode_done;
+    }
+    else
+    {
+        status = async_decode_step(job);
+        done = job->stage == async_decode_done;
+    }
+    TRACE_END();
+    if(status == e_success && !done)
+    {
+        if(job->reactor->schedule(job->reactor->context, job) == e_success)
+        {
+            return;
+        }
+        printf(RED "Error: Unable to schedule the next step\n" RESET);
+        status = e_failure;
+    }
+    if(job->buffer != NULL)
+    {
+        buf_free(job->buffer, job->buffer_size);
+        job->buffer = NULL;
+    }
+    job->status = status;
+    job->complete(job);
+}
+/* Function Definitions */
+
+static Status async_pool_job(void *arg)
+{
+    async_step(arg);
+    return e_success; // Failures are reported through complete
+}
+
+static Status async_pool_schedule(void *context, AsyncJob *job)
+{
+    return pool_submit(context, async_pool_job, job);
+}
+
+/* Pool Reactor
+ * Description: Steps are queued behind the steps of every other job, so a pool
+ * of a few workers takes its jobs a chunk at a time in turn
+ */
+void async_pool_reactor(AsyncReactor *reactor, WorkerPool *pool)
+{
+    reactor->context = pool;
+    reactor->schedule = async_pool_schedule;
+}
@@ -0,0 +1,61 @@
+#ifndef ASYNC_H
+#define ASYNC_H
+
+#include "types.h"
+#include "encode.h"
+#include "decode.h"
+#include "pool.h"
+
+/*
+ * Asynchronous encoding and decoding. An AsyncJob runs the do_encoding or
+ * do_decoding pipeline one step at a time: every header and metadata stage is
+ * a step, the data and tail stages take one chunk per step, so no step holds
+ * its thread for more than one chunk of I/O. After each step the job hands
+ * itself to its reactor, which calls async_step again when it sees fit, on any
+ * thread. The pool reactor interleaves any number of jobs on the workers of a
+ * WorkerPool; an event loop or coroutine executor plugs in its own schedule
+ * function and resumes its awaiting task from the complete callback.
+ * Jobs do not collect --stats, and the caller cleans up after a failed job
+ * as after a failed do_encoding or do_decoding. Starting a job sets quiet_mode
+ * for the whole process, as batch and watch do: the INFO banners and their one
+ * second pauses would otherwise stall the reactor's threads. Errors are still
+ * printed. tools/asynccheck.c runs jobs side by side against the synchronous paths
+ */
+
+typedef struct _AsyncJob AsyncJob;
+
+/* Called once the job finished, job->status holds the result; the job may be freed from here */
+typedef void (*AsyncComplete)(AsyncJob *job);
+
+typedef struct _AsyncReactor
+{
+    void *context; /*Store the executor the schedule function hands jobs to*/
+    Status (*schedule)(void *context, AsyncJob *job); /*Arrange for async_step(job) to run, e_failure if it cannot*/
+} AsyncReactor;
+
+struct _AsyncJob
+{
+    EncodeInfo *encInfo; /*Store the encoding run by the job, NULL for a decoding*/
+    DecodeInfo *decInfo; /*Store the decoding run by the job, NULL for an encoding*/
+    AsyncReactor *reactor; /*Store the reactor which resumes the job*/
+    AsyncComplete complete; /*Store the function told when the job finished*/
+    void *data; /*Store the caller's argument, untouched by the job*/
+    int stage; /*Store the pipeline stage of the next step*/
+    Status status; /*Store the result once the job finished*/
+    char *buffer; /*Store the tail copy buffer of an encoding*/
+    size_t buffer_size; /*Store the size of buffer*/
+};
+
+/* Start encoding encInfo (set up as for do_encoding), complete is called when it finished */
+Status async_encode(AsyncJob *job, EncodeInfo *encInfo, AsyncReactor *reactor, AsyncComplete complete, void *data);
+
+/* Start decoding decInfo (set up as for do_decoding), complete is called when it finished */
+Status async_decode(AsyncJob *job, DecodeInfo *decInfo, AsyncReactor *reactor, AsyncComplete complete, void *data);
+
+/* Run the next step of the job, then schedule it again or complete it */
+void async_step(AsyncJob *job);
+
+/* Reactor running the steps of its jobs as jobs of pool, pool_wait returns once all finished */
+void async_pool_reactor(AsyncReactor *reactor, WorkerPool *pool);
+
+#endif
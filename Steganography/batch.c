@@ -0,0 +1,544 @@
+#define _GNU_SOURCE /* open_memstream */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include <time.h>
+#include "batch.h"
+#include "decode.h"
+#include "cover.h"
+#include "pool.h"
+#include "trace.h"
+#include "types.h"
+#include "common.h"
+#include "color.h"
+
+#define TAR_NAME_SIZE 100
+#define TAR_PREFIX_SIZE 155
+
+/* One image of the window decoded ahead of the writer */
+typedef struct _BatchJob
+{
+    BatchInfo *batchInfo; /*Store the key and the completion signal*/
+    WorkerPool *pool; /*Store the pool the payload in memory is charged to*/
+    char image_fname[PATH_MAX]; /*Store the image name*/
+    char extn[MAX_FILE_SUFFIX + 1]; /*Store the recovered extension*/
+    long size; /*Store the payload size*/
+    char *data; /*Store a payload kept in memory*/
+    size_t data_size; /*Store the bytes in data*/
+    long held; /*Store the bytes of data charged to the pool until the job is released*/
+    FILE *fptr_spool; /*Store a payload too large for memory, NULL when it is in data*/
+    int payload; /*Set when the image carries a payload*/
+    Status status; /*Store the result of the extraction*/
+    int done; /*Set by the worker once the image is finished*/
+} BatchJob;
+
+/* Function Definitions */
+
+/*
+ * Validate Batch Command Line Arguments
+ * Inputs: Command line arguments: -T <archive or -> [image...]
+ * Return Values: e_success or e_failure
+ */
+Status read_and_validate_batch_args(int argc, char *argv[], BatchInfo *batchInfo)
+{
+    batchInfo->output_fname = argv[2];
+    batchInfo->image_fnames = argc > 3 ? &argv[3] : NULL;
+    batchInfo->image_count = argc - 3;
+    for(int i = 0; i < batchInfo->image_count; i++)
+    {
+        if(cover_format_for_name(batchInfo->image_fnames[i]) == NULL)
+        {
+            printf(RED "Image %s is not of a supported type (%s)\n" RESET, batchInfo->image_fnames[i], cover_supported_extns());
+            return e_failure;
+        }
+    }
+    if(batchInfo->image_fnames == NULL && isatty(STDIN_FILENO))
+    {
+        printf(RED "Error: Pass the images, or their names on stdin\n" RESET);
+        return e_failure;
+    }
+    return e_success;
+}
+/* Function Definitions */
+
+/*
+ * Validate Batch Options
+ * Inputs: Options separated from the positional command line arguments
+ * Output: Key, worker thread count and output policy when passed
+ * Return Values: e_success or e_failure
+ */
+Status read_and_validate_batch_options(char *options[], BatchInfo *batchInfo)
+{
+    for(int i = 0; options[i] != NULL; i++)
+    {
+        if(strcmp(options[i], "--key") == 0 && options[i + 1] != NULL)
+        {
+            batchInfo->key = options[++i];
+        }
+        else if(strcmp(options[i], "--threads") == 0 && options[i + 1] != NULL)
+        {
+            batchInfo->thread_count = atoi(options[++i]);
+            if(batchInfo->thread_count <= 0)
+            {
+                printf(RED "Invalid Thread Count %s\n" RESET, options[i]);
+                return e_failure;
+            }
+        }
+        else if(strcmp(options[i], "--direct") == 0)
+        {
+            batchInfo->output_policy->direct = 1;
+        }
+        else if(strcmp(options[i], "--durability") == 0 && options[i + 1] != NULL)
+        {
+            if(output_parse_durability(options[++i], batchInfo->output_policy) == e_failure)
+            {
+                return e_failure;
+            }
+        }
+        else
+        {
+            printf(RED "Unsupported Batch Option %s\n" RESET, options[i]);
+            return e_failure;
+        }
+    }
+    return e_success;
+}
+/* Function Definitions */
+
+/* Open the Payload Spool
+ * Input: Job, DecodeInfo with the payload size decoded
+ * Output: decInfo->fptr_secret writing into memory, or into an unlinked
+ * temporary file for payloads over BATCH_MEMORY_PAYLOAD
+ * Return Values : e_success and e_failure
+ */
+static Status batch_open_spool(BatchJob *job, DecodeInfo *decInfo)
+{
+    job->size = decInfo->size_secret_file;
+    strcpy(job->extn, decInfo->extn_secret_file);
+    if(job->size > BATCH_MEMORY_PAYLOAD)
+    {
+        decInfo->fptr_secret = job->fptr_spool = tmpfile();
+    }
+    else
+    {
+        decInfo->fptr_secret = open_memstream(&job->data, &job->data_size);
+    }
+    if(decInfo->fptr_secret == NULL)
+    {
+        printf(RED "Error: Unable to spool the payload of %s\n" RESET, job->image_fname);
+        return e_failure;
+    }
+    return e_success;
+}
+
+/* Extract an Image (worker job)
+ * Input: Job with the image name
+ * Output: The payload in memory or in the spool, extension and size in the job
+ * Description: Same stages as the decoder without creating the secret file.
+ * An image without the magic string is no failure, it is left out of the archive
+ * Return Values : e_success, failures are reported to the writer through the job
+ */
+static Status batch_extract(void *arg)
+{
+    BatchJob *job = arg;
+    BatchInfo *batchInfo = job->batchInfo;
+    DecodeInfo decInfo = {0};
+    decInfo.src_image_fname = job->image_fname;
+    decInfo.key = batchInfo->key;
+    Status status = e_failure;
+    job->payload = 1;
+    if(open_image_file(&decInfo) == e_success)
+    {
+        if(decode_magic_string(MAGIC_STRING, &decInfo) == e_failure)
+        {
+            job->payload = 0;
+            status = e_success;
+        }
+        else if(decode_secret_file_extn_size(&decInfo) == e_success &&
+                decode_secret_file_extn(&decInfo) == e_success &&
+                decode_secret_file_size(&decInfo) == e_success &&
+                batch_open_spool(job, &decInfo) == e_success &&
+                decode_secret_file_data(&decInfo) == e_success)
+        {
+            status = e_success;
+        }
+    }
+    if(job->fptr_spool != NULL) // Kept open for the writer
+    {
+        if(fflush(job->fptr_spool) != 0 || fseek(job->fptr_spool, 0, SEEK_SET) != 0)
+        {
+            status = e_failure;
+        }
+    }
+    else if(decInfo.fptr_secret != NULL && fclose(decInfo.fptr_secret) != 0) // Sets data and data_size
+    {
+        status = e_failure;
+    }
+    if(job->data != NULL) // Counted against the budget until written, not only while decoding
+    {
+        job->held = job->data_size;
+        pool_hold(job->pool, job->held);
+    }
+    if(decInfo.fptr_src_image != NULL)
+    {
+        fclose(decInfo.fptr_src_image);
+    }
+    arena_release(&decInfo.arena);
+    pthread_mutex_lock(&batchInfo->lock);
+    job->status = status;
+    job->done = 1;
+    pthread_cond_signal(&batchInfo->job_done);
+    pthread_mutex_unlock(&batchInfo->lock);
+    return e_success;
+}
+
+/* Release the payload of a written or failed job */
+static void batch_release(BatchJob *job)
+{
+    free(job->data);
+    job->data = NULL;
+    job->data_size = 0;
+    if(job->held > 0)
+    {
+        pool_release(job->pool, job->held);
+        job->held = 0;
+    }
+    if(job->fptr_spool != NULL)
+    {
+        fclose(job->fptr_spool);
+        job->fptr_spool = NULL;
+    }
+}
+/* Function Definitions */
+
+/* Fill a ustar Header
+ * Input: Block cleared to zeros, name and prefix fields, entry type, size, modification time
+ * Output: Header block with its checksum
+ */
+static void tar_fill_header(char *block, const char *name, int name_size, const char *prefix, int prefix_size, char type, unsigned long size, long mtime)
+{
+    memcpy(block, name, name_size);
+    snprintf(block + 100, 8, "%07o", 0644);
+    snprintf(block + 108, 8, "%07o", 0);
+    snprintf(block + 116, 8, "%07o", 0);
+    snprintf(block + 124, 12, "%011lo", size);
+    snprintf(block + 136, 12, "%011lo", (unsigned long) mtime);
+    memset(block + 148, ' ', 8); // The checksum counts its own field as spaces
+    block[156] = type;
+    memcpy(block + 257, "ustar", 6);
+    memcpy(block + 263, "00", 2);
+    memcpy(block + 345, prefix, prefix_size);
+    uint checksum = 0;
+    for(int i = 0; i < TAR_BLOCK_SIZE; i++)
+    {
+        checksum += (unsigned char) block[i];
+    }
+    snprintf(block + 148, 7, "%06o", checksum);
+}
+
+/* Write Padding
+ * Description: Zeros up to the next block boundary after size bytes of data
+ * Return Values : e_success and e_failure
+ */
+static Status tar_write_padding(FILE *fptr_tar, unsigned long size)
+{
+    static const char zeros[TAR_BLOCK_SIZE];
+    int padding = (TAR_BLOCK_SIZE - size % TAR_BLOCK_SIZE) % TAR_BLOCK_SIZE;
+    return fwrite(zeros, sizeof(char), padding, fptr_tar) == padding ? e_success : e_failure;
+}
+
+/* Write an Entry Header
+ * Input: Archive stream, entry name, payload size, modification time
+ * Description: A name longer than 100 bytes is split at a slash into prefix and
+ * name; one that can't be split is carried by a pax extended header in front
+ * Return Values : e_success and e_failure
+ */
+static Status tar_write_header(FILE *fptr_tar, const char *name, unsigned long size, long mtime)
+{
+    char block[TAR_BLOCK_SIZE];
+    int length = strlen(name), split = -1;
+    for(int i = 0; length > TAR_NAME_SIZE && i < length && i <= TAR_PREFIX_SIZE; i++)
+    {
+        if(name[i] == '/' && length - i - 1 <= TAR_NAME_SIZE && length - i - 1 > 0)
+        {
+            split = i;
+            break;
+        }
+    }
+    if(length > TAR_NAME_SIZE && split < 0)
+    {
+        char record[PATH_MAX + 32];
+        int text_size = length + strlen(" path=\n"), record_size = text_size;
+        while(text_size + snprintf(NULL, 0, "%d", record_size) != record_size) // The length counts its own digits
+        {
+            record_size = text_size + snprintf(NULL, 0, "%d", record_size);
+        }
+        snprintf(record, sizeof(record), "%d path=%s\n", record_size, name);
+        memset(block, 0, sizeof(block));
+        tar_fill_header(block, "PaxHeader", strlen("PaxHeader"), "", 0, 'x', record_size, mtime);
+        if(fwrite(block, sizeof(char), TAR_BLOCK_SIZE, fptr_tar) < TAR_BLOCK_SIZE ||
+           fwrite(record, sizeof(char), record_size, fptr_tar) < record_size || tar_write_padding(fptr_tar, record_size) == e_failure)
+        {
+            return e_failure;
+        }
+    }
+    memset(block, 0, sizeof(block));
+    if(split >= 0)
+    {
+        tar_fill_header(block, name + split + 1, length - split - 1, name, split, '0', size, mtime);
+    }
+    else
+    {
+        tar_fill_header(block, name, length < TAR_NAME_SIZE ? length : TAR_NAME_SIZE, "", 0, '0', size, mtime);
+    }
+    return fwrite(block, sizeof(char), TAR_BLOCK_SIZE, fptr_tar) == TAR_BLOCK_SIZE ? e_success : e_failure;
+}
+
+/* Write an Entry
+ * Input: Archive stream, finished job, modification time
+ * Output: Header, payload and padding appended; the entry is the image path
+ * without leading slashes with the recovered extension appended
+ * Return Values : e_success and e_failure
+ */
+static Status batch_write_entry(FILE *fptr_tar, BatchJob *job, long mtime)
+{
+    char name[PATH_MAX + MAX_FILE_SUFFIX + 1], buffer[BATCH_WRITE_BUF_SIZE / 16];
+    const char *image_fname = job->image_fname;
+    while(*image_fname == '/')
+    {
+        image_fname++;
+    }
+    snprintf(name, sizeof(name), "%s%s", image_fname, job->extn);
+    TRACE_BEGIN_BYTES("io", "write archive", job->size);
+    Status status = tar_write_header(fptr_tar, name, job->size, mtime);
+    if(status == e_success && job->fptr_spool == NULL)
+    {
+        status = job->data_size == job->size && fwrite(job->data, sizeof(char), job->size, fptr_tar) == job->size ? e_success : e_failure;
+    }
+    for(long remaining = job->size; status == e_success && job->fptr_spool != NULL && remaining > 0;)
+    {
+        size_t read = fread(buffer, sizeof(char), remaining < sizeof(buffer) ? remaining : sizeof(buffer), job->fptr_spool);
+        if(read == 0 || fwrite(buffer, sizeof(char), read, fptr_tar) < read)
+        {
+            status = e_failure;
+        }
+        remaining -= read;
+    }
+    if(status == e_success)
+    {
+        status = tar_write_padding(fptr_tar, job->size);
+    }
+    TRACE_END();
+    return status;
+}
+/* Function Definitions */
+
+/* Next Image Name
+ * Input: Index of the image, buffer of PATH_MAX bytes
+ * Description: From the command line, or the next non empty line of stdin
+ * Return Values : 1 with the name in fname, 0 when there are no more
+ */
+static int batch_next_image(BatchInfo *batchInfo, long index, char *fname)
+{
+    if(batchInfo->image_fnames != NULL)
+    {
+        if(index >= batchInfo->image_count)
+        {
+            return 0;
+        }
+        snprintf(fname, PATH_MAX, "%s", batchInfo->image_fnames[index]);
+        return 1;
+    }
+    while(fgets(fname, PATH_MAX, stdin) != NULL)
+    {
+        fname[strcspn(fname, "\n")] = '\0';
+        if(fname[0] != '\0')
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Open the Archive
+ * Output: Archive stream, the output file to commit (NULL for stdout)
+ * Description: For stdout the stream gets a duplicate of descriptor 1, which
+ * is then pointed at stderr, so no message can land inside the archive
+ * Return Values : e_success and e_failure
+ */
+static Status batch_open_archive(BatchInfo *batchInfo, FILE **fptr_tar, OutputFile **output)
+{
+    *output = NULL;
+    if(strcmp(batchInfo->output_fname, "-") == 0)
+    {
+        if(isatty(STDOUT_FILENO))
+        {
+            printf(RED "Error: Refusing to write an archive to a terminal\n" RESET);
+            return e_failure;
+        }
+        fflush(stdout);
+        int fd_tar = dup(STDOUT_FILENO);
+        if(fd_tar < 0 || dup2(STDERR_FILENO, STDOUT_FILENO) < 0 || (*fptr_tar = fdopen(fd_tar, "w")) == NULL)
+        {
+            printf(RED "Error: Unable to write the archive to stdout\n" RESET);
+            return e_failure;
+        }
+    }
+    else if((*fptr_tar = output_open(batchInfo->output_fname, 0, batchInfo->output_policy->direct, batchInfo->output_policy, output)) == NULL)
+    {
+        printf(RED "Error: Unable to open file %s\n" RESET, batchInfo->output_fname);
+        return e_failure;
+    }
+    setvbuf(*fptr_tar, NULL, _IOFBF, BATCH_WRITE_BUF_SIZE);
+    return e_success;
+}
+
+/* Close the Archive
+ * Description: Two zero blocks end the archive; a file replaces its name only once complete
+ * Return Values : e_success and e_failure
+ */
+static Status batch_close_archive(BatchInfo *batchInfo, FILE *fptr_tar, OutputFile *output, Status status)
+{
+    static const char end[2 * TAR_BLOCK_SIZE];
+    if(status == e_success && fwrite(end, sizeof(char), sizeof(end), fptr_tar) < sizeof(end))
+    {
+        status = e_failure;
+    }
+    if(fclose(fptr_tar) != 0)
+    {
+        status = e_failure;
+    }
+    if(output != NULL)
+    {
+        if(status == e_failure)
+        {
+            output_abort(output);
+        }
+        else if(output_commit(output, batchInfo->output_policy) == e_failure || output_policy_finish(batchInfo->output_policy) == e_failure)
+        {
+            status = e_failure;
+        }
+    }
+    if(status == e_failure)
+    {
+        printf(RED "Error: Unable to write the archive %s\n" RESET, batchInfo->output_fname);
+    }
+    return status;
+}
+
+/* Batch Footprint
+ * Description: The decoding of the image plus the payload it may keep in memory;
+ * the payload stays charged with pool_hold until the writer released it
+ */
+static long batch_footprint(const char *image_fname)
+{
+    CoverInfo cover = {0};
+    long footprint = cover_file_footprint(image_fname, 0, &cover);
+    long payload = cover.data_size / 8;
+    return footprint > 0 ? footprint + (payload < BATCH_MEMORY_PAYLOAD ? payload : BATCH_MEMORY_PAYLOAD) : 0;
+}
+/* Function Definitions */
+
+/*
+ * Extract Batch
+ * Inputs: BatchInfo with the archive name and the images
+ * Output: One archive entry per image carrying a payload, in input order
+ * Description: Workers decode up to a window of images ahead while this thread
+ * writes the oldest finished one and refills the window. Failed images are
+ * reported and left out, the archive still holds every other payload
+ * Return Value: e_success, or e_failure when an image failed or the archive could not be written
+ */
+Status extract_batch(BatchInfo *batchInfo)
+{
+    FILE *fptr_tar;
+    OutputFile *output;
+    if(batch_open_archive(batchInfo, &fptr_tar, &output) == e_failure)
+    {
+        return e_failure;
+    }
+    quiet_mode = 1; // One line per failed image instead of the stage banners
+    WorkerPool *pool = pool_create(batchInfo->thread_count);
+    int window = pool != NULL ? pool->thread_count * BATCH_WINDOW_PER_THREAD : 0;
+    BatchJob *jobs = calloc(window > 0 ? window : 1, sizeof(BatchJob));
+    if(pool == NULL || jobs == NULL)
+    {
+        printf(RED "Error: Unable to start the extraction workers\n" RESET);
+        if(pool != NULL)
+        {
+            pool_destroy(pool);
+        }
+        free(jobs);
+        return batch_close_archive(batchInfo, fptr_tar, output, e_failure);
+    }
+    pthread_mutex_init(&batchInfo->lock, NULL);
+    pthread_cond_init(&batchInfo->job_done, NULL);
+    Status status = e_success, write_status = e_success;
+    long submitted = 0, written = 0, extracted = 0, skipped = 0, failed = 0, bytes = 0, mtime = time(NULL);
+    int more = 1;
+    while(write_status == e_success)
+    {
+        for(; more && submitted < written + window; submitted++) // Keep the window full
+        {
+            BatchJob *job = &jobs[submitted % window];
+            memset(job, 0, sizeof(BatchJob));
+            job->batchInfo = batchInfo;
+            job->pool = pool;
+            if(!(more = batch_next_image(batchInfo, submitted, job->image_fname)))
+            {
+                break;
+            }
+            long footprint = pool->budget > 0 ? batch_footprint(job->image_fname) : 0;
+            if(pool_submit_sized(pool, POOL_ANY_NODE, footprint, batch_extract, job) == e_failure)
+            {
+                job->status = e_failure;
+                job->done = 1;
+            }
+        }
+        if(written == submitted)
+        {
+            break;
+        }
+        BatchJob *job = &jobs[written++ % window];
+        pthread_mutex_lock(&batchInfo->lock);
+        while(!job->done)
+        {
+            pthread_cond_wait(&batchInfo->job_done, &batchInfo->lock);
+        }
+        pthread_mutex_unlock(&batchInfo->lock);
+        if(job->status == e_failure)
+        {
+            printf(RED "Error: Extracting %s failed\n" RESET, job->image_fname);
+            failed++;
+            status = e_failure;
+        }
+        else if(!job->payload)
+        {
+            printf(YEL "INFO: %s carries no payload\n" RESET, job->image_fname);
+            skipped++;
+        }
+        else if((write_status = batch_write_entry(fptr_tar, job, mtime)) == e_success)
+        {
+            extracted++;
+            bytes += job->size;
+        }
+        batch_release(job);
+    }
+    pool_wait(pool); // Jobs still in the window when writing failed
+    for(; written < submitted; written++)
+    {
+        batch_release(&jobs[written % window]);
+    }
+    pool_destroy(pool);
+    free(jobs);
+    pthread_mutex_destroy(&batchInfo->lock);
+    pthread_cond_destroy(&batchInfo->job_done);
+    if(batch_close_archive(batchInfo, fptr_tar, output, write_status) == e_failure)
+    {
+        return e_failure;
+    }
+    printf(GRN "INFO: %ld payloads (%ld bytes) archived into %s, %ld images without payload, %ld failed\n" RESET,
+           extracted, bytes, batchInfo->output_fname, skipped, failed);
+    return status;
+}
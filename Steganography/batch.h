@@ -0,0 +1,46 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdio.h>
+#include <pthread.h>
+#include "types.h"
+#include "output.h"
+
+/*
+ * Batch extraction (-T). The payloads of many images go into one ustar
+ * archive instead of one output file per image, each entry named after its
+ * image with the recovered extension appended (photos/a.bmp.txt). Workers
+ * decode a window of images ahead of the writer, small payloads into memory
+ * and large ones into an unlinked spool file, and the writer appends them in
+ * command line order, so the archive is one sequential write. Images are
+ * taken from the command line, or one name per line from stdin when none are
+ * given. With - as the archive it goes to stdout and every message to stderr
+ */
+
+#define BATCH_WINDOW_PER_THREAD 4 /* Images decoded ahead of the writer per worker */
+#define BATCH_MEMORY_PAYLOAD (4 * 1024 * 1024) /* Largest payload kept in memory, larger ones are spooled */
+#define BATCH_WRITE_BUF_SIZE (1024 * 1024) /* Buffer of the archive stream */
+#define TAR_BLOCK_SIZE 512
+
+typedef struct _BatchInfo
+{
+    char *output_fname; /*Store the archive name, - for stdout*/
+    char **image_fnames; /*Store the image names of the command line, NULL to read them from stdin*/
+    int image_count; /*Store the number of image names on the command line*/
+    char *key; /*Store the passphrase of keyed and encrypted images, NULL for none*/
+    int thread_count; /*Store the number of worker threads, 0 for one per CPU*/
+    OutputPolicy *output_policy; /*Store how the archive file is written and synced*/
+    pthread_mutex_t lock; /*Serialize the workers reporting finished images*/
+    pthread_cond_t job_done; /*Signalled when an image is finished*/
+} BatchInfo;
+
+/* Read and validate batch args: <archive or -> [image...] */
+Status read_and_validate_batch_args(int argc, char *argv[], BatchInfo *batchInfo);
+
+/* Read and validate batch options (--key KEY, --threads N, --direct, --durability MODE) */
+Status read_and_validate_batch_options(char *options[], BatchInfo *batchInfo);
+
+/* Extract the payload of every image into the archive */
+Status extract_batch(BatchInfo *batchInfo);
+
+#endif
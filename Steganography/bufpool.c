@@ -0,0 +1,206 @@
+#define _GNU_SOURCE /* MADV_HUGEPAGE */
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#include "bufpool.h"
+#include "pool.h"
+
+typedef struct _FreeBuffer
+{
+    struct _FreeBuffer *next;
+} FreeBuffer;
+
+static struct
+{
+    pthread_mutex_t lock;
+    FreeBuffer *free_lists[BUF_POOL_NODES][BUF_POOL_CLASSES]; /*Store the free buffers of each node and size class*/
+    int free_counts[BUF_POOL_NODES][BUF_POOL_CLASSES]; /*Store the length of each free list*/
+} buf_pool = { PTHREAD_MUTEX_INITIALIZER, { { NULL } }, { { 0 } } };
+
+/* Function Definitions */
+
+/* Size Class
+ * Input: Requested size
+ * Return Values : Index of the smallest class holding size bytes, -1 when too large
+ */
+static int buf_class(size_t size)
+{
+    int class = 0;
+    while((size_t) BUF_MIN_SIZE << class < size)
+    {
+        if(++class == BUF_POOL_CLASSES)
+        {
+            return -1;
+        }
+    }
+    return class;
+}
+
+/* Allocate a New Buffer
+ * Description: Huge classes over-map by one huge page and trim both ends, so the
+ * buffer starts on a huge page boundary and can be backed by huge pages
+ */
+static void *buf_new(size_t class_size)
+{
+    if(class_size < BUF_HUGEPAGE_SIZE)
+    {
+        void *buf;
+        return posix_memalign(&buf, BUF_ALIGN, class_size) == 0 ? buf : NULL;
+    }
+    char *map = mmap(NULL, class_size + BUF_HUGEPAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(map == MAP_FAILED)
+    {
+        return NULL;
+    }
+    char *buf = (char *) (((uintptr_t) map + BUF_HUGEPAGE_SIZE - 1) & ~(BUF_HUGEPAGE_SIZE - 1));
+    if(buf > map)
+    {
+        munmap(map, buf - map);
+    }
+    munmap(buf + class_size, map + BUF_HUGEPAGE_SIZE - buf);
+    madvise(buf, class_size, MADV_HUGEPAGE); // Only a hint, kernels without THP still hand out small pages
+    return buf;
+}
+
+/* Node of a Buffer
+ * Description: Asks the kernel where the first page of buf lives; only on NUMA
+ * hosts, uniform ones have a single set of free lists
+ * Return Values : Free list set of the node
+ */
+static int buf_node(void *buf)
+{
+    int node = 0;
+    if(pool_node_count() > 1 &&
+       syscall(SYS_get_mempolicy, &node, NULL, 0, buf, MPOL_F_NODE | MPOL_F_ADDR) != 0)
+    {
+        node = pool_current_node();
+    }
+    return node % BUF_POOL_NODES;
+}
+
+static void buf_delete(void *buf, size_t class_size)
+{
+    if(class_size < BUF_HUGEPAGE_SIZE)
+    {
+        free(buf);
+    }
+    else
+    {
+        munmap(buf, class_size);
+    }
+}
+/* Function Definitions */
+
+void *buf_alloc(size_t size)
+{
+    int class = buf_class(size > 0 ? size : 1);
+    if(class < 0)
+    {
+        return NULL;
+    }
+    int node = pool_current_node() % BUF_POOL_NODES; // A new buffer is placed on this node when it is first written
+    pthread_mutex_lock(&buf_pool.lock);
+    FreeBuffer *buf = buf_pool.free_lists[node][class];
+    if(buf != NULL)
+    {
+        buf_pool.free_lists[node][class] = buf->next;
+        buf_pool.free_counts[node][class]--;
+    }
+    pthread_mutex_unlock(&buf_pool.lock);
+    return buf != NULL ? (void *) buf : buf_new((size_t) BUF_MIN_SIZE << class);
+}
+
+void *buf_calloc(size_t size)
+{
+    void *buf = buf_alloc(size);
+    if(buf != NULL)
+    {
+        memset(buf, 0, size);
+    }
+    return buf;
+}
+
+void buf_free(void *buf, size_t size)
+{
+    int class = buf_class(size > 0 ? size : 1);
+    if(buf == NULL || class < 0)
+    {
+        return;
+    }
+    int node = buf_node(buf);
+    pthread_mutex_lock(&buf_pool.lock);
+    if(buf_pool.free_counts[node][class] < BUF_POOL_MAX_FREE)
+    {
+        ((FreeBuffer *) buf)->next = buf_pool.free_lists[node][class];
+        buf_pool.free_lists[node][class] = buf;
+        buf_pool.free_counts[node][class]++;
+        buf = NULL;
+    }
+    pthread_mutex_unlock(&buf_pool.lock);
+    if(buf != NULL) // The class has enough spares
+    {
+        buf_delete(buf, (size_t) BUF_MIN_SIZE << class);
+    }
+}
+
+void buf_advise_mapping(void *addr, size_t length)
+{
+    madvise(addr, length, MADV_SEQUENTIAL);
+    madvise(addr, length, MADV_HUGEPAGE); // Honoured for file mappings only with read only THP for file systems
+}
+/* Function Definitions */
+
+/* Arena Allocate
+ * Input: Arena, size
+ * Description: Bump allocation from the current block; a request which does not fit
+ * starts a new block, sized for the request when it is larger than a block
+ * Return Values : Pointer aligned to ARENA_ALIGN, NULL on failure
+ */
+void *arena_alloc(Arena *arena, size_t size)
+{
+    size = (size + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1);
+    size_t header = (sizeof(ArenaBlock) + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1);
+    ArenaBlock *block = arena->blocks;
+    if(block == NULL || block->size - block->used < size)
+    {
+        size_t block_size = header + size > ARENA_BLOCK_SIZE ? header + size : ARENA_BLOCK_SIZE;
+        block = buf_alloc(block_size);
+        if(block == NULL)
+        {
+            return NULL;
+        }
+        block->next = arena->blocks;
+        block->size = block_size;
+        block->used = header;
+        arena->blocks = block;
+    }
+    void *ptr = (char *) block + block->used;
+    block->used += size;
+    return ptr;
+}
+
+char *arena_strdup(Arena *arena, const char *str)
+{
+    size_t length = strlen(str) + 1;
+    char *copy = arena_alloc(arena, length);
+    if(copy != NULL)
+    {
+        memcpy(copy, str, length);
+    }
+    return copy;
+}
+
+void arena_release(Arena *arena)
+{
+    while(arena->blocks != NULL)
+    {
+        ArenaBlock *block = arena->blocks;
+        arena->blocks = block->next;
+        buf_free(block, block->size);
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef BUFPOOL_H
+#define BUFPOOL_H
+
+#include <stddef.h>
+
+/*
+ * I/O buffers and metadata arenas.
+ * Buffers come in power of two size classes, page aligned so they suit
+ * SIMD loads and O_DIRECT alike; classes of 2 MiB and up are mapped on
+ * 2 MiB boundaries and marked for transparent huge pages. Freed buffers are
+ * kept on a per class free list shared by all threads, so the chunk and
+ * deflate buffers of one stage or job are recycled by the next instead of
+ * faulting in fresh pages. On NUMA hosts there is a set of free lists per
+ * node: a freed buffer goes back to the node its pages are on and a worker
+ * only reuses buffers of its own node.
+ * An arena hands out small metadata (names, tables of contents) from pool
+ * buffers and gives all of it back in one call
+ */
+
+#define BUF_ALIGN 4096 /* Alignment of every pool buffer */
+#define BUF_MIN_SIZE 4096 /* Smallest size class */
+#define BUF_HUGEPAGE_SIZE (2UL << 20) /* Classes from here on are huge page backed */
+#define BUF_POOL_CLASSES 24 /* 4 KiB .. 32 GiB */
+#define BUF_POOL_MAX_FREE 8 /* Buffers kept per size class and node */
+#define BUF_POOL_NODES 8 /* Nodes with their own free lists, higher nodes share them */
+#define ARENA_BLOCK_SIZE 4096
+#define ARENA_ALIGN 16
+
+/* Aligned buffer of at least size bytes, NULL on failure */
+void *buf_alloc(size_t size);
+
+/* Aligned zeroed buffer of at least size bytes, NULL on failure */
+void *buf_calloc(size_t size);
+
+/* Give a buffer back, size as passed to buf_alloc (NULL is ignored) */
+void buf_free(void *buf, size_t size);
+
+/* Read ahead and huge page hints for a mapped cover */
+void buf_advise_mapping(void *addr, size_t length);
+
+typedef struct _ArenaBlock
+{
+    struct _ArenaBlock *next; /*Store the previously filled block*/
+    size_t size; /*Store the pool size of the block*/
+    size_t used; /*Store the bytes handed out, header included*/
+} ArenaBlock;
+
+typedef struct _Arena
+{
+    ArenaBlock *blocks; /*Store the current block, NULL for an empty arena*/
+} Arena;
+
+/* size bytes aligned to ARENA_ALIGN, valid until arena_release, NULL on failure */
+void *arena_alloc(Arena *arena, size_t size);
+
+/* Copy of str in the arena, NULL on failure */
+char *arena_strdup(Arena *arena, const char *str);
+
+/* Free everything allocated from the arena, which is left empty and reusable */
+void arena_release(Arena *arena);
+
+#endif
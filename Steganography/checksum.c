@@ -0,0 +1,77 @@
+#include <string.h>
+#include <pthread.h>
+#include "checksum.h"
+
+static uint crc32c_table[256];
+static pthread_once_t crc32c_table_once = PTHREAD_ONCE_INIT;
+static int crc32c_hw;
+
+/* Build the byte-at-a-time lookup table and probe the CPU, once per process */
+static void crc32c_init(void)
+{
+    for(uint i = 0; i < 256; i++)
+    {
+        uint value = i;
+        for(int bit = 0; bit < 8; bit++)
+        {
+            value = (value >> 1) ^ (0x82F63B78 & (0 - (value & 1)));
+        }
+        crc32c_table[i] = value;
+    }
+#if defined(__x86_64__)
+    crc32c_hw = __builtin_cpu_supports("sse4.2");
+#endif
+}
+
+#if defined(__x86_64__)
+/* Raw state update with the crc32 instruction, 8 bytes at a time */
+__attribute__((target("sse4.2")))
+static uint crc32c_hw_update(uint state, const char *data, long size)
+{
+    long i = 0;
+    for(; i + 8 <= size; i += 8)
+    {
+        unsigned long word;
+        memcpy(&word, data + i, sizeof(word));
+        state = __builtin_ia32_crc32di(state, word);
+    }
+    for(; i < size; i++)
+    {
+        state = __builtin_ia32_crc32qi(state, data[i]);
+    }
+    return state;
+}
+#endif
+
+/* Function Definitions */
+
+int crc32c_hw_available(void)
+{
+    pthread_once(&crc32c_table_once, crc32c_init);
+    return crc32c_hw;
+}
+/* Function Definitions */
+
+/* Update CRC32C
+ * Input: Running crc (0 to start), data and its size
+ * Output: CRC32C of everything fed so far
+ * Description: Reflected CRC with the Castagnoli polynomial 0x82F63B78,
+ * with the crc32 instruction when available, else one table lookup per byte
+ * Return Values : Updated crc
+ */
+uint crc32c_update(uint crc, const char *data, long size)
+{
+    pthread_once(&crc32c_table_once, crc32c_init);
+    crc = ~crc;
+#if defined(__x86_64__)
+    if(crc32c_hw)
+    {
+        return ~crc32c_hw_update(crc, data, size);
+    }
+#endif
+    for(long i = 0; i < size; i++)
+    {
+        crc = crc32c_table[(crc ^ (unsigned char) data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
@@ -0,0 +1,18 @@
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include "types.h"
+
+/*
+ * CRC32C (Castagnoli) checksum used to detect corrupted payloads.
+ * Start with crc = 0 and feed the data in any number of pieces.
+ * Uses the SSE4.2 crc32 instruction when the CPU has it
+ */
+
+/* Update a running CRC32C with size bytes of data */
+uint crc32c_update(uint crc, const char *data, long size);
+
+/* Nonzero when the SSE4.2 crc32 instruction can be used */
+int crc32c_hw_available(void);
+
+#endif
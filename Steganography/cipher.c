@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <string.h>
+#include "cipher.h"
+#include "common.h"
+
+#define ROTL(value, count) (((value) << (count)) | ((value) >> (32 - (count))))
+#define QUARTER_ROUND(a, b, c, d) \
+    a += b; d ^= a; d = ROTL(d, 16); \
+    c += d; b ^= c; b = ROTL(b, 12); \
+    a += b; d ^= a; d = ROTL(d, 8); \
+    c += d; b ^= c; b = ROTL(b, 7);
+
+/* Function Definitions */
+
+/* ChaCha20 Block Function
+ * Input: Key, block counter and nonce
+ * Output: 16 words of keystream
+ */
+static void chacha20_block(const uint key[8], uint counter, const uint nonce[3], uint output[16])
+{
+    uint state[16] = { 0x61707865, 0x3320646E, 0x79622D32, 0x6B206574,
+                       key[0], key[1], key[2], key[3], key[4], key[5], key[6], key[7],
+                       counter, nonce[0], nonce[1], nonce[2] };
+    uint x[16];
+    memcpy(x, state, sizeof(x));
+    for(int round = 0; round < 10; round++) // 10 double rounds
+    {
+        QUARTER_ROUND(x[0], x[4], x[8], x[12]);
+        QUARTER_ROUND(x[1], x[5], x[9], x[13]);
+        QUARTER_ROUND(x[2], x[6], x[10], x[14]);
+        QUARTER_ROUND(x[3], x[7], x[11], x[15]);
+        QUARTER_ROUND(x[0], x[5], x[10], x[15]);
+        QUARTER_ROUND(x[1], x[6], x[11], x[12]);
+        QUARTER_ROUND(x[2], x[7], x[8], x[13]);
+        QUARTER_ROUND(x[3], x[4], x[9], x[14]);
+    }
+    for(int i = 0; i < 16; i++)
+    {
+        output[i] = x[i] + state[i];
+    }
+}
+/* Function Definitions */
+
+Status cipher_new_salt(char *salt)
+{
+    FILE *fptr_random = fopen("/dev/urandom", "r");
+    if(fptr_random == NULL)
+    {
+        return e_failure;
+    }
+    size_t read = fread(salt, sizeof(char), CIPHER_SALT_SIZE, fptr_random);
+    fclose(fptr_random);
+    return read == CIPHER_SALT_SIZE ? e_success : e_failure;
+}
+/* Function Definitions */
+
+/* Initialize Cipher Stream
+ * Input: Passphrase and CIPHER_SALT_SIZE bytes of salt
+ * Output: Stream key and nonce, position 0
+ * Description: Absorb the passphrase and salt 32 bytes at a time into the key
+ * through the block function, then stretch it with CIPHER_KDF_ROUNDS more
+ * block function calls so guessing passphrases stays expensive
+ */
+void cipher_init(CipherStream *cipher, const char *passphrase, const char *salt)
+{
+    uint block[16];
+    uint zero_nonce[3] = { 0, 0, 0 };
+    long pass_len = strlen(passphrase);
+    memset(cipher->key, 0, sizeof(cipher->key));
+    cipher->nonce[0] = get_le(salt, 4);
+    cipher->nonce[1] = get_le(salt + 4, 4);
+    cipher->nonce[2] = 0;
+    for(long i = 0; i < pass_len + CIPHER_SALT_SIZE; i += 32)
+    {
+        for(long j = i; j < i + 32 && j < pass_len + CIPHER_SALT_SIZE; j++)
+        {
+            unsigned char byte = j < pass_len ? passphrase[j] : salt[j - pass_len];
+            cipher->key[(j - i) / 4] ^= (uint) byte << (8 * ((j - i) % 4));
+        }
+        chacha20_block(cipher->key, i / 32, zero_nonce, block);
+        memcpy(cipher->key, block, sizeof(cipher->key));
+    }
+    for(uint round = 0; round < CIPHER_KDF_ROUNDS; round++)
+    {
+        chacha20_block(cipher->key, round, cipher->nonce, block);
+        for(int i = 0; i < 8; i++)
+        {
+            cipher->key[i] ^= block[i] ^ block[i + 8];
+        }
+    }
+    cipher->position = 0;
+}
+/* Function Definitions */
+
+/* Cipher Keystream
+ * Input: Cipher stream and number of bytes wanted
+ * Output: Keystream bytes from the current position onwards
+ * Description: Block n of the keystream covers bytes 64n .. 64n + 63
+ */
+void cipher_keystream(CipherStream *cipher, char *keystream, int size)
+{
+    uint block[16];
+    char bytes[64];
+    while(size > 0)
+    {
+        int within = cipher->position % 64;
+        int count = 64 - within < size ? 64 - within : size;
+        chacha20_block(cipher->key, cipher->position / 64, cipher->nonce, block);
+        for(int i = 0; i < 16; i++)
+        {
+            put_le(bytes + (4 * i), block[i], 4);
+        }
+        memcpy(keystream, bytes + within, count);
+        keystream += count;
+        cipher->position += count;
+        size -= count;
+    }
+}
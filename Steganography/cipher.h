@@ -0,0 +1,33 @@
+#ifndef CIPHER_H
+#define CIPHER_H
+
+#include "types.h"
+
+/*
+ * ChaCha20 (RFC 8439) keystream used to encrypt the secret data.
+ * The key is stretched from a passphrase and a random salt stored in the
+ * header; the salt also serves as the nonce. The keystream is addressed
+ * by byte position, so any range of the data can be decrypted on its own
+ */
+
+#define CIPHER_SALT_SIZE 8
+#define CIPHER_KDF_ROUNDS 65536
+#define CIPHER_SEGMENT_SIZE 256 /* Keystream bytes generated per kernel step */
+
+typedef struct _CipherStream
+{
+    uint key[8]; /*Store the key stretched from the passphrase*/
+    uint nonce[3]; /*Store the nonce built from the salt*/
+    unsigned long position; /*Store the keystream byte to use next*/
+} CipherStream;
+
+/* Fill salt with random bytes */
+Status cipher_new_salt(char *salt);
+
+/* Stretch passphrase and salt into the stream key, positioned at 0 */
+void cipher_init(CipherStream *cipher, const char *passphrase, const char *salt);
+
+/* Produce the next size keystream bytes and advance the position */
+void cipher_keystream(CipherStream *cipher, char *keystream, int size);
+
+#endif
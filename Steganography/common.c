@@ -0,0 +1,32 @@
+#include "common.h"
+
+int quiet_mode = 0;
+
+/* Function Definitions */
+
+/* Store a little endian integer
+ * Input: Buffer, value and number of bytes to store
+ * Output: Least significant byte first in buffer
+ */
+void put_le(char *buffer, unsigned long value, int size)
+{
+    for(int i = 0; i < size; i++)
+    {
+        buffer[i] = (value >> (8 * i)) & 0xFF;
+    }
+}
+/* Function Definitions */
+
+/* Load a little endian integer
+ * Input: Buffer and number of bytes to load
+ * Return Values : Value stored least significant byte first
+ */
+unsigned long get_le(const char *buffer, int size)
+{
+    unsigned long value = 0;
+    for(int i = 0; i < size; i++)
+    {
+        value = value | ((unsigned long) (unsigned char) buffer[i] << (8 * i));
+    }
+    return value;
+}
@@ -4,5 +4,25 @@
 /* Magic string to identify whether stegged or not */
 #define MAGIC_STRING "#*"
 
+/* The extension size field carries the extension length in its low byte
+ * and optional format features in the bits above it */
+#define EXTN_SIZE_MASK 0xFF
+#define FLAG_CHECKSUM (1 << 8) /* CRC32C of the secret data follows the file size */
+#define FLAG_SCATTER (1 << 9) /* Secret data blocks are placed by a keyed permutation */
+#define FLAG_ENCRYPT (1 << 10) /* Salt follows the file size (and checksum), secret data is encrypted */
+#define SUPPORTED_FLAGS (FLAG_CHECKSUM | FLAG_SCATTER | FLAG_ENCRYPT)
+
+/* Set by parallel and batch modes to silence the stage banners and their pacing delay */
+extern int quiet_mode;
+
+/* Stage banner helpers, no-ops in quiet mode */
+#define info_pause() do { if(!quiet_mode) sleep(1); } while(0)
+#define info_printf(...) do { if(!quiet_mode) printf(__VA_ARGS__); } while(0)
+
+/* Store a little endian integer of size bytes into buffer */
+void put_le(char *buffer, unsigned long value, int size);
+
+/* Load a little endian integer of size bytes from buffer */
+unsigned long get_le(const char *buffer, int size);
 
 #endif      
@@ -0,0 +1,512 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <pthread.h>
+#include "cover.h"
+#include "png.h"
+#include "y4m.h"
+#include "common.h"
+#include "tune.h"
+#include "types.h"
+#include "color.h"
+
+#define COVER_COPY_BUF_SIZE 4096
+#define MAX_PNM_VALUE 255 /* Only 8 bit samples carry the payload in their LSB */
+
+/* Function Definitions */
+
+/* Copy Image Header
+ * Input: Source and Destination Image file ptr, parsed cover
+ * Output: Bytes before the pixel data copied as is
+ * Description: None of the backends changes the dimensions or the sample layout,
+ * so the stego header is the cover header verbatim
+ * Return Values : e_success and e_failure
+ */
+static Status copy_header_bytes(FILE *fptr_src_image, FILE *fptr_dest_image, const CoverInfo *cover)
+{
+    char buffer[COVER_COPY_BUF_SIZE];
+    long remaining = cover->header_size;
+    rewind(fptr_src_image); // Rewind the File Position Indicator to 0th Position
+    while(remaining > 0)
+    {
+        int size = remaining < COVER_COPY_BUF_SIZE ? remaining : COVER_COPY_BUF_SIZE;
+        if(fread(buffer, sizeof(char), size, fptr_src_image) < size)
+        {
+            printf(RED "Error Reading %s header\n" RESET, cover->format->name);
+            return e_failure;
+        }
+        if(fwrite(buffer, sizeof(char), size, fptr_dest_image) < size)
+        {
+            printf(RED "Error Writing %s header\n" RESET, cover->format->name);
+            return e_failure;
+        }
+        remaining -= size;
+    }
+    return e_success;
+}
+/* Function Definitions */
+
+/* BMP
+ * Description: "BM" file header followed by a BITMAPINFOHEADER (or a later version).
+ * The pixel array starts at bfOffBits (offset 10); width is stored in offset 18,
+ * height after that and bits per pixel at offset 28. Everything from the pixel
+ * array to the end of the file, row padding included, carries the payload
+ */
+static int bmp_probe(const unsigned char *header, int size)
+{
+    return size >= 2 && header[0] == 'B' && header[1] == 'M';
+}
+
+static Status bmp_parse_header(FILE *fptr_image, CoverInfo *cover)
+{
+    char header[34];
+    fseek(fptr_image, 0, SEEK_END);
+    long file_size = ftell(fptr_image);
+    rewind(fptr_image);
+    if(fread(header, sizeof(char), sizeof(header), fptr_image) < sizeof(header))
+    {
+        printf(RED "Error Reading bmp header\n" RESET);
+        return e_failure;
+    }
+    uint bits_per_pixel = get_le(header + 28, 2);
+    uint compression = get_le(header + 30, 4);
+    int height = (int) get_le(header + 22, 4); // Negative for top down images
+    if(compression != 0 && compression != 3) // Only BI_RGB and BI_BITFIELDS store raw samples
+    {
+        printf(RED "Error: Compressed bmp images are not supported\n" RESET);
+        return e_failure;
+    }
+    if(bits_per_pixel < 8 || bits_per_pixel % 8 != 0)
+    {
+        printf(RED "Error: %u bits per pixel bmp images are not supported\n" RESET, bits_per_pixel);
+        return e_failure;
+    }
+    cover->width = get_le(header + 18, 4);
+    cover->height = height < 0 ? -height : height;
+    cover->channels = bits_per_pixel / 8;
+    cover->data_offset = get_le(header + 10, 4);
+    cover->data_size = file_size - cover->data_offset;
+    return e_success;
+}
+/* Function Definitions */
+
+/* Read a PNM/PAM header token
+ * Input: Image file ptr positioned inside the header, buffer of size bytes
+ * Output: Next whitespace separated token, skipping # comments; the whitespace
+ * after the token is left unread
+ * Return Values : e_success and e_failure
+ */
+static Status pnm_token(FILE *fptr_image, char *token, int size)
+{
+    int ch = fgetc(fptr_image);
+    while(ch != EOF && (isspace(ch) || ch == '#'))
+    {
+        if(ch == '#')
+        {
+            while(ch != EOF && ch != '\n')
+            {
+                ch = fgetc(fptr_image);
+            }
+        }
+        ch = fgetc(fptr_image);
+    }
+    int length = 0;
+    while(ch != EOF && !isspace(ch) && length < size - 1)
+    {
+        token[length++] = ch;
+        ch = fgetc(fptr_image);
+    }
+    token[length] = '\0';
+    if(length == 0 || (ch != EOF && !isspace(ch)))
+    {
+        return e_failure;
+    }
+    ungetc(ch, fptr_image); // Leave the separator, it may be the last header byte
+    return e_success;
+}
+/* Function Definitions */
+
+/* PPM/PGM
+ * Description: "P6" (RGB) or "P5" (gray) followed by width, height and maxval in
+ * ASCII, then exactly one whitespace byte before the samples
+ */
+static int pnm_probe(const unsigned char *header, int size)
+{
+    return size >= 3 && header[0] == 'P' && (header[1] == '5' || header[1] == '6') && isspace(header[2]);
+}
+
+static Status pnm_parse_header(FILE *fptr_image, CoverInfo *cover)
+{
+    char token[16];
+    long value[3];
+    rewind(fptr_image);
+    if(pnm_token(fptr_image, token, sizeof(token)) == e_failure)
+    {
+        return e_failure;
+    }
+    cover->channels = token[1] == '6' ? 3 : 1;
+    for(int i = 0; i < 3; i++)
+    {
+        char *end;
+        if(pnm_token(fptr_image, token, sizeof(token)) == e_failure)
+        {
+            printf(RED "Error: Truncated pnm header\n" RESET);
+            return e_failure;
+        }
+        value[i] = strtol(token, &end, 10);
+        if(*end != '\0' || value[i] <= 0)
+        {
+            printf(RED "Error: Invalid pnm header value %s\n" RESET, token);
+            return e_failure;
+        }
+    }
+    if(value[2] > MAX_PNM_VALUE)
+    {
+        printf(RED "Error: 16 bit pnm images are not supported\n" RESET);
+        return e_failure;
+    }
+    int separator = fgetc(fptr_image); // The single whitespace byte after maxval
+    if(separator == EOF || !isspace(separator))
+    {
+        printf(RED "Error: Truncated pnm header\n" RESET);
+        return e_failure;
+    }
+    cover->width = value[0];
+    cover->height = value[1];
+    cover->data_offset = ftell(fptr_image);
+    cover->data_size = (long) cover->width * cover->height * cover->channels;
+    return e_success;
+}
+/* Function Definitions */
+
+/* PAM
+ * Description: "P7" followed by WIDTH, HEIGHT, DEPTH, MAXVAL and TUPLTYPE lines,
+ * closed by an ENDHDR line; the samples start right after it
+ */
+static int pam_probe(const unsigned char *header, int size)
+{
+    return size >= 3 && header[0] == 'P' && header[1] == '7' && header[2] == '\n';
+}
+
+static Status pam_parse_header(FILE *fptr_image, CoverInfo *cover)
+{
+    char token[32];
+    long width = 0, height = 0, depth = 0, maxval = 0;
+    rewind(fptr_image);
+    pnm_token(fptr_image, token, sizeof(token)); // P7
+    while(1)
+    {
+        if(pnm_token(fptr_image, token, sizeof(token)) == e_failure)
+        {
+            printf(RED "Error: Truncated pam header\n" RESET);
+            return e_failure;
+        }
+        if(strcmp(token, "ENDHDR") == 0)
+        {
+            fgetc(fptr_image); // Newline closing the header
+            break;
+        }
+        long *field = strcmp(token, "WIDTH") == 0 ? &width : strcmp(token, "HEIGHT") == 0 ? &height :
+                      strcmp(token, "DEPTH") == 0 ? &depth : strcmp(token, "MAXVAL") == 0 ? &maxval : NULL;
+        if(pnm_token(fptr_image, token, sizeof(token)) == e_failure) // Value, or the first word of TUPLTYPE
+        {
+            printf(RED "Error: Truncated pam header\n" RESET);
+            return e_failure;
+        }
+        if(field != NULL)
+        {
+            *field = strtol(token, NULL, 10);
+        }
+        else
+        {
+            int ch = fgetc(fptr_image); // TUPLTYPE and unknown fields run to the end of the line
+            while(ch != EOF && ch != '\n')
+            {
+                ch = fgetc(fptr_image);
+            }
+        }
+    }
+    if(width <= 0 || height <= 0 || depth <= 0 || maxval <= 0)
+    {
+        printf(RED "Error: Invalid pam header\n" RESET);
+        return e_failure;
+    }
+    if(maxval > MAX_PNM_VALUE)
+    {
+        printf(RED "Error: 16 bit pam images are not supported\n" RESET);
+        return e_failure;
+    }
+    cover->width = width;
+    cover->height = height;
+    cover->channels = depth;
+    cover->data_offset = ftell(fptr_image);
+    cover->data_size = (long) width * height * depth;
+    return e_success;
+}
+/* Function Definitions */
+
+/* TGA
+ * Description: 18 byte header with no signature: ID length, color map type, image type
+ * (2 true color or 3 gray, uncompressed), color map spec, origin, width, height,
+ * pixel depth and descriptor. The pixels follow the ID and the color map; any
+ * extension area and footer after them are copied untouched
+ */
+static int tga_probe(const unsigned char *header, int size)
+{
+    return size >= COVER_PROBE_SIZE && header[1] <= 1 && (header[2] == 2 || header[2] == 3) &&
+           (header[16] == 8 || header[16] == 24 || header[16] == 32) &&
+           (header[12] | header[13]) != 0 && (header[14] | header[15]) != 0;
+}
+
+static Status tga_parse_header(FILE *fptr_image, CoverInfo *cover)
+{
+    char header[COVER_PROBE_SIZE];
+    rewind(fptr_image);
+    if(fread(header, sizeof(char), sizeof(header), fptr_image) < sizeof(header))
+    {
+        printf(RED "Error Reading tga header\n" RESET);
+        return e_failure;
+    }
+    long color_map_size = 0;
+    if(header[1] == 1) // A color map may be present even for true color images
+    {
+        color_map_size = get_le(header + 5, 2) * ((get_le(header + 7, 1) + 7) / 8);
+    }
+    cover->width = get_le(header + 12, 2);
+    cover->height = get_le(header + 14, 2);
+    cover->channels = get_le(header + 16, 1) / 8;
+    cover->data_offset = COVER_PROBE_SIZE + get_le(header, 1) + color_map_size;
+    cover->data_size = (long) cover->width * cover->height * cover->channels;
+    return e_success;
+}
+/* Function Definitions */
+
+/* Registered backends, probed in order; TGA has no signature so it goes last */
+static const CoverFormat cover_formats[] =
+{
+    { "bmp", { ".bmp", NULL }, bmp_probe, bmp_parse_header, copy_header_bytes, NULL, NULL, NULL, 1 },
+    { "pnm", { ".ppm", ".pgm", ".pnm", NULL }, pnm_probe, pnm_parse_header, copy_header_bytes, NULL, NULL, NULL, 1 },
+    { "pam", { ".pam", NULL }, pam_probe, pam_parse_header, copy_header_bytes, NULL, NULL, NULL, 1 },
+    { "png", { ".png", NULL }, png_probe, png_parse_header, copy_header_bytes, png_open_reader, png_open_writer, png_footprint, 0 },
+    { "y4m", { ".y4m", NULL }, y4m_probe, y4m_parse_header, copy_header_bytes, y4m_open_reader, y4m_open_writer, y4m_footprint, 1 },
+    { "tga", { ".tga", NULL }, tga_probe, tga_parse_header, copy_header_bytes, NULL, NULL, NULL, 1 },
+};
+
+#define COVER_FORMAT_COUNT (sizeof(cover_formats) / sizeof(cover_formats[0]))
+#define COVER_EXTN_SIZE 8 /* Room for one extension and its separator */
+
+static char cover_extns[COVER_FORMAT_COUNT * MAX_COVER_EXTNS * COVER_EXTN_SIZE];
+static pthread_once_t cover_extns_once = PTHREAD_ONCE_INIT;
+
+/* Function Definitions */
+
+/* Cover Format For Name
+ * Input: Image file name
+ * Return Values : Backend registered for the extension of fname, NULL when unsupported
+ */
+const CoverFormat *cover_format_for_name(const char *fname)
+{
+    const char *extn = strrchr(fname, '.');
+    if(extn == NULL)
+    {
+        return NULL;
+    }
+    for(uint i = 0; i < COVER_FORMAT_COUNT; i++)
+    {
+        for(int j = 0; cover_formats[i].extns[j] != NULL; j++)
+        {
+            if(strcmp(extn, cover_formats[i].extns[j]) == 0)
+            {
+                return &cover_formats[i];
+            }
+        }
+    }
+    return NULL;
+}
+/* Function Definitions */
+
+/* Join the extensions of every backend, once per process */
+static void cover_extns_init(void)
+{
+    int length = 0;
+    for(uint i = 0; i < COVER_FORMAT_COUNT; i++)
+    {
+        for(int j = 0; cover_formats[i].extns[j] != NULL; j++)
+        {
+            length += snprintf(cover_extns + length, sizeof(cover_extns) - length, "%s%s", length > 0 ? " " : "", cover_formats[i].extns[j]);
+        }
+    }
+}
+
+/* Supported Cover Extensions
+ * Return Values : Space separated list of every registered extension
+ */
+const char *cover_supported_extns(void)
+{
+    pthread_once(&cover_extns_once, cover_extns_init);
+    return cover_extns;
+}
+/* Function Definitions */
+
+/* Probe the Format
+ * Input: Opened image file ptr
+ * Output: cover->format set to the backend recognizing the header, the file
+ * left behind the probed bytes
+ * Return Values : e_success, e_failure when no backend recognizes it
+ */
+static Status cover_probe(FILE *fptr_image, CoverInfo *cover)
+{
+    unsigned char header[COVER_PROBE_SIZE];
+    rewind(fptr_image);
+    int size = fread(header, sizeof(char), sizeof(header), fptr_image);
+    cover->format = NULL;
+    for(uint i = 0; i < COVER_FORMAT_COUNT && cover->format == NULL; i++)
+    {
+        if(cover_formats[i].probe(header, size))
+        {
+            cover->format = &cover_formats[i];
+        }
+    }
+    return cover->format != NULL ? e_success : e_failure;
+}
+/* Function Definitions */
+
+/* Open Cover
+ * Input: Opened image file ptr
+ * Output: Cover info with the format, dimensions and pixel region
+ * Description: Probe the first bytes against every backend, let the first match
+ * parse the header and check the pixel region lies inside the file
+ * Return Values : e_success and e_failure
+ */
+Status cover_open(FILE *fptr_image, CoverInfo *cover)
+{
+    fseek(fptr_image, 0, SEEK_END);
+    long file_size = ftell(fptr_image);
+    if(cover_probe(fptr_image, cover) == e_failure)
+    {
+        printf(RED "Error: Unrecognized image format\n" RESET);
+        return e_failure;
+    }
+    if(cover->format->parse_header(fptr_image, cover) == e_failure)
+    {
+        return e_failure;
+    }
+    rewind(fptr_image);
+    if(cover->format->open_reader != NULL) // Compressed pixels, the backend set up header and trailer
+    {
+        return cover->data_size > 0 ? e_success : e_failure;
+    }
+    cover->header_size = cover->data_offset;
+    cover->trailer_offset = cover->data_offset + cover->data_size;
+    if(cover->data_offset <= 0 || cover->data_size <= 0 || cover->data_offset + cover->data_size > file_size)
+    {
+        printf(RED "Error: Truncated %s image\n" RESET, cover->format->name);
+        return e_failure;
+    }
+    return e_success;
+}
+/* Function Definitions */
+
+/* Open Cover Pixels
+ * Input: Opened image file ptr, parsed cover
+ * Output: For compressed formats the image FILE ptr is replaced by a read only stream
+ * of the decompressed pixels, which owns (and closes) the image
+ * Return Values : e_success and e_failure
+ */
+Status cover_open_pixels(FILE **fptr_image, const CoverInfo *cover)
+{
+    if(cover->format->open_reader == NULL)
+    {
+        return e_success;
+    }
+    FILE *fptr_pixels = cover->format->open_reader(*fptr_image, cover);
+    if(fptr_pixels == NULL)
+    {
+        printf(RED "Error: Unable to decompress %s image\n" RESET, cover->format->name);
+        return e_failure;
+    }
+    *fptr_image = fptr_pixels;
+    return e_success;
+}
+/* Function Definitions */
+
+/* Write Cover Header
+ * Input: Source and Destination Image file ptrs, parsed cover
+ * Output: Stego header written, both files positioned at the pixel region
+ * Description: For compressed formats both FILE ptrs are replaced by pixel streams;
+ * the destination stream compresses the pixels and writes the rest of the image
+ * when it is closed
+ * Return Values : e_success and e_failure
+ */
+Status cover_write_header(FILE **fptr_src_image, FILE **fptr_dest_image, const CoverInfo *cover)
+{
+    if(cover->format->write_header(*fptr_src_image, *fptr_dest_image, cover) == e_failure)
+    {
+        return e_failure;
+    }
+    if(cover->format->open_writer != NULL)
+    {
+        FILE *fptr_pixels = cover->format->open_writer(*fptr_src_image, *fptr_dest_image, cover);
+        if(fptr_pixels == NULL)
+        {
+            printf(RED "Error: Unable to create %s image stream\n" RESET, cover->format->name);
+            return e_failure;
+        }
+        *fptr_dest_image = fptr_pixels;
+        return cover_open_pixels(fptr_src_image, cover);
+    }
+    if(fseek(*fptr_src_image, cover->data_offset, SEEK_SET) != 0)
+    {
+        printf(RED "Error Seeking to Pixel Data\n" RESET);
+        return e_failure;
+    }
+    return e_success;
+}
+/* Function Definitions */
+
+/* Job Footprint
+ * Input: Parsed cover, nonzero when the job writes a stego image
+ * Description: The chunk buffers of the encode and decode loops, the stdio buffers
+ * of the image, payload and stego files and the pixel streams of compressed formats;
+ * an encoding reads the cover through one stream and writes through another.
+ * The payload passes through a chunk at a time, so its size only enters through
+ * the chunk size
+ * Return Values : Bytes
+ */
+long cover_footprint(const CoverInfo *cover, int writing)
+{
+    long footprint = (long) COVER_CHUNK_BUFFERS * tune_config.chunk_size + 3 * BUFSIZ;
+    if(cover->format->footprint != NULL)
+    {
+        footprint += cover->format->footprint(cover, 0);
+        if(writing)
+        {
+            footprint += cover->format->footprint(cover, 1);
+        }
+    }
+    return footprint;
+}
+
+/* File Footprint
+ * Input: Image file name, nonzero for an encoding
+ * Output: The parsed header in cover
+ * Description: Sizes a job before it runs, from the header alone. An image that
+ * can't be parsed counts nothing here and is reported by the job itself
+ * Return Values : cover_footprint of the image, 0 when its header can't be parsed
+ */
+long cover_file_footprint(const char *fname, int writing, CoverInfo *cover)
+{
+    long footprint = 0;
+    FILE *fptr_image = fopen(fname, "r");
+    if(fptr_image == NULL)
+    {
+        return 0;
+    }
+    if(cover_probe(fptr_image, cover) == e_success && cover->format->parse_header(fptr_image, cover) == e_success)
+    {
+        footprint = cover_footprint(cover, writing);
+    }
+    fclose(fptr_image);
+    return footprint;
+}
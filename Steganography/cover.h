@@ -0,0 +1,71 @@
+#ifndef COVER_H
+#define COVER_H
+
+#include <stdio.h>
+#include "types.h"
+
+/*
+ * Cover image formats. Every backend recognizes its header, reports where
+ * the pixel samples live and writes the header of the stego image; the
+ * encoder and decoder only ever touch the pixel region, so any format with
+ * 8 bit samples can carry a payload.
+ * Raw formats are read and written in place. Compressed formats swap the
+ * image FILE ptrs for streams of the decompressed pixels, where the pixel
+ * region starts at offset 0 and the rest of the file is handled by the backend.
+ * Supported: BMP, binary PPM/PGM (P6/P5), PAM (P7), uncompressed TGA, PNG
+ * and the luma planes of Y4M video
+ */
+
+#define COVER_PROBE_SIZE 18 /* Bytes read from the start of the file to recognize the format */
+#define MAX_COVER_EXTNS 4
+#define COVER_CHUNK_BUFFERS 18 /* Chunk sized buffers of a job: two image chunks of 8 bytes per payload byte and two payload chunks */
+
+struct _CoverFormat;
+
+typedef struct _CoverInfo
+{
+    const struct _CoverFormat *format; /*Store the backend which parsed the header*/
+    uint width; /*Store the image width in pixels*/
+    uint height; /*Store the image height in pixels*/
+    uint channels; /*Store the 8 bit samples per pixel*/
+    long data_offset; /*Store the offset of the pixel region in the pixel stream*/
+    long data_size; /*Store the size of the pixel region in bytes*/
+    long header_size; /*Store the bytes copied as is in front of the pixel data*/
+    long trailer_offset; /*Store the file offset of the data after the pixels (compressed formats)*/
+} CoverInfo;
+
+typedef struct _CoverFormat
+{
+    const char *name; /*Store the format name for messages*/
+    const char *extns[MAX_COVER_EXTNS]; /*Store the NULL terminated file name extensions*/
+    int (*probe)(const unsigned char *header, int size); /*Nonzero when the header belongs to the format*/
+    Status (*parse_header)(FILE *fptr_image, CoverInfo *cover); /*Find the pixel region*/
+    Status (*write_header)(FILE *fptr_src_image, FILE *fptr_dest_image, const CoverInfo *cover); /*Write the stego header*/
+    FILE *(*open_reader)(FILE *fptr_image, const CoverInfo *cover); /*Stream the decompressed pixels, NULL for raw formats*/
+    FILE *(*open_writer)(FILE *fptr_src_image, FILE *fptr_dest_image, const CoverInfo *cover); /*Stream compressing the pixels, NULL for raw formats*/
+    long (*footprint)(const CoverInfo *cover, int writing); /*Bytes of memory a pixel stream holds, NULL for raw formats*/
+    int same_size; /*Nonzero when the stego image is exactly as large as the cover*/
+} CoverFormat;
+
+/* Format registered for the extension of fname, NULL when unsupported */
+const CoverFormat *cover_format_for_name(const char *fname);
+
+/* Space separated list of the supported extensions, for messages */
+const char *cover_supported_extns(void);
+
+/* Recognize the format of an opened image and parse its header */
+Status cover_open(FILE *fptr_image, CoverInfo *cover);
+
+/* Replace an opened image by a stream of its pixels, for compressed formats */
+Status cover_open_pixels(FILE **fptr_image, const CoverInfo *cover);
+
+/* Write the stego image header and leave both files at the pixel region */
+Status cover_write_header(FILE **fptr_src_image, FILE **fptr_dest_image, const CoverInfo *cover);
+
+/* Peak memory of a job decoding (writing 0) or encoding (writing 1) the image, in bytes */
+long cover_footprint(const CoverInfo *cover, int writing);
+
+/* Same for an image file, parsing only its header into cover; 0 when it can't be parsed */
+long cover_file_footprint(const char *fname, int writing, CoverInfo *cover);
+
+#endif
@@ -1,8 +1,12 @@
 #include <stdio.h>
 #include <string.h>
+#include <ctype.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include "decode.h"
+#include "checksum.h"
+#include "bufpool.h"
+#include "trace.h"
 #include "types.h"
 #include "common.h"
 #include "color.h"
@@ -19,22 +23,141 @@
 
 Status decode_secret_file_data(DecodeInfo *decInfo)
 {
-    char data_buffer[decInfo->size_secret_file + 1]; // Take 1 extra space to store NULL character
-    if(decode_data_from_image(data_buffer, decInfo->size_secret_file, decInfo->fptr_src_image) == e_success)
+    Status status = decode_secret_data_start(decInfo);
+    while(status == e_success && decInfo->payload_remaining > 0)
     {
-        data_buffer[decInfo->size_secret_file] = '\0'; // Add NULL character at the last index
-        int write = fwrite(data_buffer, sizeof(char), decInfo->size_secret_file, decInfo->fptr_secret); // Write the data into Secret File
-        if(write < decInfo->size_secret_file)
+        status = decode_secret_data_step(decInfo);
+    }
+    return status == e_success ? decode_secret_data_finish(decInfo) : e_failure;
+}
+/* Function Definitions */
+
+/* Start Decoding the Secret File Data
+ * Input: DecodeInfo with the header decoded and the secret file open
+ * Output: Data stage state of decInfo set up for decode_secret_data_step
+ * Description: Range decodes start at their slice, resumed runs after the part
+ * an earlier run wrote
+ * Return Values : e_success and e_failure
+ */
+Status decode_secret_data_start(DecodeInfo *decInfo)
+{
+    long offset = 0, remaining = decInfo->size_secret_file;
+    if(decInfo->range_mode)
+    {
+        if(decInfo->range_offset >= decInfo->size_secret_file)
         {
-            printf(RED "Error Writing Secret File Data\n" RESET);
+            printf(RED "Error: Range Offset %ld is beyond Secret File Size %ld\n" RESET, decInfo->range_offset, decInfo->size_secret_file);
             return e_failure;
         }
-        return e_success;
+        offset = decInfo->range_offset;
+        remaining = decInfo->size_secret_file - offset;
+        if(decInfo->range_length < remaining) // Clamp the slice to the end of the secret file
+        {
+            remaining = decInfo->range_length;
+        }
     }
-    else
+    /* The checksum covers the whole secret file, so it is only verified on full decodes */
+    decInfo->payload_verify = (decInfo->flags & FLAG_CHECKSUM) && !decInfo->range_mode;
+    decInfo->payload_checksum = 0;
+    Journal *journal = decInfo->range_mode ? NULL : &decInfo->journal;
+    if(journal != NULL && journal->resuming) // Carry on after the part an earlier run wrote
+    {
+        offset = journal->record.payload_offset;
+        remaining = decInfo->size_secret_file - offset;
+        decInfo->payload_checksum = journal->record.checksum;
+    }
+    if(decInfo->flags & FLAG_ENCRYPT) // The keystream is addressed by payload offset
+    {
+        decInfo->cipher.position = offset;
+    }
+    decInfo->payload_offset = decInfo->payload_start = offset;
+    decInfo->payload_remaining = remaining;
+    decInfo->payload_position = -1;
+    progress_start(&decInfo->progress, "Decoding", remaining);
+    return e_success;
+}
+/* Function Definitions */
+
+/* Decode One Chunk of the Secret File Data
+ * Input: DecodeInfo after decode_secret_data_start, with payload_remaining > 0
+ * Output: The next chunk written to the secret file and payload_remaining reduced
+ * Return Values : e_success and e_failure
+ */
+Status decode_secret_data_step(DecodeInfo *decInfo)
+{
+    Journal *journal = decInfo->range_mode ? NULL : &decInfo->journal;
+    CipherStream *cipher = decInfo->flags & FLAG_ENCRYPT ? &decInfo->cipher : NULL;
+    char data_buffer[MAX_SECRET_CHUNK_SIZE]; // Stream the secret file through a fixed size chunk
+    long offset = decInfo->payload_offset, remaining = decInfo->payload_remaining;
+    if(progress_update(&decInfo->progress, offset - decInfo->payload_start) == e_failure)
+    {
+        return e_failure;
+    }
+    long contiguous;
+    long position = secret_data_position(decInfo, offset, &contiguous);
+    int size = remaining < tune_config.chunk_size ? remaining : tune_config.chunk_size;
+    if(size > contiguous)
+    {
+        size = contiguous;
+    }
+    if(position != decInfo->payload_position && fseek(decInfo->fptr_src_image, position, SEEK_SET) != 0) // Seek only at block jumps
+    {
+        printf(RED "Error Seeking to Secret File Data\n" RESET);
+        return e_failure;
+    }
+    decInfo->payload_position = position + (size * MAX_IMAGE_BUF_SIZE);
+    if(decode_payload_from_image(data_buffer, size, decInfo->fptr_src_image,
+                                 decInfo->payload_verify || (journal != NULL && journal->enabled) ? &decInfo->payload_checksum : NULL, cipher) == e_failure)
+    {
+        return e_failure;
+    }
+    TRACE_BEGIN_BYTES("io", "write secret", size);
+    int write = fwrite(data_buffer, sizeof(char), size, decInfo->fptr_secret); // Write the data into Secret File
+    TRACE_END();
+    if(write < size)
+    {
+        printf(RED "Error Writing Secret File Data\n" RESET);
+        return e_failure;
+    }
+    offset += size;
+    decInfo->payload_offset = offset;
+    decInfo->payload_remaining = remaining - size;
+    if(journal != NULL && journal_due(journal, offset) &&
+       (fflush(decInfo->fptr_secret) != 0 ||
+        journal_checkpoint(journal, fileno(decInfo->fptr_secret), journal_data, offset, offset, decInfo->payload_checksum) == e_failure || journal_stop))
     {
         return e_failure;
     }
+    return e_success;
+}
+/* Function Definitions */
+
+/* Finish Decoding the Secret File Data
+ * Input: DecodeInfo with every chunk decoded
+ * Output: Checksum verified, journal of a resumable run closed
+ * Return Values : e_success and e_failure
+ */
+Status decode_secret_data_finish(DecodeInfo *decInfo)
+{
+    Journal *journal = decInfo->range_mode ? NULL : &decInfo->journal;
+    long offset = decInfo->payload_offset;
+    progress_update(&decInfo->progress, offset - decInfo->payload_start);
+    if(decInfo->payload_verify && decInfo->payload_checksum != decInfo->checksum)
+    {
+        printf(RED "Error: Checksum Mismatch (stored %08x, decoded %08x), %s is corrupted\n" RESET,
+               decInfo->checksum, decInfo->payload_checksum, decInfo->src_image_fname);
+        return e_failure;
+    }
+    if(journal != NULL && journal->enabled) // Drop anything an earlier run wrote past its last checkpoint
+    {
+        if(fflush(decInfo->fptr_secret) != 0 || ftruncate(fileno(decInfo->fptr_secret), offset) != 0)
+        {
+            printf(RED "Error Writing Secret File Data\n" RESET);
+            return e_failure;
+        }
+        journal_close(journal, 1);
+    }
+    return e_success;
 }
 /* Function Definitions */
 
@@ -47,8 +170,8 @@ Status decode_secret_file_data(DecodeInfo *decInfo)
  */
 Status decode_secret_file_size(DecodeInfo *decInfo)
 {
-    uint size = MAX_IMAGE_BUF_SIZE * (uint) sizeof(int); // Size is 32 Bytes
-    char buffer[size]; // Create an array buffer of size 32 bytes
+    char buffer[MAX_IMAGE_BUF_SIZE * sizeof(int)]; // Create an array buffer of size 32 bytes
+    uint size = sizeof(buffer); // Size is 32 Bytes
     uint file_size = 0;
     int read = fread(buffer,sizeof(char), size, decInfo->fptr_src_image); // Read 32 Bytes from source Image
     if(read < size)
@@ -64,10 +187,139 @@ Status decode_secret_file_size(DecodeInfo *decInfo)
         return e_failure;
     }
     decInfo->size_secret_file = file_size;
+    if(decInfo->flags & FLAG_CHECKSUM) // The checksum field follows the size
+    {
+        uint checksum = 0;
+        if(fread(buffer, sizeof(char), size, decInfo->fptr_src_image) < size)
+        {
+            printf(RED "Error Reading Checksum\n" RESET);
+            return e_failure;
+        }
+        decode_size_from_lsb(&checksum, buffer);
+        decInfo->checksum = checksum;
+    }
+    if(decInfo->flags & FLAG_ENCRYPT) // The salt follows, derive the stream key from it
+    {
+        char salt[CIPHER_SALT_SIZE];
+        if(decInfo->key == NULL)
+        {
+            printf(RED "Error: %s is encrypted, pass --key KEY\n" RESET, decInfo->src_image_fname);
+            return e_failure;
+        }
+        if(decode_data_from_image(salt, CIPHER_SALT_SIZE, decInfo->fptr_src_image) == e_failure)
+        {
+            printf(RED "Error Reading Salt\n" RESET);
+            return e_failure;
+        }
+        cipher_init(&decInfo->cipher, decInfo->key, salt);
+    }
+    decInfo->data_offset = ftell(decInfo->fptr_src_image); // Secret file data starts right after the size
+    if(decInfo->flags & FLAG_SCATTER) // Rebuild the block permutation the encoder used
+    {
+        if(decInfo->key == NULL)
+        {
+            printf(RED "Error: %s is keyed, pass --key KEY\n" RESET, decInfo->src_image_fname);
+            return e_failure;
+        }
+        long block_count = (decInfo->cover.data_offset + decInfo->cover.data_size - decInfo->data_offset) / SCATTER_BLOCK_SIZE;
+        if(block_count * SCATTER_BLOCK_DATA < decInfo->size_secret_file)
+        {
+            printf(RED "Error: Invalid File Size\n" RESET);
+            return e_failure;
+        }
+        scatter_init(&decInfo->scatter, decInfo->key, block_count);
+    }
+    return e_success;
+}
+/* Function Definitions */
+
+/* Locate Secret File Data
+ * Input: Offset of a byte inside the secret file data
+ * Output: Number of following bytes stored contiguously after it
+ * Description: Sequential data follows data_offset directly; scattered data sits
+ * in the image block picked by the key for its payload block
+ * Return Values : Image offset of the byte
+ */
+long secret_data_position(DecodeInfo *decInfo, long offset, long *contiguous)
+{
+    if(!(decInfo->flags & FLAG_SCATTER))
+    {
+        *contiguous = decInfo->size_secret_file - offset;
+        return decInfo->data_offset + (offset * MAX_IMAGE_BUF_SIZE);
+    }
+    long within = offset % SCATTER_BLOCK_DATA;
+    *contiguous = SCATTER_BLOCK_DATA - within;
+    return decInfo->data_offset + (scatter_block(&decInfo->scatter, offset / SCATTER_BLOCK_DATA) * SCATTER_BLOCK_SIZE)
+           + (within * MAX_IMAGE_BUF_SIZE);
+}
+/* Function Definitions */
+
+/* Decode a Byte Range of Secret File Data From Source Image
+ * Input: Offset and Length of the slice inside the secret file, buffer to store the slice
+ * Output: Decodes only the requested slice into data
+ * Description: Byte i of the secret file data is stored in the 8 image bytes found by
+ * secret_data_position, so seek straight there instead of decoding the prefix.
+ * The keystream is seekable too, so encrypted slices decrypt without the prefix.
+ * decode_secret_file_size must have been called first
+ * Return Values : e_success and e_failure
+ */
+Status decode_secret_file_range(DecodeInfo *decInfo, long offset, long length, char *data)
+{
+    if(offset < 0 || length < 0 || offset + length > decInfo->size_secret_file)
+    {
+        printf(RED "Error: Invalid Range %ld:%ld\n" RESET, offset, length);
+        return e_failure;
+    }
+    while(length > 0)
+    {
+        long contiguous;
+        long position = secret_data_position(decInfo, offset, &contiguous);
+        long size = length < contiguous ? length : contiguous;
+        if(fseek(decInfo->fptr_src_image, position, SEEK_SET) != 0)
+        {
+            printf(RED "Error Seeking to Range Offset\n" RESET);
+            return e_failure;
+        }
+        CipherStream *cipher = NULL;
+        if(decInfo->flags & FLAG_ENCRYPT)
+        {
+            cipher = &decInfo->cipher;
+            cipher->position = offset;
+        }
+        if(decode_payload_from_image(data, size, decInfo->fptr_src_image, NULL, cipher) == e_failure)
+        {
+            return e_failure;
+        }
+        data += size;
+        offset += size;
+        length -= size;
+    }
     return e_success;
 }
 /* Function Definitions */
 
+/* Secret File Extension Check
+ * Description: The extension comes from the image and is appended to the output
+ * name, so it may only be a dot followed by letters and digits
+ * Return Values : Nonzero when extn is one
+ */
+int secret_extn_valid(const char *extn)
+{
+    if(extn[0] != '.' || extn[1] == '\0')
+    {
+        return 0;
+    }
+    for(int i = 1; extn[i] != '\0'; i++)
+    {
+        if(!isalnum((unsigned char) extn[i]))
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+/* Function Definitions */
+
 /* Decode Secret File Extension from Source Image
  * Input: Secret File Extension Size, Source Image file ptr
  * Output: Copies Extension Encoded Inside Source Image to extn secret file in structure
@@ -82,7 +334,16 @@ Status decode_secret_file_extn(DecodeInfo *decInfo)
     if(decode_data_from_image(extn_buffer, decInfo->file_extn_size, decInfo->fptr_src_image) == e_success)
     {
         extn_buffer[decInfo->file_extn_size] = '\0';
+        if(!secret_extn_valid(extn_buffer))
+        {
+            printf(RED "Error: Invalid Secret File Extension\n" RESET);
+            return e_failure;
+        }
         strcpy(decInfo->extn_secret_file, extn_buffer);
+        if(decInfo->secret_fname == NULL) // Library callers only need the extension
+        {
+            return e_success;
+        }
         if(strlen(decInfo->secret_fname) + strlen(decInfo->extn_secret_file) >= MAX_FILENAME_SIZE)
         {
             printf(RED "Error: File Name too long\n" RESET);
@@ -128,8 +389,8 @@ Status decode_size_from_lsb(uint *size, char *buffer)
  */
 Status decode_secret_file_extn_size(DecodeInfo *decInfo)
 {
-    uint size = MAX_IMAGE_BUF_SIZE * (uint) sizeof(int);
-    char buffer[size];
+    char buffer[MAX_IMAGE_BUF_SIZE * sizeof(int)];
+    uint size = sizeof(buffer);
     uint file_extn_size = 0;
     int read = fread(buffer,sizeof(char), size, decInfo->fptr_src_image);
     if(read < size)
@@ -138,11 +399,18 @@ Status decode_secret_file_extn_size(DecodeInfo *decInfo)
         return e_failure;
     }
     decode_size_from_lsb(&file_extn_size, buffer);
-    if(file_extn_size <= 0)
+    decInfo->flags = file_extn_size & ~EXTN_SIZE_MASK; // Optional features live above the extension length
+    file_extn_size &= EXTN_SIZE_MASK;
+    if(file_extn_size <= 0 || file_extn_size > MAX_FILE_SUFFIX)
     {
         printf(RED "Error: Invalid File Extension Size\n" RESET);
         return e_failure;
     }
+    if(decInfo->flags & ~SUPPORTED_FLAGS)
+    {
+        printf(RED "Error: Unsupported Stego Format Features %08x\n" RESET, decInfo->flags);
+        return e_failure;
+    }
     decInfo->file_extn_size = file_extn_size;
     return e_success;
 }
@@ -172,31 +440,139 @@ Status decode_byte_from_lsb(char *data, char *image_buffer)
  * Input: Character Data, Character Data Size, Source Image file ptr
  * Output: Decode Character Bytes of Data From Source Image For 
  * MAGIC STRING, Secret File Extension and Secret File Data
- * Description: Read 8 Bytes of Data from Source Image, Decode the Character
- * Encoded Inside those 8 Bytes
+ * Description: Read 8 Bytes of Data from Source Image for every Character and Decode
+ * the Characters Encoded Inside them, one chunk at a time
  * Return Values : e_success and e_failure
  */
 Status decode_data_from_image(char *data, uint size, FILE *fptr_src_image)
 {
-    char image_buffer[MAX_IMAGE_BUF_SIZE];
-    for( int i = 0; i < size; i++)
+    return decode_payload_from_image(data, size, fptr_src_image, NULL, NULL);
+}
+
+Status decode_payload_from_image(char *data, uint size, FILE *fptr_src_image, uint *crc, CipherStream *cipher)
+{
+    uint chunk_size = tune_config.chunk_size;
+    size_t image_size = chunk_size * MAX_IMAGE_BUF_SIZE;
+    char *image_buffer = buf_alloc(image_size);
+    if(image_buffer == NULL)
+    {
+        printf(RED "Error: Memory Allocation Failed\n" RESET);
+        return e_failure;
+    }
+    for( uint i = 0; i < size; i += chunk_size)
     {
-        int read = fread(image_buffer, sizeof(char), MAX_IMAGE_BUF_SIZE, fptr_src_image);
-        if( read < MAX_IMAGE_BUF_SIZE)
+        int count = size - i < chunk_size ? size - i : chunk_size;
+        TRACE_BEGIN_BYTES("io", "read stego", count * MAX_IMAGE_BUF_SIZE);
+        int read = fread(image_buffer, sizeof(char), count * MAX_IMAGE_BUF_SIZE, fptr_src_image);
+        TRACE_END();
+        if( read < count * MAX_IMAGE_BUF_SIZE)
         {
             printf(RED "Error reading data bytes from source image\n" RESET);
+            buf_free(image_buffer, image_size);
             return e_failure;
         }
-        decode_byte_from_lsb(&data[i], image_buffer);
+        TRACE_BEGIN_BYTES("kernel", "decode chunk", count);
+        decode_chunk_from_lsb(data + i, count, image_buffer, crc, cipher);
+        TRACE_END();
     }
+    buf_free(image_buffer, image_size);
     return e_success;
 }
+/* Function Definitions */
+
+/* Decode a Chunk of Character Data From LSB of Image Data
+ * Input: Buffer for size Characters, Buffer Containing size * 8 Bytes of Image Data, running CRC32C (or NULL),
+ * keystream for the characters (or NULL)
+ * Output: Decoded (decrypted) Characters, updated CRC32C
+ * Description: On CPUs with SSE4.2 every 8 decoded characters are assembled into one word,
+ * XORed with the keystream and folded into the CRC with the crc32 instruction before it
+ * is stored, so neither decryption nor verification needs an extra pass over the data
+ */
+static void decode_chunk_generic(char *data, int size, const char *image_buffer, uint *crc, const char *keystream)
+{
+    for(int i = 0; i < size; i++)
+    {
+        decode_byte_from_lsb(&data[i], (char *) image_buffer + (i * MAX_IMAGE_BUF_SIZE));
+        if(keystream != NULL)
+        {
+            data[i] ^= keystream[i];
+        }
+    }
+    if(crc != NULL)
+    {
+        *crc = crc32c_update(*crc, data, size);
+    }
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2")))
+static void decode_chunk_sse42(char *data, int size, const char *image_buffer, uint *crc, const char *keystream)
+{
+    uint state = ~*crc;
+    int i = 0;
+    for(; i + 8 <= size; i += 8)
+    {
+        unsigned long word = 0, key_word = 0;
+        for(int j = 0; j < 8; j++)
+        {
+            char ch;
+            decode_byte_from_lsb(&ch, (char *) image_buffer + ((i + j) * MAX_IMAGE_BUF_SIZE));
+            word |= (unsigned long) (unsigned char) ch << (8 * j);
+        }
+        if(keystream != NULL)
+        {
+            memcpy(&key_word, keystream + i, sizeof(key_word));
+        }
+        word ^= key_word;
+        state = __builtin_ia32_crc32di(state, word);
+        memcpy(data + i, &word, sizeof(word));
+    }
+    for(; i < size; i++)
+    {
+        decode_byte_from_lsb(&data[i], (char *) image_buffer + (i * MAX_IMAGE_BUF_SIZE));
+        if(keystream != NULL)
+        {
+            data[i] ^= keystream[i];
+        }
+        state = __builtin_ia32_crc32qi(state, data[i]);
+    }
+    *crc = ~state;
+}
+#endif
+
+static void decode_chunk_dispatch(char *data, int size, const char *image_buffer, uint *crc, const char *keystream)
+{
+#if defined(__x86_64__)
+    if(crc != NULL && tune_use_sse42())
+    {
+        decode_chunk_sse42(data, size, image_buffer, crc, keystream);
+        return;
+    }
+#endif
+    decode_chunk_generic(data, size, image_buffer, crc, keystream);
+}
+
+void decode_chunk_from_lsb(char *data, int size, const char *image_buffer, uint *crc, CipherStream *cipher)
+{
+    if(cipher == NULL)
+    {
+        decode_chunk_dispatch(data, size, image_buffer, crc, NULL);
+        return;
+    }
+    char keystream[CIPHER_SEGMENT_SIZE]; // Small enough to stay in L1 next to the data
+    for(int i = 0; i < size; i += CIPHER_SEGMENT_SIZE)
+    {
+        int count = size - i < CIPHER_SEGMENT_SIZE ? size - i : CIPHER_SEGMENT_SIZE;
+        cipher_keystream(cipher, keystream, count);
+        decode_chunk_dispatch(data + i, count, image_buffer + (i * MAX_IMAGE_BUF_SIZE), crc, keystream);
+    }
+}
 
 /* Function Definitions */
 
 /* Decode Magic string From Source Image
  * Input: Magic string, Source Image file ptr
- * Output: Decodes Magic String From Source Image After 54 Bytes of Header data
+ * Output: Decodes Magic String From Source Image After the Header data
  * Description: Call decode data to image function to decode the magic string character 
  * based on the length of magic string and compare the decoded magic string with user
  * magic string. If Both the Magic String Matched then Continue Decoding Process,
@@ -206,7 +582,7 @@ Status decode_data_from_image(char *data, uint size, FILE *fptr_src_image)
 
 Status decode_magic_string(const char *magic_string, DecodeInfo *decInfo)
 {
-    fseek(decInfo->fptr_src_image, MAX_HEADER_SIZE, SEEK_SET);
+    fseek(decInfo->fptr_src_image, decInfo->cover.data_offset, SEEK_SET);
     uint size = strlen(magic_string);
     char buffer[size + 1];
     
@@ -229,6 +605,86 @@ Status decode_magic_string(const char *magic_string, DecodeInfo *decInfo)
     } 
 }
 /* Function Definitions */
+/*
+ * Open a Resumable Secret File
+ * Inputs: DecodeInfo with the extension decoded, --resume given
+ * Output: Secret file positioned at the payload offset of the journal, 0 without one
+ * Description: The bytes an earlier run wrote are kept when their CRC32C matches the
+ * checkpoint, otherwise the secret file starts over
+ * Return Value: e_success or e_failure, on file errors
+ */
+Status open_resumable_secret_file(DecodeInfo *decInfo)
+{
+    Journal *journal = &decInfo->journal;
+    if(journal_open(journal, decInfo->secret_fname,
+                    journal_identity(decInfo->src_image_fname, NULL, decInfo->key, decInfo->flags)) == e_failure)
+    {
+        return e_failure;
+    }
+    decInfo->fptr_secret = journal->resuming ? fopen(decInfo->secret_fname, "r+") : NULL;
+    if(decInfo->fptr_secret != NULL)
+    {
+        char buffer[MAX_SECRET_CHUNK_SIZE];
+        uint checksum = 0;
+        long remaining = journal->record.payload_offset;
+        size_t read;
+        while(remaining > 0 && (read = fread(buffer, sizeof(char), remaining < sizeof(buffer) ? remaining : sizeof(buffer), decInfo->fptr_secret)) > 0)
+        {
+            checksum = crc32c_update(checksum, buffer, read);
+            remaining -= read;
+        }
+        if(remaining > 0 || checksum != journal->record.checksum || fseek(decInfo->fptr_secret, journal->record.payload_offset, SEEK_SET) != 0)
+        {
+            info_printf(YEL "INFO: %s does not match its journal, starting over\n" RESET, decInfo->secret_fname);
+            fclose(decInfo->fptr_secret);
+            decInfo->fptr_secret = NULL;
+        }
+    }
+    if(decInfo->fptr_secret == NULL)
+    {
+        journal->resuming = 0;
+        journal->record.payload_offset = 0;
+        journal->record.checksum = 0;
+        journal->next_checkpoint = journal->interval;
+        decInfo->fptr_secret = fopen(decInfo->secret_fname, "w");
+    }
+    if(decInfo->fptr_secret == NULL)
+    {
+        printf(RED "Error: Unable to open file %s\n" RESET, decInfo->secret_fname);
+        return e_failure;
+    }
+    return e_success;
+}
+/* Function Definitions */
+
+/* Resumable Secret File
+ * Return Values : Nonzero when the secret file is written under a journal,
+ * which --resume does for full decodes only
+ */
+int secret_file_resumable(const DecodeInfo *decInfo)
+{
+    return decInfo->journal.enabled && !decInfo->range_mode;
+}
+
+/* Abort the Secret File
+ * Input: DecodeInfo of a failed or cancelled decoding
+ * Output: Secret file closed and removed, so nothing partial or unverified is
+ * left behind; a journaled part is kept for --resume
+ */
+void abort_secret_file(DecodeInfo *decInfo)
+{
+    if(decInfo->fptr_secret != NULL)
+    {
+        fclose(decInfo->fptr_secret);
+        decInfo->fptr_secret = NULL;
+        if(!secret_file_resumable(decInfo))
+        {
+            remove(decInfo->secret_fname);
+        }
+    }
+    journal_close(&decInfo->journal, 0);
+}
+/* Function Definitions */
 /* 
  * Get File pointers for o/p files
  * Inputs: Secret file
@@ -237,6 +693,10 @@ Status decode_magic_string(const char *magic_string, DecodeInfo *decInfo)
  */
 Status open_secret_file(DecodeInfo *decInfo)
 {
+    if(secret_file_resumable(decInfo))
+    {
+        return open_resumable_secret_file(decInfo);
+    }
     decInfo->fptr_secret = fopen(decInfo->secret_fname, "w");
     if(decInfo->fptr_secret == NULL)
     {
@@ -249,7 +709,7 @@ Status open_secret_file(DecodeInfo *decInfo)
 /* 
  * Get File pointers for i/p
  * Inputs: Src Image file
- * Output: FILE pointer for above files
+ * Output: FILE pointer for above files, format and pixel region of the image
  * Return Value: e_success or e_failure, on file errors
  */
 Status open_image_file(DecodeInfo *decInfo)
@@ -260,7 +720,12 @@ Status open_image_file(DecodeInfo *decInfo)
         printf(RED "Error: Unable to open file %s\n" RESET, decInfo->src_image_fname);
         return e_failure;
     }
-    return e_success;
+    if(cover_open(decInfo->fptr_src_image, &decInfo->cover) == e_failure) // Locate the pixel region
+    {
+        printf(RED "Error: Unable to read %s header\n" RESET, decInfo->src_image_fname);
+        return e_failure;
+    }
+    return cover_open_pixels(&decInfo->fptr_src_image, &decInfo->cover); // Compressed formats are read through a pixel stream
 }
 /* Function Definitions */
 /*
@@ -271,38 +736,129 @@ Status open_image_file(DecodeInfo *decInfo)
 */
 Status read_and_validate_decode_args(char *argv[], DecodeInfo *decInfo)
 {
-    if(strcmp((strstr(argv[2], ".")), ".bmp") == 0)
+    if(cover_format_for_name(argv[2]) != NULL)
     {
         decInfo->src_image_fname = argv[2];
         if( !(argv[3] == NULL))
         {
-            const char* delim = ".";
-            if(!(strstr(argv[3], "delim") == NULL))
+            decInfo->secret_fname = argv[3];
+            char *extn = strrchr(argv[3], '.');
+            if(extn != NULL && extn != argv[3] && strchr(extn, '/') == NULL && extn[-1] != '/') /* The decoded extension replaces the one passed, dots of directories are kept */
             {
-                decInfo->secret_fname = argv[3];   
+                *extn = '\0';
             }
-            else
+        }
+        else
+        {
+            decInfo->secret_fname = "Secret_Message";
+        }
+        /* The extension is appended later, copy the name into room for it */
+        char *secret_fname = arena_alloc(&decInfo->arena, MAX_FILENAME_SIZE);
+        if(secret_fname == NULL || strlen(decInfo->secret_fname) >= MAX_FILENAME_SIZE)
+        {
+            printf(RED "Error: Memory Allocation Failed\n" RESET);
+            return e_failure;
+        }
+        decInfo->secret_fname = strcpy(secret_fname, decInfo->secret_fname);
+        return e_success;
+    }
+    else
+    {
+        printf(RED "Source Image File is not of a supported type (%s)\n" RESET, cover_supported_extns());
+        return e_failure;
+    }
+}
+/* Function Definitions */
+/*
+* Validate Decode Options
+* Inputs: Options separated from the positional command line arguments
+* Output: Range offset and length when --range OFFSET:LEN is passed, key when --key KEY is passed
+* Return Values: e_success or e_failure
+*/
+Status read_and_validate_decode_options(char *options[], DecodeInfo *decInfo)
+{
+    for(int i = 0; options[i] != NULL; i++)
+    {
+        if(strcmp(options[i], "--range") == 0)
+        {
+            char *end;
+            if(options[i + 1] == NULL)
             {
-                decInfo->secret_fname = strtok(argv[3], delim);
+                printf(RED "--range needs OFFSET:LEN\n" RESET);
+                return e_failure;
+            }
+            decInfo->range_offset = strtol(options[++i], &end, 0);
+            if(*end != ':' || decInfo->range_offset < 0)
+            {
+                printf(RED "Invalid Range %s, expected OFFSET:LEN\n" RESET, options[i]);
+                return e_failure;
             }
+            decInfo->range_length = strtol(end + 1, &end, 0);
+            if(*end != '\0' || decInfo->range_length <= 0)
+            {
+                printf(RED "Invalid Range %s, expected OFFSET:LEN\n" RESET, options[i]);
+                return e_failure;
+            }
+            decInfo->range_mode = 1;
         }
-        else
+        else if(strcmp(options[i], "--key") == 0 && options[i + 1] != NULL)
+        {
+            decInfo->key = options[++i];
+        }
+        else if(strcmp(options[i], "--stats") == 0)
+        {
+            decInfo->stats.enabled = 1;
+        }
+        else if(strcmp(options[i], "--progress") == 0)
+        {
+            decInfo->progress.callback = progress_print;
+        }
+        else if(strcmp(options[i], "--resume") == 0)
+        {
+            decInfo->journal.enabled = 1;
+            decInfo->journal.fd = -1;
+        }
+        else if(strcmp(options[i], "--checkpoint") == 0 && options[i + 1] != NULL)
         {
-            decInfo->secret_fname = malloc(MAX_FILENAME_SIZE);
-            if(decInfo->secret_fname == NULL)
+            decInfo->journal.interval = atol(options[++i]) << 20;
+            if(decInfo->journal.interval <= 0)
             {
-                printf(RED "Error: Memory Allocation Failed\n" RESET);
+                printf(RED "Invalid Checkpoint Interval %s MB\n" RESET, options[i]);
                 return e_failure;
             }
-            strcpy(decInfo->secret_fname, "Secret_Message");
         }
-        return e_success;
+        else
+        {
+            printf(RED "Unsupported Decode Option %s\n" RESET, options[i]);
+            return e_failure;
+        }
     }
-    else
+    if(decInfo->journal.interval == 0)
     {
-        printf(RED "Source Image File is not of type .bmp\n" RESET);
-        return e_failure;
+        decInfo->journal.interval = (long) JOURNAL_DEFAULT_INTERVAL << 20;
+    }
+    return e_success;
+}
+/* Function Definitions */
+/*
+ * Decode Secret File Header
+ * Inputs: DecodeInfo with fptr_src_image opened
+ * Output: Extension and size of the secret file, data_offset of its data
+ * Description: Library entry point which verifies the magic string and decodes the
+ * extension and size fields without creating the secret file, so callers can follow
+ * up with decode_secret_file_range
+ * Return Value: e_success or e_failure
+ */
+Status decode_secret_file_header(DecodeInfo *decInfo)
+{
+    if(decode_magic_string(MAGIC_STRING, decInfo) == e_success &&
+       decode_secret_file_extn_size(decInfo) == e_success &&
+       decode_secret_file_extn(decInfo) == e_success &&
+       decode_secret_file_size(decInfo) == e_success)
+    {
+        return e_success;
     }
+    return e_failure;
 }
 /* Function Definitions */
 /* 
@@ -313,34 +869,34 @@ Status read_and_validate_decode_args(char *argv[], DecodeInfo *decInfo)
  */
 Status do_decoding(DecodeInfo *decInfo)
 {
-    if(open_image_file(decInfo) == e_success)
+    if(PERF_STAGE(&decInfo->stats, "open image", open_image_file(decInfo)) == e_success)
     {
-        sleep(1);
-        printf(BGREEN"[INFO] opened IMAGE File Successfully\n"RESET);
-        if(decode_magic_string(MAGIC_STRING, decInfo) == e_success)
+        info_pause();
+        info_printf(BGREEN"[INFO] opened IMAGE File Successfully\n"RESET);
+        if(PERF_STAGE(&decInfo->stats, "decode magic string", decode_magic_string(MAGIC_STRING, decInfo)) == e_success)
         {
-            sleep(1);
-            printf(BBLUE "[INFO] Magic String Verified Successfully\n" RESET);
-            if(decode_secret_file_extn_size(decInfo) ==e_success)
+            info_pause();
+            info_printf(BBLUE "[INFO] Magic String Verified Successfully\n" RESET);
+            if(PERF_STAGE(&decInfo->stats, "decode extn size", decode_secret_file_extn_size(decInfo)) == e_success)
             {
-                sleep(1);
-                printf(BMAGENTA "[INFO] Secret File Extension Size Decoded Successfully\n" RESET);
-                if(decode_secret_file_extn(decInfo) == e_success)
+                info_pause();
+                info_printf(BMAGENTA "[INFO] Secret File Extension Size Decoded Successfully\n" RESET);
+                if(PERF_STAGE(&decInfo->stats, "decode extn", decode_secret_file_extn(decInfo)) == e_success)
                 {
-                    sleep(1);
-                    printf(BCYAN "[INFO] Secret File Extension Decoded Successfully\n" RESET);
-                    if(open_secret_file(decInfo) == e_success)
+                    info_pause();
+                    info_printf(BCYAN "[INFO] Secret File Extension Decoded Successfully\n" RESET);
+                    if(PERF_STAGE(&decInfo->stats, "open secret file", open_secret_file(decInfo)) == e_success)
                     {
-                        sleep(1);
-                        printf(BGREEN"[INFO] opened SECRET File Successfully\n"RESET);
-                        if(decode_secret_file_size(decInfo) == e_success)
+                        info_pause();
+                        info_printf(BGREEN"[INFO] opened SECRET File Successfully\n"RESET);
+                        if(PERF_STAGE(&decInfo->stats, "decode file size", decode_secret_file_size(decInfo)) == e_success)
                         {
-                            sleep(1);
-                            printf(BMAGENTA "[INFO] Secret File Size Decoded Successfully\n" RESET);
-                            if(decode_secret_file_data(decInfo) == e_success)
+                            info_pause();
+                            info_printf(BMAGENTA "[INFO] Secret File Size Decoded Successfully\n" RESET);
+                            if(PERF_STAGE(&decInfo->stats, "decode file data", decode_secret_file_data(decInfo)) == e_success)
                             {
-                                sleep(1);
-                                printf(BCYAN "[INFO] Secret File Data Decoded Successfully\n" RESET);
+                                info_pause();
+                                info_printf(BCYAN "[INFO] Secret File Data Decoded Successfully\n" RESET);
                                 return e_success;
                             }
                             else
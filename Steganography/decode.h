@@ -1,6 +1,14 @@
 #ifndef DECODE_H
 #define DECODE_H
 #include "types.h"
+#include "tune.h"
+#include "scatter.h"
+#include "cipher.h"
+#include "cover.h"
+#include "perfstat.h"
+#include "bufpool.h"
+#include "journal.h"
+#include "progress.h"
 
 /* 
  * Structure to store information required for
@@ -10,8 +18,8 @@
  */
 #define MAX_SECRET_BUF_SIZE 1
 #define MAX_IMAGE_BUF_SIZE (MAX_SECRET_BUF_SIZE * 8)
+#define MAX_SECRET_CHUNK_SIZE 65536 /* Largest payload chunk --chunk and --tune may pick, see tune.h */
 #define MAX_FILE_SUFFIX 4
-#define MAX_HEADER_SIZE 54
 #define MAX_FILENAME_SIZE 256
 
 typedef struct _DecodeInfo
@@ -19,17 +27,50 @@ typedef struct _DecodeInfo
     /* Source Image info */
     char *src_image_fname; /* Store the source image name*/
     FILE *fptr_src_image; /* Store the source image */
+    CoverInfo cover; /*Store the format and pixel region of the source image*/
 
     /* Secret File Info */
     char *secret_fname; /*Store the secret file name */
     FILE *fptr_secret; /*Store the secret file address*/
     uint file_extn_size; /*Store the size of the secret file extension*/
-    char extn_secret_file[MAX_FILE_SUFFIX]; /*Store the extension of secret file*/
+    char extn_secret_file[MAX_FILE_SUFFIX + 1]; /*Store the extension of secret file*/
     char secret_data[MAX_SECRET_BUF_SIZE]; /*Store the data present inside the secret file*/
     long size_secret_file; /*Store the size of the secret file*/
+    long data_offset; /*Store the image offset where the secret file data starts*/
+    uint flags; /*Store the optional format features found in the extension size field*/
+    uint checksum; /*Store the CRC32C of the secret file data, when FLAG_CHECKSUM is set*/
+
+    /* Key Info */
+    char *key; /*Store the passphrase for images whose data blocks are scattered*/
+    ScatterKey scatter; /*Store the block permutation derived from the key*/
+    CipherStream cipher; /*Store the keystream state for encrypted secret data*/
+
+    /* Range Decoding Info */
+    int range_mode; /*Set when only a slice of the secret file data is to be decoded*/
+    long range_offset; /*Store the first byte of the slice to decode*/
+    long range_length; /*Store the number of bytes in the slice to decode*/
+
+    /* Data Stage Info */
+    long payload_offset; /*Store the secret file offset of the next chunk*/
+    long payload_remaining; /*Store the secret file bytes left to decode*/
+    long payload_start; /*Store the secret file offset the run started at*/
+    long payload_position; /*Store the image offset the last chunk ended at*/
+    uint payload_checksum; /*Store the running CRC32C of the decoded data*/
+    int payload_verify; /*Check payload_checksum against the stored checksum at the end*/
+
+    /* Resume Info */
+    Journal journal; /*Store the checkpoints of a resumable decoding*/
+
+    /* Progress Info */
+    Progress progress; /*Store the payload bytes decoded and the cancel flag*/
+
+    /* Stats Info */
+    PerfStats stats; /*Store the time and performance counters of every decoding stage*/
 
     char *magic_str;
 
+    Arena arena; /*Store the names and tables allocated while decoding, freed by arena_release*/
+
 } DecodeInfo;
 
 /* Check operation type */
@@ -38,6 +79,9 @@ OperationType check_operation_type(char *argv[]);
 /* Read and validate decode args from argv */
 Status read_and_validate_decode_args(char *argv[], DecodeInfo *decInfo);
 
+/* Read and validate decode options (--range OFFSET:LEN, --key KEY, --stats, --resume, --checkpoint MB, --progress) */
+Status read_and_validate_decode_options(char *options[], DecodeInfo *decInfo);
+
 /* Perform the decoding */
 Status do_decoding(DecodeInfo *decInfo);
 
@@ -46,15 +90,24 @@ Status open_image_file(DecodeInfo *decInfo);
 
 Status open_secret_file(DecodeInfo *decInfo);
 
+/* Open the secret file of a --resume decoding, keeping the part an earlier run wrote */
+Status open_resumable_secret_file(DecodeInfo *decInfo);
+
 /* Decode Magic String */
 Status decode_magic_string(const char *magic_string, DecodeInfo *decInfo);
 
 /* Decode function, which does the real decoding */
 Status decode_data_from_image(char *data, uint size, FILE *fptr_src_image);
 
+/* Decode function for secret data, decrypting and updating a running CRC32C (crc and cipher may be NULL) */
+Status decode_payload_from_image(char *data, uint size, FILE *fptr_src_image, uint *crc, CipherStream *cipher);
+
 /* Decode a byte from LSB of image data array */
 Status decode_byte_from_lsb(char *data, char *image_buffer);
 
+/* Decode size bytes from LSB of size * 8 image bytes, decrypting and checksumming them in the same pass */
+void decode_chunk_from_lsb(char *data, int size, const char *image_buffer, uint *crc, CipherStream *cipher);
+
 /* Decode a size from LSB of image data array */
 Status decode_size_from_lsb(uint *size, char *buffer);
 
@@ -64,9 +117,36 @@ Status decode_secret_file_extn_size(DecodeInfo *decInfo);
 /* Decode secret file extenstion */
 Status decode_secret_file_extn(DecodeInfo *decInfo);
 
+/* Nonzero when the secret file is written under a journal (--resume, full decodes) */
+int secret_file_resumable(const DecodeInfo *decInfo);
+
+/* Close and remove the secret file of a failed decoding, keeping a journaled part */
+void abort_secret_file(DecodeInfo *decInfo);
+
+/* Check an extension read from an image: a dot followed by letters and digits */
+int secret_extn_valid(const char *extn);
+
 /* Decode secret file size */
 Status decode_secret_file_size(DecodeInfo *decInfo);
 
 /* Decode secret file data*/
 Status decode_secret_file_data(DecodeInfo *decInfo);
+
+/* Set up the data stage: range, journal offset, keystream position, progress */
+Status decode_secret_data_start(DecodeInfo *decInfo);
+
+/* Decode the next chunk of secret file data */
+Status decode_secret_data_step(DecodeInfo *decInfo);
+
+/* Verify the checksum once every chunk is decoded */
+Status decode_secret_data_finish(DecodeInfo *decInfo);
+
+/* Decode magic string, extension and size without creating the secret file */
+Status decode_secret_file_header(DecodeInfo *decInfo);
+
+/* Image offset of a secret data byte, and how many bytes follow it contiguously */
+long secret_data_position(DecodeInfo *decInfo, long offset, long *contiguous);
+
+/* Decode a byte range of secret file data by seeking straight to it */
+Status decode_secret_file_range(DecodeInfo *decInfo, long offset, long length, char *data);
 #endif
\ No newline at end of file
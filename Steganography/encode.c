@@ -1,7 +1,15 @@
 #include <stdio.h>
 #include <string.h>
+#include <stdlib.h>
 #include <unistd.h>
+#include <limits.h>
+#include <sys/stat.h>
 #include "encode.h"
+#include "inplace.h"
+#include "bufpool.h"
+#include "trace.h"
+#include "decode.h"
+#include "checksum.h"
 #include "types.h"
 #include "common.h"
 #include "color.h"
@@ -13,53 +21,416 @@
  * Output: Copies Remaining data bytes till End of File Into Destination Image
  * Description: After copying the secret file data, Encode the remaining data bytes present
  * in Source Image Till it reaches End of File into Destination Image
- * Return Values : e_success
+ * Return Values : e_success and e_failure
+ */
+Status copy_remaining_img_data(FILE *fptr_src, FILE *fptr_dest, Progress *progress)
+{
+    info_pause();
+    info_printf(YEL "INFO: Copying Left Over Data\n" RESET);
+    size_t size = tune_config.chunk_size * MAX_IMAGE_BUF_SIZE;
+    char *buffer = buf_alloc(size);
+    long copied = buffer != NULL ? 1 : -1;
+    while(copied > 0) // Copy in blocks, video covers have a lot left over
+    {
+        copied = copy_remaining_img_block(fptr_src, fptr_dest, buffer, size, progress);
+    }
+    buf_free(buffer, size);
+    return copied == 0 ? e_success : e_failure;
+}
+/* Function Definitions */
+
+/* Copy One Block of the Remaining Image Data
+ * Input: Source and destination image, buffer of size bytes, progress (may be NULL)
+ * Return Values : Bytes copied, 0 once the source is at its end, -1 on failure or cancellation
+ */
+long copy_remaining_img_block(FILE *fptr_src, FILE *fptr_dest, char *buffer, size_t size, Progress *progress)
+{
+    TRACE_BEGIN_BYTES("io", "read cover", size);
+    size_t read = fread(buffer, 1, size, fptr_src);
+    TRACE_END();
+    if(read == 0)
+    {
+        return 0;
+    }
+    TRACE_BEGIN_BYTES("io", "write stego", read);
+    size_t written = fwrite(buffer, 1, read, fptr_dest);
+    TRACE_END();
+    if(written < read || (progress != NULL && progress_check(progress) == e_failure))
+    {
+        return -1;
+    }
+    return read;
+}
+/* Function Definitions */
+
+/* Close the Destination Image
+ * Input: EncodeInfo with the stego image written
+ * Output: Stego image flushed and closed
+ * Description: Compressed formats write their pixel data when the stream is closed,
+ * so a write error may only show up here. With --verify the stego image must
+ * hash the same as the cover once the pixel LSBs are masked
+ * Return Values : e_success and e_failure
  */
-Status copy_remaining_img_data(FILE *fptr_src, FILE *fptr_dest)
+Status close_stego_image(EncodeInfo *encInfo)
 {
-    sleep(1);
-    printf(YEL "INFO: Copying Left Over Data\n" RESET);
-    char ch;
-    while(fread(&ch, 1, 1, fptr_src) > 0)
+    int result = fclose(encInfo->fptr_stego_image);
+    encInfo->fptr_stego_image = NULL;
+    if(result != 0)
+    {
+        printf(RED "Error: Unable to write %s\n" RESET, encInfo->stego_image_fname);
+        abort_stego_image(encInfo);
+        return e_failure;
+    }
+    if(encInfo->update_in_place)
     {
-        fwrite(&ch, 1, 1, fptr_dest);
+        info_printf(YEL "INFO: Rewrote %ld bytes of %s in place\n" RESET, encInfo->bytes_updated, encInfo->stego_image_fname);
     }
+    if(encInfo->verify && encInfo->verify_cover.cover != NULL && // Raw formats, compressed ones are re-encoded
+       (encInfo->verify_cover.crc != encInfo->verify_stego.crc || encInfo->verify_cover.next != encInfo->verify_stego.next))
+    {
+        printf(RED "Error: Verification failed, %s differs from the cover beyond the pixel LSBs\n" RESET, encInfo->stego_image_fname);
+        abort_stego_image(encInfo);
+        return e_failure;
+    }
+    if(encInfo->verify)
+    {
+        info_printf(GRN "INFO: Verified %s\n" RESET, encInfo->stego_image_fname);
+    }
+    if(encInfo->output != NULL) // Only a complete, verified image replaces the output
+    {
+        OutputFile *output = encInfo->output;
+        encInfo->output = NULL;
+        if(output_commit(output, encInfo->output_policy) == e_failure)
+        {
+            journal_close(&encInfo->journal, 0);
+            return e_failure;
+        }
+    }
+    journal_close(&encInfo->journal, 1);
     return e_success;
 }
 /* Function Definitions */
 
+/* Abort the Destination Image
+ * Input: EncodeInfo of a failed encoding
+ * Output: Stego image stream closed, its temporary file removed
+ * Description: An output which already existed is left untouched
+ */
+void abort_stego_image(EncodeInfo *encInfo)
+{
+    if(encInfo->fptr_stego_image != NULL)
+    {
+        fclose(encInfo->fptr_stego_image);
+        encInfo->fptr_stego_image = NULL;
+    }
+    if(encInfo->output != NULL)
+    {
+        output_abort(encInfo->output);
+        encInfo->output = NULL;
+    }
+    journal_close(&encInfo->journal, 0);
+}
+/* Function Definitions */
+
 /* Encode Secret File Data in Destination Image
  * Input: Secret File Data, Secret File Data Size, Source and Destination Image file ptr
  * Output: Copies Data of Secret File Into Destination Image
  * Description: Call encode data to image function to Encode the Data of Secret File Character by Character
- * into Destination Image
+ * into Destination Image. With a key, every block of SCATTER_BLOCK_DATA characters goes to the image
+ * block picked by scatter_block instead of following the previous one
  * Return Values : e_success and e_failure
  */
 Status encode_secret_file_data(EncodeInfo *encInfo)
 {
-    sleep(1);
-    printf(YEL "INFO: Encoding %s File Data\n" RESET, encInfo->secret_fname);
+    Status status = encode_secret_data_start(encInfo);
+    while(status == e_success && encInfo->data_remaining > 0)
+    {
+        status = encode_secret_data_step(encInfo);
+    }
+    return status == e_success ? encode_secret_data_finish(encInfo) : e_failure;
+}
+/* Function Definitions */
+
+/* Start Encoding the Secret File Data
+ * Input: EncodeInfo with both images at the secret data
+ * Output: Data stage state of encInfo set up for encode_secret_data_step
+ * Description: Scattered images get their blocks prepared here, resumed runs
+ * pick up the payload offset of their journal
+ * Return Values : e_success and e_failure
+ */
+Status encode_secret_data_start(EncodeInfo *encInfo)
+{
+    info_pause();
+    info_printf(YEL "INFO: Encoding %s File Data\n" RESET, encInfo->secret_fname);
     rewind(encInfo->fptr_secret);
-    char image_data[encInfo->size_secret_file + 1]; // Take 1 extra space to store NULL character
-    fread(image_data, sizeof(char), encInfo->size_secret_file, encInfo->fptr_secret);
-    image_data[encInfo->size_secret_file] = '\0'; // Add NULL character at the last index
-    uint len = strlen(image_data);
+    encInfo->data_offset = ftell(encInfo->fptr_src_image);
+    encInfo->data_chunk_size = tune_config.chunk_size;
+    if(encInfo->key != NULL)
+    {
+        if(prepare_scattered_data(encInfo) == e_failure)
+        {
+            return e_failure;
+        }
+        encInfo->data_chunk_size = SCATTER_BLOCK_DATA;
+    }
+    encInfo->data_remaining = encInfo->size_secret_file;
+    encInfo->data_resume_offset = 0; // Payload already in the part file of a resumed run
+    if(encInfo->journal.resuming)
+    {
+        encInfo->data_resume_offset = encInfo->journal.record.stage == journal_tail ? encInfo->size_secret_file : encInfo->journal.record.payload_offset;
+    }
+    progress_start(&encInfo->progress, "Encoding", encInfo->size_secret_file);
+    return e_success;
+}
+/* Function Definitions */
+
+/* Encode One Chunk of the Secret File Data
+ * Input: EncodeInfo after encode_secret_data_start, with data_remaining > 0
+ * Output: The next chunk of the secret file encoded and data_remaining reduced
+ * Return Values : e_success and e_failure
+ */
+Status encode_secret_data_step(EncodeInfo *encInfo)
+{
+    char secret_chunk[MAX_SECRET_CHUNK_SIZE]; // Stream the secret file through a fixed size chunk
+    long remaining = encInfo->data_remaining;
+    if(progress_update(&encInfo->progress, encInfo->size_secret_file - remaining) == e_failure)
+    {
+        return e_failure;
+    }
+    int size = remaining < encInfo->data_chunk_size ? remaining : encInfo->data_chunk_size;
+    TRACE_BEGIN_BYTES("io", "read secret", size);
+    int read = fread(secret_chunk, sizeof(char), size, encInfo->fptr_secret);
+    TRACE_END();
+    if(read < size)
+    {
+        printf(RED "Error Reading Secret File Data\n" RESET);
+        return e_failure;
+    }
+    if(encInfo->key != NULL) // Move both images to the block picked for this chunk
+    {
+        long block = (encInfo->size_secret_file - remaining) / SCATTER_BLOCK_DATA;
+        long position = encInfo->data_offset + (scatter_block(&encInfo->scatter, block) * SCATTER_BLOCK_SIZE);
+        if(fseek(encInfo->fptr_src_image, position, SEEK_SET) != 0 || fseek(encInfo->fptr_stego_image, position, SEEK_SET) != 0)
+        {
+            printf(RED "Error Seeking to Scatter Block\n" RESET);
+            return e_failure;
+        }
+    }
+    remaining -= size;
+    encInfo->data_remaining = remaining;
     /*Remove Newline Character From the End*/
-    if (len > 0 && image_data[len - 1] == '\n')
+    if (remaining == 0 && !encInfo->binary_payload && secret_chunk[size - 1] == '\n')
     {
-        image_data[len - 1] = '\0';
-        len--;
+        secret_chunk[size - 1] = '\0';
     }
-    if(encode_data_to_image(image_data, encInfo->size_secret_file, encInfo->fptr_src_image, encInfo->fptr_stego_image) == e_success)
+    long payload_offset = encInfo->size_secret_file - remaining;
+    if(payload_offset <= encInfo->data_resume_offset) // Check what the earlier run wrote instead of writing it again
     {
+        if(check_resumed_chunk(secret_chunk, size, encInfo) == e_failure ||
+           (payload_offset == encInfo->data_resume_offset && encInfo->checksum != encInfo->journal.record.checksum))
+        {
+            printf(RED "Error: %s does not match its journal, remove %s to start over\n" RESET,
+                   encInfo->output->temp_fname, encInfo->journal.fname);
+            return e_failure;
+        }
         return e_success;
     }
-    else
+    if(encode_payload_to_image(secret_chunk, size, encInfo->fptr_src_image, encInfo->fptr_stego_image,
+                               encInfo->use_checksum ? &encInfo->checksum : NULL,
+                               encInfo->use_encryption ? &encInfo->cipher : NULL, encInfo->verify) == e_failure)
     {
         printf(RED "Error Encoding Secret File Data\n" RESET);
         return e_failure;
     }
-    
+    if(journal_due(&encInfo->journal, payload_offset) &&
+       (output_sync(encInfo->fptr_stego_image, encInfo->output) == e_failure ||
+        journal_checkpoint(&encInfo->journal, encInfo->output->fd, journal_data, ftell(encInfo->fptr_stego_image),
+                           payload_offset, encInfo->checksum) == e_failure || journal_stop))
+    {
+        return e_failure;
+    }
+    return e_success;
+}
+/* Function Definitions */
+
+/* Finish Encoding the Secret File Data
+ * Input: EncodeInfo with every chunk encoded
+ * Output: Checksum stored, images past the payload (resumable runs copy the rest of the image here)
+ * Return Values : e_success and e_failure
+ */
+Status encode_secret_data_finish(EncodeInfo *encInfo)
+{
+    progress_update(&encInfo->progress, encInfo->size_secret_file);
+    if(encInfo->key != NULL) // The rest of the image is already in place
+    {
+        fseek(encInfo->fptr_src_image, 0, SEEK_END);
+        fseek(encInfo->fptr_stego_image, 0, SEEK_END);
+    }
+    if(encInfo->use_checksum && encode_secret_file_checksum(encInfo) == e_failure)
+    {
+        return e_failure;
+    }
+    return encInfo->journal.enabled ? copy_remaining_resumable(encInfo) : e_success;
+}
+/* Function Definitions */
+
+/* Check a Resumed Chunk
+ * Input: size Characters of the secret file, EncodeInfo with both images at the chunk
+ * Output: Both images moved past the chunk, running CRC32C and keystream advanced
+ * Description: The part file must hold the chunk encoded into the cover bytes: the
+ * LSBs decode to the characters and nothing else changed
+ * Return Values : e_success and e_failure
+ */
+Status check_resumed_chunk(char *data, int size, EncodeInfo *encInfo)
+{
+    size_t image_size = size * MAX_IMAGE_BUF_SIZE, count = image_size;
+    char *cover_buffer = buf_alloc(2 * image_size + size);
+    char *part_buffer = cover_buffer + image_size, *decoded = part_buffer + image_size;
+    long position = ftell(encInfo->fptr_stego_image);
+    Status status = cover_buffer != NULL &&
+                    fread(cover_buffer, sizeof(char), count, encInfo->fptr_src_image) == count &&
+                    pread(encInfo->output->fd, part_buffer, count, position) == (ssize_t) count &&
+                    fseek(encInfo->fptr_stego_image, position + count, SEEK_SET) == 0 ? e_success : e_failure;
+    if(status == e_success)
+    {
+        decode_chunk_from_lsb(decoded, size, part_buffer, encInfo->use_checksum ? &encInfo->checksum : NULL,
+                              encInfo->use_encryption ? &encInfo->cipher : NULL);
+        if(memcmp(decoded, data, size) != 0 || verify_lsb_only(cover_buffer, part_buffer, count) == e_failure)
+        {
+            status = e_failure;
+        }
+    }
+    buf_free(cover_buffer, 2 * image_size + size);
+    return status;
+}
+/* Function Definitions */
+
+/* Copy the Remaining Image Data of a Resumable Encoding
+ * Input: EncodeInfo with the payload encoded
+ * Output: Rest of the cover copied, checkpointed every journal interval
+ * Description: The payload counts as fully written from here on. Bytes an earlier run
+ * already copied are compared with the cover instead of copied again. Scattered images
+ * were copied whole before their blocks, so only the final checkpoint is left
+ * Return Values : e_success and e_failure
+ */
+Status copy_remaining_resumable(EncodeInfo *encInfo)
+{
+    Journal *journal = &encInfo->journal;
+    long position = ftell(encInfo->fptr_stego_image);
+    long copied = journal->resuming && journal->record.stage == journal_tail ? journal->record.cover_offset : position;
+    size_t size = tune_config.chunk_size * MAX_IMAGE_BUF_SIZE;
+    char *buffer = buf_alloc(2 * size);
+    Status status = buffer != NULL && fseek(encInfo->fptr_src_image, position, SEEK_SET) == 0 ? e_success : e_failure;
+    size_t read;
+    while(status == e_success && (read = fread(buffer, sizeof(char), size, encInfo->fptr_src_image)) > 0)
+    {
+        if(position < copied) // Copied by the earlier run
+        {
+            if(pread(encInfo->output->fd, buffer + size, read, position) != (ssize_t) read || memcmp(buffer, buffer + size, read) != 0)
+            {
+                printf(RED "Error: %s does not match its journal, remove %s to start over\n" RESET, encInfo->output->temp_fname, journal->fname);
+                status = e_failure;
+            }
+            position += read;
+            if(status == e_success && fseek(encInfo->fptr_stego_image, position, SEEK_SET) != 0)
+            {
+                status = e_failure;
+            }
+            continue;
+        }
+        if(fwrite(buffer, sizeof(char), read, encInfo->fptr_stego_image) < read || progress_check(&encInfo->progress) == e_failure)
+        {
+            status = e_failure;
+        }
+        position += read;
+        if(status == e_success && (position - journal->record.cover_offset >= journal->interval || journal_stop) &&
+           (output_sync(encInfo->fptr_stego_image, encInfo->output) == e_failure ||
+            journal_checkpoint(journal, encInfo->output->fd, journal_tail, position, encInfo->size_secret_file, encInfo->checksum) == e_failure ||
+            journal_stop))
+        {
+            status = e_failure;
+        }
+    }
+    buf_free(buffer, 2 * size);
+    if(status == e_success &&
+       (output_sync(encInfo->fptr_stego_image, encInfo->output) == e_failure ||
+        journal_checkpoint(journal, encInfo->output->fd, journal_tail, position, encInfo->size_secret_file, encInfo->checksum) == e_failure))
+    {
+        status = e_failure;
+    }
+    return status;
+}
+/* Function Definitions */
+
+/* Prepare Scattered Secret File Data
+ * Input: EncodeInfo with both images positioned after the header fields
+ * Output: Scatter key for the whole blocks left in the image, and the rest of the
+ * source image copied to the destination image
+ * Description: Scattered blocks are written out of order, so lay the untouched bytes
+ * down first with large sequential copies and then overwrite just the picked blocks
+ * Return Values : e_success and e_failure
+ */
+Status prepare_scattered_data(EncodeInfo *encInfo)
+{
+    long data_offset = ftell(encInfo->fptr_src_image);
+    long block_count = (encInfo->cover.data_offset + encInfo->cover.data_size - data_offset) / SCATTER_BLOCK_SIZE;
+    long blocks_needed = (encInfo->size_secret_file + SCATTER_BLOCK_DATA - 1) / SCATTER_BLOCK_DATA;
+    if(blocks_needed > block_count)
+    {
+        printf(RED "ERROR: %s has %ld scatter blocks, %s needs %ld\n" RESET, encInfo->src_image_fname, block_count, encInfo->secret_fname, blocks_needed);
+        return e_failure;
+    }
+    scatter_init(&encInfo->scatter, encInfo->key, block_count);
+    if(encInfo->journal.resuming) // Copied before the first checkpoint of the earlier run
+    {
+        return e_success;
+    }
+    fseek(encInfo->fptr_src_image, data_offset, SEEK_SET);
+    char buffer[SCATTER_BLOCK_SIZE * 16];
+    size_t read;
+    while((read = fread(buffer, sizeof(char), sizeof(buffer), encInfo->fptr_src_image)) > 0)
+    {
+        if(fwrite(buffer, sizeof(char), read, encInfo->fptr_stego_image) < read)
+        {
+            printf(RED "Error Copying Image Data\n" RESET);
+            return e_failure;
+        }
+        if(progress_check(&encInfo->progress) == e_failure)
+        {
+            return e_failure;
+        }
+    }
+    if(encInfo->journal.enabled &&
+       (output_sync(encInfo->fptr_stego_image, encInfo->output) == e_failure ||
+        journal_checkpoint(&encInfo->journal, encInfo->output->fd, journal_data, ftell(encInfo->fptr_stego_image), 0, 0) == e_failure))
+    {
+        return e_failure;
+    }
+    return e_success;
+}
+/* Function Definitions */
+
+/* Encode Secret File Checksum in Destination Image
+ * Input: EncodeInfo with the CRC32C accumulated while encoding the data
+ * Output: Checksum encoded into the 32 bytes reserved after the file size
+ * Description: The checksum is only known once the data pass is done, so
+ * encode_secret_file_size keeps the reserved image bytes; encode the checksum
+ * into them and rewrite just those 32 bytes of the stego image
+ * Return Values : e_success and e_failure
+ */
+Status encode_secret_file_checksum(EncodeInfo *encInfo)
+{
+    uint size = sizeof(encInfo->checksum_image_data);
+    long end = ftell(encInfo->fptr_stego_image);
+    if(encode_size_field(encInfo->checksum, encInfo->checksum_image_data, encInfo) == e_failure ||
+       fseek(encInfo->fptr_stego_image, encInfo->checksum_offset, SEEK_SET) != 0 ||
+       fwrite(encInfo->checksum_image_data, sizeof(char), size, encInfo->fptr_stego_image) < size ||
+       fseek(encInfo->fptr_stego_image, end, SEEK_SET) != 0)
+    {
+        printf(RED "Error Writing Checksum\n" RESET);
+        return e_failure;
+    }
+    return e_success;
 }
 /* Function Definitions */
 
@@ -72,23 +443,48 @@ Status encode_secret_file_data(EncodeInfo *encInfo)
  */
 Status encode_secret_file_size(long file_size, EncodeInfo *encInfo)
 {
-    sleep(1);
-    printf(YEL "INFO: Encoding %s File Size\n" RESET, encInfo->secret_fname);
-    uint size = MAX_IMAGE_BUF_SIZE * (uint) sizeof(int); // Size is 32 Bytes
-    char buffer[size]; // Create an array buffer of size 32 bytes
+    info_pause();
+    info_printf(YEL "INFO: Encoding %s File Size\n" RESET, encInfo->secret_fname);
+    char buffer[MAX_IMAGE_BUF_SIZE * sizeof(int)]; // Create an array buffer of size 32 bytes
+    uint size = sizeof(buffer); // Size is 32 Bytes
     int read = fread(buffer, sizeof(char), size, encInfo->fptr_src_image); // Read 32 Bytes from source Image
     if(read < size)
     {
         printf(RED "Error Reading File Size\n" RESET);
         return e_failure;
     }
-    encode_size_to_lsb(file_size, buffer); // Encode the lsb of read bytes with secret file size
+    if(encode_size_field(file_size, buffer, encInfo) == e_failure) // Encode the lsb of read bytes with secret file size
+    {
+        return e_failure;
+    }
     int write = fwrite(buffer, sizeof(char), size, encInfo->fptr_stego_image); // Write 32 bytes inside Destination image
     if(write < size)
     {
         printf(RED "Error Writing File Size\n" RESET);
         return e_failure;
     }
+    if(encInfo->use_checksum) // Reserve the next 32 bytes for the checksum, copied as is until the data is encoded
+    {
+        encInfo->checksum = 0;
+        encInfo->checksum_offset = ftell(encInfo->fptr_stego_image);
+        if(fread(encInfo->checksum_image_data, sizeof(char), size, encInfo->fptr_src_image) < size ||
+           fwrite(encInfo->checksum_image_data, sizeof(char), size, encInfo->fptr_stego_image) < size)
+        {
+            printf(RED "Error Reserving Checksum\n" RESET);
+            return e_failure;
+        }
+    }
+    if(encInfo->use_encryption) // The salt follows, then derive the stream key from it
+    {
+        char *salt = encInfo->journal.record.salt; // A resumed run keeps the salt of the part file
+        if((!encInfo->journal.resuming && cipher_new_salt(salt) == e_failure) ||
+           encode_data_to_image(salt, CIPHER_SALT_SIZE, encInfo->fptr_src_image, encInfo->fptr_stego_image, encInfo->verify) == e_failure)
+        {
+            printf(RED "Error Encoding Salt\n" RESET);
+            return e_failure;
+        }
+        cipher_init(&encInfo->cipher, encInfo->key, salt);
+    }
     return e_success;
 }
 /* Function Definitions */
@@ -102,10 +498,10 @@ Status encode_secret_file_size(long file_size, EncodeInfo *encInfo)
  */
 Status encode_secret_file_extn(char *file_extn, EncodeInfo *encInfo)
 {
-    sleep(1);
-    printf(YEL "INFO: Encoding %s File Extenstion\n" RESET, encInfo->secret_fname);
+    info_pause();
+    info_printf(YEL "INFO: Encoding %s File Extenstion\n" RESET, encInfo->secret_fname);
     int extn_size = strlen(file_extn); // Size of Secret File Extension
-    if(encode_data_to_image(file_extn, extn_size, encInfo->fptr_src_image, encInfo->fptr_stego_image) == e_success) // Encode the Extension of Secret File in Destination Image
+    if(encode_data_to_image(file_extn, extn_size, encInfo->fptr_src_image, encInfo->fptr_stego_image, encInfo->verify) == e_success) // Encode the Extension of Secret File in Destination Image
     {
         return e_success;
     }
@@ -136,6 +532,29 @@ Status encode_size_to_lsb(uint size, char *buffer)
 }
 /* Function Definitions */
 
+/* Encode Size Field
+ * Input: Size, 32 image bytes, EncodeInfo
+ * Output: Size encoded into the LSB of the image bytes
+ * Description: With --verify, check the field decodes back and only LSBs changed
+ * Return Values : e_success and e_failure
+ */
+Status encode_size_field(uint size, char *buffer, EncodeInfo *encInfo)
+{
+    char cover_data[MAX_IMAGE_BUF_SIZE * sizeof(int)];
+    uint decoded = 0;
+    memcpy(cover_data, buffer, sizeof(cover_data));
+    encode_size_to_lsb(size, buffer);
+    if(encInfo->verify &&
+       (decode_size_from_lsb(&decoded, buffer) == e_failure || decoded != size ||
+        verify_lsb_only(cover_data, buffer, sizeof(cover_data)) == e_failure))
+    {
+        printf(RED "Error: Verification failed, size field decodes to %u instead of %u\n" RESET, decoded, size);
+        return e_failure;
+    }
+    return e_success;
+}
+/* Function Definitions */
+
 /* Encode Secret File Extension Size in Destination Image
  * Input: Secret File Extension Size, Source and Destination Image file ptr
  * Output: Copies Extension Size of Secret File Into Destination Image
@@ -145,17 +564,29 @@ Status encode_size_to_lsb(uint size, char *buffer)
  */
 Status encode_secret_file_extn_size(long file_extn_size, EncodeInfo *encInfo)
 {
-    sleep(1);
-    printf(YEL "INFO: Encoding %s File Extenstion Size\n" RESET, encInfo->secret_fname);
-    uint size = MAX_IMAGE_BUF_SIZE * (uint) sizeof(int); // Size is 32 Bytes
-    char buffer[size]; // Create an array buffer of size 32 bytes
+    info_pause();
+    info_printf(YEL "INFO: Encoding %s File Extenstion Size\n" RESET, encInfo->secret_fname);
+    char buffer[MAX_IMAGE_BUF_SIZE * sizeof(int)]; // Create an array buffer of size 32 bytes
+    uint size = sizeof(buffer); // Size is 32 Bytes
     int read = fread(buffer,sizeof(char), size, encInfo->fptr_src_image); // Read 32 Bytes from source Image
     if(read < size)
     {
         printf(RED "EXTN Encoding Failed\n" RESET);
         return e_failure;
     }
-    if( encode_size_to_lsb(file_extn_size, buffer) == e_success) // Encode the lsb of read bytes with file extn size
+    if(encInfo->use_checksum)
+    {
+        file_extn_size |= FLAG_CHECKSUM; // Tell the decoder a checksum follows the file size
+    }
+    if(encInfo->key != NULL)
+    {
+        file_extn_size |= FLAG_SCATTER; // Tell the decoder the data blocks are keyed
+    }
+    if(encInfo->use_encryption)
+    {
+        file_extn_size |= FLAG_ENCRYPT; // Tell the decoder a salt follows and the data is encrypted
+    }
+    if( encode_size_field(file_extn_size, buffer, encInfo) == e_success) // Encode the lsb of read bytes with file extn size
     {
         int write = fwrite(buffer, sizeof(char), size, encInfo->fptr_stego_image); // Write 32 bytes inside Destination image
         if(write < size)
@@ -192,48 +623,172 @@ Status encode_byte_to_lsb(char data, char *image_buffer)
  * Input: Character Data, Character Data Size, Source and Destination Image file ptr
  * Output: Copies Character Bytes of Data into Destination Image For 
  * MAGIC STRING, Secret File Extension and Secret File Data
- * Description: Read 8 Bytes of Data from Source Image, Encode the Character Data into 8 Bytes 
- * and Write the Encoded 8 Bytes Inside Destination Image For Size times 
+ * Description: Read 8 Bytes of Data from Source Image for every Character, Encode the Characters
+ * into them and Write the Encoded Bytes Inside Destination Image, one chunk at a time
  * Return Values : e_success and e_failure
  */
-Status encode_data_to_image(char *data, int size, FILE *fptr_src_image, FILE *fptr_stego_image)
+Status encode_data_to_image(char *data, int size, FILE *fptr_src_image, FILE *fptr_stego_image, int verify)
+{
+    return encode_payload_to_image(data, size, fptr_src_image, fptr_stego_image, NULL, NULL, verify);
+}
+
+Status encode_payload_to_image(char *data, int size, FILE *fptr_src_image, FILE *fptr_stego_image, uint *crc, CipherStream *cipher, int verify)
 {
-    char image_buffer[MAX_IMAGE_BUF_SIZE]; // Declare a character array of Size 8 bytes
+    int chunk_size = tune_config.chunk_size;
+    size_t image_size = chunk_size * MAX_IMAGE_BUF_SIZE; // 8 image bytes per character of the chunk
+    size_t buffer_size = verify ? 2 * image_size + chunk_size : image_size; // --verify also keeps the cover and the decoded chunk
+    char *image_buffer = buf_alloc(buffer_size);
+    char *cover_buffer = image_buffer + image_size, *decoded = cover_buffer + image_size;
+    CipherStream check_cipher;
+    Status status = e_success;
+    if(image_buffer == NULL)
+    {
+        printf(RED "Error: Memory Allocation Failed\n" RESET);
+        return e_failure;
+    }
     
-    for( int i = 0; i < size; i++) 
+    for( int i = 0; i < size && status == e_success; i += chunk_size) 
     {
-        int read = fread(image_buffer, sizeof(char), MAX_IMAGE_BUF_SIZE, fptr_src_image); // Read 8 Bytes from source Image
-        if(read < MAX_IMAGE_BUF_SIZE)
+        int count = size - i < chunk_size ? size - i : chunk_size;
+        TRACE_BEGIN_BYTES("io", "read cover", count * MAX_IMAGE_BUF_SIZE);
+        int read = fread(image_buffer, sizeof(char), count * MAX_IMAGE_BUF_SIZE, fptr_src_image); // Read 8 Bytes per Character from source Image
+        TRACE_END();
+        if(read < count * MAX_IMAGE_BUF_SIZE)
         {
             printf(RED "Error reading data bytes from source image\n" RESET);
-            return e_failure;
+            status = e_failure;
+            break;
+        }
+        if(verify) // Keep what the kernel starts from, to decode its output back
+        {
+            memcpy(cover_buffer, image_buffer, count * MAX_IMAGE_BUF_SIZE);
+            if(cipher != NULL)
+            {
+                check_cipher = *cipher;
+            }
         }
-        encode_byte_to_lsb(data[i], image_buffer); // Convert the read bytes lsb with Character bytes
-        int write = fwrite(image_buffer, sizeof(char), MAX_IMAGE_BUF_SIZE, fptr_stego_image); // Encode the Converted Bytes Inside the Destination Image
+        TRACE_BEGIN_BYTES("kernel", "encode chunk", count);
+        encode_chunk_to_lsb(data + i, count, image_buffer, crc, cipher); // Convert the read bytes lsb with Character bytes
+        TRACE_END();
+        if(verify)
+        {
+            decode_chunk_from_lsb(decoded, count, image_buffer, NULL, cipher != NULL ? &check_cipher : NULL);
+            if(memcmp(decoded, data + i, count) != 0 ||
+               verify_lsb_only(cover_buffer, image_buffer, count * MAX_IMAGE_BUF_SIZE) == e_failure)
+            {
+                printf(RED "Error: Verification failed, encoded data does not decode back\n" RESET);
+                status = e_failure;
+                break;
+            }
+        }
+        TRACE_BEGIN_BYTES("io", "write stego", count * MAX_IMAGE_BUF_SIZE);
+        int write = fwrite(image_buffer, sizeof(char), count * MAX_IMAGE_BUF_SIZE, fptr_stego_image); // Encode the Converted Bytes Inside the Destination Image
+        TRACE_END();
 
-        if(write < 8)
+        if(write < count * MAX_IMAGE_BUF_SIZE)
         {
             printf(RED "Error writing data bytes to stego image\n" RESET);
-            return e_failure;
+            status = e_failure;
         }
     }
-    return e_success;
+    buf_free(image_buffer, buffer_size);
+    return status;
+}
+/* Function Definitions */
+
+/* Encode a Chunk of Character Data Into LSB of Image Data
+ * Input: size Characters, Buffer Containing size * 8 Bytes of Image Data, running CRC32C (or NULL),
+ * keystream for the characters (or NULL)
+ * Output: Image Data Bytes with the (encrypted) Characters in their LSB, updated CRC32C
+ * Description: On CPUs with SSE4.2 the characters are loaded 8 at a time and folded into
+ * the CRC with the crc32 instruction, XORed with the keystream and spread over the LSB
+ * while the word is still in a register, so neither the checksum nor the encryption
+ * costs an extra pass over the data. The CRC covers the plain characters
+ */
+static void encode_chunk_generic(const char *data, int size, char *image_buffer, uint *crc, const char *keystream)
+{
+    for(int i = 0; i < size; i++)
+    {
+        encode_byte_to_lsb(keystream ? data[i] ^ keystream[i] : data[i], image_buffer + (i * MAX_IMAGE_BUF_SIZE));
+    }
+    if(crc != NULL)
+    {
+        *crc = crc32c_update(*crc, data, size);
+    }
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2")))
+static void encode_chunk_sse42(const char *data, int size, char *image_buffer, uint *crc, const char *keystream)
+{
+    uint state = ~*crc;
+    int i = 0;
+    for(; i + 8 <= size; i += 8)
+    {
+        unsigned long word, key_word = 0;
+        memcpy(&word, data + i, sizeof(word));
+        state = __builtin_ia32_crc32di(state, word);
+        if(keystream != NULL)
+        {
+            memcpy(&key_word, keystream + i, sizeof(key_word));
+        }
+        word ^= key_word;
+        for(int j = 0; j < 8; j++)
+        {
+            encode_byte_to_lsb(word >> (8 * j), image_buffer + ((i + j) * MAX_IMAGE_BUF_SIZE));
+        }
+    }
+    for(; i < size; i++)
+    {
+        state = __builtin_ia32_crc32qi(state, data[i]);
+        encode_byte_to_lsb(keystream ? data[i] ^ keystream[i] : data[i], image_buffer + (i * MAX_IMAGE_BUF_SIZE));
+    }
+    *crc = ~state;
+}
+#endif
+
+static void encode_chunk_dispatch(const char *data, int size, char *image_buffer, uint *crc, const char *keystream)
+{
+#if defined(__x86_64__)
+    if(crc != NULL && tune_use_sse42())
+    {
+        encode_chunk_sse42(data, size, image_buffer, crc, keystream);
+        return;
+    }
+#endif
+    encode_chunk_generic(data, size, image_buffer, crc, keystream);
+}
+
+void encode_chunk_to_lsb(const char *data, int size, char *image_buffer, uint *crc, CipherStream *cipher)
+{
+    if(cipher == NULL)
+    {
+        encode_chunk_dispatch(data, size, image_buffer, crc, NULL);
+        return;
+    }
+    char keystream[CIPHER_SEGMENT_SIZE]; // Small enough to stay in L1 next to the data
+    for(int i = 0; i < size; i += CIPHER_SEGMENT_SIZE)
+    {
+        int count = size - i < CIPHER_SEGMENT_SIZE ? size - i : CIPHER_SEGMENT_SIZE;
+        cipher_keystream(cipher, keystream, count);
+        encode_chunk_dispatch(data + i, count, image_buffer + (i * MAX_IMAGE_BUF_SIZE), crc, keystream);
+    }
 }
 /* Function Definitions */
 
 /* Encode Magic string into destination Image
  * Input: Magic string, Magic String Size, Source and Destination Image file ptr
- * Output: Copies Magic String into Destination Image After 54 Bytes of Header data
+ * Output: Copies Magic String into Destination Image After the Header data
  * Description: Call encode data to image function to encode the magic string character 
  * based on the length of magic string into destination image
  * Return Values : e_success and e_failure
  */
 Status encode_magic_string(const char *magic_string, EncodeInfo *encInfo)
 {
-    sleep(1);
-    printf(YEL "INFO: Encoding Magic String Signature\n" RESET);
+    info_pause();
+    info_printf(YEL "INFO: Encoding Magic String Signature\n" RESET);
     int size = strlen(MAGIC_STRING);
-    if(encode_data_to_image(MAGIC_STRING, size, encInfo->fptr_src_image, encInfo->fptr_stego_image) == e_success)
+    if(encode_data_to_image(MAGIC_STRING, size, encInfo->fptr_src_image, encInfo->fptr_stego_image, encInfo->verify) == e_success)
     {
         return e_success;
     }
@@ -245,31 +800,38 @@ Status encode_magic_string(const char *magic_string, EncodeInfo *encInfo)
 }
 /* Function Definitions */
 
-/* Copy BMP header from source bmp image to destination stego image
- * Input: Source and Destination Image file ptr
- * Output: Copies 54 Bytes of Header Data From src to dest image
- * Description: Read 54 bytes of data from source bmp image and write the data to destination stego image
+/* Copy image header from source image to destination stego image
+ * Input: EncodeInfo with the source image header parsed
+ * Output: Copies the Header Data in front of the pixel region From src to dest image
+ * Description: Let the cover format backend write the stego header, leaving both
+ * images positioned at the pixel region
  * Return Values : e_success and e_failure
  */
-Status copy_bmp_header(FILE *fptr_src_image, FILE *fptr_dest_image)
+Status copy_image_header(EncodeInfo *encInfo)
 {
-    sleep(1);
-    printf(YEL "INFO: Copying Image Header\n" RESET);
-    rewind(fptr_src_image); // Rewind the File Position Indicator to 0th Position
-    char buffer[MAX_HEADER_SIZE];
-    int read = fread(buffer, sizeof(char), MAX_HEADER_SIZE, fptr_src_image); // Read 54 Bytes from the Source Image
-    if(read < MAX_HEADER_SIZE)
+    info_pause();
+    info_printf(YEL "INFO: Copying Image Header\n" RESET);
+    if(encInfo->update_in_place && encInfo->cover.format->open_writer != NULL)
     {
-        printf(RED "Error Reading bmp header\n" RESET);
+        printf(RED "Error: %s images can't be updated in place\n" RESET, encInfo->cover.format->name);
         return e_failure;
     }
-    int write = fwrite(buffer, sizeof(char), MAX_HEADER_SIZE, fptr_dest_image); // Write read Bytes in the Destination Image
-    if(write < MAX_HEADER_SIZE)
+    if(encInfo->verify && encInfo->cover.format->open_writer == NULL) // Hash what passes through both images
     {
-        printf(RED "Error Writing bmp header\n" RESET);
-        return e_failure;
+        long end = encInfo->update_in_place ? encInfo->cover.data_offset + encInfo->cover.data_size : LONG_MAX;
+        verify_track_init(&encInfo->verify_cover, &encInfo->cover, end);
+        verify_track_init(&encInfo->verify_stego, &encInfo->cover, end);
+        FILE *fptr_src = verify_open(encInfo->fptr_src_image, "r", &encInfo->verify_cover);
+        FILE *fptr_stego = fptr_src != NULL ? verify_open(encInfo->fptr_stego_image, "w", &encInfo->verify_stego) : NULL;
+        if(fptr_stego == NULL)
+        {
+            printf(RED "Error: Unable to set up verification\n" RESET);
+            return e_failure;
+        }
+        encInfo->fptr_src_image = fptr_src;
+        encInfo->fptr_stego_image = fptr_stego;
     }
-    return e_success;
+    return cover_write_header(&encInfo->fptr_src_image, &encInfo->fptr_stego_image, &encInfo->cover);
 }
 /* Function Definitions */
 
@@ -281,79 +843,110 @@ Status copy_bmp_header(FILE *fptr_src_image, FILE *fptr_dest_image)
  */
 Status check_capacity(EncodeInfo* encInfo)
 {
-    encInfo->image_capacity = get_image_size_for_bmp(encInfo->fptr_src_image, encInfo); // Get Source Image Size
+    encInfo->image_capacity = get_image_size(encInfo->fptr_src_image, encInfo); // Get Source Image Size
+    if(encInfo->image_capacity == 0)
+    {
+        printf(RED "ERROR: Unable to read %s header\n" RESET, encInfo->src_image_fname);
+        return e_failure;
+    }
     encInfo->size_secret_file = get_file_size(encInfo->fptr_secret); // Get Secret File Size
-    sleep(1);
-    printf(YEL "INFO: Checking for %s capacity to handle %s\n" RESET, encInfo->src_image_fname, encInfo->secret_fname);
+    info_pause();
+    info_printf(YEL "INFO: Checking for %s capacity to handle %s\n" RESET, encInfo->src_image_fname, encInfo->secret_fname);
     int MAGIC_STRING_SIZE = strlen(MAGIC_STRING); // Size of Magic String
     int extn_secret_file_size = strlen(encInfo->extn_secret_file); // Size of Secret file extension
-    uint file_size = 4; // Maximum File size
-    uint capacity = (MAX_HEADER_SIZE) + ((MAGIC_STRING_SIZE + file_size + extn_secret_file_size 
-    + encInfo->size_secret_file + MAX_FILE_SUFFIX) * MAX_IMAGE_BUF_SIZE);
+    long file_size = 4; // Maximum File size
+    long checksum_size = encInfo->use_checksum ? sizeof(int) : 0; // Optional checksum field
+    long salt_size = encInfo->use_encryption ? CIPHER_SALT_SIZE : 0; // Optional salt field
+    long capacity = ((MAGIC_STRING_SIZE + file_size + extn_secret_file_size 
+    + encInfo->size_secret_file + MAX_FILE_SUFFIX + checksum_size + salt_size) * MAX_IMAGE_BUF_SIZE); // 64 bit, y4m covers reach GiBs
     if(encInfo->image_capacity > capacity) // Check if Image capacity is greater than the calculated Capacity
     {
-        sleep(1);
-        printf(GRN "INFO: Done. Found OK\n" RESET);
+        info_pause();
+        info_printf(GRN "INFO: Done. Found OK\n" RESET);
         return e_success;
     }
     else
     {
-        sleep(1);
+        info_pause();
         printf(RED "ERROR: %s doesn't have the capacity to encode %s\n" RESET, encInfo->src_image_fname, encInfo->secret_fname);
         return e_failure;
     }
 }
 /* Function Definitions */
 
-/* Get image size
- * Input: Image file ptr
- * Output: width * height * bytes per pixel (3 in our case)
- * Description: In BMP Image, width is stored in offset 18,
- * and height after that. size is 4 bytes
+/* Get file size
+ * Input: Secret file ptr
+ * Output: Size of the secret file in bytes
  */
 uint get_file_size(FILE* fptr_secret)
 {
-    sleep(1);
-    printf(YEL "INFO: Checking for secret.txt size\n" RESET);
+    info_pause();
+    info_printf(YEL "INFO: Checking for secret.txt size\n" RESET);
     fseek(fptr_secret, 0, SEEK_END);
     uint size = ftell(fptr_secret);
     if (size > 0)
     {
-        sleep(1);
-        printf(GRN "INFO: Done. Not Empty\n" RESET);
+        info_pause();
+        info_printf(GRN "INFO: Done. Not Empty\n" RESET);
         return size;
     }
-    sleep(1);
-    printf(RED "INFO: Done. Empty\n" RESET);
+    info_pause();
+    info_printf(RED "INFO: Done. Empty\n" RESET);
     return size;
 }
-uint get_image_size_for_bmp(FILE *fptr_image, EncodeInfo *encInfo)
+/* Get image size
+ * Input: Image file ptr
+ * Output: Size of the pixel region, 0 if the header can't be parsed
+ * Description: The cover format backend recognizes the image and reports
+ * its dimensions and where the pixel samples are stored
+ */
+long get_image_size(FILE *fptr_image, EncodeInfo *encInfo)
 {
-    uint width, height;
-    // Seek to 18th byte
-    fseek(fptr_image, 18, SEEK_SET);
-
-    // Read the width (an int)
-    fread(&width, sizeof(int), 1, fptr_image);
-
-    // Read the height (an int)
-    fread(&height, sizeof(int), 1, fptr_image);
-
-    printf(RED "width = %u\n" RESET, width);
-    printf(RED "height = %u\n" RESET, height);
-
-    // Read bit pixel
-    fseek(fptr_image, 2L, SEEK_CUR);
-	fread(&encInfo->bits_per_pixel, sizeof(short), 1, fptr_image);
-	rewind(fptr_image);
+    if(cover_open(fptr_image, &encInfo->cover) == e_failure)
+    {
+        return 0;
+    }
+    info_printf(RED "width = %u\n" RESET, encInfo->cover.width);
+    info_printf(RED "height = %u\n" RESET, encInfo->cover.height);
 
-    // Convert bits per pixel to bytes per pixel
-    uint bytes_per_pixel = encInfo->bits_per_pixel / 8;
+    // Bits per pixel of the 8 bit samples
+    encInfo->bits_per_pixel = encInfo->cover.channels * 8;
 
     // Return image capacity
-    return width * height * bytes_per_pixel;
+    return encInfo->cover.data_size;
 }
 
+/* Function Definitions */
+
+/* Open a Resumable Stego Image
+ * Input: EncodeInfo with both input files open, expected output size
+ * Output: Stream over <output>.part, journal open
+ * Description: The part file is only resumed when the journal matches the inputs and
+ * the part holds everything the journal says was written; otherwise it starts empty
+ * Return Values : e_success and e_failure
+ */
+static Status open_resumable_stego(EncodeInfo *encInfo, long size)
+{
+    long part_size;
+    uint flags = encInfo->use_checksum | (encInfo->key != NULL) << 1 | encInfo->use_encryption << 2 | encInfo->binary_payload << 3;
+    encInfo->fptr_stego_image = output_open_part(encInfo->stego_image_fname, size, 1, encInfo->output_policy, &encInfo->output, &part_size);
+    if (encInfo->fptr_stego_image == NULL ||
+        journal_open(&encInfo->journal, encInfo->stego_image_fname,
+                     journal_identity(encInfo->src_image_fname, encInfo->secret_fname, encInfo->key, flags)) == e_failure)
+    {
+        return e_failure;
+    }
+    if (encInfo->journal.resuming && part_size < encInfo->journal.record.cover_offset)
+    {
+        printf(YEL "INFO: %s is shorter than its journal, starting over\n" RESET, encInfo->output->temp_fname);
+        encInfo->journal.resuming = 0;
+    }
+    if (!encInfo->journal.resuming && ftruncate(encInfo->output->fd, 0) != 0)
+    {
+        return e_failure;
+    }
+    return e_success;
+}
 /* 
  * Get File pointers for i/p and o/p files
  * Inputs: Src Image file, Secret file and
@@ -363,8 +956,8 @@ uint get_image_size_for_bmp(FILE *fptr_image, EncodeInfo *encInfo)
  */
 Status open_files(EncodeInfo *encInfo)
 {
-    sleep(1);
-    printf(YEL "INFO: Opening required files\n" RESET);
+    info_pause();
+    info_printf(YEL "INFO: Opening required files\n" RESET);
     // Src Image file
     encInfo->fptr_src_image = fopen(encInfo->src_image_fname, "r");
     // Do Error handling
@@ -375,22 +968,54 @@ Status open_files(EncodeInfo *encInfo)
 
     	return e_failure;
     }
-    sleep(1);
-    printf(GRN "INFO: Opened %s Successfully\n" RESET, encInfo->src_image_fname);
-    // Secret file
-    encInfo->fptr_secret = fopen(encInfo->secret_fname, "r");
-    // Do Error handling
+    info_pause();
+    info_printf(GRN "INFO: Opened %s Successfully\n" RESET, encInfo->src_image_fname);
+    // Secret file, unless already prepared (e.g. an archive built in a temporary file)
     if (encInfo->fptr_secret == NULL)
     {
-    	perror("fopen");
-    	fprintf(stderr, RED "ERROR: Unable to open file %s\n" RESET, encInfo->secret_fname);
+        encInfo->fptr_secret = fopen(encInfo->secret_fname, "r");
+        // Do Error handling
+        if (encInfo->fptr_secret == NULL)
+        {
+            perror("fopen");
+            fprintf(stderr, RED "ERROR: Unable to open file %s\n" RESET, encInfo->secret_fname);
 
-    	return e_failure;
+            return e_failure;
+        }
+        info_pause();
+        info_printf(GRN "INFO: Opened %s Successfully\n" RESET, encInfo->secret_fname);
+    }
+    // Stego Image file, or a diffing stream over the source image for an in place update
+    if (encInfo->update_in_place && strcmp(encInfo->stego_image_fname, encInfo->src_image_fname) != 0)
+    {
+        printf(RED "Error: --update needs the stego image as the only image\n" RESET);
+        return e_failure;
+    }
+    const CoverFormat *format = cover_format_for_name(encInfo->src_image_fname);
+    struct stat st;
+    long size = format != NULL && format->same_size && fstat(fileno(encInfo->fptr_src_image), &st) == 0 ? st.st_size : 0;
+    if (encInfo->update_in_place)
+    {
+        encInfo->fptr_stego_image = inplace_open(encInfo->stego_image_fname, &encInfo->bytes_updated);
+    }
+    else if (encInfo->journal.enabled)
+    {
+        if (format == NULL || format->open_writer != NULL || encInfo->verify)
+        {
+            printf(RED "Error: --resume needs a raw cover format (bmp, pnm, pam, tga) and no --verify\n" RESET);
+            return e_failure;
+        }
+        if (open_resumable_stego(encInfo, size) == e_failure)
+        {
+            return e_failure;
+        }
+    }
+    else
+    {
+        encInfo->fptr_stego_image = output_open(encInfo->stego_image_fname, size,
+                                                format != NULL && format->open_writer == NULL, // Compressed and video writers need a plain fd
+                                                encInfo->output_policy, &encInfo->output);
     }
-    sleep(1);
-    printf(GRN "INFO: Opened %s Successfully\n" RESET, encInfo->secret_fname);
-    // Stego Image file
-    encInfo->fptr_stego_image = fopen(encInfo->stego_image_fname, "w");
     // Do Error handling
     if (encInfo->fptr_stego_image == NULL)
     {
@@ -399,8 +1024,8 @@ Status open_files(EncodeInfo *encInfo)
 
     	return e_failure;
     }
-    sleep(1);
-    printf(GRN "INFO: Opened %s Successfully\n" RESET, encInfo->stego_image_fname);
+    info_pause();
+    info_printf(GRN "INFO: Opened %s Successfully\n" RESET, encInfo->stego_image_fname);
     // No failure return e_success
     return e_success;
 }
@@ -412,33 +1037,46 @@ Status open_files(EncodeInfo *encInfo)
 */
 Status read_and_validate_encode_args(char *argv[], EncodeInfo *encInfo)
 {
-    if(strcmp((strstr(argv[2], ".")), ".bmp") == 0) /* Check For Passed Image Format as .bmp */
+    const CoverFormat *format = cover_format_for_name(argv[2]);
+    if(format != NULL) /* Check For Passed Image Format as a supported cover */
     {
         encInfo->src_image_fname = argv[2];
         char *extn;
-        extn = strstr(argv[3], ".");
-        if((strcmp(extn, ".txt") == 0) || (strcmp(extn, ".sh") == 0) || (strcmp(extn, ".c") == 0)) /* Check For Passed Secret File Format as .txt or .c or .sh */
+        extn = strrchr(argv[3], '.'); /* Extension of the file name, dots of directories are not one */
+        if(extn != NULL && strchr(extn, '/') == NULL &&
+           ((strcmp(extn, ".txt") == 0) || (strcmp(extn, ".sh") == 0) || (strcmp(extn, ".c") == 0))) /* Check For Passed Secret File Format as .txt or .c or .sh */
         {
             encInfo->secret_fname = argv[3];
             strcpy(encInfo->extn_secret_file, extn);
-            if (!(argv[4] == NULL)) /* Check Whether Output Image Argument is Passed or not ! */
+            if (encInfo->update_in_place) /* The stego image is rewritten in place */
             {
-                if(strcmp((strstr(argv[4], ".")), ".bmp") == 0) /* If Output Image Argument is Passed check if it's Extension is .bmp */
+                if (argv[4] != NULL)
+                {
+                    printf(RED "Error: --update rewrites %s in place, no output file is taken\n" RESET, argv[2]);
+                    return e_failure;
+                }
+                encInfo->stego_image_fname = argv[2];
+            }
+            else if (!(argv[4] == NULL)) /* Check Whether Output Image Argument is Passed or not ! */
+            {
+                if(cover_format_for_name(argv[4]) == format) /* If Output Image Argument is Passed check it is of the same format */
                 {
                     encInfo->stego_image_fname = argv[4];
                 }
                 else
                 {
-                    sleep(1);
-                    printf(RED "Output File name is not of type .bmp\n" RESET);
+                    info_pause();
+                    printf(RED "Output File name is not of type %s\n" RESET, strrchr(argv[2], '.'));
                     return e_failure;
                 }
             }
             else
             {
-                sleep(1);
-                printf(YEL "INFO: Output File not mentioned. Creating stego.bmp as default\n" RESET);
-                encInfo->stego_image_fname = "stego.bmp"; /* If not Passed Create Default File Named STEGO.bmp */
+                static char default_fname[MAX_FILE_SUFFIX + 8];
+                snprintf(default_fname, sizeof(default_fname), "stego%s", strrchr(argv[2], '.'));
+                info_pause();
+                info_printf(YEL "INFO: Output File not mentioned. Creating %s as default\n" RESET, default_fname);
+                encInfo->stego_image_fname = default_fname; /* If not Passed Create Default File Named STEGO with the cover extension */
             }
             
         }
@@ -450,12 +1088,99 @@ Status read_and_validate_encode_args(char *argv[], EncodeInfo *encInfo)
     }
     else
     {
-        printf(RED "Source Image File is not of type .bmp\n" RESET);
+        printf(RED "Source Image File is not of a supported type (%s)\n" RESET, cover_supported_extns());
         return e_failure;
     }
     return e_success;
 }
 
+/*
+* Validate Encode Options
+* Inputs: Options separated from the positional command line arguments
+* Output: use_checksum when --checksum is passed, use_encryption when --encrypt is passed,
+* key when --key KEY is passed
+* Return Values: e_success or e_failure
+*/
+Status read_and_validate_encode_options(char *options[], EncodeInfo *encInfo)
+{
+    for(int i = 0; options[i] != NULL; i++)
+    {
+        if(strcmp(options[i], "--checksum") == 0)
+        {
+            encInfo->use_checksum = 1;
+        }
+        else if(strcmp(options[i], "--encrypt") == 0)
+        {
+            encInfo->use_encryption = 1;
+        }
+        else if(strcmp(options[i], "--update") == 0)
+        {
+            encInfo->update_in_place = 1;
+        }
+        else if(strcmp(options[i], "--verify") == 0)
+        {
+            encInfo->verify = 1;
+        }
+        else if(strcmp(options[i], "--stats") == 0)
+        {
+            encInfo->stats.enabled = 1;
+        }
+        else if(strcmp(options[i], "--progress") == 0)
+        {
+            encInfo->progress.callback = progress_print;
+        }
+        else if(strcmp(options[i], "--resume") == 0)
+        {
+            encInfo->journal.enabled = 1;
+            encInfo->journal.fd = -1;
+        }
+        else if(strcmp(options[i], "--checkpoint") == 0 && options[i + 1] != NULL)
+        {
+            encInfo->journal.interval = atol(options[++i]) << 20;
+            if(encInfo->journal.interval <= 0)
+            {
+                printf(RED "Invalid Checkpoint Interval %s MB\n" RESET, options[i]);
+                return e_failure;
+            }
+        }
+        else if(strcmp(options[i], "--direct") == 0 && encInfo->output_policy != NULL)
+        {
+            encInfo->output_policy->direct = 1;
+        }
+        else if(strcmp(options[i], "--durability") == 0 && options[i + 1] != NULL && encInfo->output_policy != NULL)
+        {
+            if(output_parse_durability(options[++i], encInfo->output_policy) == e_failure)
+            {
+                return e_failure;
+            }
+        }
+        else if(strcmp(options[i], "--key") == 0 && options[i + 1] != NULL)
+        {
+            encInfo->key = options[++i];
+            if(strlen(encInfo->key) == 0)
+            {
+                printf(RED "Error: Empty Key\n" RESET);
+                return e_failure;
+            }
+        }
+        else
+        {
+            printf(RED "Unsupported Encode Option %s\n" RESET, options[i]);
+            return e_failure;
+        }
+    }
+    if(encInfo->use_encryption && encInfo->key == NULL)
+    {
+        printf(RED "Error: --encrypt needs --key KEY\n" RESET);
+        return e_failure;
+    }
+    if(encInfo->journal.interval == 0)
+    {
+        encInfo->journal.interval = (long) JOURNAL_DEFAULT_INTERVAL << 20;
+    }
+    return e_success;
+}
+
 /* 
  * Perform Encoding
  * Inputs: Call each Functions one by one to perform the encoding task
@@ -465,43 +1190,46 @@ Status read_and_validate_encode_args(char *argv[], EncodeInfo *encInfo)
 
 Status do_encoding(EncodeInfo *encInfo)
 {
-    if(open_files(encInfo) == e_success)
+    if(PERF_STAGE(&encInfo->stats, "open files", open_files(encInfo)) == e_success)
     {
-        sleep(1);
-        printf(BGREEN"[INFO] Done\n"RESET);
-        printf(BMAGENTA "[INFO] ## Encoding Procedure Started ##\n" RESET);
-        if(check_capacity(encInfo) == e_success)
+        info_pause();
+        info_printf(BGREEN"[INFO] Done\n"RESET);
+        info_printf(BMAGENTA "[INFO] ## Encoding Procedure Started ##\n" RESET);
+        if(PERF_STAGE(&encInfo->stats, "check capacity", check_capacity(encInfo)) == e_success)
         {
-            sleep(1);
-            printf(BGREEN"[INFO] Check Capacity Done\n"RESET);
-            if( copy_bmp_header(encInfo->fptr_src_image, encInfo->fptr_stego_image) == e_success)
+            info_pause();
+            info_printf(BGREEN"[INFO] Check Capacity Done\n"RESET);
+            if( PERF_STAGE(&encInfo->stats, "copy image header", copy_image_header(encInfo)) == e_success)
             {
-                sleep(1);
-                printf(BCYAN"[INFO] Copying BMP Header Successfully\n"RESET);
-                if( encode_magic_string(MAGIC_STRING, encInfo) == e_success)
+                info_pause();
+                info_printf(BCYAN"[INFO] Copying Image Header Successfully\n"RESET);
+                if( PERF_STAGE(&encInfo->stats, "encode magic string", encode_magic_string(MAGIC_STRING, encInfo)) == e_success)
                 {
-                    sleep(1);
-                    printf(BBLUE"[INFO] MAGIC STRING Encoded Successfully\n"RESET);
-                    if( encode_secret_file_extn_size(strlen(encInfo->extn_secret_file), encInfo) == e_success)
+                    info_pause();
+                    info_printf(BBLUE"[INFO] MAGIC STRING Encoded Successfully\n"RESET);
+                    if( PERF_STAGE(&encInfo->stats, "encode extn size", encode_secret_file_extn_size(strlen(encInfo->extn_secret_file), encInfo)) == e_success)
                     {
-                        sleep(1);
-                        printf(BMAGENTA"[INFO] Secret File Extension Size Encoded Successfully\n"RESET);
-                        if( encode_secret_file_extn(encInfo->extn_secret_file, encInfo) == e_success)
+                        info_pause();
+                        info_printf(BMAGENTA"[INFO] Secret File Extension Size Encoded Successfully\n"RESET);
+                        if( PERF_STAGE(&encInfo->stats, "encode extn", encode_secret_file_extn(encInfo->extn_secret_file, encInfo)) == e_success)
                         {
-                            sleep(1);
-                            printf(BCYAN"[INFO] Secret File Extension Encoded Successfully\n");
-                            if( encode_secret_file_size(encInfo->size_secret_file, encInfo) == e_success)
+                            info_pause();
+                            info_printf(BCYAN"[INFO] Secret File Extension Encoded Successfully\n");
+                            if( PERF_STAGE(&encInfo->stats, "encode file size", encode_secret_file_size(encInfo->size_secret_file, encInfo)) == e_success)
                             {
-                                sleep(1);
-                                printf(BMAGENTA"[INFO] Secret File Size Encoded SuccessFully\n"RESET);
-                                if( encode_secret_file_data(encInfo) == e_success)
+                                info_pause();
+                                info_printf(BMAGENTA"[INFO] Secret File Size Encoded SuccessFully\n"RESET);
+                                if( PERF_STAGE(&encInfo->stats, "encode file data", encode_secret_file_data(encInfo)) == e_success)
                                 {
-                                    sleep(1);
-                                    printf(BCYAN"[INFO] Secret File Data Encoded Successfully\n"RESET);
-                                    if (copy_remaining_img_data(encInfo->fptr_src_image, encInfo->fptr_stego_image) == e_success)
+                                    info_pause();
+                                    info_printf(BCYAN"[INFO] Secret File Data Encoded Successfully\n"RESET);
+                                    if ((encInfo->update_in_place || // Past the payload an updated image is left as it is
+                                         PERF_STAGE(&encInfo->stats, "copy remaining data",
+                                                    copy_remaining_img_data(encInfo->fptr_src_image, encInfo->fptr_stego_image, &encInfo->progress)) == e_success) &&
+                                        PERF_STAGE(&encInfo->stats, "close stego image", close_stego_image(encInfo)) == e_success)
                                     {
-                                        sleep(1);
-                                        printf(BRED "[INFO] Remaining Image Data Copied Successfully\n" RESET);
+                                        info_pause();
+                                        info_printf(BRED "[INFO] Remaining Image Data Copied Successfully\n" RESET);
                                         return e_success;
                                     }
                                     else
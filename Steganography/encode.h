@@ -2,6 +2,15 @@
 #define ENCODE_H
 
 #include "types.h" // Contains user defined types
+#include "tune.h"
+#include "scatter.h"
+#include "cipher.h"
+#include "cover.h"
+#include "verify.h"
+#include "perfstat.h"
+#include "output.h"
+#include "journal.h"
+#include "progress.h"
 
 /* 
  * Structure to store information required for
@@ -12,28 +21,64 @@
 
 #define MAX_SECRET_BUF_SIZE 1
 #define MAX_IMAGE_BUF_SIZE (MAX_SECRET_BUF_SIZE * 8)
+#define MAX_SECRET_CHUNK_SIZE 65536 /* Largest payload chunk --chunk and --tune may pick, see tune.h */
 #define MAX_FILE_SUFFIX 4
-#define MAX_HEADER_SIZE 54
 
 typedef struct _EncodeInfo
 {
     /* Source Image info */
     char *src_image_fname; /* Store the source image name*/
     FILE *fptr_src_image; /* Store the source image */
-    uint image_capacity; /*Store the size of the source image */
+    long image_capacity; /*Store the size of the source image */
     uint bits_per_pixel;
+    CoverInfo cover; /*Store the format and pixel region of the source image*/
     char image_data[MAX_IMAGE_BUF_SIZE]; /*TO store the image data*/
 
     /* Secret File Info */
     char *secret_fname; /*Store the secret file name */
     FILE *fptr_secret; /*Store the secret file address*/
-    char extn_secret_file[MAX_FILE_SUFFIX]; /*Store the extension of secret file*/
+    char extn_secret_file[MAX_FILE_SUFFIX + 1]; /*Store the extension of secret file*/
     char secret_data[MAX_SECRET_BUF_SIZE]; /*Store the data present inside the secret file*/
     long size_secret_file; /*Store the size of the secret file*/
+    int binary_payload; /*Embed the secret data verbatim, without trimming a trailing newline*/
+
+    /* Checksum Info */
+    int use_checksum; /*Store a CRC32C of the secret data after the file size*/
+    uint checksum; /*Store the running CRC32C of the encoded secret data*/
+    long checksum_offset; /*Store the stego image offset of the checksum field*/
+    char checksum_image_data[MAX_IMAGE_BUF_SIZE * sizeof(int)]; /*Store the image bytes which carry the checksum*/
+
+    /* Key Info */
+    char *key; /*Store the passphrase which scatters the data blocks, NULL for sequential data*/
+    ScatterKey scatter; /*Store the block permutation derived from the key*/
+    int use_encryption; /*Encrypt the secret data with a stream derived from the key*/
+    CipherStream cipher; /*Store the keystream state*/
 
     /* Stego Image Info */
-    char *stego_image_fname; /*Store the output bmp file name*/
-    FILE *fptr_stego_image; /*Store the output bmp file address*/
+    char *stego_image_fname; /*Store the output image file name*/
+    FILE *fptr_stego_image; /*Store the output image file address*/
+    int update_in_place; /*Re-embed into an existing stego image, writing back only the changed bytes*/
+    long bytes_updated; /*Store the number of image bytes changed by an in place update*/
+    OutputPolicy *output_policy; /*Store how the stego image is written and synced, NULL for the defaults*/
+    OutputFile *output; /*Store the temporary file behind fptr_stego_image until it is committed*/
+    Journal journal; /*Store the checkpoints of a resumable encoding*/
+
+    /* Data Stage Info */
+    long data_offset; /*Store the source image offset of the secret data*/
+    int data_chunk_size; /*Store the secret file bytes encoded per step*/
+    long data_remaining; /*Store the secret file bytes left to encode*/
+    long data_resume_offset; /*Store the payload bytes a resumed run only checks*/
+
+    /* Verify Info */
+    int verify; /*Check the stego image against the payload and the cover while encoding*/
+    VerifyTrack verify_cover; /*Store the running hash of the cover*/
+    VerifyTrack verify_stego; /*Store the running hash of the stego image*/
+
+    /* Progress Info */
+    Progress progress; /*Store the payload bytes encoded and the cancel flag*/
+
+    /* Stats Info */
+    PerfStats stats; /*Store the time and performance counters of every encoding stage*/
 
 } EncodeInfo;
 
@@ -45,6 +90,9 @@ OperationType check_operation_type(char *argv[]);
 /* Read and validate Encode args from argv */
 Status read_and_validate_encode_args(char *argv[], EncodeInfo *encInfo);
 
+/* Read and validate encode options (--checksum, --encrypt, --key KEY, --update, --verify, --stats, --direct, --durability MODE, --resume, --checkpoint MB, --progress) */
+Status read_and_validate_encode_options(char *options[], EncodeInfo *encInfo);
+
 /* Perform the encoding */
 Status do_encoding(EncodeInfo *encInfo);
 
@@ -55,13 +103,13 @@ Status open_files(EncodeInfo *encInfo);
 Status check_capacity(EncodeInfo *encInfo);
 
 /* Get image size */
-uint get_image_size_for_bmp(FILE *fptr_image, EncodeInfo *encInfo);
+long get_image_size(FILE *fptr_image, EncodeInfo *encInfo);
 
 /* Get file size */
 uint get_file_size(FILE *fptr);
 
-/* Copy bmp image header */
-Status copy_bmp_header(FILE *fptr_src_image, FILE *fptr_dest_image);
+/* Copy image header */
+Status copy_image_header(EncodeInfo *encInfo);
 
 /* Store Magic String */
 Status encode_magic_string(const char *magic_string, EncodeInfo *encInfo);
@@ -78,16 +126,55 @@ Status encode_secret_file_size(long file_size, EncodeInfo *encInfo);
 /* Encode secret file data*/
 Status encode_secret_file_data(EncodeInfo *encInfo);
 
-/* Encode function, which does the real encoding */
-Status encode_data_to_image(char *data, int size, FILE *fptr_src_image, FILE *fptr_stego_image);
+/* Set up the data stage: scatter blocks, journal offset, progress */
+Status encode_secret_data_start(EncodeInfo *encInfo);
+
+/* Encode the next chunk of secret file data */
+Status encode_secret_data_step(EncodeInfo *encInfo);
+
+/* Store the checksum once every chunk is encoded */
+Status encode_secret_data_finish(EncodeInfo *encInfo);
+
+/* Encode function, which does the real encoding (verify checks the encoded bytes decode back) */
+Status encode_data_to_image(char *data, int size, FILE *fptr_src_image, FILE *fptr_stego_image, int verify);
+
+/* Encode function for secret data, updating a running CRC32C and encrypting (crc and cipher may be NULL) */
+Status encode_payload_to_image(char *data, int size, FILE *fptr_src_image, FILE *fptr_stego_image, uint *crc, CipherStream *cipher, int verify);
 
 /* Encode a byte into LSB of image data array */
 Status encode_byte_to_lsb(char data, char *image_buffer);
 
+/* Encode size bytes into LSB of size * 8 image bytes, checksumming and encrypting them in the same pass */
+void encode_chunk_to_lsb(const char *data, int size, char *image_buffer, uint *crc, CipherStream *cipher);
+
+/* Derive the block permutation and copy the image bytes around the scattered blocks */
+Status prepare_scattered_data(EncodeInfo *encInfo);
+
+/* Store the checksum in the field reserved after the file size */
+Status encode_secret_file_checksum(EncodeInfo *encInfo);
+
 /* Encode a size into LSB of image data array */
 Status encode_size_to_lsb(uint size, char *buffer);
 
-/* Copy remaining image bytes from src to stego image after encoding */
-Status copy_remaining_img_data(FILE *fptr_src, FILE *fptr_dest);
+/* Encode a size field, checking it decodes back with --verify */
+Status encode_size_field(uint size, char *buffer, EncodeInfo *encInfo);
+
+/* Copy remaining image bytes from src to stego image after encoding, stopping when progress is cancelled (progress may be NULL) */
+Status copy_remaining_img_data(FILE *fptr_src, FILE *fptr_dest, Progress *progress);
+
+/* Copy one buffer of remaining image bytes, returning the bytes copied, 0 at the end and -1 on failure */
+long copy_remaining_img_block(FILE *fptr_src, FILE *fptr_dest, char *buffer, size_t size, Progress *progress);
+
+/* Close the stego image, which finishes compressed formats, and commit it under its name */
+Status close_stego_image(EncodeInfo *encInfo);
+
+/* Close and remove the stego image of a failed encoding */
+void abort_stego_image(EncodeInfo *encInfo);
+
+/* Check a chunk of the part file left by an earlier run instead of encoding it again */
+Status check_resumed_chunk(char *data, int size, EncodeInfo *encInfo);
+
+/* Copy the rest of the image with checkpoints, skipping what an earlier run copied */
+Status copy_remaining_resumable(EncodeInfo *encInfo);
 
 #endif
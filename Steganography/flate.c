@@ -0,0 +1,871 @@
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "flate.h"
+#include "bufpool.h"
+
+#define FLATE_MAX_BITS 15
+#define FLATE_LITERALS 286
+#define FLATE_DISTANCES 30
+#define FLATE_CODE_LENGTHS 19
+#define FLATE_MIN_MATCH 3
+#define FLATE_MAX_MATCH 258
+#define FLATE_HASH_BITS 15
+#define FLATE_MAX_CHAIN 8 /* Fast level: few candidates per position, greedy matching */
+#define FLATE_BLOCK_SYMBOLS 16384 /* Symbols per dynamic Huffman block */
+
+static const short length_base[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                       35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const short length_extra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                        3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const short distance_base[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385,
+                                         513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const short distance_extra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7,
+                                          8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+static const unsigned char code_length_order[FLATE_CODE_LENGTHS] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+/* Function Definitions */
+
+/* Update Adler-32
+ * Input: Running checksum (1 for a new stream), data and its size
+ * Return Values : Updated checksum
+ */
+uint adler32_update(uint adler, const unsigned char *data, long size)
+{
+    unsigned long a = adler & 0xFFFF, b = adler >> 16;
+    while(size > 0)
+    {
+        long count = size < 5552 ? size : 5552; // Largest run without overflowing before the modulo
+        size -= count;
+        while(count-- > 0)
+        {
+            a += *data++;
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+    return (b << 16) | a;
+}
+/* Function Definitions */
+
+/* Reverse the low length bits of code, deflate sends Huffman codes MSB first inside an LSB first stream */
+static uint reverse_bits(uint code, int length)
+{
+    uint reversed = 0;
+    for(int i = 0; i < length; i++)
+    {
+        reversed = (reversed << 1) | ((code >> i) & 1);
+    }
+    return reversed;
+}
+/* Function Definitions */
+
+/* Inflate input helpers; running out of input sets the error flag and yields zero bits */
+static int need_bits(Inflater *inflater, int count)
+{
+    while(inflater->bit_count < count)
+    {
+        int byte = inflater->read_byte(inflater->source);
+        if(byte < 0)
+        {
+            return 0;
+        }
+        inflater->bit_buffer |= (unsigned long) byte << inflater->bit_count;
+        inflater->bit_count += 8;
+    }
+    return 1;
+}
+
+static uint get_bits(Inflater *inflater, int count)
+{
+    if(!need_bits(inflater, count))
+    {
+        inflater->error = 1;
+        return 0;
+    }
+    uint value = inflater->bit_buffer & ((1UL << count) - 1);
+    inflater->bit_buffer >>= count;
+    inflater->bit_count -= count;
+    return value;
+}
+/* Function Definitions */
+
+/* Build Huffman Decoding Table
+ * Input: Code length of every symbol
+ * Output: Canonical code counts, symbols in code order and the fast lookup table
+ * Return Values : e_success, e_failure for over subscribed codes
+ */
+static Status build_huffman(FlateHuffman *huffman, const unsigned char *lengths, int count)
+{
+    short offsets[FLATE_MAX_BITS + 1];
+    memset(huffman->count, 0, sizeof(huffman->count));
+    memset(huffman->fast, 0, sizeof(huffman->fast));
+    for(int i = 0; i < count; i++)
+    {
+        huffman->count[lengths[i]]++;
+    }
+    huffman->count[0] = 0;
+    int left = 1;
+    for(int length = 1; length <= FLATE_MAX_BITS; length++)
+    {
+        left = (left << 1) - huffman->count[length];
+        if(left < 0)
+        {
+            return e_failure;
+        }
+    }
+    offsets[1] = 0;
+    for(int length = 1; length < FLATE_MAX_BITS; length++)
+    {
+        offsets[length + 1] = offsets[length] + huffman->count[length];
+    }
+    for(int i = 0; i < count; i++)
+    {
+        if(lengths[i] != 0)
+        {
+            huffman->symbol[offsets[lengths[i]]++] = i;
+        }
+    }
+    /* Fill the fast table with every code short enough, padded with all possible following bits */
+    uint code = 0;
+    int index = 0;
+    for(int length = 1; length <= FLATE_FAST_BITS; length++)
+    {
+        for(int i = 0; i < huffman->count[length]; i++, index++, code++)
+        {
+            uint reversed = reverse_bits(code, length);
+            for(uint fill = reversed; fill < (1U << FLATE_FAST_BITS); fill += 1U << length)
+            {
+                huffman->fast[fill] = (huffman->symbol[index] << 4) | length;
+            }
+        }
+        code <<= 1;
+    }
+    return e_success;
+}
+/* Function Definitions */
+
+/* Decode one symbol, -1 when no code matches */
+static int decode_symbol(Inflater *inflater, const FlateHuffman *huffman)
+{
+    need_bits(inflater, FLATE_FAST_BITS); // May come up short at the end of the input, the fast entry says how much it needs
+    int entry = huffman->fast[inflater->bit_buffer & ((1 << FLATE_FAST_BITS) - 1)];
+    if(entry != 0 && (entry & 15) <= inflater->bit_count)
+    {
+        inflater->bit_buffer >>= entry & 15;
+        inflater->bit_count -= entry & 15;
+        return entry >> 4;
+    }
+    int code = 0, first = 0, index = 0;
+    for(int length = 1; length <= FLATE_MAX_BITS; length++)
+    {
+        code |= get_bits(inflater, 1);
+        int count = huffman->count[length];
+        if(code - count < first)
+        {
+            return huffman->symbol[index + (code - first)];
+        }
+        index += count;
+        first = (first + count) << 1;
+        code <<= 1;
+    }
+    return -1;
+}
+/* Function Definitions */
+
+/* Read Block Header
+ * Description: Set up a stored block or the Huffman codes of a fixed or dynamic block
+ * Return Values : e_success and e_failure
+ */
+static Status read_block_header(Inflater *inflater)
+{
+    unsigned char lengths[FLATE_LITERALS + FLATE_DISTANCES + 2];
+    inflater->last_block = get_bits(inflater, 1);
+    inflater->block_type = get_bits(inflater, 2);
+    if(inflater->block_type == 0) // Stored: byte aligned LEN and NLEN
+    {
+        inflater->bit_buffer >>= inflater->bit_count % 8;
+        inflater->bit_count -= inflater->bit_count % 8;
+        uint length = get_bits(inflater, 16);
+        uint complement = get_bits(inflater, 16);
+        if(length != (~complement & 0xFFFF))
+        {
+            return e_failure;
+        }
+        inflater->stored_remaining = length;
+        return e_success;
+    }
+    if(inflater->block_type == 1) // Fixed codes
+    {
+        for(int i = 0; i < 288; i++)
+        {
+            lengths[i] = i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8;
+        }
+        build_huffman(&inflater->literal, lengths, 288);
+        memset(lengths, 5, FLATE_DISTANCES);
+        build_huffman(&inflater->distance, lengths, FLATE_DISTANCES);
+        return e_success;
+    }
+    if(inflater->block_type != 2)
+    {
+        return e_failure;
+    }
+    int literal_count = get_bits(inflater, 5) + 257;
+    int distance_count = get_bits(inflater, 5) + 1;
+    int code_length_count = get_bits(inflater, 4) + 4;
+    if(literal_count > FLATE_LITERALS || distance_count > FLATE_DISTANCES)
+    {
+        return e_failure;
+    }
+    memset(lengths, 0, FLATE_CODE_LENGTHS);
+    for(int i = 0; i < code_length_count; i++)
+    {
+        lengths[code_length_order[i]] = get_bits(inflater, 3);
+    }
+    FlateHuffman code_lengths;
+    if(build_huffman(&code_lengths, lengths, FLATE_CODE_LENGTHS) == e_failure)
+    {
+        return e_failure;
+    }
+    int index = 0;
+    while(index < literal_count + distance_count && !inflater->error)
+    {
+        int symbol = decode_symbol(inflater, &code_lengths);
+        int repeat, value = 0;
+        if(symbol < 0)
+        {
+            return e_failure;
+        }
+        if(symbol < 16)
+        {
+            lengths[index++] = symbol;
+            continue;
+        }
+        if(symbol == 16)
+        {
+            if(index == 0)
+            {
+                return e_failure;
+            }
+            value = lengths[index - 1];
+            repeat = 3 + get_bits(inflater, 2);
+        }
+        else if(symbol == 17)
+        {
+            repeat = 3 + get_bits(inflater, 3);
+        }
+        else
+        {
+            repeat = 11 + get_bits(inflater, 7);
+        }
+        if(index + repeat > literal_count + distance_count)
+        {
+            return e_failure;
+        }
+        while(repeat-- > 0)
+        {
+            lengths[index++] = value;
+        }
+    }
+    if(inflater->error || lengths[256] == 0 ||
+       build_huffman(&inflater->literal, lengths, literal_count) == e_failure ||
+       build_huffman(&inflater->distance, lengths + literal_count, distance_count) == e_failure)
+    {
+        return e_failure;
+    }
+    return e_success;
+}
+/* Function Definitions */
+
+/* Initialize Inflater
+ * Input: Compressed input callback positioned at the zlib header
+ * Output: Inflater ready to produce output
+ * Return Values : e_success, e_failure for a header which is not deflate without dictionary
+ */
+Status inflater_init(Inflater *inflater, FlateReadByte read_byte, void *source)
+{
+    memset(inflater, 0, offsetof(Inflater, literal)); // The tables and window need no clearing
+    inflater->read_byte = read_byte;
+    inflater->source = source;
+    inflater->block_type = -1;
+    inflater->adler = 1;
+    uint header = get_bits(inflater, 8) << 8;
+    header |= get_bits(inflater, 8);
+    if(inflater->error || (header >> 8 & 0x0F) != 8 || header % 31 != 0 || (header & 0x20))
+    {
+        return e_failure;
+    }
+    inflater->bit_buffer = 0; // Bits were read LSB first, the header is byte aligned anyway
+    inflater->bit_count = 0;
+    return e_success;
+}
+/* Function Definitions */
+
+/* Store an output byte in the caller's buffer and the window */
+#define INFLATE_PUT(byte) do { unsigned char value = (byte); output[produced++] = value; \
+    inflater->window[inflater->window_pos] = value; \
+    inflater->window_pos = (inflater->window_pos + 1) & (FLATE_WINDOW_SIZE - 1); } while(0)
+
+/* Inflate
+ * Input: Output buffer of size bytes
+ * Output: Up to size bytes of decompressed data
+ * Description: Decode symbol by symbol until the buffer is full; a match which
+ * doesn't fit is finished on the next call. The Adler-32 trailer is checked
+ * at the end of the stream
+ * Return Values : Bytes produced, 0 at the end of the stream, -1 on corrupted input
+ */
+long inflater_read(Inflater *inflater, unsigned char *output, long size)
+{
+    long produced = 0, checked = 0;
+    while(produced < size && !inflater->done && !inflater->error)
+    {
+        if(inflater->copy_length > 0)
+        {
+            INFLATE_PUT(inflater->window[(inflater->window_pos - inflater->copy_distance) & (FLATE_WINDOW_SIZE - 1)]);
+            inflater->copy_length--;
+            continue;
+        }
+        if(inflater->block_type < 0)
+        {
+            if(inflater->last_block) // Byte aligned Adler-32 of the uncompressed data
+            {
+                inflater->bit_buffer >>= inflater->bit_count % 8;
+                inflater->bit_count -= inflater->bit_count % 8;
+                uint adler = 0;
+                for(int i = 0; i < 4; i++)
+                {
+                    adler = (adler << 8) | get_bits(inflater, 8);
+                }
+                inflater->adler = adler32_update(inflater->adler, output + checked, produced - checked);
+                checked = produced;
+                if(adler != inflater->adler)
+                {
+                    inflater->error = 1;
+                }
+                inflater->done = 1;
+                break;
+            }
+            if(read_block_header(inflater) == e_failure)
+            {
+                inflater->error = 1;
+            }
+            continue;
+        }
+        if(inflater->block_type == 0)
+        {
+            if(inflater->stored_remaining == 0)
+            {
+                inflater->block_type = -1;
+                continue;
+            }
+            INFLATE_PUT(get_bits(inflater, 8));
+            inflater->stored_remaining--;
+            continue;
+        }
+        int symbol = decode_symbol(inflater, &inflater->literal);
+        if(symbol < 256)
+        {
+            if(symbol < 0)
+            {
+                inflater->error = 1;
+                break;
+            }
+            INFLATE_PUT(symbol);
+        }
+        else if(symbol == 256)
+        {
+            inflater->block_type = -1;
+        }
+        else
+        {
+            symbol -= 257;
+            if(symbol >= 29)
+            {
+                inflater->error = 1;
+                break;
+            }
+            inflater->copy_length = length_base[symbol] + get_bits(inflater, length_extra[symbol]);
+            int distance = decode_symbol(inflater, &inflater->distance);
+            if(distance < 0 || distance >= 30)
+            {
+                inflater->error = 1;
+                break;
+            }
+            inflater->copy_distance = distance_base[distance] + get_bits(inflater, distance_extra[distance]);
+        }
+    }
+    if(inflater->error)
+    {
+        return -1;
+    }
+    inflater->adler = adler32_update(inflater->adler, output + checked, produced - checked);
+    return produced;
+}
+/* Function Definitions */
+
+/* Deflate output: bits are packed LSB first into a growing buffer */
+typedef struct _BitWriter
+{
+    unsigned char *data;
+    long size;
+    long capacity;
+    unsigned long bits;
+    int count;
+    int failed;
+} BitWriter;
+
+static void put_bits(BitWriter *writer, uint value, int count)
+{
+    writer->bits |= (unsigned long) value << writer->count;
+    writer->count += count;
+    while(writer->count >= 8 && !writer->failed)
+    {
+        if(writer->size == writer->capacity)
+        {
+            unsigned char *data = buf_alloc(writer->capacity * 2);
+            if(data == NULL)
+            {
+                writer->failed = 1; // deflate_chunk checks it once the chunk is done
+                return;
+            }
+            memcpy(data, writer->data, writer->size);
+            buf_free(writer->data, writer->capacity);
+            writer->data = data;
+            writer->capacity *= 2;
+        }
+        writer->data[writer->size++] = writer->bits & 0xFF;
+        writer->bits >>= 8;
+        writer->count -= 8;
+    }
+}
+/* Function Definitions */
+
+/* Build Length Limited Huffman Code
+ * Input: Frequency of every symbol, length limit
+ * Output: Code length of every symbol, 0 for unused symbols
+ * Description: Build a Huffman tree with the two queue method over the sorted
+ * leaves; when it is deeper than the limit, flatten the frequencies and retry
+ */
+typedef struct _HuffmanLeaf
+{
+    uint weight;
+    int symbol;
+} HuffmanLeaf;
+
+static int compare_leaves(const void *a, const void *b)
+{
+    const HuffmanLeaf *left = a, *right = b;
+    if(left->weight != right->weight)
+    {
+        return left->weight < right->weight ? -1 : 1;
+    }
+    return left->symbol - right->symbol;
+}
+
+static void build_lengths(const uint *frequency, int count, int limit, unsigned char *lengths)
+{
+    HuffmanLeaf leaves[FLATE_LITERALS];
+    uint weight[2 * FLATE_LITERALS];
+    int parent[2 * FLATE_LITERALS], depth[2 * FLATE_LITERALS];
+    uint scale = 0;
+    memset(lengths, 0, count);
+    while(1)
+    {
+        int used = 0;
+        for(int i = 0; i < count; i++)
+        {
+            if(frequency[i] != 0)
+            {
+                leaves[used].weight = ((frequency[i] - 1) >> scale) + 1;
+                leaves[used++].symbol = i;
+            }
+        }
+        if(used == 0)
+        {
+            return;
+        }
+        if(used == 1)
+        {
+            lengths[leaves[0].symbol] = 1;
+            return;
+        }
+        qsort(leaves, used, sizeof(HuffmanLeaf), compare_leaves);
+        for(int i = 0; i < used; i++)
+        {
+            weight[i] = leaves[i].weight;
+        }
+        /* Leaves are 0..used-1, internal nodes used..2*used-2 in the order they are made */
+        int next_leaf = 0, next_node = used, nodes = used;
+        while(nodes < 2 * used - 1)
+        {
+            int pick[2];
+            for(int j = 0; j < 2; j++)
+            {
+                if(next_leaf < used && (next_node == nodes || weight[next_leaf] <= weight[next_node]))
+                {
+                    pick[j] = next_leaf++;
+                }
+                else
+                {
+                    pick[j] = next_node++;
+                }
+            }
+            weight[nodes] = weight[pick[0]] + weight[pick[1]];
+            parent[pick[0]] = parent[pick[1]] = nodes;
+            nodes++;
+        }
+        int max_depth = 0;
+        depth[nodes - 1] = 0;
+        for(int i = nodes - 2; i >= 0; i--)
+        {
+            depth[i] = depth[parent[i]] + 1;
+        }
+        for(int i = 0; i < used; i++)
+        {
+            max_depth = depth[i] > max_depth ? depth[i] : max_depth;
+        }
+        if(max_depth <= limit)
+        {
+            for(int i = 0; i < used; i++)
+            {
+                lengths[leaves[i].symbol] = depth[i];
+            }
+            return;
+        }
+        scale++;
+    }
+}
+/* Function Definitions */
+
+/* Canonical codes for the lengths, bit reversed ready for put_bits */
+static void build_codes(const unsigned char *lengths, int count, uint *codes)
+{
+    uint length_count[FLATE_MAX_BITS + 1] = {0}, next_code[FLATE_MAX_BITS + 1];
+    for(int i = 0; i < count; i++)
+    {
+        length_count[lengths[i]]++;
+    }
+    length_count[0] = 0;
+    uint code = 0;
+    for(int length = 1; length <= FLATE_MAX_BITS; length++)
+    {
+        code = (code + length_count[length - 1]) << 1;
+        next_code[length] = code;
+    }
+    for(int i = 0; i < count; i++)
+    {
+        if(lengths[i] != 0)
+        {
+            codes[i] = reverse_bits(next_code[lengths[i]]++, lengths[i]);
+        }
+    }
+}
+/* Function Definitions */
+
+static int length_code(int length)
+{
+    int code = 28;
+    while(length_base[code] > length)
+    {
+        code--;
+    }
+    return code;
+}
+
+static int distance_code(int distance)
+{
+    int code = 29;
+    while(distance_base[code] > distance)
+    {
+        code--;
+    }
+    return code;
+}
+/* Function Definitions */
+
+/* A literal (distance 0) or a match */
+typedef struct _DeflateSymbol
+{
+    unsigned short length;
+    unsigned short distance;
+} DeflateSymbol;
+
+/* Write Dynamic Huffman Block
+ * Input: Symbols of the block
+ * Output: Non final block with codes built from the symbol frequencies
+ */
+static void write_dynamic_block(BitWriter *writer, const DeflateSymbol *symbols, int count)
+{
+    uint literal_freq[FLATE_LITERALS] = {0}, distance_freq[FLATE_DISTANCES] = {0}, length_freq[FLATE_CODE_LENGTHS] = {0};
+    unsigned char lengths[FLATE_LITERALS + FLATE_DISTANCES], code_lengths[FLATE_CODE_LENGTHS];
+    uint literal_codes[FLATE_LITERALS], distance_codes[FLATE_DISTANCES], length_codes[FLATE_CODE_LENGTHS];
+    for(int i = 0; i < count; i++)
+    {
+        if(symbols[i].distance == 0)
+        {
+            literal_freq[symbols[i].length]++;
+        }
+        else
+        {
+            literal_freq[257 + length_code(symbols[i].length)]++;
+            distance_freq[distance_code(symbols[i].distance)]++;
+        }
+    }
+    literal_freq[256] = 1;
+    int has_distance = 0;
+    for(int i = 0; i < FLATE_DISTANCES; i++)
+    {
+        has_distance |= distance_freq[i] != 0;
+    }
+    if(!has_distance)
+    {
+        distance_freq[0] = 1; // At least one distance code is sent
+    }
+    build_lengths(literal_freq, FLATE_LITERALS, FLATE_MAX_BITS, lengths);
+    build_lengths(distance_freq, FLATE_DISTANCES, FLATE_MAX_BITS, lengths + FLATE_LITERALS);
+    build_codes(lengths, FLATE_LITERALS, literal_codes);
+    build_codes(lengths + FLATE_LITERALS, FLATE_DISTANCES, distance_codes);
+    int literal_count = FLATE_LITERALS, distance_count = FLATE_DISTANCES;
+    while(literal_count > 257 && lengths[literal_count - 1] == 0)
+    {
+        literal_count--;
+    }
+    while(distance_count > 1 && lengths[FLATE_LITERALS + distance_count - 1] == 0)
+    {
+        distance_count--;
+    }
+    /* Run length encode both length tables back to back */
+    unsigned char all[FLATE_LITERALS + FLATE_DISTANCES];
+    unsigned char runs[FLATE_LITERALS + FLATE_DISTANCES][2];
+    int total = literal_count + distance_count, run_count = 0;
+    memcpy(all, lengths, literal_count);
+    memcpy(all + literal_count, lengths + FLATE_LITERALS, distance_count);
+    for(int i = 0; i < total;)
+    {
+        int run = 1;
+        while(i + run < total && all[i + run] == all[i])
+        {
+            run++;
+        }
+        if(all[i] == 0 && run >= 11)
+        {
+            run = run > 138 ? 138 : run;
+            runs[run_count][0] = 18;
+            runs[run_count++][1] = run - 11;
+        }
+        else if(all[i] == 0 && run >= 3)
+        {
+            runs[run_count][0] = 17;
+            runs[run_count++][1] = run - 3;
+        }
+        else if(i > 0 && all[i] == all[i - 1] && run >= 3)
+        {
+            run = run > 6 ? 6 : run;
+            runs[run_count][0] = 16;
+            runs[run_count++][1] = run - 3;
+        }
+        else
+        {
+            run = 1;
+            runs[run_count][0] = all[i];
+            runs[run_count++][1] = 0;
+        }
+        length_freq[runs[run_count - 1][0]]++;
+        i += run;
+    }
+    build_lengths(length_freq, FLATE_CODE_LENGTHS, 7, code_lengths);
+    build_codes(code_lengths, FLATE_CODE_LENGTHS, length_codes);
+    int code_length_count = FLATE_CODE_LENGTHS;
+    while(code_length_count > 4 && code_lengths[code_length_order[code_length_count - 1]] == 0)
+    {
+        code_length_count--;
+    }
+
+    put_bits(writer, 0, 1); // Not final, the stream is closed by deflate_zlib_trailer
+    put_bits(writer, 2, 2);
+    put_bits(writer, literal_count - 257, 5);
+    put_bits(writer, distance_count - 1, 5);
+    put_bits(writer, code_length_count - 4, 4);
+    for(int i = 0; i < code_length_count; i++)
+    {
+        put_bits(writer, code_lengths[code_length_order[i]], 3);
+    }
+    for(int i = 0; i < run_count; i++)
+    {
+        int symbol = runs[i][0];
+        put_bits(writer, length_codes[symbol], code_lengths[symbol]);
+        if(symbol >= 16)
+        {
+            put_bits(writer, runs[i][1], symbol == 16 ? 2 : symbol == 17 ? 3 : 7);
+        }
+    }
+    for(int i = 0; i < count; i++)
+    {
+        if(symbols[i].distance == 0)
+        {
+            put_bits(writer, literal_codes[symbols[i].length], lengths[symbols[i].length]);
+            continue;
+        }
+        int code = length_code(symbols[i].length);
+        put_bits(writer, literal_codes[257 + code], lengths[257 + code]);
+        put_bits(writer, symbols[i].length - length_base[code], length_extra[code]);
+        code = distance_code(symbols[i].distance);
+        put_bits(writer, distance_codes[code], lengths[FLATE_LITERALS + code]);
+        put_bits(writer, symbols[i].distance - distance_base[code], distance_extra[code]);
+    }
+    put_bits(writer, literal_codes[256], lengths[256]);
+}
+/* Function Definitions */
+
+static uint hash3(const unsigned char *data)
+{
+    return ((data[0] << 16 | data[1] << 8 | data[2]) * 2654435761U) >> (32 - FLATE_HASH_BITS);
+}
+
+long deflate_chunk_footprint(long dict_size, long size)
+{
+    long total = dict_size + size;
+    return (sizeof(int) << FLATE_HASH_BITS) + sizeof(int) * (total > 0 ? total : 1) +
+           sizeof(DeflateSymbol) * FLATE_BLOCK_SYMBOLS + size + size / 8 + 1024;
+}
+
+/* Deflate Chunk
+ * Input: dict_size bytes of history followed by size bytes to compress
+ * Output: Pool buffer with the compressed chunk, the caller gives it back with
+ * buf_free(output, capacity)
+ * Description: Greedy LZ77 over hash chains, matches may reach back into the
+ * history so chunks compressed independently lose little ratio. Symbols are
+ * sent in dynamic Huffman blocks and the chunk ends with an empty stored block,
+ * leaving the output byte aligned and the stream open for the next chunk.
+ * The hash chains and the output come from the buffer pool, so the jobs of one
+ * image reuse each other's pages
+ * Return Values : Compressed size, -1 when out of memory
+ */
+long deflate_chunk(const unsigned char *data, long dict_size, long size, unsigned char **output, long *capacity)
+{
+    long total = dict_size + size;
+    size_t head_size = sizeof(int) << FLATE_HASH_BITS, prev_size = sizeof(int) * (total > 0 ? total : 1);
+    size_t symbols_size = sizeof(DeflateSymbol) * FLATE_BLOCK_SYMBOLS;
+    int *head = buf_alloc(head_size);
+    int *prev = buf_alloc(prev_size);
+    DeflateSymbol *symbols = buf_alloc(symbols_size);
+    BitWriter writer = { buf_alloc(size + size / 8 + 1024), 0, size + size / 8 + 1024, 0, 0, 0 };
+    if(head == NULL || prev == NULL || symbols == NULL || writer.data == NULL)
+    {
+        buf_free(head, head_size);
+        buf_free(prev, prev_size);
+        buf_free(symbols, symbols_size);
+        buf_free(writer.data, writer.capacity);
+        return -1;
+    }
+    memset(head, -1, sizeof(int) << FLATE_HASH_BITS);
+    for(long i = 0; i + FLATE_MIN_MATCH <= dict_size; i++) // Prime the chains with the history
+    {
+        uint hash = hash3(data + i);
+        prev[i] = head[hash];
+        head[hash] = i;
+    }
+    int symbol_count = 0;
+    for(long i = dict_size; i < total;)
+    {
+        int best_length = 0, best_distance = 0;
+        if(i + FLATE_MIN_MATCH <= total)
+        {
+            uint hash = hash3(data + i);
+            int limit = total - i < FLATE_MAX_MATCH ? total - i : FLATE_MAX_MATCH;
+            int chain = FLATE_MAX_CHAIN;
+            for(long candidate = head[hash]; candidate >= 0 && i - candidate <= FLATE_WINDOW_SIZE && chain-- > 0; candidate = prev[candidate])
+            {
+                if(data[candidate + best_length] != data[i + best_length])
+                {
+                    continue;
+                }
+                int length = 0;
+                while(length < limit && data[candidate + length] == data[i + length])
+                {
+                    length++;
+                }
+                if(length > best_length)
+                {
+                    best_length = length;
+                    best_distance = i - candidate;
+                    if(length == limit)
+                    {
+                        break;
+                    }
+                }
+            }
+            prev[i] = head[hash];
+            head[hash] = i;
+        }
+        if(best_length >= FLATE_MIN_MATCH)
+        {
+            symbols[symbol_count].length = best_length;
+            symbols[symbol_count++].distance = best_distance;
+            for(long j = i + 1; j < i + best_length && j + FLATE_MIN_MATCH <= total; j++)
+            {
+                uint hash = hash3(data + j);
+                prev[j] = head[hash];
+                head[hash] = j;
+            }
+            i += best_length;
+        }
+        else
+        {
+            symbols[symbol_count].length = data[i];
+            symbols[symbol_count++].distance = 0;
+            i++;
+        }
+        if(symbol_count == FLATE_BLOCK_SYMBOLS)
+        {
+            write_dynamic_block(&writer, symbols, symbol_count);
+            symbol_count = 0;
+        }
+    }
+    if(symbol_count > 0)
+    {
+        write_dynamic_block(&writer, symbols, symbol_count);
+    }
+    /* Empty stored block: byte aligns the output without ending the stream */
+    put_bits(&writer, 0, 3);
+    if(writer.count > 0)
+    {
+        put_bits(&writer, 0, 8 - writer.count);
+    }
+    put_bits(&writer, 0x0000, 16);
+    put_bits(&writer, 0xFFFF, 16);
+    buf_free(head, head_size);
+    buf_free(prev, prev_size);
+    buf_free(symbols, symbols_size);
+    if(writer.failed)
+    {
+        buf_free(writer.data, writer.capacity);
+        return -1;
+    }
+    *output = writer.data;
+    *capacity = writer.capacity;
+    return writer.size;
+}
+/* Function Definitions */
+
+/* zlib Header and Trailer
+ * Description: CM 8 with a 32K window and the fastest level flag; the trailer is a
+ * final empty fixed block followed by the big endian Adler-32
+ */
+void deflate_zlib_header(unsigned char *header)
+{
+    header[0] = 0x78;
+    header[1] = 0x01;
+}
+
+int deflate_zlib_trailer(uint adler, unsigned char *trailer)
+{
+    trailer[0] = 0x03;
+    trailer[1] = 0x00;
+    for(int i = 0; i < 4; i++)
+    {
+        trailer[2 + i] = adler >> (24 - 8 * i);
+    }
+    return 6;
+}
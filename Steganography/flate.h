@@ -0,0 +1,70 @@
+#ifndef FLATE_H
+#define FLATE_H
+
+#include "types.h"
+
+/*
+ * In-tree zlib (RFC 1950) / deflate (RFC 1951) codec for compressed covers.
+ * The inflater pulls compressed bytes through a callback and produces output
+ * in pieces of any size, keeping only the 32K window in memory.
+ * The deflater compresses independent chunks with a fast greedy matcher and
+ * dynamic Huffman blocks; every chunk ends byte aligned, so chunks compressed
+ * on different threads can be concatenated into one stream
+ */
+
+#define FLATE_WINDOW_SIZE 32768
+#define FLATE_FAST_BITS 9 /* Codes up to this length are decoded with one table lookup */
+
+/* Next compressed byte, or -1 at the end of the input */
+typedef int (*FlateReadByte)(void *source);
+
+typedef struct _FlateHuffman
+{
+    short count[16]; /*Store the number of codes of every length*/
+    short symbol[288]; /*Store the symbols ordered by code*/
+    short fast[1 << FLATE_FAST_BITS]; /*Store symbol << 4 | length for the short codes*/
+} FlateHuffman;
+
+typedef struct _Inflater
+{
+    FlateReadByte read_byte; /*Store the compressed input callback*/
+    void *source; /*Store the callback argument*/
+    unsigned long bit_buffer; /*Store the input bits not consumed yet*/
+    int bit_count; /*Store the number of bits in bit_buffer*/
+    int last_block; /*Set once the final block header is read*/
+    int block_type; /*Store the current block type, -1 between blocks*/
+    long stored_remaining; /*Store the bytes left in a stored block*/
+    int copy_length; /*Store the bytes left of the match being copied*/
+    int copy_distance; /*Store the distance of the match being copied*/
+    int done; /*Set at the end of the stream*/
+    int error; /*Set when the stream is corrupted*/
+    uint adler; /*Store the running Adler-32 of the output*/
+    FlateHuffman literal; /*Store the literal/length code of the current block*/
+    FlateHuffman distance; /*Store the distance code of the current block*/
+    uint window_pos; /*Store the next window position*/
+    unsigned char window[FLATE_WINDOW_SIZE]; /*Store the last 32K of output*/
+} Inflater;
+
+/* Read the zlib header and get ready to produce output */
+Status inflater_init(Inflater *inflater, FlateReadByte read_byte, void *source);
+
+/* Produce up to size bytes, returns the count, 0 at the end of the stream, -1 on corrupted input */
+long inflater_read(Inflater *inflater, unsigned char *output, long size);
+
+/* Compress size bytes following dict_size bytes of history into non final blocks ending byte aligned,
+ * output is a pool buffer of capacity bytes */
+long deflate_chunk(const unsigned char *data, long dict_size, long size, unsigned char **output, long *capacity);
+
+/* Bytes of buffer pool memory deflate_chunk holds for a chunk, the output included */
+long deflate_chunk_footprint(long dict_size, long size);
+
+/* Two byte zlib header for fast compression */
+void deflate_zlib_header(unsigned char *header);
+
+/* Final empty block and Adler-32 closing a stream of chunks, returns its size (6) */
+int deflate_zlib_trailer(uint adler, unsigned char *trailer);
+
+/* Update a running Adler-32 (start with 1) */
+uint adler32_update(uint adler, const unsigned char *data, long size);
+
+#endif
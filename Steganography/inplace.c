@@ -0,0 +1,125 @@
+#define _GNU_SOURCE /* fopencookie */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "inplace.h"
+#include "types.h"
+#include "color.h"
+
+/* Existing image rewritten through a diff */
+typedef struct _InplaceStream
+{
+    int fd_image; /*Store the image opened read-write*/
+    long position; /*Store the stream position*/
+    long changed; /*Store the number of bytes written back*/
+    long *bytes_written; /*Store where to report changed on close*/
+} InplaceStream;
+
+/* Function Definitions */
+
+/* Write Changed Runs
+ * Input: Stream, new bytes for the file region at the stream position
+ * Output: Runs of bytes differing from the file written with pwrite
+ * Description: Bytes past the end of the file count as changed
+ * Return Values : e_success and e_failure
+ */
+static Status inplace_write_diff(InplaceStream *stream, const char *data, long size)
+{
+    char old[INPLACE_BUF_SIZE];
+    ssize_t count = pread(stream->fd_image, old, size, stream->position);
+    if(count < 0)
+    {
+        return e_failure;
+    }
+    memset(old + count, 0, size - count);
+    for(long i = 0; i < size;)
+    {
+        if(i < count && data[i] == old[i])
+        {
+            i++;
+            continue;
+        }
+        long start = i;
+        while(i < size && (i >= count || data[i] != old[i]))
+        {
+            i++;
+        }
+        if(pwrite(stream->fd_image, data + start, i - start, stream->position + start) < i - start)
+        {
+            return e_failure;
+        }
+        stream->changed += i - start;
+    }
+    stream->position += size;
+    return e_success;
+}
+/* Function Definitions */
+
+static ssize_t inplace_write(void *cookie, const char *buffer, size_t size)
+{
+    InplaceStream *stream = cookie;
+    for(size_t done = 0; done < size; done += INPLACE_BUF_SIZE)
+    {
+        long count = size - done < INPLACE_BUF_SIZE ? size - done : INPLACE_BUF_SIZE;
+        if(inplace_write_diff(stream, buffer + done, count) == e_failure)
+        {
+            return done > 0 ? (ssize_t) done : -1;
+        }
+    }
+    return size;
+}
+
+static int inplace_seek(void *cookie, off64_t *offset, int whence)
+{
+    InplaceStream *stream = cookie;
+    long base = whence == SEEK_SET ? 0 : stream->position;
+    if(whence == SEEK_END)
+    {
+        base = lseek(stream->fd_image, 0, SEEK_END);
+    }
+    if(base < 0 || base + *offset < 0)
+    {
+        return -1;
+    }
+    stream->position = base + *offset;
+    *offset = stream->position;
+    return 0;
+}
+
+static int inplace_close(void *cookie)
+{
+    InplaceStream *stream = cookie;
+    int result = close(stream->fd_image);
+    *stream->bytes_written = stream->changed;
+    free(stream);
+    return result;
+}
+
+/* Open In Place Stream
+ * Input: Existing image name, where to report the number of bytes changed
+ * Output: Write only FILE ptr starting at offset 0 of the image
+ * Return Values : FILE ptr, NULL on failure
+ */
+FILE *inplace_open(const char *fname, long *bytes_written)
+{
+    cookie_io_functions_t io = { NULL, inplace_write, inplace_seek, inplace_close };
+    InplaceStream *stream = calloc(1, sizeof(InplaceStream));
+    if(stream == NULL)
+    {
+        return NULL;
+    }
+    stream->bytes_written = bytes_written;
+    stream->fd_image = open(fname, O_RDWR);
+    FILE *fptr = stream->fd_image >= 0 ? fopencookie(stream, "w", io) : NULL;
+    if(fptr == NULL)
+    {
+        if(stream->fd_image >= 0)
+        {
+            close(stream->fd_image);
+        }
+        free(stream);
+    }
+    return fptr;
+}
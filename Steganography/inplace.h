@@ -0,0 +1,19 @@
+#ifndef INPLACE_H
+#define INPLACE_H
+
+#include <stdio.h>
+#include "types.h"
+
+/*
+ * In place image update (--update). The stream is written like a new stego
+ * image, but every write is compared with the bytes already in the file and
+ * only the differing runs are written back, so re-embedding a small payload
+ * costs a few KB of writes whatever the size of the cover
+ */
+
+#define INPLACE_BUF_SIZE 65536
+
+/* Write only stream over an existing image; *bytes_written gets the bytes actually changed on close */
+FILE *inplace_open(const char *fname, long *bytes_written);
+
+#endif
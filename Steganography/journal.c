@@ -0,0 +1,177 @@
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include "journal.h"
+#include "checksum.h"
+#include "trace.h"
+#include "types.h"
+#include "common.h"
+#include "color.h"
+
+volatile sig_atomic_t journal_stop;
+static struct sigaction journal_old_term, journal_old_int; /* Restored by journal_close */
+
+/* Function Definitions */
+
+static void journal_signal(int signal)
+{
+    (void) signal;
+    journal_stop = 1;
+}
+
+static unsigned long journal_mix(unsigned long hash, const void *data, long size)
+{
+    const unsigned char *bytes = data;
+    for(long i = 0; i < size; i++) // FNV-1a
+    {
+        hash = (hash ^ bytes[i]) * 0x100000001B3UL;
+    }
+    return hash;
+}
+
+static uint journal_record_crc(const JournalRecord *record)
+{
+    return crc32c_update(0, (const char *) record, offsetof(JournalRecord, record_crc));
+}
+
+/* Key Check
+ * Description: 32 bits of the key stretched through the cipher KDF, so the journal
+ * tells keys apart without holding anything cheaper to guess from than the image
+ */
+static uint journal_key_check(const char *key)
+{
+    static const char salt[CIPHER_SALT_SIZE] = "JRNLKEY";
+    CipherStream cipher;
+    cipher_init(&cipher, key, salt);
+    uint check = cipher.key[0];
+    memset(&cipher, 0, sizeof(cipher));
+    return check;
+}
+/* Function Definitions */
+
+/* Journal Identity
+ * Description: Size and modification time stand in for the file contents, so any
+ * change to the inputs between runs starts the job over. The key itself stays out
+ * of the journal, only its KDF check value is mixed in
+ */
+unsigned long journal_identity(const char *image_fname, const char *payload_fname, const char *key, uint flags)
+{
+    unsigned long hash = 0xCBF29CE484222325UL;
+    const char *fnames[2] = { image_fname, payload_fname };
+    for(int i = 0; i < 2; i++)
+    {
+        struct stat st;
+        if(fnames[i] != NULL && stat(fnames[i], &st) == 0)
+        {
+            hash = journal_mix(hash, &st.st_size, sizeof(st.st_size));
+            hash = journal_mix(hash, &st.st_mtim, sizeof(st.st_mtim));
+        }
+    }
+    if(key != NULL)
+    {
+        uint check = journal_key_check(key);
+        hash = journal_mix(hash, &check, sizeof(check));
+    }
+    return journal_mix(hash, &flags, sizeof(flags));
+}
+/* Function Definitions */
+
+/* Open Journal
+ * Input: Journal with enabled and interval set, output file name, identity of the inputs
+ * Output: Journal file open, resuming set with the record of a previous run
+ * Description: Records of other inputs, other versions or torn writes are ignored and
+ * overwritten by the first checkpoint
+ * Return Values : e_success and e_failure
+ */
+Status journal_open(Journal *journal, const char *output_fname, unsigned long identity)
+{
+    snprintf(journal->fname, sizeof(journal->fname), "%s%s", output_fname, JOURNAL_EXTN);
+    journal->fd = open(journal->fname, O_RDWR | O_CREAT, 0600);
+    if(journal->fd < 0)
+    {
+        printf(RED "Error: Unable to open %s\n" RESET, journal->fname);
+        return e_failure;
+    }
+    JournalRecord record;
+    journal->resuming = pread(journal->fd, &record, sizeof(record), 0) == sizeof(record) &&
+                        record.magic == JOURNAL_MAGIC && record.version == JOURNAL_VERSION &&
+                        record.identity == identity && record.record_crc == journal_record_crc(&record);
+    if(journal->resuming)
+    {
+        journal->record = record;
+        info_printf(YEL "INFO: Resuming from %s at %ld payload bytes\n" RESET, journal->fname, record.payload_offset);
+    }
+    else
+    {
+        memset(&journal->record, 0, offsetof(JournalRecord, salt)); // The salt may already be chosen
+        journal->record.magic = JOURNAL_MAGIC;
+        journal->record.version = JOURNAL_VERSION;
+        journal->record.identity = identity;
+    }
+    journal->next_checkpoint = journal->record.payload_offset + journal->interval;
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = journal_signal;
+    sigaction(SIGTERM, &action, &journal_old_term);
+    sigaction(SIGINT, &action, &journal_old_int);
+    return e_success;
+}
+
+int journal_due(const Journal *journal, long payload_offset)
+{
+    return journal->enabled && (payload_offset >= journal->next_checkpoint || journal_stop);
+}
+/* Function Definitions */
+
+/* Write Checkpoint
+ * Input: Journal, output fd with everything before the checkpoint written to it, progress
+ * Output: Output and record on disk, in that order, so a record never runs ahead of the data
+ * Return Values : e_success and e_failure
+ */
+Status journal_checkpoint(Journal *journal, int fd_output, JournalStage stage, long cover_offset, long payload_offset, uint checksum)
+{
+    if(!journal->enabled)
+    {
+        return e_success;
+    }
+    journal->record.stage = stage;
+    journal->record.cover_offset = cover_offset;
+    journal->record.payload_offset = payload_offset;
+    journal->record.checksum = checksum;
+    journal->record.record_crc = journal_record_crc(&journal->record);
+    TRACE_BEGIN("io", "checkpoint");
+    int failed = fdatasync(fd_output) != 0 ||
+                 pwrite(journal->fd, &journal->record, sizeof(journal->record), 0) != sizeof(journal->record) ||
+                 fdatasync(journal->fd) != 0;
+    TRACE_END();
+    if(failed)
+    {
+        printf(RED "Error: Unable to write checkpoint to %s\n" RESET, journal->fname);
+        return e_failure;
+    }
+    journal->next_checkpoint = payload_offset + journal->interval;
+    return e_success;
+}
+
+void journal_close(Journal *journal, int complete)
+{
+    if(!journal->enabled || journal->fd < 0)
+    {
+        return;
+    }
+    close(journal->fd);
+    journal->fd = -1;
+    sigaction(SIGTERM, &journal_old_term, NULL); // Back to whatever handled them before
+    sigaction(SIGINT, &journal_old_int, NULL);
+    if(complete)
+    {
+        unlink(journal->fname);
+    }
+    else if(journal_stop)
+    {
+        info_printf(YEL "INFO: Stopped, run again with --resume to continue from %s\n" RESET, journal->fname);
+    }
+}
@@ -0,0 +1,71 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <signal.h>
+#include "types.h"
+#include "cipher.h"
+
+/*
+ * Progress journal for resumable encoding and decoding (--resume).
+ * Every --checkpoint MB of payload the output is synced and a small record
+ * (stage, cover offset, payload offset, running CRC32C) is written next to
+ * it as <output>.journal. A later run with --resume and the same inputs
+ * picks the record up, checks the part already written against the inputs
+ * and carries on from there. The journal is private to the user (mode 0600). SIGTERM and SIGINT stop a journaled run at the
+ * next chunk with a final checkpoint
+ */
+
+#define JOURNAL_MAGIC 0x4C4E524A /* "JRNL" */
+#define JOURNAL_VERSION 1
+#define JOURNAL_EXTN ".journal"
+#define JOURNAL_DEFAULT_INTERVAL 64 /* MB of payload between checkpoints */
+
+typedef enum
+{
+    journal_data = 1, /*Payload data up to payload_offset is in place*/
+    journal_tail = 2 /*Payload and checksum are done, the file is complete up to cover_offset*/
+} JournalStage;
+
+typedef struct _JournalRecord
+{
+    uint magic; /*Store JOURNAL_MAGIC*/
+    uint version; /*Store JOURNAL_VERSION*/
+    unsigned long identity; /*Store the hash of the inputs and options the record belongs to*/
+    uint stage; /*Store the JournalStage reached*/
+    uint checksum; /*Store the running CRC32C of the payload up to payload_offset*/
+    long cover_offset; /*Store the output bytes complete in file order*/
+    long payload_offset; /*Store the payload bytes complete*/
+    char salt[CIPHER_SALT_SIZE]; /*Store the salt of encrypted payloads, reused on resume*/
+    uint record_crc; /*Store the CRC32C of the fields above, to reject torn records*/
+} JournalRecord;
+
+typedef struct _Journal
+{
+    int enabled; /*Set by --resume*/
+    long interval; /*Store the payload bytes between checkpoints*/
+    int fd; /*Store the journal file, -1 when closed*/
+    char fname[4096]; /*Store the journal file name*/
+    int resuming; /*Set when a matching record was found*/
+    JournalRecord record; /*Store the record resumed from, then the last checkpoint written*/
+    long next_checkpoint; /*Store the payload offset due for the next checkpoint*/
+} Journal;
+
+/* Set by SIGTERM and SIGINT while a journal is open */
+extern volatile sig_atomic_t journal_stop;
+
+/* Hash of the image and payload files (NULL or missing ones are skipped), a KDF check of the key and the format flags */
+unsigned long journal_identity(const char *image_fname, const char *payload_fname, const char *key, uint flags);
+
+/* Open <output>.journal, loading its record when it matches identity */
+Status journal_open(Journal *journal, const char *output_fname, unsigned long identity);
+
+/* Nonzero when payload_offset reached the next checkpoint or a stop was requested */
+int journal_due(const Journal *journal, long payload_offset);
+
+/* Sync fd_output, then write and sync the record */
+Status journal_checkpoint(Journal *journal, int fd_output, JournalStage stage, long cover_offset, long payload_offset, uint checksum);
+
+/* Close the journal, removing it once the output is complete */
+void journal_close(Journal *journal, int complete);
+
+#endif
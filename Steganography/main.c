@@ -8,8 +8,26 @@
 * •	The appliaction also provides a option to decrpt the output encoded image file
 * •	This is a command line application and all the options has to be passed as a command line argument
 * SAMPLE INPUT :
-* ./lsb_steg: Encoding: ./lsb_steg -e <.bmp_file> <.text_file> [output file (optional)]
-* ./lsb_steg: Decoding: ./lsb_steg -d <.bmp_file> [output file (optional)]
+* ./lsb_steg: Encoding: ./lsb_steg -e <.bmp_file> <.text_file> [output file (optional)] [--checksum (optional)] [--encrypt (optional, needs --key)] [--key KEY (optional)] [--verify (optional)] [--stats (optional)] [--direct (optional)] [--durability none|file|group:N (optional)] [--resume (optional)] [--checkpoint MB (optional)] [--progress (optional)]
+* ./lsb_steg: Update In Place: ./lsb_steg -e <stego .bmp_file> <.text_file> --update [encoding options]
+* ./lsb_steg: Decoding: ./lsb_steg -d <.bmp_file> [output file (optional)] [--range OFFSET:LEN (optional)] [--key KEY (optional)] [--stats (optional)] [--resume (optional)] [--checkpoint MB (optional)] [--progress (optional)]
+* ./lsb_steg: Archive: ./lsb_steg -a <.bmp_file> <output .bmp_file> <file> [file...] [--checksum (optional)] [--encrypt (optional, needs --key)] [--key KEY (optional)]
+* ./lsb_steg: List Archive: ./lsb_steg -l <.bmp_file> [--key KEY (optional)]
+* ./lsb_steg: Extract Archive Entry: ./lsb_steg -x <.bmp_file> <entry name> [output file (optional)] [--key KEY (optional)]
+* ./lsb_steg: Split: ./lsb_steg -s <secret file> <output prefix> <.bmp_file> [.bmp_file...] [--threads N (optional)] [--direct (optional)] [--durability none|file|group:N (optional)]
+* ./lsb_steg: Join: ./lsb_steg -j <output file> <.bmp_file> [.bmp_file...] [--threads N (optional)]
+* ./lsb_steg: Analyze: ./lsb_steg -A <.bmp_file> [.bmp_file...] [--threads N (optional)]
+* ./lsb_steg: Watch: ./lsb_steg -w <watch dir> <output dir> [--key KEY (optional)] [--threads N (optional)] [--queue N (optional)] [--debounce MS (optional)]
+* ./lsb_steg: Batch Extract: ./lsb_steg -T <archive .tar or -> [.bmp_file...] [--key KEY (optional)] [--threads N (optional)] [--direct (optional)] [--durability none|file|group:N (optional)]
+* (without images their names are read from stdin, one per line; with - the archive goes to stdout)
+* ./lsb_steg: Tune: ./lsb_steg --tune (calibrates this machine and saves the result for later runs)
+* Every operation also takes [--tune] [--chunk BYTES] [--kernel auto|generic|sse42] [--io buffered|direct] (optional) over the saved tuning
+* and [--trace FILE] (optional), writing the spans of every thread as Chrome trace JSON for Perfetto
+* Split, Join, Analyze, Watch and Batch Extract take [--memory SIZE[K|M|G]] (optional), starting images only while their
+* estimated memory fits the budget (default three quarters of the cgroup memory limit)
+* Every <.bmp_file> may also be a binary PPM/PGM (.ppm .pgm .pnm), PAM (.pam), uncompressed TGA (.tga),
+* 8 bit non interlaced PNG (.png) image or YUV4MPEG2 video (.y4m);
+* output images keep the format of their cover
 
 * SAMPLE OUTPUT (ENCODING):
 * ✓[INFO] You have selected encoding process
@@ -61,14 +79,79 @@
 #include <unistd.h>
 #include "encode.h"
 #include "decode.h"
+#include "archive.h"
+#include "shard.h"
+#include "analyze.h"
+#include "tune.h"
+#include "watch.h"
+#include "batch.h"
+#include "trace.h"
+#include "pool.h"
 #include "types.h"
 #include "color.h"
 
+/* Options which take the next command line argument as their value */
+static const char *value_options[] = { "--range", "--threads", "--key", "--durability", "--checkpoint", "--chunk", "--kernel", "--io", "--queue", "--debounce", "--trace", "--memory", NULL };
+
+/* Separate Options From Positional Arguments
+ * Input: Command line arguments
+ * Output: Options ("--name [value]") moved into options, argv compacted to positional arguments
+ * Return Values : Number of positional arguments left in argv
+ */
+int split_options(int argc, char *argv[], char *options[])
+{
+    int positional = 0, count = 0;
+    for(int i = 0; i < argc; i++)
+    {
+        if(strncmp(argv[i], "--", 2) == 0)
+        {
+            options[count++] = argv[i];
+            for(int j = 0; value_options[j] != NULL; j++)
+            {
+                if(strcmp(argv[i], value_options[j]) == 0 && i + 1 < argc)
+                {
+                    options[count++] = argv[++i]; // Option value
+                    break;
+                }
+            }
+        }
+        else
+        {
+            argv[positional++] = argv[i];
+        }
+    }
+    options[count] = NULL;
+    argv[positional] = NULL;
+    return positional;
+}
+
 int main(int argc, char *argv[])
 {
-    EncodeInfo encInfo;
-    DecodeInfo decInfo;
-    uint img_size;
+    EncodeInfo encInfo = {0};
+    DecodeInfo decInfo = {0};
+    OutputPolicy output_policy;
+    output_policy_init(&output_policy);
+    encInfo.output_policy = &output_policy;
+    char *options[argc + 1];
+    argc = split_options(argc, argv, options);
+    int tuned;
+    if(tune_apply_options(options, &tuned) == e_failure) /* Cached tuning, --tune and its overrides */
+    {
+        return e_failure;
+    }
+    output_policy.direct = tune_config.direct;
+    if(trace_apply_options(options) == e_failure) /* --trace FILE */
+    {
+        return e_failure;
+    }
+    if(pool_apply_options(options) == e_failure) /* --memory SIZE */
+    {
+        return e_failure;
+    }
+    if(tuned && argc < 3) /* --tune on its own */
+    {
+        return e_success;
+    }
     /* Validate Number of Command Line Arguments Passed */
     if(argc >= 3) 
     {
@@ -79,17 +162,21 @@ int main(int argc, char *argv[])
             printf(BRED"[INFO] You have selected encoding process\n"RESET);
             if(argc > 3 && argc <= 5) /* Number of Command Line Arguments Required For Encoding Operation*/
             {
-                if( read_and_validate_encode_args(argv, &encInfo) == e_success) /* Call the read and validate function to validate
+                if( read_and_validate_encode_options(options, &encInfo) == e_success && /* Options first, --update changes the output */
+                    read_and_validate_encode_args(argv, &encInfo) == e_success) /* Call the read and validate function to validate
                 Command Line Arguments Passed, If the Function return e_success then perform encoding operation*/
                 {
-                    if( do_encoding(&encInfo) == e_success) 
+                    progress_catch_signals(&encInfo.progress); /* Ctrl-C cancels, removing the partial output */
+                    if( do_encoding(&encInfo) == e_success && output_policy_finish(&output_policy) == e_success) 
                     {
                         sleep(1);
                         printf(BGREEN"[INFO] ## Encoding Done Successfully ##\n"RESET);
+                        perf_stats_report(&encInfo.stats, encInfo.size_secret_file);
                     }
                     else
                     {
-                        printf(RED "Encoding Failed\n" RESET);
+                        printf(RED "%s\n" RESET, progress_cancelled(&encInfo.progress) ? "Encoding Cancelled" : "Encoding Failed");
+                        abort_stego_image(&encInfo);
                         e_failure;
                     }
                 }
@@ -112,17 +199,21 @@ int main(int argc, char *argv[])
             printf(BRED"[INFO] You have selected decoding process\n"RESET);
             if(argc <= 4) /* Number of Command Line Arguments Required For Decoding Operation*/
             {
-                if( read_and_validate_decode_args(argv, &decInfo) == e_success) /* Call the read and validate function to validate
+                if( read_and_validate_decode_args(argv, &decInfo) == e_success &&
+                    read_and_validate_decode_options(options, &decInfo) == e_success) /* Call the read and validate function to validate
                 Command Line Arguments Passed, If the Function return e_success then perform decoding operation*/
                 {
+                    progress_catch_signals(&decInfo.progress); /* Ctrl-C cancels, removing the partial output */
                     if( do_decoding(&decInfo) == e_success)
                     {
                         sleep(1);
                         printf(BGREEN"[INFO] Decoding Done Successfully\n"RESET);
+                        perf_stats_report(&decInfo.stats, decInfo.size_secret_file);
                     }
                     else
                     {
-                        printf(RED "Decoding Failed\n" RESET);
+                        printf(RED "%s\n" RESET, progress_cancelled(&decInfo.progress) ? "Decoding Cancelled" : "Decoding Failed");
+                        abort_secret_file(&decInfo); /* No partial or unverified payload is left behind, a journaled part is kept for --resume */
                         e_failure;
                     }
                 }
@@ -130,6 +221,7 @@ int main(int argc, char *argv[])
                 {
                     e_failure;
                 }
+                arena_release(&decInfo.arena);
             }
             else
             {
@@ -138,6 +230,124 @@ int main(int argc, char *argv[])
                 return e_failure;
             }
         }
+        if ( check_operation_type(argv) == e_archive) /* -a packs several files with a table of contents */
+        {
+            sleep(1);
+            printf(BRED"[INFO] You have selected archive process\n"RESET);
+            if(argc >= 5) /* Cover image, output image and at least one file */
+            {
+                if( read_and_validate_archive_args(argv, &encInfo) == e_success &&
+                    read_and_validate_encode_options(options, &encInfo) == e_success &&
+                    build_archive(&argv[4], &encInfo) == e_success)
+                {
+                    progress_catch_signals(&encInfo.progress); /* Ctrl-C cancels, removing the partial output */
+                    if( do_encoding(&encInfo) == e_success && output_policy_finish(&output_policy) == e_success)
+                    {
+                        sleep(1);
+                        printf(BGREEN"[INFO] ## Archive Encoded Successfully ##\n"RESET);
+                        perf_stats_report(&encInfo.stats, encInfo.size_secret_file);
+                    }
+                    else
+                    {
+                        printf(RED "%s\n" RESET, progress_cancelled(&encInfo.progress) ? "Encoding Cancelled" : "Encoding Failed");
+                        abort_stego_image(&encInfo);
+                        return e_failure;
+                    }
+                }
+                else
+                {
+                    return e_failure;
+                }
+            }
+            else
+            {
+                printf(RED "Invalid Number of Arguments Passed for Archive\n" RESET);
+                return e_failure;
+            }
+        }
+        if ( check_operation_type(argv) == e_list) /* -l lists the archive table of contents */
+        {
+            decInfo.src_image_fname = argv[2];
+            if(argc != 3 || read_and_validate_decode_options(options, &decInfo) == e_failure || list_archive(&decInfo) == e_failure)
+            {
+                printf(RED "Listing Archive Failed\n" RESET);
+                return e_failure;
+            }
+            arena_release(&decInfo.arena);
+        }
+        if ( check_operation_type(argv) == e_extract) /* -x decodes a single archive entry */
+        {
+            decInfo.src_image_fname = argv[2];
+            if(argc < 4 || argc > 5 || read_and_validate_decode_options(options, &decInfo) == e_failure ||
+               extract_archive_entry(&decInfo, argv[3], argv[4]) == e_failure)
+            {
+                printf(RED "Extracting Archive Entry Failed\n" RESET);
+                return e_failure;
+            }
+            arena_release(&decInfo.arena);
+            sleep(1);
+            printf(BGREEN"[INFO] Extracted %s Successfully\n"RESET, argv[3]);
+        }
+        if ( check_operation_type(argv) == e_split || check_operation_type(argv) == e_join) /* -s stripes a payload across
+        several covers, -j reassembles it from the stego images */
+        {
+            ShardInfo shardInfo = {0};
+            shardInfo.output_policy = &output_policy;
+            OperationType operation = check_operation_type(argv);
+            sleep(1);
+            printf(BRED"[INFO] You have selected %s process\n"RESET, operation == e_split ? "split" : "join");
+            if( (operation == e_split ? read_and_validate_split_args(argc, argv, &shardInfo) : read_and_validate_join_args(argc, argv, &shardInfo)) == e_success &&
+                read_and_validate_shard_options(options, &shardInfo) == e_success)
+            {
+                if( (operation == e_split ? split_payload(&shardInfo) : join_payload(&shardInfo)) == e_success)
+                {
+                    printf(BGREEN"[INFO] ## %s Done Successfully ##\n"RESET, operation == e_split ? "Split" : "Join");
+                }
+                else
+                {
+                    printf(RED "%s Failed\n" RESET, operation == e_split ? "Split" : "Join");
+                    return e_failure;
+                }
+            }
+            else
+            {
+                return e_failure;
+            }
+        }
+        if ( check_operation_type(argv) == e_analyze) /* -A scores images for LSB payloads of any tool */
+        {
+            AnalyzeInfo analyzeInfo = {0};
+            if( read_and_validate_analyze_args(argc, argv, &analyzeInfo) == e_failure ||
+                read_and_validate_analyze_options(options, &analyzeInfo) == e_failure ||
+                analyze_images(&analyzeInfo) == e_failure)
+            {
+                printf(RED "Analysis Failed\n" RESET);
+                return e_failure;
+            }
+        }
+        if ( check_operation_type(argv) == e_watch) /* -w extracts the images arriving in a directory */
+        {
+            WatchInfo watchInfo = {0};
+            if( read_and_validate_watch_args(argc, argv, &watchInfo) == e_failure || /* Args first, they set the defaults */
+                read_and_validate_watch_options(options, &watchInfo) == e_failure ||
+                watch_images(&watchInfo) == e_failure)
+            {
+                printf(RED "Watch Failed\n" RESET);
+                return e_failure;
+            }
+        }
+        if ( check_operation_type(argv) == e_batch) /* -T extracts the payloads of many images into one archive */
+        {
+            BatchInfo batchInfo = {0};
+            batchInfo.output_policy = &output_policy;
+            if( read_and_validate_batch_args(argc, argv, &batchInfo) == e_failure ||
+                read_and_validate_batch_options(options, &batchInfo) == e_failure ||
+                extract_batch(&batchInfo) == e_failure)
+            {
+                printf(RED "Batch Extraction Failed\n" RESET);
+                return e_failure;
+            }
+        }
         if( check_operation_type(argv) == e_unsupported ) /* Check the Operation Type Based on the flag passed from Command Line,
         if anything other than -e or -d is passed then operation type is unsupported */
         {
@@ -162,6 +372,38 @@ OperationType check_operation_type(char *argv[])
     {
         return e_decode; /*If true then return e_decode*/
     }
+    else if (strcmp(argv[1], "-a") == 0) /*Compare and check the argv[1] == -a*/
+    {
+        return e_archive; /*If true then return e_archive*/
+    }
+    else if (strcmp(argv[1], "-l") == 0) /*Compare and check the argv[1] == -l*/
+    {
+        return e_list; /*If true then return e_list*/
+    }
+    else if (strcmp(argv[1], "-x") == 0) /*Compare and check the argv[1] == -x*/
+    {
+        return e_extract; /*If true then return e_extract*/
+    }
+    else if (strcmp(argv[1], "-s") == 0) /*Compare and check the argv[1] == -s*/
+    {
+        return e_split; /*If true then return e_split*/
+    }
+    else if (strcmp(argv[1], "-j") == 0) /*Compare and check the argv[1] == -j*/
+    {
+        return e_join; /*If true then return e_join*/
+    }
+    else if (strcmp(argv[1], "-A") == 0) /*Compare and check the argv[1] == -A*/
+    {
+        return e_analyze; /*If true then return e_analyze*/
+    }
+    else if (strcmp(argv[1], "-w") == 0) /*Compare and check the argv[1] == -w*/
+    {
+        return e_watch; /*If true then return e_watch*/
+    }
+    else if (strcmp(argv[1], "-T") == 0) /*Compare and check the argv[1] == -T*/
+    {
+        return e_batch; /*If true then return e_batch*/
+    }
     else{
         return e_unsupported; /*For any other arguments return e_unsupported*/
     }
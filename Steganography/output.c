@@ -0,0 +1,440 @@
+#define _GNU_SOURCE /* fopencookie, fallocate, O_DIRECT */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include "output.h"
+#include "bufpool.h"
+#include "trace.h"
+#include "types.h"
+#include "color.h"
+
+/* O_DIRECT stream: one aligned window of the file, written back whole */
+typedef struct _DirectStream
+{
+    int fd; /*Store the output, opened with O_DIRECT*/
+    unsigned char *window; /*Store the buffered window, aligned for O_DIRECT*/
+    long window_start; /*Store the file offset of the window, -1 before the first write*/
+    int dirty; /*Set when the window holds unwritten data*/
+    long position; /*Store the stream position*/
+    long length; /*Store the bytes written so far, the final file size*/
+    long disk_end; /*Store the end of the data already written to the file*/
+} DirectStream;
+
+static mode_t output_default_mode;
+static pthread_once_t output_mode_once = PTHREAD_ONCE_INIT;
+
+/* Function Definitions */
+
+static void output_mode_init(void)
+{
+    mode_t mask = umask(0); // umask can only be read by setting it
+    umask(mask);
+    output_default_mode = 0666 & ~mask;
+}
+
+/* Write the window back, padded to the O_DIRECT alignment */
+static int direct_flush(DirectStream *stream)
+{
+    if(!stream->dirty)
+    {
+        return 0;
+    }
+    long end = stream->length - stream->window_start < OUTPUT_DIRECT_WINDOW ? stream->length - stream->window_start : OUTPUT_DIRECT_WINDOW;
+    long size = (end + BUF_ALIGN - 1) & ~(long) (BUF_ALIGN - 1);
+    TRACE_BEGIN_BYTES("io", "direct write", size);
+    ssize_t written = pwrite(stream->fd, stream->window, size, stream->window_start);
+    TRACE_END();
+    if(written != size)
+    {
+        return -1;
+    }
+    if(stream->window_start + size > stream->disk_end)
+    {
+        stream->disk_end = stream->window_start + size;
+    }
+    stream->dirty = 0;
+    return 0;
+}
+
+/* Move the window, reading back what was written there before (seeks to the checksum field) */
+static int direct_load(DirectStream *stream, long start)
+{
+    if(direct_flush(stream) != 0)
+    {
+        return -1;
+    }
+    ssize_t count = 0;
+    if(start < stream->disk_end)
+    {
+        count = pread(stream->fd, stream->window, OUTPUT_DIRECT_WINDOW, start);
+        if(count < 0)
+        {
+            return -1;
+        }
+    }
+    memset(stream->window + count, 0, OUTPUT_DIRECT_WINDOW - count);
+    stream->window_start = start;
+    return 0;
+}
+
+static ssize_t direct_write(void *cookie, const char *buffer, size_t size)
+{
+    DirectStream *stream = cookie;
+    size_t done = 0;
+    while(done < size)
+    {
+        long start = stream->position & ~(long) (OUTPUT_DIRECT_WINDOW - 1);
+        if(start != stream->window_start && direct_load(stream, start) != 0)
+        {
+            return done > 0 ? (ssize_t) done : -1;
+        }
+        long offset = stream->position - start;
+        long count = size - done < (size_t) (OUTPUT_DIRECT_WINDOW - offset) ? (long) (size - done) : OUTPUT_DIRECT_WINDOW - offset;
+        memcpy(stream->window + offset, buffer + done, count);
+        stream->dirty = 1;
+        stream->position += count;
+        done += count;
+        if(stream->position > stream->length)
+        {
+            stream->length = stream->position;
+        }
+    }
+    return size;
+}
+
+static int direct_seek(void *cookie, off64_t *offset, int whence)
+{
+    DirectStream *stream = cookie;
+    long base = whence == SEEK_SET ? 0 : whence == SEEK_CUR ? stream->position : stream->length;
+    if(base + *offset < 0)
+    {
+        return -1;
+    }
+    stream->position = base + *offset;
+    *offset = stream->position;
+    return 0;
+}
+
+/* Write the last window and cut the file to the bytes written, the fd stays open for the commit */
+static int direct_close(void *cookie)
+{
+    DirectStream *stream = cookie;
+    int result = direct_flush(stream) == 0 && ftruncate(stream->fd, stream->length) == 0 ? 0 : -1;
+    buf_free(stream->window, OUTPUT_DIRECT_WINDOW);
+    free(stream);
+    return result;
+}
+
+static FILE *direct_open(int fd, struct _DirectStream **direct)
+{
+    cookie_io_functions_t io = { NULL, direct_write, direct_seek, direct_close };
+    if(fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_DIRECT) != 0) // tmpfs and some others refuse O_DIRECT
+    {
+        return NULL;
+    }
+    DirectStream *stream = calloc(1, sizeof(DirectStream));
+    unsigned char *window = buf_alloc(OUTPUT_DIRECT_WINDOW);
+    FILE *fptr = stream != NULL && window != NULL ? fopencookie(stream, "w", io) : NULL;
+    if(fptr == NULL)
+    {
+        free(stream);
+        buf_free(window, OUTPUT_DIRECT_WINDOW);
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT);
+        return NULL;
+    }
+    struct stat st;
+    stream->fd = fd;
+    stream->window = window;
+    stream->window_start = -1;
+    stream->length = stream->disk_end = fstat(fd, &st) == 0 ? st.st_size : 0; // Part files keep their data
+    setvbuf(fptr, NULL, _IONBF, 0); // The window is the buffer
+    *direct = stream;
+    return fptr;
+}
+/* Function Definitions */
+
+void output_policy_init(OutputPolicy *policy)
+{
+    memset(policy, 0, sizeof(*policy));
+    policy->durability = durability_none;
+    policy->group_size = 1;
+    pthread_mutex_init(&policy->lock, NULL);
+}
+
+Status output_parse_durability(const char *value, OutputPolicy *policy)
+{
+    char *end;
+    if(strcmp(value, "none") == 0)
+    {
+        policy->durability = durability_none;
+    }
+    else if(strcmp(value, "file") == 0)
+    {
+        policy->durability = durability_file;
+    }
+    else if(strncmp(value, "group:", 6) == 0 && (policy->group_size = strtol(value + 6, &end, 10)) > 0 && *end == '\0')
+    {
+        policy->durability = durability_group;
+    }
+    else
+    {
+        printf(RED "Invalid Durability %s, expected none, file or group:N\n" RESET, value);
+        return e_failure;
+    }
+    return e_success;
+}
+/* Function Definitions */
+
+/* New Output
+ * Input: Final output name, suffix of the temporary name
+ * Return Values : Output with the temporary name reserved (fd not opened), NULL on failure
+ */
+static OutputFile *output_new(const char *fname, const char *suffix)
+{
+    const char *base = strrchr(fname, '/') != NULL ? strrchr(fname, '/') + 1 : fname;
+    OutputFile *file = calloc(1, sizeof(OutputFile));
+    if(file == NULL || (file->fname = strdup(fname)) == NULL ||
+       (file->temp_fname = malloc(strlen(fname) + strlen(suffix) + 2)) == NULL)
+    {
+        if(file != NULL)
+        {
+            free(file->fname);
+            free(file);
+        }
+        return NULL;
+    }
+    if(strcmp(suffix, ".part") == 0) // Found again by the next run
+    {
+        sprintf(file->temp_fname, "%s%s", fname, suffix);
+    }
+    else
+    {
+        sprintf(file->temp_fname, "%.*s.%s%s", (int) (base - fname), fname, base, suffix); // Hidden, same directory
+    }
+    file->fd = -1;
+    return file;
+}
+
+/* Attach a Stream
+ * Input: Output with its file open, expected size (0 when unknown), whether O_DIRECT may be used
+ * Description: Gives the file the mode fopen would have given the output and reserves its
+ * blocks. O_DIRECT is only attempted when both the caller and the policy ask for it and
+ * falls back to buffered writes where the file system refuses it
+ * Return Values : FILE ptr, NULL on failure (the output is aborted)
+ */
+static FILE *output_attach(OutputFile *file, long size, int direct, const OutputPolicy *policy, OutputFile **output)
+{
+    struct stat st;
+    pthread_once(&output_mode_once, output_mode_init);
+    fchmod(file->fd, stat(file->fname, &st) == 0 && S_ISREG(st.st_mode) ? st.st_mode & 07777 : output_default_mode);
+    if(size > 0)
+    {
+        fallocate(file->fd, FALLOC_FL_KEEP_SIZE, 0, size); // Only a reservation, file systems without it still work
+    }
+    FILE *fptr = NULL;
+    if(direct && policy != NULL && policy->direct)
+    {
+        fptr = direct_open(file->fd, &file->direct);
+        if(fptr == NULL)
+        {
+            printf(YEL "INFO: O_DIRECT not available for %s, writing through the page cache\n" RESET, file->fname);
+        }
+    }
+    if(fptr == NULL)
+    {
+        int fd = dup(file->fd); // Closing the stream must leave the file open for the commit
+        fptr = fd >= 0 ? fdopen(fd, "w") : NULL;
+        if(fptr == NULL && fd >= 0)
+        {
+            close(fd);
+        }
+    }
+    if(fptr == NULL)
+    {
+        output_abort(file);
+        return NULL;
+    }
+    *output = file;
+    return fptr;
+}
+/* Function Definitions */
+
+/* Open Output
+ * Input: Final output name, expected size (0 when unknown), whether the caller's writes
+ * allow O_DIRECT, policy (NULL for the defaults)
+ * Output: Stream to a new temporary file in the output's directory
+ * Return Values : FILE ptr, NULL on failure
+ */
+FILE *output_open(const char *fname, long size, int direct, const OutputPolicy *policy, OutputFile **output)
+{
+    OutputFile *file = output_new(fname, ".XXXXXX");
+    if(file == NULL || (file->fd = mkstemp(file->temp_fname)) < 0)
+    {
+        if(file != NULL)
+        {
+            file->temp_fname[0] = '\0';
+            output_abort(file);
+        }
+        return NULL;
+    }
+    return output_attach(file, size, direct, policy, output);
+}
+
+/* Open Part Output
+ * Description: The part file of a resumable job keeps its contents and survives a failed
+ * run; the stream starts at offset 0 and overwrites what the caller does not skip
+ */
+FILE *output_open_part(const char *fname, long size, int direct, const OutputPolicy *policy, OutputFile **output, long *part_size)
+{
+    struct stat st;
+    OutputFile *file = output_new(fname, ".part");
+    if(file == NULL || (file->fd = open(file->temp_fname, O_RDWR | O_CREAT, 0600)) < 0 || fstat(file->fd, &st) != 0)
+    {
+        if(file != NULL)
+        {
+            file->keep = 1;
+            output_abort(file);
+        }
+        return NULL;
+    }
+    file->keep = 1;
+    *part_size = st.st_size;
+    return output_attach(file, size, direct, policy, output);
+}
+
+Status output_sync(FILE *fptr, OutputFile *output)
+{
+    TRACE_BEGIN("io", "sync");
+    Status status = fflush(fptr) == 0 && (output->direct == NULL || direct_flush(output->direct) == 0) && fdatasync(output->fd) == 0 ? e_success : e_failure;
+    TRACE_END();
+    return status;
+}
+/* Function Definitions */
+
+/* Length of the directory part of fname, 0 for the current directory */
+static int output_dir_length(const char *fname)
+{
+    const char *slash = strrchr(fname, '/');
+    return slash != NULL ? slash - fname + 1 : 0;
+}
+
+/* Sync the directory holding fname, making a rename in it durable */
+static int output_sync_dir(const char *fname)
+{
+    char dir[4096];
+    int length = output_dir_length(fname);
+    snprintf(dir, sizeof(dir), "%.*s", length > 0 ? length : 1, length > 0 ? fname : ".");
+    int fd = open(dir, O_RDONLY | O_DIRECTORY);
+    int result = fd >= 0 && fsync(fd) == 0 ? 0 : -1;
+    if(fd >= 0)
+    {
+        close(fd);
+    }
+    return result;
+}
+
+/* Commit Files
+ * Input: List of closed outputs, whether to sync them
+ * Description: All the data is synced before the first rename, then every file is renamed
+ * and each directory synced once, so a group pays for one flush of the device.
+ * Files of a failed group are removed
+ * Return Values : e_success and e_failure
+ */
+static Status output_commit_files(OutputFile *files, int sync)
+{
+    Status status = e_success;
+    for(OutputFile *file = files; sync && status == e_success && file != NULL; file = file->next)
+    {
+        TRACE_BEGIN("io", "sync");
+        int result = fdatasync(file->fd);
+        TRACE_END();
+        if(result != 0)
+        {
+            printf(RED "Error: Unable to sync %s\n" RESET, file->fname);
+            status = e_failure;
+        }
+    }
+    for(OutputFile *file = files; status == e_success && file != NULL; file = file->next)
+    {
+        if(rename(file->temp_fname, file->fname) != 0)
+        {
+            printf(RED "Error: Unable to rename %s to %s\n" RESET, file->temp_fname, file->fname);
+            status = e_failure;
+        }
+        else
+        {
+            file->temp_fname[0] = '\0'; // Renamed, nothing left to remove
+        }
+    }
+    for(OutputFile *file = files; sync && status == e_success && file != NULL; file = file->next)
+    {
+        int length = output_dir_length(file->fname), synced = 0;
+        for(OutputFile *prev = files; prev != file && !synced; prev = prev->next)
+        {
+            synced = output_dir_length(prev->fname) == length && strncmp(prev->fname, file->fname, length) == 0;
+        }
+        if(!synced && output_sync_dir(file->fname) != 0)
+        {
+            printf(RED "Error: Unable to sync the directory of %s\n" RESET, file->fname);
+            status = e_failure;
+        }
+    }
+    while(files != NULL)
+    {
+        OutputFile *file = files;
+        files = file->next;
+        output_abort(file);
+    }
+    return status;
+}
+/* Function Definitions */
+
+Status output_commit(OutputFile *output, OutputPolicy *policy)
+{
+    Durability durability = policy != NULL ? policy->durability : durability_none;
+    if(durability != durability_group)
+    {
+        output->next = NULL;
+        return output_commit_files(output, durability == durability_file);
+    }
+    pthread_mutex_lock(&policy->lock);
+    output->next = policy->pending;
+    policy->pending = output;
+    OutputFile *group = NULL;
+    if(++policy->pending_count >= policy->group_size)
+    {
+        group = policy->pending;
+        policy->pending = NULL;
+        policy->pending_count = 0;
+    }
+    pthread_mutex_unlock(&policy->lock);
+    return group != NULL ? output_commit_files(group, 1) : e_success;
+}
+
+void output_abort(OutputFile *output)
+{
+    if(output->fd >= 0)
+    {
+        close(output->fd);
+    }
+    if(output->temp_fname[0] != '\0' && !output->keep)
+    {
+        unlink(output->temp_fname);
+    }
+    free(output->temp_fname);
+    free(output->fname);
+    free(output);
+}
+
+Status output_policy_finish(OutputPolicy *policy)
+{
+    pthread_mutex_lock(&policy->lock);
+    OutputFile *group = policy->pending;
+    policy->pending = NULL;
+    policy->pending_count = 0;
+    pthread_mutex_unlock(&policy->lock);
+    return group != NULL ? output_commit_files(group, 1) : e_success;
+}
@@ -0,0 +1,74 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stdio.h>
+#include <pthread.h>
+#include "types.h"
+
+/*
+ * Output image writer. Every stego image is written to a temporary file next
+ * to its final name and renamed over it once complete, so a crash never
+ * leaves a torn image behind. When the output size is known (it is the
+ * cover's size for all but compressed covers) the blocks are reserved up
+ * front with fallocate. --direct writes through O_DIRECT from an aligned
+ * window, keeping large outputs out of the page cache.
+ * --durability picks when the data is forced to disk before the rename:
+ * never (none, the default), per file (file, fdatasync) or once for every
+ * N files written in a batch (group:N)
+ */
+
+#define OUTPUT_DIRECT_WINDOW (1024 * 1024) /* Bytes buffered per O_DIRECT write, a multiple of BUF_ALIGN */
+
+typedef enum
+{
+    durability_none,
+    durability_file,
+    durability_group
+} Durability;
+
+/* Temporary file waiting to be renamed over its output */
+typedef struct _OutputFile
+{
+    char *fname; /*Store the final output name*/
+    char *temp_fname; /*Store the temporary name the data is written to*/
+    int fd; /*Store the temporary file, open until committed*/
+    int keep; /*Set for part files of resumable jobs, which outlive a failed run*/
+    struct _DirectStream *direct; /*Store the O_DIRECT window, NULL for buffered writes*/
+    struct _OutputFile *next; /*Store the next file of a pending group*/
+} OutputFile;
+
+typedef struct _OutputPolicy
+{
+    Durability durability; /*Store when the data is synced*/
+    int group_size; /*Store the number of files per group commit*/
+    int direct; /*Write through O_DIRECT where the format allows it*/
+    pthread_mutex_t lock; /*Serialize group commits of concurrent jobs*/
+    OutputFile *pending; /*Store the files written but not committed yet*/
+    int pending_count; /*Store the number of pending files*/
+} OutputPolicy;
+
+/* Defaults: no sync, buffered writes */
+void output_policy_init(OutputPolicy *policy);
+
+/* Parse none, file or group:N */
+Status output_parse_durability(const char *value, OutputPolicy *policy);
+
+/* Write only stream to a temporary file for fname, size bytes reserved (0 when unknown), NULL on failure */
+FILE *output_open(const char *fname, long size, int direct, const OutputPolicy *policy, OutputFile **output);
+
+/* Same, but through <fname>.part kept from an earlier run; *part_size gets its size (0 when new) */
+FILE *output_open_part(const char *fname, long size, int direct, const OutputPolicy *policy, OutputFile **output, long *part_size);
+
+/* Push everything written to fptr down to the disk */
+Status output_sync(FILE *fptr, OutputFile *output);
+
+/* Rename the closed output over its final name, after syncing it as the policy (NULL for the defaults) asks */
+Status output_commit(OutputFile *output, OutputPolicy *policy);
+
+/* Remove the temporary file of an output which failed, part files are only closed */
+void output_abort(OutputFile *output);
+
+/* Commit the files still pending in a group */
+Status output_policy_finish(OutputPolicy *policy);
+
+#endif
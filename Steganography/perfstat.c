@@ -0,0 +1,149 @@
+#define _GNU_SOURCE /* syscall */
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "perfstat.h"
+#include "trace.h"
+#include "types.h"
+#include "color.h"
+
+static const struct { const char *name; uint type; unsigned long config; } perf_counters[perf_counter_count] =
+{
+    { "Mcycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { "Minstr", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { "cache-miss", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+    { "branch-miss", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+    { "ctx-switch", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES },
+};
+
+/* Function Definitions */
+
+/* Open Counters
+ * Description: One counter per event for this process, inherited by the worker
+ * threads created later; user space only for the hardware events, so a
+ * perf_event_paranoid of 2 still allows them
+ */
+static void perf_open(PerfStats *stats)
+{
+    int available = 0;
+    for(int i = 0; i < perf_counter_count; i++)
+    {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = perf_counters[i].type;
+        attr.config = perf_counters[i].config;
+        attr.inherit = 1;
+        attr.exclude_kernel = perf_counters[i].type == PERF_TYPE_HARDWARE;
+        attr.exclude_hv = 1;
+        stats->fds[i] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        available += stats->fds[i] >= 0;
+    }
+    if(available < perf_counter_count)
+    {
+        printf(YEL "INFO: %d of %d performance counters available, check /proc/sys/kernel/perf_event_paranoid\n" RESET,
+               available, perf_counter_count);
+    }
+    stats->opened = 1;
+}
+
+static void perf_read(const PerfStats *stats, unsigned long *counts)
+{
+    for(int i = 0; i < perf_counter_count; i++)
+    {
+        counts[i] = 0;
+        if(stats->fds[i] >= 0 && read(stats->fds[i], &counts[i], sizeof(counts[i])) != sizeof(counts[i]))
+        {
+            counts[i] = 0;
+        }
+    }
+}
+/* Function Definitions */
+
+void perf_stage_begin(PerfStats *stats, const char *name)
+{
+    TRACE_BEGIN("stage", name);
+    if(!stats->enabled || stats->stage_count == MAX_PERF_STAGES)
+    {
+        return;
+    }
+    if(!stats->opened)
+    {
+        perf_open(stats);
+    }
+    stats->stages[stats->stage_count].name = name;
+    clock_gettime(CLOCK_MONOTONIC, &stats->start_time);
+    perf_read(stats, stats->start_counts);
+}
+
+Status perf_stage_end(PerfStats *stats, Status status)
+{
+    TRACE_END();
+    if(!stats->enabled || stats->stage_count == MAX_PERF_STAGES)
+    {
+        return status;
+    }
+    PerfStage *stage = &stats->stages[stats->stage_count++];
+    struct timespec end_time;
+    perf_read(stats, stage->counts);
+    clock_gettime(CLOCK_MONOTONIC, &end_time);
+    for(int i = 0; i < perf_counter_count; i++)
+    {
+        stage->counts[i] -= stats->start_counts[i];
+    }
+    stage->seconds = (end_time.tv_sec - stats->start_time.tv_sec) + (end_time.tv_nsec - stats->start_time.tv_nsec) / 1e9;
+    return status;
+}
+/* Function Definitions */
+
+/* Report Stages
+ * Input: Stats, payload size in bytes
+ * Output: Table of the stages: time, then every available counter per MB of payload
+ * (millions for cycles and instructions), instructions per cycle when both are known
+ */
+void perf_stats_report(PerfStats *stats, long bytes)
+{
+    if(!stats->enabled || !stats->opened)
+    {
+        return;
+    }
+    double megabytes = bytes > 0 ? bytes / (1024.0 * 1024.0) : 1;
+    int have_ipc = stats->fds[perf_cycles] >= 0 && stats->fds[perf_instructions] >= 0;
+    printf(BCYAN "[STATS] %-22s %10s", "Stage (per MB payload)", "ms");
+    for(int i = 0; i < perf_counter_count; i++)
+    {
+        if(stats->fds[i] >= 0)
+        {
+            printf(" %12s", perf_counters[i].name);
+        }
+    }
+    printf(have_ipc ? " %6s\n" RESET : "\n" RESET, "IPC");
+    for(int s = 0; s < stats->stage_count; s++)
+    {
+        PerfStage *stage = &stats->stages[s];
+        printf("[STATS] %-22s %10.3f", stage->name, stage->seconds * 1000);
+        for(int i = 0; i < perf_counter_count; i++)
+        {
+            if(stats->fds[i] >= 0)
+            {
+                double scale = i == perf_cycles || i == perf_instructions ? 1e6 : 1;
+                printf(" %12.2f", stage->counts[i] / scale / megabytes);
+            }
+        }
+        if(have_ipc)
+        {
+            printf(" %6.2f", stage->counts[perf_cycles] ? (double) stage->counts[perf_instructions] / stage->counts[perf_cycles] : 0);
+        }
+        printf("\n");
+    }
+    for(int i = 0; i < perf_counter_count; i++)
+    {
+        if(stats->fds[i] >= 0)
+        {
+            close(stats->fds[i]);
+        }
+    }
+    stats->opened = 0;
+}
@@ -0,0 +1,58 @@
+#ifndef PERFSTAT_H
+#define PERFSTAT_H
+
+#include <time.h>
+#include "types.h"
+
+/*
+ * Per stage performance counters (--stats). Every stage of do_encoding and
+ * do_decoding is timed and, through perf_event_open, charged with the cycles,
+ * instructions, cache misses, branch misses and context switches of the
+ * process and its worker threads. Counters the kernel refuses (see
+ * /proc/sys/kernel/perf_event_paranoid) are left out of the report, which
+ * then shows the time only
+ */
+
+#define MAX_PERF_STAGES 16
+
+typedef enum
+{
+    perf_cycles,
+    perf_instructions,
+    perf_cache_misses,
+    perf_branch_misses,
+    perf_context_switches,
+    perf_counter_count
+} PerfCounter;
+
+typedef struct _PerfStage
+{
+    const char *name; /*Store the stage name*/
+    double seconds; /*Store the wall clock time of the stage*/
+    unsigned long counts[perf_counter_count]; /*Store the counter deltas of the stage*/
+} PerfStage;
+
+typedef struct _PerfStats
+{
+    int enabled; /*Set by --stats*/
+    int opened; /*Set once the counters were opened*/
+    int fds[perf_counter_count]; /*Store the counter descriptors, -1 when not permitted*/
+    unsigned long start_counts[perf_counter_count]; /*Store the counter values at the start of the stage*/
+    struct timespec start_time; /*Store the time at the start of the stage*/
+    PerfStage stages[MAX_PERF_STAGES]; /*Store the finished stages*/
+    int stage_count; /*Store the number of finished stages*/
+} PerfStats;
+
+/* Run a stage under the counters: PERF_STAGE(stats, "name", call) evaluates to the call's Status */
+#define PERF_STAGE(stats, name, call) (perf_stage_begin((stats), (name)), perf_stage_end((stats), (call)))
+
+/* Start a stage, opening the counters on first use (no-op unless enabled) */
+void perf_stage_begin(PerfStats *stats, const char *name);
+
+/* Finish the current stage and pass its status through */
+Status perf_stage_end(PerfStats *stats, Status status);
+
+/* Print the stages with per MB rates for bytes of payload, then close the counters */
+void perf_stats_report(PerfStats *stats, long bytes);
+
+#endif
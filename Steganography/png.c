@@ -0,0 +1,705 @@
+#define _GNU_SOURCE /* fopencookie */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "png.h"
+#include "flate.h"
+#include "pool.h"
+#include "bufpool.h"
+#include "common.h"
+#include "types.h"
+#include "color.h"
+
+#define PNG_COPY_BUF_SIZE 65536
+
+static const unsigned char png_signature[PNG_SIGNATURE_SIZE] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+/* Decompressed pixel stream of a PNG image */
+typedef struct _PngReader
+{
+    FILE *fptr_image; /*Store the PNG image*/
+    CoverInfo cover; /*Store the dimensions and the IDAT position*/
+    long next_chunk; /*Store the file offset of the next IDAT chunk*/
+    long chunk_remaining; /*Store the compressed bytes left in the current IDAT chunk*/
+    long row_size; /*Store the bytes per scanline, without the filter byte*/
+    long row_pos; /*Store the bytes of the current scanline already read*/
+    long rows_done; /*Store the number of scanlines decoded*/
+    long position; /*Store the read position in the pixel stream*/
+    unsigned char *row; /*Store the current unfiltered scanline*/
+    unsigned char *prev_row; /*Store the scanline above it*/
+    FILE *fptr_spool; /*Store every pixel once a backward seek needed them*/
+    Inflater inflater;
+} PngReader;
+
+/* Pixel stream compressed into a PNG image on close */
+typedef struct _PngWriter
+{
+    FILE *fptr_image; /*Store the stego PNG, positioned after the copied header*/
+    FILE *fptr_spool; /*Store the raw pixels written so far*/
+    int fd_source; /*Store the cover PNG, for the chunks following its pixel data*/
+    CoverInfo cover; /*Store the dimensions and the trailer position*/
+} PngWriter;
+
+/* Independent chunk of filtered scanlines compressed by a worker */
+typedef struct _PngDeflateJob
+{
+    unsigned char *input; /*Store the history followed by the filtered scanlines*/
+    long history; /*Store the bytes of history in front of the scanlines*/
+    long size; /*Store the bytes of filtered scanlines*/
+    long input_size; /*Store the pool size of the input buffer*/
+    unsigned char *output; /*Store the compressed chunk*/
+    long output_size; /*Store the size of the compressed chunk*/
+    long output_capacity; /*Store the pool size of the output buffer*/
+} PngDeflateJob;
+
+static uint png_crc_table[256];
+static pthread_once_t png_crc_once = PTHREAD_ONCE_INIT;
+
+/* Function Definitions */
+
+/* Big endian integers, as used by every PNG field */
+static unsigned long get_be(const unsigned char *buffer, int size)
+{
+    unsigned long value = 0;
+    for(int i = 0; i < size; i++)
+    {
+        value = (value << 8) | buffer[i];
+    }
+    return value;
+}
+
+static void put_be(unsigned char *buffer, unsigned long value, int size)
+{
+    for(int i = 0; i < size; i++)
+    {
+        buffer[i] = value >> (8 * (size - 1 - i));
+    }
+}
+/* Function Definitions */
+
+/* CRC-32 (IEEE) of the chunk type and data, start with 0 */
+static void png_crc_init(void)
+{
+    for(uint i = 0; i < 256; i++)
+    {
+        uint crc = i;
+        for(int bit = 0; bit < 8; bit++)
+        {
+            crc = crc & 1 ? 0xEDB88320 ^ (crc >> 1) : crc >> 1;
+        }
+        png_crc_table[i] = crc;
+    }
+}
+
+static uint png_crc(uint crc, const unsigned char *data, long size)
+{
+    pthread_once(&png_crc_once, png_crc_init);
+    crc = ~crc;
+    while(size-- > 0)
+    {
+        crc = png_crc_table[(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+/* Function Definitions */
+
+/* Write Chunk
+ * Input: Image file ptr, chunk type, data given as a prefix and a body
+ * Output: Length, type, data and CRC written
+ * Return Values : e_success and e_failure
+ */
+static Status png_write_chunk(FILE *fptr_image, const char *type, const unsigned char *prefix, long prefix_size,
+                              const unsigned char *data, long size)
+{
+    unsigned char header[8], trailer[4];
+    put_be(header, prefix_size + size, 4);
+    memcpy(header + 4, type, 4);
+    uint crc = png_crc(0, header + 4, 4);
+    crc = png_crc(crc, prefix, prefix_size);
+    crc = png_crc(crc, data, size);
+    put_be(trailer, crc, 4);
+    if(fwrite(header, sizeof(char), 8, fptr_image) < 8 ||
+       fwrite(prefix, sizeof(char), prefix_size, fptr_image) < prefix_size ||
+       fwrite(data, sizeof(char), size, fptr_image) < size ||
+       fwrite(trailer, sizeof(char), 4, fptr_image) < 4)
+    {
+        return e_failure;
+    }
+    return e_success;
+}
+/* Function Definitions */
+
+/* PNG Probe
+ * Return Values : Nonzero when the header starts with the PNG signature
+ */
+int png_probe(const unsigned char *header, int size)
+{
+    return size >= PNG_SIGNATURE_SIZE && memcmp(header, png_signature, PNG_SIGNATURE_SIZE) == 0;
+}
+/* Function Definitions */
+
+/* Parse PNG Header
+ * Input: PNG image file ptr
+ * Output: Dimensions and channels from IHDR; header_size is the offset of the first
+ * IDAT chunk and trailer_offset the offset of the chunk after the last one
+ * Return Values : e_success and e_failure
+ */
+Status png_parse_header(FILE *fptr_image, CoverInfo *cover)
+{
+    unsigned char header[PNG_SIGNATURE_SIZE + 8 + 13];
+    rewind(fptr_image);
+    if(fread(header, sizeof(char), sizeof(header), fptr_image) < sizeof(header) ||
+       get_be(header + 8, 4) != 13 || memcmp(header + 12, "IHDR", 4) != 0)
+    {
+        printf(RED "Error Reading png header\n" RESET);
+        return e_failure;
+    }
+    const unsigned char *ihdr = header + 16;
+    int channels[7] = { 1, 0, 3, 0, 2, 0, 4 }; // By color type: gray, RGB, gray + alpha, RGBA
+    if(ihdr[8] != 8)
+    {
+        printf(RED "Error: %d bit png images are not supported\n" RESET, ihdr[8]);
+        return e_failure;
+    }
+    if(ihdr[9] > 6 || channels[ihdr[9]] == 0)
+    {
+        printf(RED "Error: Palette png images are not supported\n" RESET);
+        return e_failure;
+    }
+    if(ihdr[10] != 0 || ihdr[11] != 0 || ihdr[12] != 0)
+    {
+        printf(RED "Error: Interlaced png images are not supported\n" RESET);
+        return e_failure;
+    }
+    cover->width = get_be(ihdr, 4);
+    cover->height = get_be(ihdr + 4, 4);
+    cover->channels = channels[ihdr[9]];
+    cover->data_offset = 0;
+    cover->data_size = (long) cover->width * cover->height * cover->channels;
+    cover->header_size = 0;
+    cover->trailer_offset = 0;
+    /* Walk the chunks, the IDAT chunks must be consecutive */
+    long offset = sizeof(header) + 4;
+    unsigned char chunk[8];
+    while(fseek(fptr_image, offset, SEEK_SET) == 0 && fread(chunk, sizeof(char), 8, fptr_image) == 8)
+    {
+        if(memcmp(chunk + 4, "IDAT", 4) == 0)
+        {
+            if(cover->trailer_offset != 0)
+            {
+                printf(RED "Error: Invalid png chunk order\n" RESET);
+                return e_failure;
+            }
+            if(cover->header_size == 0)
+            {
+                cover->header_size = offset;
+            }
+        }
+        else if(cover->header_size != 0 && cover->trailer_offset == 0)
+        {
+            cover->trailer_offset = offset;
+        }
+        if(memcmp(chunk + 4, "IEND", 4) == 0)
+        {
+            break;
+        }
+        offset += 12 + get_be(chunk, 4);
+    }
+    if(cover->header_size == 0 || cover->trailer_offset == 0)
+    {
+        printf(RED "Error: Truncated png image\n" RESET);
+        return e_failure;
+    }
+    return e_success;
+}
+/* Function Definitions */
+
+/* Next compressed byte for the inflater, following the IDAT chunks */
+static int png_read_byte(void *source)
+{
+    PngReader *reader = source;
+    while(reader->chunk_remaining == 0)
+    {
+        unsigned char chunk[8];
+        if(fseek(reader->fptr_image, reader->next_chunk, SEEK_SET) != 0 ||
+           fread(chunk, sizeof(char), 8, reader->fptr_image) < 8 || memcmp(chunk + 4, "IDAT", 4) != 0)
+        {
+            return -1;
+        }
+        reader->chunk_remaining = get_be(chunk, 4);
+        reader->next_chunk += 12 + reader->chunk_remaining; // Skip the CRC, the Adler-32 covers the data
+    }
+    reader->chunk_remaining--;
+    return fgetc(reader->fptr_image);
+}
+/* Function Definitions */
+
+static int paeth(int left, int up, int up_left)
+{
+    int estimate = left + up - up_left;
+    int to_left = abs(estimate - left), to_up = abs(estimate - up), to_up_left = abs(estimate - up_left);
+    if(to_left <= to_up && to_left <= to_up_left)
+    {
+        return left;
+    }
+    return to_up <= to_up_left ? up : up_left;
+}
+
+/* Undo the filter of a scanline in place, prev is the unfiltered scanline above */
+static void png_unfilter(int filter, unsigned char *row, const unsigned char *prev, long size, int bpp)
+{
+    for(long i = 0; i < size; i++)
+    {
+        int left = i >= bpp ? row[i - bpp] : 0, up = prev[i], up_left = i >= bpp ? prev[i - bpp] : 0;
+        switch(filter)
+        {
+            case 1: row[i] += left; break;
+            case 2: row[i] += up; break;
+            case 3: row[i] += (left + up) >> 1; break;
+            case 4: row[i] += paeth(left, up, up_left); break;
+        }
+    }
+}
+
+/* Filter a scanline with every filter type and keep the one with the smallest sum of residuals */
+static void png_filter(const unsigned char *row, const unsigned char *prev, long size, int bpp,
+                       unsigned char *output, unsigned char *scratch)
+{
+    unsigned long best = -1UL;
+    for(int filter = 0; filter <= 4; filter++)
+    {
+        unsigned long sum = 0;
+        for(long i = 0; i < size; i++)
+        {
+            int left = i >= bpp ? row[i - bpp] : 0, up = prev[i], up_left = i >= bpp ? prev[i - bpp] : 0;
+            int predicted = filter == 0 ? 0 : filter == 1 ? left : filter == 2 ? up :
+                            filter == 3 ? (left + up) >> 1 : paeth(left, up, up_left);
+            scratch[i] = row[i] - predicted;
+            sum += abs((signed char) scratch[i]);
+        }
+        if(sum < best)
+        {
+            best = sum;
+            output[0] = filter;
+            memcpy(output + 1, scratch, size);
+        }
+    }
+}
+/* Function Definitions */
+
+/* Restart decoding from the first IDAT chunk */
+static Status png_reader_start(PngReader *reader)
+{
+    reader->next_chunk = reader->cover.header_size;
+    reader->chunk_remaining = 0;
+    reader->rows_done = 0;
+    reader->row_pos = reader->row_size;
+    reader->position = 0;
+    memset(reader->row, 0, reader->row_size);
+    return inflater_init(&reader->inflater, png_read_byte, reader);
+}
+
+static Status png_inflate_full(PngReader *reader, unsigned char *data, long size)
+{
+    while(size > 0)
+    {
+        long count = inflater_read(&reader->inflater, data, size);
+        if(count <= 0)
+        {
+            return e_failure;
+        }
+        data += count;
+        size -= count;
+    }
+    return e_success;
+}
+
+/* Decode the next scanline, the previous one becomes the row above */
+static Status png_decode_row(PngReader *reader)
+{
+    unsigned char *swap = reader->prev_row, filter;
+    reader->prev_row = reader->row;
+    reader->row = swap;
+    if(png_inflate_full(reader, &filter, 1) == e_failure || filter > 4 ||
+       png_inflate_full(reader, reader->row, reader->row_size) == e_failure)
+    {
+        printf(RED "Error: Corrupted png pixel data\n" RESET);
+        return e_failure;
+    }
+    png_unfilter(filter, reader->row, reader->prev_row, reader->row_size, reader->cover.channels);
+    reader->rows_done++;
+    reader->row_pos = 0;
+    return e_success;
+}
+
+/* Produce (or with a NULL buffer skip) up to size pixel bytes */
+static ssize_t png_reader_decode(PngReader *reader, char *buffer, size_t size)
+{
+    size_t done = 0;
+    while(done < size)
+    {
+        if(reader->row_pos == reader->row_size)
+        {
+            if(reader->rows_done == reader->cover.height)
+            {
+                break;
+            }
+            if(png_decode_row(reader) == e_failure)
+            {
+                return -1;
+            }
+        }
+        size_t count = size - done < (size_t) (reader->row_size - reader->row_pos) ? size - done : (size_t) (reader->row_size - reader->row_pos);
+        if(buffer != NULL)
+        {
+            memcpy(buffer + done, reader->row + reader->row_pos, count);
+        }
+        reader->row_pos += count;
+        done += count;
+    }
+    reader->position += done;
+    return done;
+}
+
+/* Spool Pixels
+ * Description: The stream decodes forward only; the first backward seek decodes
+ * every pixel into a temporary file which serves the stream from then on
+ * Return Values : e_success and e_failure
+ */
+static Status png_reader_spool(PngReader *reader)
+{
+    char buffer[PNG_COPY_BUF_SIZE];
+    reader->fptr_spool = tmpfile();
+    if(reader->fptr_spool == NULL || png_reader_start(reader) == e_failure)
+    {
+        return e_failure;
+    }
+    ssize_t count;
+    while((count = png_reader_decode(reader, buffer, sizeof(buffer))) > 0)
+    {
+        if(fwrite(buffer, sizeof(char), count, reader->fptr_spool) < (size_t) count)
+        {
+            return e_failure;
+        }
+    }
+    return count == 0 ? e_success : e_failure;
+}
+/* Function Definitions */
+
+static ssize_t png_reader_read(void *cookie, char *buffer, size_t size)
+{
+    PngReader *reader = cookie;
+    if(reader->fptr_spool != NULL)
+    {
+        size_t count = fread(buffer, sizeof(char), size, reader->fptr_spool);
+        reader->position += count;
+        return count;
+    }
+    return png_reader_decode(reader, buffer, size);
+}
+
+static int png_reader_seek(void *cookie, off64_t *offset, int whence)
+{
+    PngReader *reader = cookie;
+    long target = (whence == SEEK_SET ? 0 : whence == SEEK_CUR ? reader->position : reader->cover.data_size) + *offset;
+    if(target < 0)
+    {
+        return -1;
+    }
+    if(reader->fptr_spool == NULL && target < reader->position && png_reader_spool(reader) == e_failure)
+    {
+        return -1;
+    }
+    if(reader->fptr_spool != NULL)
+    {
+        if(fseek(reader->fptr_spool, target, SEEK_SET) != 0)
+        {
+            return -1;
+        }
+    }
+    else if(target > reader->position)
+    {
+        long skip = target < reader->cover.data_size ? target - reader->position : reader->cover.data_size - reader->position;
+        if(skip > 0 && png_reader_decode(reader, NULL, skip) < 0)
+        {
+            return -1;
+        }
+    }
+    reader->position = target;
+    *offset = target;
+    return 0;
+}
+
+static int png_reader_close(void *cookie)
+{
+    PngReader *reader = cookie;
+    fclose(reader->fptr_image);
+    if(reader->fptr_spool != NULL)
+    {
+        fclose(reader->fptr_spool);
+    }
+    free(reader->row);
+    free(reader->prev_row);
+    free(reader);
+    return 0;
+}
+
+/* Open PNG Reader
+ * Input: PNG image file ptr and its parsed header
+ * Output: Read only FILE ptr of the unfiltered scanlines, which closes the image
+ * Description: Memory use is two scanlines and the 32K inflate window
+ * Return Values : FILE ptr, NULL on failure
+ */
+FILE *png_open_reader(FILE *fptr_image, const CoverInfo *cover)
+{
+    cookie_io_functions_t io = { png_reader_read, NULL, png_reader_seek, png_reader_close };
+    PngReader *reader = calloc(1, sizeof(PngReader));
+    if(reader == NULL)
+    {
+        return NULL;
+    }
+    reader->fptr_image = fptr_image;
+    reader->cover = *cover;
+    reader->row_size = (long) cover->width * cover->channels;
+    reader->row = calloc(reader->row_size, 1);
+    reader->prev_row = calloc(reader->row_size, 1);
+    FILE *fptr = NULL;
+    if(reader->row != NULL && reader->prev_row != NULL && png_reader_start(reader) == e_success)
+    {
+        fptr = fopencookie(reader, "r", io);
+    }
+    if(fptr == NULL)
+    {
+        free(reader->row);
+        free(reader->prev_row);
+        free(reader);
+    }
+    return fptr;
+}
+/* Function Definitions */
+
+static Status png_deflate_job(void *arg)
+{
+    PngDeflateJob *job = arg;
+    job->output_size = deflate_chunk(job->input, job->history, job->size, &job->output, &job->output_capacity);
+    return job->output_size < 0 ? e_failure : e_success;
+}
+
+/* Write Pixels
+ * Input: Writer with every pixel in the spool
+ * Output: IDAT chunks holding one zlib stream
+ * Description: Filter the scanlines in order, cut them into chunks of about
+ * PNG_DEFLATE_CHUNK_SIZE bytes and deflate a batch of chunks on the worker pool.
+ * Each chunk sees the 32K in front of it as history and ends byte aligned, so
+ * the compressed chunks are written as consecutive IDAT chunks
+ * Return Values : e_success and e_failure
+ */
+static Status png_write_pixels(PngWriter *writer)
+{
+    long row_size = (long) writer->cover.width * writer->cover.channels, stride = row_size + 1;
+    long rows_per_job = PNG_DEFLATE_CHUNK_SIZE / stride > 0 ? PNG_DEFLATE_CHUNK_SIZE / stride : 1;
+    int thread_count = pool_default_threads();
+    if(fseek(writer->fptr_spool, 0, SEEK_END) != 0 || ftell(writer->fptr_spool) != writer->cover.data_size)
+    {
+        printf(RED "Error: Incomplete png pixel data\n" RESET);
+        return e_failure;
+    }
+    rewind(writer->fptr_spool);
+    PngDeflateJob *jobs = calloc(thread_count, sizeof(PngDeflateJob));
+    unsigned char *history = malloc(FLATE_WINDOW_SIZE);
+    unsigned char *row = calloc(row_size, 1), *prev_row = calloc(row_size, 1), *scratch = malloc(row_size);
+    WorkerPool *pool = pool_create(thread_count);
+    Status status = jobs && history && row && prev_row && scratch && pool ? e_success : e_failure;
+    for(int i = 0; status == e_success && i < thread_count; i++)
+    {
+        jobs[i].input_size = FLATE_WINDOW_SIZE + rows_per_job * stride;
+        jobs[i].input = pool_buf_alloc(pool, pool_job_node(pool, i), jobs[i].input_size);
+        status = jobs[i].input != NULL ? e_success : e_failure;
+    }
+    unsigned char zlib_header[2];
+    long history_size = 0, prefix_size = 2;
+    uint adler = 1;
+    deflate_zlib_header(zlib_header);
+    for(long y = 0; status == e_success && y < writer->cover.height;)
+    {
+        int job_count = 0;
+        for(; job_count < thread_count && y < writer->cover.height && status == e_success; job_count++)
+        {
+            PngDeflateJob *job = &jobs[job_count];
+            memcpy(job->input, history, history_size);
+            job->history = history_size;
+            job->size = 0;
+            for(long r = 0; r < rows_per_job && y < writer->cover.height; r++, y++)
+            {
+                unsigned char *swap = prev_row;
+                prev_row = row;
+                row = swap;
+                if(fread(row, sizeof(char), row_size, writer->fptr_spool) < row_size)
+                {
+                    status = e_failure;
+                    break;
+                }
+                png_filter(row, prev_row, row_size, writer->cover.channels, job->input + job->history + job->size, scratch);
+                job->size += stride;
+            }
+            adler = adler32_update(adler, job->input + job->history, job->size);
+            history_size = job->history + job->size < FLATE_WINDOW_SIZE ? job->history + job->size : FLATE_WINDOW_SIZE;
+            memcpy(history, job->input + job->history + job->size - history_size, history_size);
+            if(status == e_success)
+            {
+                status = pool_submit_node(pool, pool_job_node(pool, job_count), png_deflate_job, job); // Where its input lives
+            }
+        }
+        if(pool_wait(pool) == e_failure)
+        {
+            status = e_failure;
+        }
+        for(int i = 0; i < job_count; i++)
+        {
+            if(status == e_success)
+            {
+                status = png_write_chunk(writer->fptr_image, "IDAT", zlib_header, prefix_size, jobs[i].output, jobs[i].output_size);
+                prefix_size = 0; // Only the first chunk carries the zlib header
+            }
+            buf_free(jobs[i].output, jobs[i].output_capacity);
+            jobs[i].output = NULL;
+        }
+    }
+    if(status == e_success)
+    {
+        unsigned char trailer[6];
+        int size = deflate_zlib_trailer(adler, trailer);
+        status = png_write_chunk(writer->fptr_image, "IDAT", zlib_header, prefix_size, trailer, size);
+    }
+    if(pool != NULL)
+    {
+        pool_destroy(pool);
+    }
+    for(int i = 0; jobs != NULL && i < thread_count; i++)
+    {
+        buf_free(jobs[i].input, jobs[i].input_size);
+    }
+    free(jobs);
+    free(history);
+    free(row);
+    free(prev_row);
+    free(scratch);
+    return status;
+}
+/* Function Definitions */
+
+/* Copy the chunks after the cover's pixel data (IEND included) */
+static Status png_copy_trailer(PngWriter *writer)
+{
+    char buffer[PNG_COPY_BUF_SIZE];
+    off_t offset = writer->cover.trailer_offset;
+    ssize_t count;
+    while((count = pread(writer->fd_source, buffer, sizeof(buffer), offset)) > 0)
+    {
+        if(fwrite(buffer, sizeof(char), count, writer->fptr_image) < (size_t) count)
+        {
+            return e_failure;
+        }
+        offset += count;
+    }
+    return count == 0 ? e_success : e_failure;
+}
+
+static ssize_t png_writer_write(void *cookie, const char *buffer, size_t size)
+{
+    PngWriter *writer = cookie;
+    return fwrite(buffer, sizeof(char), size, writer->fptr_spool);
+}
+
+static int png_writer_seek(void *cookie, off64_t *offset, int whence)
+{
+    PngWriter *writer = cookie;
+    if(fseek(writer->fptr_spool, *offset, whence) != 0)
+    {
+        return -1;
+    }
+    *offset = ftell(writer->fptr_spool);
+    return 0;
+}
+
+static int png_writer_close(void *cookie)
+{
+    PngWriter *writer = cookie;
+    Status status = png_write_pixels(writer);
+    if(status == e_success)
+    {
+        status = png_copy_trailer(writer);
+    }
+    if(status == e_failure)
+    {
+        printf(RED "Error Writing png pixel data\n" RESET);
+    }
+    if(fclose(writer->fptr_image) != 0)
+    {
+        status = e_failure;
+    }
+    fclose(writer->fptr_spool);
+    close(writer->fd_source);
+    free(writer);
+    return status == e_success ? 0 : -1;
+}
+
+/* Open PNG Writer
+ * Input: Cover PNG file ptr, stego PNG file ptr holding the copied header, parsed cover header
+ * Output: Write only FILE ptr for the raw pixels, which owns the stego image
+ * Description: Closing the stream compresses the pixels and copies the cover's trailing chunks
+ * Return Values : FILE ptr, NULL on failure
+ */
+FILE *png_open_writer(FILE *fptr_src_image, FILE *fptr_dest_image, const CoverInfo *cover)
+{
+    cookie_io_functions_t io = { NULL, png_writer_write, png_writer_seek, png_writer_close };
+    PngWriter *writer = calloc(1, sizeof(PngWriter));
+    if(writer == NULL)
+    {
+        return NULL;
+    }
+    writer->fptr_image = fptr_dest_image;
+    writer->cover = *cover;
+    writer->fptr_spool = tmpfile();
+    writer->fd_source = dup(fileno(fptr_src_image));
+    FILE *fptr = NULL;
+    if(writer->fptr_spool != NULL && writer->fd_source >= 0)
+    {
+        fptr = fopencookie(writer, "w", io);
+    }
+    if(fptr == NULL)
+    {
+        if(writer->fptr_spool != NULL)
+        {
+            fclose(writer->fptr_spool);
+        }
+        if(writer->fd_source >= 0)
+        {
+            close(writer->fd_source);
+        }
+        free(writer);
+    }
+    return fptr;
+}
+/* Function Definitions */
+
+/* PNG Stream Footprint
+ * Input: Parsed header, nonzero for the writer
+ * Description: The reader holds two scanlines and the inflater with its window.
+ * The writer filters through three scanlines and deflates a batch of one job per
+ * worker at a time, each job holding its input and the deflate buffers
+ * Return Values : Bytes of memory
+ */
+long png_footprint(const CoverInfo *cover, int writing)
+{
+    long row_size = (long) cover->width * cover->channels, stride = row_size + 1;
+    if(!writing)
+    {
+        return sizeof(PngReader) + 2 * row_size;
+    }
+    long rows_per_job = PNG_DEFLATE_CHUNK_SIZE / stride > 0 ? PNG_DEFLATE_CHUNK_SIZE / stride : 1;
+    long job_size = FLATE_WINDOW_SIZE + rows_per_job * stride + deflate_chunk_footprint(FLATE_WINDOW_SIZE, rows_per_job * stride);
+    return sizeof(PngWriter) + 3 * row_size + FLATE_WINDOW_SIZE + pool_default_threads() * job_size;
+}
@@ -0,0 +1,35 @@
+#ifndef PNG_H
+#define PNG_H
+
+#include <stdio.h>
+#include "types.h"
+#include "cover.h"
+
+/*
+ * PNG cover backend. Only non interlaced 8 bit gray, gray + alpha, RGB and
+ * RGBA images are accepted; palette indices can't take LSB changes.
+ * The reader inflates and unfilters one scanline at a time. The writer spools
+ * the raw pixels (the encoder seeks back to the checksum field and writes
+ * scattered blocks out of order), then filters them and deflates independent
+ * chunks of scanlines on the worker pool when the stream is closed
+ */
+
+#define PNG_SIGNATURE_SIZE 8
+#define PNG_DEFLATE_CHUNK_SIZE (128 * 1024) /* Filtered bytes per parallel deflate job */
+
+/* Nonzero for the PNG signature */
+int png_probe(const unsigned char *header, int size);
+
+/* Walk the chunks: dimensions from IHDR, header up to the first IDAT, trailer after the last */
+Status png_parse_header(FILE *fptr_image, CoverInfo *cover);
+
+/* Read only stream of the unfiltered pixels, owning fptr_image */
+FILE *png_open_reader(FILE *fptr_image, const CoverInfo *cover);
+
+/* Write only stream of the pixels, writing the IDAT chunks and the trailer into fptr_dest_image on close */
+FILE *png_open_writer(FILE *fptr_src_image, FILE *fptr_dest_image, const CoverInfo *cover);
+
+/* Bytes of memory the reader (writing 0) or the writer (writing 1) of the image holds */
+long png_footprint(const CoverInfo *cover, int writing);
+
+#endif
@@ -0,0 +1,546 @@
+#define _GNU_SOURCE /* cpu_set_t, pthread_attr_setaffinity_np */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include "pool.h"
+#include "bufpool.h"
+#include "tune.h"
+#include "trace.h"
+#include "color.h"
+
+#define POOL_NODE_PATH "/sys/devices/system/node/node%d/cpulist"
+
+static struct
+{
+    pthread_once_t once;
+    int node_count; /*Store the number of nodes with CPUs this process may run on*/
+    int ids[POOL_MAX_NODES]; /*Store the kernel node number of each node*/
+    cpu_set_t cpus[POOL_MAX_NODES]; /*Store the CPUs of each node, limited to the process affinity*/
+} pool_topology = { PTHREAD_ONCE_INIT, 0 };
+
+static __thread PoolWorker *pool_worker_self; /* Worker of the calling thread, NULL outside the pool */
+long pool_memory_budget;
+
+/* Function Definitions */
+
+/* Parse a CPU List
+ * Input: sysfs cpulist such as "0-3,8-11"
+ * Output: The CPUs in the list added to cpus
+ */
+static void pool_parse_cpulist(const char *list, cpu_set_t *cpus)
+{
+    while(*list != '\0' && *list != '\n')
+    {
+        char *end;
+        long first = strtol(list, &end, 10), last = first;
+        if(end == list)
+        {
+            return;
+        }
+        if(*end == '-')
+        {
+            list = end + 1;
+            last = strtol(list, &end, 10);
+        }
+        for(long cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++)
+        {
+            CPU_SET(cpu, cpus);
+        }
+        list = *end == ',' ? end + 1 : end;
+    }
+}
+
+/* Discover Topology
+ * Description: Nodes without CPUs (memory only) or without CPUs this process is
+ * allowed on (taskset, cpusets) are left out; a host without the sysfs node
+ * directory counts as one node
+ */
+static void pool_discover(void)
+{
+    cpu_set_t allowed;
+    if(sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+    {
+        CPU_ZERO(&allowed);
+    }
+    for(int node = 0; node < 1024 && pool_topology.node_count < POOL_MAX_NODES; node++)
+    {
+        char path[64], list[4096];
+        snprintf(path, sizeof(path), POOL_NODE_PATH, node);
+        FILE *fptr = fopen(path, "r");
+        if(fptr == NULL)
+        {
+            continue; // Node numbers may have holes
+        }
+        cpu_set_t *cpus = &pool_topology.cpus[pool_topology.node_count];
+        CPU_ZERO(cpus);
+        if(fgets(list, sizeof(list), fptr) != NULL)
+        {
+            pool_parse_cpulist(list, cpus);
+        }
+        fclose(fptr);
+        CPU_AND(cpus, cpus, &allowed);
+        if(CPU_COUNT(cpus) > 0)
+        {
+            pool_topology.ids[pool_topology.node_count++] = node;
+        }
+    }
+    if(pool_topology.node_count == 0)
+    {
+        pool_topology.node_count = 1;
+    }
+}
+/* Function Definitions */
+
+int pool_node_count(void)
+{
+    pthread_once(&pool_topology.once, pool_discover);
+    return pool_topology.node_count;
+}
+
+/* Current Node
+ * Description: Workers know their node; other threads ask the kernel, on NUMA hosts only
+ * Return Values : Kernel node number of the calling thread
+ */
+int pool_current_node(void)
+{
+    uint cpu, node = 0;
+    if(pool_worker_self != NULL)
+    {
+        return pool_topology.ids[pool_worker_self->node];
+    }
+    if(pool_node_count() > 1 && syscall(SYS_getcpu, &cpu, &node, NULL) != 0)
+    {
+        node = 0;
+    }
+    return node;
+}
+
+/* Node of a Batch Job
+ * Description: Round robin, so a batch submitted in order fills the queue of
+ * every node at once and the workers of one node do not start by stealing
+ */
+int pool_job_node(const WorkerPool *pool, long job)
+{
+    return job % pool->node_count;
+}
+/* Function Definitions */
+
+/* Take a Job Off a Queue
+ * Input: The pool with its lock held, queue
+ * Description: The oldest job that fits the budget next to the running jobs and
+ * the held bytes. Jobs without a footprint always start and with nothing running
+ * any job does, so held bytes never keep the pool from making progress.
+ * A job left waiting for memory is passed by the jobs behind it until it is
+ * reserved; from then on no other counted job starts before it
+ * Return Values : The job, NULL when no job of the queue may start
+ */
+static PoolJob *pool_take_from(WorkerPool *pool, PoolQueue *queue)
+{
+    PoolJob *prev = NULL, *waiting = NULL;
+    for(PoolJob *job = queue->head; job != NULL; prev = job, job = job->next)
+    {
+        if(job->footprint > 0 && ((pool->reserved != NULL && pool->reserved != job) ||
+                                  (pool->in_use > 0 && pool->in_use + pool->held + job->footprint > pool->budget)))
+        {
+            waiting = waiting == NULL ? job : waiting; // Smaller jobs behind it may backfill
+            continue;
+        }
+        if(job->footprint > 0 && waiting != NULL && pool->reserved == NULL && ++waiting->passed >= POOL_BACKFILL_LIMIT)
+        {
+            pool->reserved = waiting;
+        }
+        if(prev == NULL)
+        {
+            queue->head = job->next;
+        }
+        else
+        {
+            prev->next = job->next;
+        }
+        if(queue->tail == job)
+        {
+            queue->tail = prev;
+        }
+        pool->in_use += job->footprint;
+        if(pool->reserved == job)
+        {
+            pool->reserved = NULL;
+        }
+        return job;
+    }
+    return NULL;
+}
+
+/* Take a Job
+ * Input: The pool with its lock held, node of the worker
+ * Description: The worker's own node first, then jobs for any node, then the
+ * oldest job of a node whose workers are all busy, so no worker idles while
+ * work is queued but a job waiting for a woken worker of its node stays put
+ * Return Values : The job, NULL when no queued job may start
+ */
+static PoolJob *pool_take(WorkerPool *pool, int node)
+{
+    PoolJob *job = pool_take_from(pool, &pool->queues[node]);
+    if(job == NULL)
+    {
+        job = pool_take_from(pool, &pool->queues[POOL_MAX_NODES]);
+    }
+    for(int i = 0; job == NULL && i < pool->node_count; i++)
+    {
+        if(pool->idle[i] == 0)
+        {
+            job = pool_take_from(pool, &pool->queues[i]);
+        }
+    }
+    return job;
+}
+
+/* Lock the Pool
+ * Description: While tracing, the time spent waiting for a lock held by another
+ * thread is recorded, so contention on the queues shows up in the trace
+ */
+static void pool_lock(WorkerPool *pool)
+{
+    if(!trace_enabled)
+    {
+        pthread_mutex_lock(&pool->lock);
+    }
+    else if(pthread_mutex_trylock(&pool->lock) != 0)
+    {
+        long start = trace_now();
+        pthread_mutex_lock(&pool->lock);
+        trace_span("lock", "pool lock wait", start);
+    }
+}
+
+/* Worker Thread
+ * Input: The worker
+ * Description: Take jobs until the pool shuts down
+ */
+static void *pool_worker(void *arg)
+{
+    PoolWorker *worker = arg;
+    WorkerPool *pool = worker->pool;
+    pool_worker_self = worker;
+    trace_thread_name("pool worker");
+    pool_lock(pool);
+    while(1)
+    {
+        PoolJob *job;
+        while((job = pool_take(pool, worker->node)) == NULL && !pool->shutdown)
+        {
+            pool->idle[worker->node]++;
+            pthread_cond_wait(&pool->job_ready, &pool->lock);
+            pool->idle[worker->node]--;
+        }
+        if(job == NULL) // Shutting down and nothing left to run
+        {
+            break;
+        }
+        pthread_mutex_unlock(&pool->lock);
+        if(trace_enabled) // The wait on a track of its own, the run on the worker
+        {
+            trace_wait("queue", "queued", job->submitted);
+            trace_begin("pool", "job", "queued_us", (trace_now() - job->submitted) / 1000);
+        }
+        Status status = job->function(job->arg);
+        TRACE_END();
+        long footprint = job->footprint;
+        free(job);
+        pool_lock(pool);
+        if(status == e_failure)
+        {
+            pool->failures++;
+        }
+        if(footprint > 0) // Jobs waiting for memory may fit now, on any node
+        {
+            pool->in_use -= footprint;
+            pthread_cond_broadcast(&pool->job_ready);
+        }
+        if(--pool->pending == 0)
+        {
+            pthread_cond_broadcast(&pool->job_done);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+/* Function Definitions */
+
+int pool_default_threads(void)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if(tune_config.thread_count > 0) // From --tune
+    {
+        return tune_config.thread_count;
+    }
+    return cpus > 0 ? cpus : 1;
+}
+/* Function Definitions */
+
+/* Parse a Size
+ * Input: Bytes with an optional K, M or G suffix
+ * Return Values : The size, -1 when it is not one
+ */
+static long pool_parse_size(const char *text)
+{
+    char *end;
+    long size = strtol(text, &end, 10);
+    int shift = 0;
+    switch(*end)
+    {
+        case 'K': case 'k': shift = 10; end++; break;
+        case 'M': case 'm': shift = 20; end++; break;
+        case 'G': case 'g': shift = 30; end++; break;
+    }
+    if(end == text || *end != '\0' || size <= 0 || size > (LONG_MAX >> shift))
+    {
+        return -1;
+    }
+    return size << shift;
+}
+
+/* Take the Memory Option
+ * Input: Options separated from the positional arguments
+ * Output: --memory SIZE removed from options; without it a quarter of the
+ * cgroup memory limit is left for everything but the jobs, no limit outside a
+ * limited cgroup
+ * Return Values : e_success and e_failure
+ */
+Status pool_apply_options(char *options[])
+{
+    const char *size = NULL;
+    int kept = 0;
+    for(int i = 0; options[i] != NULL; i++)
+    {
+        if(strcmp(options[i], "--memory") == 0 && options[i + 1] != NULL)
+        {
+            size = options[++i];
+        }
+        else
+        {
+            options[kept++] = options[i]; // Left for the operation's own option parser
+        }
+    }
+    options[kept] = NULL;
+    if(size != NULL)
+    {
+        pool_memory_budget = pool_parse_size(size);
+        if(pool_memory_budget < 0)
+        {
+            printf(RED "Invalid Memory Budget %s\n" RESET, size);
+            return e_failure;
+        }
+        return e_success;
+    }
+    char limit[32];
+    FILE *fptr = fopen(POOL_CGROUP_LIMIT, "r");
+    if(fptr != NULL)
+    {
+        if(fgets(limit, sizeof(limit), fptr) != NULL)
+        {
+            limit[strcspn(limit, "\n")] = '\0';
+            long bytes = pool_parse_size(limit); // "max" when unlimited
+            pool_memory_budget = bytes > 0 ? bytes / 4 * 3 : 0;
+        }
+        fclose(fptr);
+    }
+    return e_success;
+}
+/* Function Definitions */
+
+/* Create Worker Pool
+ * Input: Number of threads (<= 0 for one per online CPU)
+ * Description: With more than one node, worker i goes to node i * nodes / threads
+ * and may run on any CPU of that node; the scheduler still balances inside it
+ * Return Values : The pool, NULL on failure
+ */
+WorkerPool *pool_create(int thread_count)
+{
+    WorkerPool *pool = calloc(1, sizeof(WorkerPool));
+    if(pool == NULL)
+    {
+        return NULL;
+    }
+    pool->thread_count = thread_count > 0 ? thread_count : pool_default_threads();
+    pool->budget = pool_memory_budget;
+    pool->node_count = pool_node_count() < pool->thread_count ? pool_node_count() : pool->thread_count;
+    pool->workers = calloc(pool->thread_count, sizeof(PoolWorker));
+    if(pool->workers == NULL)
+    {
+        free(pool);
+        return NULL;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->job_ready, NULL);
+    pthread_cond_init(&pool->job_done, NULL);
+    for(int i = 0; i < pool->thread_count; i++)
+    {
+        PoolWorker *worker = &pool->workers[i];
+        worker->pool = pool;
+        worker->node = (long) i * pool->node_count / pool->thread_count;
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        if(pool->node_count > 1)
+        {
+            pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &pool_topology.cpus[worker->node]);
+        }
+        int result = pthread_create(&worker->thread, &attr, pool_worker, worker);
+        pthread_attr_destroy(&attr);
+        if(result != 0)
+        {
+            pool->thread_count = i; // Run with the workers started so far
+            break;
+        }
+    }
+    if(pool->thread_count == 0)
+    {
+        printf(RED "Error: Unable to start worker threads\n" RESET);
+        pool_destroy(pool);
+        return NULL;
+    }
+    return pool;
+}
+/* Function Definitions */
+
+Status pool_submit(WorkerPool *pool, JobFunction function, void *arg)
+{
+    return pool_submit_sized(pool, POOL_ANY_NODE, 0, function, arg);
+}
+
+Status pool_submit_node(WorkerPool *pool, int node, JobFunction function, void *arg)
+{
+    return pool_submit_sized(pool, node, 0, function, arg);
+}
+
+/* Submit a Job to a Node
+ * Input: Pool, node (POOL_ANY_NODE or 0..node_count-1, others wrap), bytes the job
+ * holds while running (0 when not counted), job
+ * Description: Every worker is woken, since the signalled one may sit on another node
+ * Return Values : e_success and e_failure
+ */
+Status pool_submit_sized(WorkerPool *pool, int node, long footprint, JobFunction function, void *arg)
+{
+    PoolJob *job = malloc(sizeof(PoolJob));
+    if(job == NULL)
+    {
+        return e_failure;
+    }
+    job->function = function;
+    job->arg = arg;
+    job->submitted = trace_enabled ? trace_now() : 0;
+    job->footprint = pool->budget > 0 ? footprint : 0;
+    job->passed = 0;
+    job->next = NULL;
+    PoolQueue *queue = &pool->queues[node == POOL_ANY_NODE || pool->node_count == 1 ? POOL_MAX_NODES : node % pool->node_count];
+    pool_lock(pool);
+    if(queue->tail == NULL)
+    {
+        queue->head = job;
+    }
+    else
+    {
+        queue->tail->next = job;
+    }
+    queue->tail = job;
+    pool->pending++;
+    if(queue == &pool->queues[POOL_MAX_NODES])
+    {
+        pthread_cond_signal(&pool->job_ready);
+    }
+    else
+    {
+        pthread_cond_broadcast(&pool->job_ready);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return e_success;
+}
+/* Function Definitions */
+
+void pool_hold(WorkerPool *pool, long bytes)
+{
+    pool_lock(pool);
+    pool->held += bytes;
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void pool_release(WorkerPool *pool, long bytes)
+{
+    pool_lock(pool);
+    pool->held -= bytes;
+    pthread_cond_broadcast(&pool->job_ready);
+    pthread_mutex_unlock(&pool->lock);
+}
+/* Function Definitions */
+
+typedef struct _PoolTouch
+{
+    void *buffer; /*Store the buffer allocated by the job*/
+    size_t size; /*Store the size requested*/
+} PoolTouch;
+
+static Status pool_touch_job(void *arg)
+{
+    PoolTouch *touch = arg;
+    touch->buffer = buf_calloc(touch->size);
+    return touch->buffer != NULL ? e_success : e_failure;
+}
+
+/* Allocate a Buffer on a Node
+ * Input: Pool, node, size
+ * Description: Pages are placed on the node of the thread that first writes them
+ * and the buffer pool keeps a free list per node, so the buffer is taken and
+ * cleared by a worker of node. Waits for the pool, so call it before submitting
+ * a batch. Uniform hosts just clear it here
+ * Return Values : Buffer to release with buf_free, NULL on failure
+ */
+void *pool_buf_alloc(WorkerPool *pool, int node, size_t size)
+{
+    PoolTouch touch = { NULL, size };
+    if(pool->node_count == 1)
+    {
+        pool_touch_job(&touch);
+    }
+    else if(pool_submit_node(pool, node, pool_touch_job, &touch) == e_failure || pool_wait(pool) == e_failure)
+    {
+        buf_free(touch.buffer, size);
+        touch.buffer = NULL;
+    }
+    return touch.buffer;
+}
+/* Function Definitions */
+
+Status pool_wait(WorkerPool *pool)
+{
+    pool_lock(pool);
+    while(pool->pending > 0)
+    {
+        pthread_cond_wait(&pool->job_done, &pool->lock);
+    }
+    int failures = pool->failures;
+    pool->failures = 0;
+    pthread_mutex_unlock(&pool->lock);
+    return failures == 0 ? e_success : e_failure;
+}
+/* Function Definitions */
+
+void pool_destroy(WorkerPool *pool)
+{
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = 1;
+    pthread_cond_broadcast(&pool->job_ready);
+    pthread_mutex_unlock(&pool->lock);
+    for(int i = 0; i < pool->thread_count; i++)
+    {
+        pthread_join(pool->workers[i].thread, NULL);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->job_ready);
+    pthread_cond_destroy(&pool->job_done);
+    free(pool->workers);
+    free(pool);
+}
@@ -0,0 +1,118 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <pthread.h>
+#include "types.h"
+
+/*
+ * Fixed size worker pool used by the parallel modes.
+ * Jobs are run in submission order by whichever worker is free.
+ * On NUMA hosts the NUMA nodes are read from sysfs, the workers are spread
+ * over the nodes in contiguous blocks and pinned to the CPUs of their node.
+ * A job submitted to a node is run by a worker of that node, unless every
+ * worker there is busy and another node runs out of work first. Memory a
+ * job touches first is placed on its node by the kernel.
+ * Under a memory budget (--memory SIZE, by default three quarters of the cgroup
+ * memory limit) a job submitted with its footprint starts only while it fits
+ * next to the footprints of the running jobs. Smaller jobs queued behind one
+ * that does not fit start first, until they passed it POOL_BACKFILL_LIMIT
+ * times; then it is held until enough memory is free. A job larger than the
+ * whole budget runs alone. Memory a job leaves behind for its caller is charged
+ * with pool_hold until pool_release, and counts against the budget like the
+ * footprints of running jobs
+ */
+
+#define POOL_MAX_NODES 64
+#define POOL_ANY_NODE -1
+#define POOL_BACKFILL_LIMIT 16 /* Jobs started past one waiting for memory before it is held */
+#define POOL_CGROUP_LIMIT "/sys/fs/cgroup/memory.max"
+
+typedef Status (*JobFunction)(void *arg);
+
+typedef struct _PoolJob
+{
+    JobFunction function; /*Store the function to run*/
+    void *arg; /*Store the argument passed to the function*/
+    long submitted; /*Store when the job was queued, for --trace*/
+    long footprint; /*Store the bytes of memory the job holds while running, 0 when not counted*/
+    int passed; /*Store the number of jobs started past it while it waited for memory*/
+    struct _PoolJob *next;
+} PoolJob;
+
+typedef struct _PoolQueue
+{
+    PoolJob *head, *tail; /*Store the pending jobs in submission order*/
+} PoolQueue;
+
+typedef struct _PoolWorker
+{
+    struct _WorkerPool *pool; /*Store the pool the worker takes jobs from*/
+    pthread_t thread; /*Store the worker thread*/
+    int node; /*Store the node the worker is pinned to*/
+} PoolWorker;
+
+typedef struct _WorkerPool
+{
+    PoolWorker *workers; /*Store the worker threads*/
+    int thread_count; /*Store the number of worker threads*/
+    int node_count; /*Store the number of NUMA nodes the workers are spread over*/
+    PoolQueue queues[POOL_MAX_NODES + 1]; /*Store the pending jobs of each node, the last queue for jobs of any node*/
+    int idle[POOL_MAX_NODES]; /*Store the workers of each node waiting for a job*/
+    int pending; /*Store the number of jobs submitted but not finished*/
+    int failures; /*Store the number of jobs which returned e_failure*/
+    long budget; /*Store the bytes the running jobs may hold together, 0 for no limit*/
+    long in_use; /*Store the footprints of the running jobs*/
+    long held; /*Store the bytes charged by pool_hold and not released yet*/
+    PoolJob *reserved; /*Store the job passed too often, no counted job starts before it*/
+    int shutdown; /*Set when the workers should exit*/
+    pthread_mutex_t lock;
+    pthread_cond_t job_ready; /*Signalled when a job is queued*/
+    pthread_cond_t job_done; /*Signalled when pending drops to zero*/
+} WorkerPool;
+
+/* Memory budget of new pools in bytes, 0 for no limit */
+extern long pool_memory_budget;
+
+/* Take --memory SIZE out of options, or default to the cgroup memory limit */
+Status pool_apply_options(char *options[]);
+
+/* Number of online CPUs, used as the default thread count */
+int pool_default_threads(void);
+
+/* Start a pool with thread_count workers */
+WorkerPool *pool_create(int thread_count);
+
+/* Number of NUMA nodes with CPUs, 1 on uniform memory hosts */
+int pool_node_count(void);
+
+/* Kernel node number of the calling thread, 0 on uniform memory hosts */
+int pool_current_node(void);
+
+/* Node of the job-th job of a batch, round robin over the nodes of the pool */
+int pool_job_node(const WorkerPool *pool, long job);
+
+/* Queue a job for any worker */
+Status pool_submit(WorkerPool *pool, JobFunction function, void *arg);
+
+/* Queue a job for the workers of node (POOL_ANY_NODE for any) */
+Status pool_submit_node(WorkerPool *pool, int node, JobFunction function, void *arg);
+
+/* Queue a job holding footprint bytes while running, started only when they fit the budget */
+Status pool_submit_sized(WorkerPool *pool, int node, long footprint, JobFunction function, void *arg);
+
+/* Charge bytes a finished job leaves behind against the budget, until pool_release */
+void pool_hold(WorkerPool *pool, long bytes);
+
+/* Give back bytes charged by pool_hold, jobs waiting for memory may start */
+void pool_release(WorkerPool *pool, long bytes);
+
+/* Allocate and clear a pool buffer on a worker of node, so its pages are placed there */
+void *pool_buf_alloc(WorkerPool *pool, int node, size_t size);
+
+/* Wait for every submitted job, e_failure if any of them failed */
+Status pool_wait(WorkerPool *pool);
+
+/* Stop the workers and free the pool */
+void pool_destroy(WorkerPool *pool);
+
+#endif
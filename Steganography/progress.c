@@ -0,0 +1,106 @@
+#include <stdio.h>
+#include <signal.h>
+#include <string.h>
+#include "progress.h"
+#include "types.h"
+
+static Progress *signal_progress; /* Cancelled by progress_signal */
+
+/* Function Definitions */
+
+/* Start a Stage
+ * Input: Progress, stage name, payload bytes of the stage
+ * Description: The cancel flag is left alone, a cancel requested before the
+ * run started still stops it
+ */
+void progress_start(Progress *progress, const char *stage, long total)
+{
+    progress->stage = stage;
+    progress->total = total;
+    __atomic_store_n(&progress->done, 0, __ATOMIC_RELAXED);
+    progress->next_report = 0;
+    progress_update(progress, 0);
+}
+/* Function Definitions */
+
+/* Update Progress
+ * Input: Progress, payload bytes done so far
+ * Description: Called once per chunk, so the common case is one relaxed store,
+ * one relaxed load and a compare; the callback only runs when the count
+ * crossed the next report step or the stage finished
+ * Return Values : e_success, e_failure once cancelled
+ */
+Status progress_update(Progress *progress, long done)
+{
+    __atomic_store_n(&progress->done, done, __ATOMIC_RELAXED);
+    if(progress->callback != NULL && (done >= progress->next_report || done == progress->total))
+    {
+        long step = progress->total / PROGRESS_STEPS;
+        progress->next_report = done + (step > 0 ? step : 1);
+        if(progress->callback(progress, progress->data) != 0)
+        {
+            progress_cancel(progress);
+        }
+    }
+    return progress_check(progress);
+}
+/* Function Definitions */
+
+/* Check for Cancellation
+ * Return Values : e_success, e_failure once cancelled
+ */
+Status progress_check(Progress *progress)
+{
+    return __atomic_load_n(&progress->cancel, __ATOMIC_RELAXED) ? e_failure : e_success;
+}
+/* Function Definitions */
+
+void progress_cancel(Progress *progress)
+{
+    __atomic_store_n(&progress->cancel, 1, __ATOMIC_RELAXED);
+}
+/* Function Definitions */
+
+int progress_cancelled(const Progress *progress)
+{
+    return __atomic_load_n(&progress->cancel, __ATOMIC_RELAXED);
+}
+/* Function Definitions */
+
+/* Print Progress
+ * Description: Rewrites one stderr line per report, ending it when the stage is done
+ */
+int progress_print(const Progress *progress, void *data)
+{
+    (void) data;
+    long done = __atomic_load_n(&progress->done, __ATOMIC_RELAXED);
+    int percent = progress->total > 0 ? (int) (done * 100 / progress->total) : 100;
+    fprintf(stderr, "\r%s: %3d%% (%ld of %ld bytes)%s", progress->stage, percent, done, progress->total,
+            done == progress->total ? "\n" : "");
+    return 0;
+}
+/* Function Definitions */
+
+static void progress_signal(int signal_number)
+{
+    (void) signal_number;
+    if(signal_progress != NULL)
+    {
+        progress_cancel(signal_progress);
+    }
+}
+/* Function Definitions */
+
+/* Catch Stop Signals
+ * Description: Only the flag is set in the handler; the loops see it at their
+ * next chunk boundary and the caller removes the partial output
+ */
+void progress_catch_signals(Progress *progress)
+{
+    signal_progress = progress;
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = progress_signal;
+    sigaction(SIGTERM, &action, NULL);
+    sigaction(SIGINT, &action, NULL);
+}
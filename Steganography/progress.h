@@ -0,0 +1,55 @@
+#ifndef PROGRESS_H
+#define PROGRESS_H
+
+#include "types.h"
+
+/*
+ * Progress and cancellation hook for encoding and decoding.
+ * The data loops publish the payload bytes done at every chunk boundary and
+ * poll the cancel flag there, so a caller on another thread can watch
+ * done/total and stop the run with progress_cancel. The callback, when set,
+ * runs on the encoding thread about every hundredth of the payload; a
+ * nonzero return cancels as well. A cancelled run fails like any other and
+ * its partial output is removed
+ */
+
+#define PROGRESS_STEPS 100 /* Callbacks per run, at most */
+
+typedef struct _Progress Progress;
+
+/* Called with the progress so far, return nonzero to cancel */
+typedef int (*ProgressCallback)(const Progress *progress, void *data);
+
+struct _Progress
+{
+    long done; /*Store the payload bytes processed, updated at chunk boundaries*/
+    long total; /*Store the payload bytes of the run*/
+    int cancel; /*Set to stop the run at the next chunk boundary*/
+    const char *stage; /*Store what the run is doing, for the callback*/
+    ProgressCallback callback; /*Store the function told about progress, NULL for none*/
+    void *data; /*Store the argument passed to the callback*/
+    long next_report; /*Store the done count due for the next callback*/
+};
+
+/* Start counting a stage of total payload bytes */
+void progress_start(Progress *progress, const char *stage, long total);
+
+/* Publish done bytes, e_failure once the run is cancelled */
+Status progress_update(Progress *progress, long done);
+
+/* Poll for cancellation without moving the count, e_failure once cancelled */
+Status progress_check(Progress *progress);
+
+/* Ask the run to stop at its next chunk boundary, safe from other threads and signal handlers */
+void progress_cancel(Progress *progress);
+
+/* Nonzero once the run was cancelled */
+int progress_cancelled(const Progress *progress);
+
+/* Callback printing a percentage line on stderr (--progress) */
+int progress_print(const Progress *progress, void *data);
+
+/* Cancel progress on SIGINT and SIGTERM instead of being killed, so the output is cleaned up */
+void progress_catch_signals(Progress *progress);
+
+#endif
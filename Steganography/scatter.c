@@ -0,0 +1,60 @@
+#include "scatter.h"
+
+#define SCATTER_ROUNDS 4
+
+/* Function Definitions */
+
+/* SplitMix64 finalizer, the counter based generator behind the Feistel rounds */
+static unsigned long scatter_mix(unsigned long z)
+{
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9UL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBUL;
+    return z ^ (z >> 31);
+}
+/* Function Definitions */
+
+/* Initialize Scatter Key
+ * Input: Passphrase and number of whole blocks available in the image
+ * Output: Seed and Feistel width covering block_count
+ * Description: Hash the passphrase with FNV-1a and mix it; the Feistel domain is the
+ * smallest even power of two holding block_count, so cycle walking needs at most
+ * a few rounds per lookup on average
+ */
+void scatter_init(ScatterKey *scatter, const char *passphrase, unsigned long block_count)
+{
+    unsigned long hash = 0xCBF29CE484222325UL;
+    for(const char *ch = passphrase; *ch != '\0'; ch++)
+    {
+        hash = (hash ^ (unsigned char) *ch) * 0x100000001B3UL;
+    }
+    scatter->seed = scatter_mix(hash);
+    scatter->block_count = block_count;
+    scatter->half_bits = 1;
+    while((1UL << (2 * scatter->half_bits)) < block_count)
+    {
+        scatter->half_bits++;
+    }
+}
+/* Function Definitions */
+
+/* Scatter Block
+ * Input: Scatter key and payload block index (< block_count)
+ * Return Values : Image block index, a bijection of [0, block_count)
+ */
+unsigned long scatter_block(const ScatterKey *scatter, unsigned long index)
+{
+    unsigned long mask = (1UL << scatter->half_bits) - 1;
+    unsigned long value = index;
+    do
+    {
+        unsigned long left = value >> scatter->half_bits, right = value & mask;
+        for(int round = 0; round < SCATTER_ROUNDS; round++)
+        {
+            unsigned long next = left ^ (scatter_mix(scatter->seed + (round * 0x9E3779B97F4A7C15UL) + right) & mask);
+            left = right;
+            right = next;
+        }
+        value = (left << scatter->half_bits) | right;
+    } while(value >= scatter->block_count); // Cycle walk back into range
+    return value;
+}
@@ -0,0 +1,32 @@
+#ifndef SCATTER_H
+#define SCATTER_H
+
+#include "types.h"
+
+/*
+ * Keyed placement of the secret data. The image bytes after the header
+ * fields are split into blocks of SCATTER_BLOCK_SIZE bytes, and payload
+ * block j is stored in image block scatter_block(j). Bits stay sequential
+ * inside a block so encode and decode keep reading whole blocks.
+ * The permutation is a keyed Feistel network over the block index, walked
+ * until it lands inside the block count, so any block can be located
+ * without building a table
+ */
+
+#define SCATTER_BLOCK_SIZE 4096 /* Image bytes per block */
+#define SCATTER_BLOCK_DATA (SCATTER_BLOCK_SIZE / 8) /* Secret data bytes per block */
+
+typedef struct _ScatterKey
+{
+    unsigned long seed; /*Store the key derived from the passphrase*/
+    unsigned long block_count; /*Store the number of whole blocks in the image*/
+    int half_bits; /*Store the width of each Feistel half*/
+} ScatterKey;
+
+/* Derive the permutation of block_count blocks from a passphrase */
+void scatter_init(ScatterKey *scatter, const char *passphrase, unsigned long block_count);
+
+/* Image block holding payload block index */
+unsigned long scatter_block(const ScatterKey *scatter, unsigned long index);
+
+#endif
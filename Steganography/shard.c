@@ -0,0 +1,661 @@
+#define _GNU_SOURCE /* fopencookie */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include "shard.h"
+#include "pool.h"
+#include "checksum.h"
+#include "common.h"
+#include "types.h"
+#include "color.h"
+
+/* Bytes of the payload which a shard can not use in its cover:
+ * magic string, extension size, extension, file size, the spare
+ * MAX_FILE_SUFFIX counted by check_capacity and the shard header */
+#define SHARD_OVERHEAD (2 + 4 + 4 + 4 + MAX_FILE_SUFFIX + SHARD_HEADER_SIZE)
+
+/* Secret file stream of one shard: the shard header followed by a slice of the payload */
+typedef struct _ShardStream
+{
+    char header[SHARD_HEADER_SIZE];
+    FILE *fptr_payload; /*Store the payload file, opened per shard*/
+    long offset; /*Store the start of the slice inside the payload*/
+    long length; /*Store the size of the slice*/
+    long pos; /*Store the read position inside header + slice*/
+} ShardStream;
+
+typedef struct _ShardJob
+{
+    ShardInfo *shardInfo;
+    int index; /*Store the shard index*/
+    char stego_fname[MAX_FILENAME_SIZE]; /*Store the output stego image name (split)*/
+    char header[SHARD_HEADER_SIZE]; /*Store the shard header*/
+    long offset, length; /*Store the slice of the payload in this shard*/
+    uint checksum; /*Store the CRC32C of the slice*/
+    DecodeInfo decInfo; /*Store the decode state of the stego image (join)*/
+    int fd_output; /*Store the reassembled payload file (join)*/
+    long footprint; /*Store the memory the job is estimated to hold while running*/
+} ShardJob;
+
+/* Function Definitions */
+
+static ssize_t shard_stream_read(void *cookie, char *buffer, size_t size)
+{
+    ShardStream *stream = cookie;
+    size_t done = 0;
+    while(done < size && stream->pos < SHARD_HEADER_SIZE + stream->length)
+    {
+        if(stream->pos < SHARD_HEADER_SIZE)
+        {
+            buffer[done++] = stream->header[stream->pos++];
+            continue;
+        }
+        long slice_pos = stream->pos - SHARD_HEADER_SIZE;
+        size_t count = size - done;
+        if(count > stream->length - slice_pos)
+        {
+            count = stream->length - slice_pos;
+        }
+        if(fseek(stream->fptr_payload, stream->offset + slice_pos, SEEK_SET) != 0)
+        {
+            return -1;
+        }
+        count = fread(buffer + done, sizeof(char), count, stream->fptr_payload);
+        if(count == 0)
+        {
+            return -1;
+        }
+        done += count;
+        stream->pos += count;
+    }
+    return done;
+}
+
+static int shard_stream_seek(void *cookie, off64_t *offset, int whence)
+{
+    ShardStream *stream = cookie;
+    long base = whence == SEEK_SET ? 0 : whence == SEEK_CUR ? stream->pos : SHARD_HEADER_SIZE + stream->length;
+    if(base + *offset < 0)
+    {
+        return -1;
+    }
+    stream->pos = base + *offset;
+    *offset = stream->pos;
+    return 0;
+}
+
+static int shard_stream_close(void *cookie)
+{
+    ShardStream *stream = cookie;
+    fclose(stream->fptr_payload);
+    free(stream);
+    return 0;
+}
+
+/* Open Shard Stream
+ * Input: Shard job with its header and slice
+ * Output: Read only FILE ptr yielding the header then the slice, without copying the payload
+ * Return Values : FILE ptr, NULL on failure
+ */
+static FILE *open_shard_stream(ShardJob *job)
+{
+    cookie_io_functions_t io = { shard_stream_read, NULL, shard_stream_seek, shard_stream_close };
+    ShardStream *stream = calloc(1, sizeof(ShardStream));
+    if(stream == NULL)
+    {
+        return NULL;
+    }
+    memcpy(stream->header, job->header, SHARD_HEADER_SIZE);
+    stream->offset = job->offset;
+    stream->length = job->length;
+    stream->fptr_payload = fopen(job->shardInfo->secret_fname, "r");
+    if(stream->fptr_payload == NULL)
+    {
+        free(stream);
+        return NULL;
+    }
+    FILE *fptr = fopencookie(stream, "r", io);
+    if(fptr == NULL)
+    {
+        shard_stream_close(stream);
+    }
+    return fptr;
+}
+/* Function Definitions */
+
+/* Shard Capacity
+ * Input: Cover image name
+ * Output: Number of payload bytes a shard can carry in the cover, 0 if it can't be read,
+ * and the memory encoding into the cover takes
+ * Description: Same bound as check_capacity with the shard overhead added
+ */
+static long shard_capacity(const char *image_fname, long *footprint)
+{
+    EncodeInfo encInfo = {0};
+    FILE *fptr_image = fopen(image_fname, "r");
+    if(fptr_image == NULL)
+    {
+        printf(RED "Error: Unable to open file %s\n" RESET, image_fname);
+        return 0;
+    }
+    long capacity = get_image_size(fptr_image, &encInfo);
+    fclose(fptr_image);
+    if(capacity > 0)
+    {
+        *footprint = cover_footprint(&encInfo.cover, 1);
+    }
+    capacity = (capacity - 1) / MAX_IMAGE_BUF_SIZE - SHARD_OVERHEAD;
+    return capacity > 0 ? capacity : 0;
+}
+/* Function Definitions */
+
+/* Payload Id
+ * Description: Random id tying the shards of one split together
+ */
+static uint new_payload_id(void)
+{
+    uint id = 0;
+    FILE *fptr_random = fopen("/dev/urandom", "r");
+    if(fptr_random == NULL || fread(&id, sizeof(id), 1, fptr_random) < 1)
+    {
+        id = time(NULL) ^ ((uint) getpid() << 16);
+    }
+    if(fptr_random != NULL)
+    {
+        fclose(fptr_random);
+    }
+    return id;
+}
+/* Function Definitions */
+
+static void close_encode_files(EncodeInfo *encInfo)
+{
+    if(encInfo->fptr_src_image != NULL)
+    {
+        fclose(encInfo->fptr_src_image);
+    }
+    if(encInfo->fptr_secret != NULL)
+    {
+        fclose(encInfo->fptr_secret);
+    }
+    abort_stego_image(encInfo); // Nothing left once the image was committed
+}
+/* Function Definitions */
+
+/* Encode Shard (worker job)
+ * Input: Shard job
+ * Output: Stego image carrying the shard header and its slice of the payload
+ * Description: Checksum the slice, then run the regular encoding pipeline with
+ * the shard stream as the secret file
+ * Return Values : e_success and e_failure
+ */
+static Status encode_shard(void *arg)
+{
+    ShardJob *job = arg;
+    ShardInfo *shardInfo = job->shardInfo;
+    FILE *fptr_payload = fopen(shardInfo->secret_fname, "r");
+    if(fptr_payload == NULL || fseek(fptr_payload, job->offset, SEEK_SET) != 0)
+    {
+        printf(RED "Error: Unable to read shard %d of %s\n" RESET, job->index, shardInfo->secret_fname);
+        if(fptr_payload != NULL)
+        {
+            fclose(fptr_payload);
+        }
+        return e_failure;
+    }
+    char buffer[MAX_SECRET_CHUNK_SIZE];
+    long remaining = job->length;
+    while(remaining > 0)
+    {
+        size_t read = fread(buffer, sizeof(char), remaining < MAX_SECRET_CHUNK_SIZE ? remaining : MAX_SECRET_CHUNK_SIZE, fptr_payload);
+        if(read == 0)
+        {
+            break;
+        }
+        job->checksum = crc32c_update(job->checksum, buffer, read);
+        remaining -= read;
+    }
+    fclose(fptr_payload);
+    if(remaining > 0)
+    {
+        printf(RED "Error: %s changed while splitting\n" RESET, shardInfo->secret_fname);
+        return e_failure;
+    }
+    put_le(job->header + 24, job->checksum, 4);
+
+    EncodeInfo encInfo = {0};
+    encInfo.src_image_fname = shardInfo->image_fnames[job->index];
+    encInfo.stego_image_fname = job->stego_fname;
+    encInfo.secret_fname = shardInfo->secret_fname;
+    encInfo.fptr_secret = open_shard_stream(job);
+    strcpy(encInfo.extn_secret_file, SHARD_EXTN);
+    encInfo.binary_payload = 1;
+    encInfo.output_policy = shardInfo->output_policy;
+    Status status = e_failure;
+    if(encInfo.fptr_secret != NULL)
+    {
+        status = do_encoding(&encInfo);
+    }
+    close_encode_files(&encInfo);
+    if(status == e_failure)
+    {
+        printf(RED "Error: Encoding shard %d into %s failed\n" RESET, job->index, encInfo.src_image_fname);
+        return e_failure;
+    }
+    printf(GRN "INFO: Shard %d (%ld bytes) -> %s\n" RESET, job->index, job->length, job->stego_fname);
+    return e_success;
+}
+/* Function Definitions */
+
+/*
+ * Validate Split Command Line Arguments
+ * Inputs: Command line arguments: -s <secret file> <output prefix> <image>...
+ * Return Values: e_success or e_failure
+ */
+Status read_and_validate_split_args(int argc, char *argv[], ShardInfo *shardInfo)
+{
+    if(argc < 5)
+    {
+        printf(RED "Invalid Number of Arguments Passed for Split\n" RESET);
+        return e_failure;
+    }
+    shardInfo->secret_fname = argv[2];
+    shardInfo->output_fname = argv[3];
+    shardInfo->image_fnames = &argv[4];
+    shardInfo->image_count = argc - 4;
+    if(shardInfo->image_count > MAX_SHARDS)
+    {
+        printf(RED "Error: At most %d cover images can be used\n" RESET, MAX_SHARDS);
+        return e_failure;
+    }
+    for(int i = 0; i < shardInfo->image_count; i++)
+    {
+        if(cover_format_for_name(shardInfo->image_fnames[i]) == NULL)
+        {
+            printf(RED "Cover Image %s is not of a supported type (%s)\n" RESET, shardInfo->image_fnames[i], cover_supported_extns());
+            return e_failure;
+        }
+    }
+    return e_success;
+}
+/* Function Definitions */
+
+/*
+ * Validate Join Command Line Arguments
+ * Inputs: Command line arguments: -j <output file> <image>...
+ * Return Values: e_success or e_failure
+ */
+Status read_and_validate_join_args(int argc, char *argv[], ShardInfo *shardInfo)
+{
+    if(argc < 4)
+    {
+        printf(RED "Invalid Number of Arguments Passed for Join\n" RESET);
+        return e_failure;
+    }
+    shardInfo->output_fname = argv[2];
+    shardInfo->image_fnames = &argv[3];
+    shardInfo->image_count = argc - 3;
+    if(shardInfo->image_count > MAX_SHARDS)
+    {
+        printf(RED "Error: At most %d stego images can be joined\n" RESET, MAX_SHARDS);
+        return e_failure;
+    }
+    return e_success;
+}
+/* Function Definitions */
+
+/*
+ * Validate Shard Options
+ * Inputs: Options separated from the positional command line arguments
+ * Output: Worker thread count when --threads N is passed
+ * Return Values: e_success or e_failure
+ */
+Status read_and_validate_shard_options(char *options[], ShardInfo *shardInfo)
+{
+    for(int i = 0; options[i] != NULL; i++)
+    {
+        if(strcmp(options[i], "--threads") == 0 && options[i + 1] != NULL)
+        {
+            shardInfo->thread_count = atoi(options[++i]);
+            if(shardInfo->thread_count <= 0)
+            {
+                printf(RED "Invalid Thread Count %s\n" RESET, options[i]);
+                return e_failure;
+            }
+        }
+        else if(strcmp(options[i], "--direct") == 0 && shardInfo->output_policy != NULL)
+        {
+            shardInfo->output_policy->direct = 1;
+        }
+        else if(strcmp(options[i], "--durability") == 0 && options[i + 1] != NULL && shardInfo->output_policy != NULL)
+        {
+            if(output_parse_durability(options[++i], shardInfo->output_policy) == e_failure)
+            {
+                return e_failure;
+            }
+        }
+        else
+        {
+            printf(RED "Unsupported Shard Option %s\n" RESET, options[i]);
+            return e_failure;
+        }
+    }
+    return e_success;
+}
+/* Function Definitions */
+
+/* Split Payload
+ * Input: ShardInfo with the payload, output prefix and cover images
+ * Output: <prefix>_<index>.<cover extension> for every cover which received a shard
+ * Description: Give each cover a slice proportional to its capacity, then encode
+ * all the shards concurrently on the worker pool
+ * Return Values : e_success and e_failure
+ */
+Status split_payload(ShardInfo *shardInfo)
+{
+    FILE *fptr_payload = fopen(shardInfo->secret_fname, "r");
+    if(fptr_payload == NULL)
+    {
+        printf(RED "Error: Unable to open file %s\n" RESET, shardInfo->secret_fname);
+        return e_failure;
+    }
+    fseek(fptr_payload, 0, SEEK_END);
+    long payload_size = ftell(fptr_payload);
+    fclose(fptr_payload);
+    if(payload_size <= 0)
+    {
+        printf(RED "Error: %s is empty\n" RESET, shardInfo->secret_fname);
+        return e_failure;
+    }
+    char extn[MAX_FILE_SUFFIX + 1] = "";
+    char *dot = strrchr(shardInfo->secret_fname, '.');
+    if(dot != NULL && strchr(dot, '/') == NULL)
+    {
+        if(strlen(dot) > MAX_FILE_SUFFIX || !secret_extn_valid(dot))
+        {
+            printf(RED "Error: Extension %s must be a dot and at most %d letters or digits\n" RESET, dot, MAX_FILE_SUFFIX - 1);
+            return e_failure;
+        }
+        strcpy(extn, dot);
+    }
+
+    quiet_mode = 1; // Shards are encoded concurrently, only report per shard results
+    long *capacity = calloc(shardInfo->image_count, sizeof(long));
+    long *footprint = calloc(shardInfo->image_count, sizeof(long));
+    ShardJob *jobs = calloc(shardInfo->image_count, sizeof(ShardJob));
+    if(capacity == NULL || footprint == NULL || jobs == NULL)
+    {
+        printf(RED "Error: Memory Allocation Failed\n" RESET);
+        free(capacity);
+        free(footprint);
+        free(jobs);
+        return e_failure;
+    }
+    long total_capacity = 0;
+    for(int i = 0; i < shardInfo->image_count; i++)
+    {
+        capacity[i] = shard_capacity(shardInfo->image_fnames[i], &footprint[i]);
+        total_capacity += capacity[i];
+    }
+    if(total_capacity < payload_size)
+    {
+        printf(RED "ERROR: Cover images can hold %ld bytes, %s has %ld bytes\n" RESET, total_capacity, shardInfo->secret_fname, payload_size);
+        free(capacity);
+        free(footprint);
+        free(jobs);
+        return e_failure;
+    }
+    /* Proportional split, rounding up so the last used cover takes no more than its share */
+    int total_shards = 0;
+    long offset = 0;
+    for(int i = 0; i < shardInfo->image_count && offset < payload_size; i++)
+    {
+        long length = (long) (((long double) payload_size * capacity[i] + total_capacity - 1) / total_capacity);
+        if(length > payload_size - offset)
+        {
+            length = payload_size - offset;
+        }
+        if(length == 0)
+        {
+            continue;
+        }
+        ShardJob *job = &jobs[total_shards++];
+        job->shardInfo = shardInfo;
+        job->index = i;
+        job->offset = offset;
+        job->length = length;
+        job->footprint = footprint[i];
+        offset += length;
+    }
+    free(capacity);
+    free(footprint);
+
+    uint payload_id = new_payload_id();
+    for(int i = 0; i < total_shards; i++)
+    {
+        ShardJob *job = &jobs[i];
+        put_le(job->header, i, 2);
+        put_le(job->header + 2, total_shards, 2);
+        put_le(job->header + 4, payload_id, 4);
+        put_le(job->header + 8, payload_size, 8);
+        put_le(job->header + 16, job->offset, 8);
+        strncpy(job->header + 28, extn, MAX_FILE_SUFFIX + 1);
+        snprintf(job->stego_fname, MAX_FILENAME_SIZE, "%s_%d%s", shardInfo->output_fname, i,
+                 strrchr(shardInfo->image_fnames[job->index], '.')); // Same format as the cover
+    }
+    printf(YEL "INFO: Splitting %s (%ld bytes) into %d shards\n" RESET, shardInfo->secret_fname, payload_size, total_shards);
+
+    int thread_count = shardInfo->thread_count > 0 ? shardInfo->thread_count : pool_default_threads();
+    WorkerPool *pool = pool_create(thread_count < total_shards ? thread_count : total_shards); // No more workers than shards
+    Status status = pool == NULL ? e_failure : e_success;
+    for(int i = 0; status == e_success && i < total_shards; i++)
+    {
+        status = pool_submit_sized(pool, pool_job_node(pool, i), jobs[i].footprint, encode_shard, &jobs[i]);
+    }
+    if(pool != NULL)
+    {
+        if(pool_wait(pool) == e_failure)
+        {
+            status = e_failure;
+        }
+        pool_destroy(pool);
+    }
+    if(shardInfo->output_policy != NULL && output_policy_finish(shardInfo->output_policy) == e_failure) // Shards left in the last group
+    {
+        status = e_failure;
+    }
+    free(jobs);
+    return status;
+}
+/* Function Definitions */
+
+/* Read Shard Header (worker job)
+ * Input: Shard job with the stego image name
+ * Output: Image opened, shard header decoded into the job
+ * Return Values : e_success and e_failure
+ */
+static Status read_shard_header(void *arg)
+{
+    ShardJob *job = arg;
+    DecodeInfo *decInfo = &job->decInfo;
+    decInfo->src_image_fname = job->shardInfo->image_fnames[job->index];
+    if(open_image_file(decInfo) == e_failure || decode_secret_file_header(decInfo) == e_failure)
+    {
+        printf(RED "Error: %s is not a stego image\n" RESET, decInfo->src_image_fname);
+        return e_failure;
+    }
+    if(strcmp(decInfo->extn_secret_file, SHARD_EXTN) != 0 || decInfo->size_secret_file < SHARD_HEADER_SIZE ||
+       decode_secret_file_range(decInfo, 0, SHARD_HEADER_SIZE, job->header) == e_failure)
+    {
+        printf(RED "Error: %s does not contain a shard\n" RESET, decInfo->src_image_fname);
+        return e_failure;
+    }
+    job->offset = get_le(job->header + 16, 8);
+    job->length = decInfo->size_secret_file - SHARD_HEADER_SIZE;
+    job->checksum = get_le(job->header + 24, 4);
+    job->footprint = cover_footprint(&decInfo->cover, 0);
+    return e_success;
+}
+/* Function Definitions */
+
+/* Decode Shard Body (worker job)
+ * Input: Shard job with its header decoded
+ * Output: Slice written at its offset in the reassembled payload
+ * Description: Decode in fixed size chunks, checksumming inside the decode kernel
+ * Return Values : e_success and e_failure
+ */
+static Status decode_shard_body(void *arg)
+{
+    ShardJob *job = arg;
+    char buffer[MAX_SECRET_CHUNK_SIZE];
+    uint checksum = 0;
+    FILE *fptr_image = job->decInfo.fptr_src_image;
+    if(fseek(fptr_image, job->decInfo.data_offset + (SHARD_HEADER_SIZE * MAX_IMAGE_BUF_SIZE), SEEK_SET) != 0)
+    {
+        printf(RED "Error: Reassembling shard from %s failed\n" RESET, job->decInfo.src_image_fname);
+        return e_failure;
+    }
+    for(long done = 0; done < job->length; )
+    {
+        int size = job->length - done < MAX_SECRET_CHUNK_SIZE ? job->length - done : MAX_SECRET_CHUNK_SIZE;
+        if(decode_payload_from_image(buffer, size, fptr_image, &checksum, NULL) == e_failure ||
+           pwrite(job->fd_output, buffer, size, job->offset + done) < size)
+        {
+            printf(RED "Error: Reassembling shard from %s failed\n" RESET, job->decInfo.src_image_fname);
+            return e_failure;
+        }
+        done += size;
+    }
+    if(checksum != job->checksum)
+    {
+        printf(RED "Error: Checksum Mismatch for shard in %s\n" RESET, job->decInfo.src_image_fname);
+        return e_failure;
+    }
+    return e_success;
+}
+/* Function Definitions */
+
+/* Join Payload
+ * Input: ShardInfo with the output file name and stego images in any order
+ * Output: Reassembled payload, named like the decoder does with the recovered extension
+ * Description: Decode every shard header in parallel, check that the shards belong
+ * to one payload and cover it exactly, then decode the bodies in parallel straight
+ * into their offsets of the output file
+ * Return Values : e_success and e_failure
+ */
+Status join_payload(ShardInfo *shardInfo)
+{
+    quiet_mode = 1;
+    int count = shardInfo->image_count;
+    ShardJob *jobs = calloc(count, sizeof(ShardJob));
+    ShardJob **by_index = calloc(count, sizeof(ShardJob *));
+    int thread_count = shardInfo->thread_count > 0 ? shardInfo->thread_count : pool_default_threads();
+    WorkerPool *pool = pool_create(thread_count < count ? thread_count : count); // No more workers than images
+    Status status = (jobs == NULL || by_index == NULL || pool == NULL) ? e_failure : e_success;
+    for(int i = 0; status == e_success && i < count; i++)
+    {
+        jobs[i].shardInfo = shardInfo;
+        jobs[i].index = i;
+        jobs[i].fd_output = -1;
+        status = pool_submit_node(pool, pool_job_node(pool, i), read_shard_header, &jobs[i]);
+    }
+    if(pool != NULL && pool_wait(pool) == e_failure)
+    {
+        status = e_failure;
+    }
+
+    /* Every shard must come from the same split and appear exactly once */
+    long payload_size = 0;
+    for(int i = 0; status == e_success && i < count; i++)
+    {
+        uint index = get_le(jobs[i].header, 2);
+        if(get_le(jobs[i].header + 2, 2) != count || get_le(jobs[i].header + 4, 4) != get_le(jobs[0].header + 4, 4) ||
+           get_le(jobs[i].header + 8, 8) != get_le(jobs[0].header + 8, 8) || memcmp(jobs[i].header + 28, jobs[0].header + 28, MAX_FILE_SUFFIX + 1) != 0)
+        {
+            printf(RED "Error: %s belongs to a different payload or the shard set is incomplete\n" RESET, jobs[i].decInfo.src_image_fname);
+            status = e_failure;
+        }
+        else if(index >= count || by_index[index] != NULL)
+        {
+            printf(RED "Error: Duplicate shard %u in %s\n" RESET, index, jobs[i].decInfo.src_image_fname);
+            status = e_failure;
+        }
+        else
+        {
+            by_index[index] = &jobs[i];
+        }
+    }
+    for(int i = 0; status == e_success && i < count; i++)
+    {
+        if(by_index[i]->offset != payload_size)
+        {
+            printf(RED "Error: Shard %d does not continue shard %d\n" RESET, i, i - 1);
+            status = e_failure;
+        }
+        payload_size += by_index[i]->length;
+    }
+    if(status == e_success && payload_size != (long) get_le(jobs[0].header + 8, 8))
+    {
+        printf(RED "Error: Shards hold %ld bytes, payload has %lu\n" RESET, payload_size, get_le(jobs[0].header + 8, 8));
+        status = e_failure;
+    }
+
+    char output_fname[MAX_FILENAME_SIZE], extn[MAX_FILE_SUFFIX + 1];
+    int fd_output = -1;
+    snprintf(extn, sizeof(extn), "%.*s", MAX_FILE_SUFFIX, jobs[0].header + 28);
+    if(status == e_success && extn[0] != '\0' && !secret_extn_valid(extn)) // It comes from the image and ends up in the output name
+    {
+        printf(RED "Error: Invalid Extension in Shard Header\n" RESET);
+        status = e_failure;
+    }
+    if(status == e_success)
+    {
+        char *dot = strrchr(shardInfo->output_fname, '.');
+        int base_len = (dot != NULL && strchr(dot, '/') == NULL) ? dot - shardInfo->output_fname : (int) strlen(shardInfo->output_fname);
+        snprintf(output_fname, MAX_FILENAME_SIZE, "%.*s%s", base_len, shardInfo->output_fname, extn);
+        fd_output = open(output_fname, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if(fd_output < 0 || ftruncate(fd_output, payload_size) != 0)
+        {
+            printf(RED "Error: Unable to open file %s\n" RESET, output_fname);
+            status = e_failure;
+        }
+    }
+    for(int i = 0; status == e_success && i < count; i++)
+    {
+        jobs[i].fd_output = fd_output;
+        status = pool_submit_sized(pool, pool_job_node(pool, i), jobs[i].footprint, decode_shard_body, &jobs[i]); // Same node as its header
+    }
+    if(pool != NULL)
+    {
+        if(pool_wait(pool) == e_failure)
+        {
+            status = e_failure;
+        }
+        pool_destroy(pool);
+    }
+    if(fd_output >= 0 && close(fd_output) != 0)
+    {
+        status = e_failure;
+    }
+    if(status == e_success)
+    {
+        printf(GRN "INFO: Joined %d shards (%ld bytes) into %s\n" RESET, count, payload_size, output_fname);
+    }
+    else if(fd_output >= 0)
+    {
+        unlink(output_fname);
+    }
+    for(int i = 0; jobs != NULL && i < count; i++)
+    {
+        if(jobs[i].decInfo.fptr_src_image != NULL)
+        {
+            fclose(jobs[i].decInfo.fptr_src_image);
+        }
+    }
+    free(jobs);
+    free(by_index);
+    return status;
+}
@@ -0,0 +1,46 @@
+#ifndef SHARD_H
+#define SHARD_H
+
+#include <stdio.h>
+#include "types.h"
+#include "encode.h"
+#include "decode.h"
+
+/*
+ * Shard payload layout (all integers little endian)
+ * [shard index : 2][total shards : 2][payload id : 4][payload size : 8]
+ * [shard offset : 8][shard crc32c : 4][payload extension : 5]
+ * followed by the shard body, the slice of the payload starting at shard offset.
+ * Shards are embedded like any other secret file with the extension .shd
+ */
+
+#define SHARD_EXTN ".shd"
+#define SHARD_HEADER_SIZE 33
+#define MAX_SHARDS 65535
+
+typedef struct _ShardInfo
+{
+    char *secret_fname; /*Store the payload file name*/
+    char *output_fname; /*Store the output prefix (split) or output file name (join)*/
+    char **image_fnames; /*Store the cover (split) or stego (join) image names*/
+    int image_count; /*Store the number of images*/
+    int thread_count; /*Store the number of worker threads, 0 for one per CPU*/
+    OutputPolicy *output_policy; /*Store how the shard images are written and synced, NULL for the defaults*/
+} ShardInfo;
+
+/* Read and validate split args: <secret file> <output prefix> <image>... */
+Status read_and_validate_split_args(int argc, char *argv[], ShardInfo *shardInfo);
+
+/* Read and validate join args: <output file> <image>... */
+Status read_and_validate_join_args(int argc, char *argv[], ShardInfo *shardInfo);
+
+/* Read and validate shard options (--threads N, --direct, --durability MODE) */
+Status read_and_validate_shard_options(char *options[], ShardInfo *shardInfo);
+
+/* Stripe the payload across the cover images, encoding the shards concurrently */
+Status split_payload(ShardInfo *shardInfo);
+
+/* Reassemble the payload from stego images given in any order, in parallel */
+Status join_payload(ShardInfo *shardInfo);
+
+#endif
@@ -0,0 +1,278 @@
+/*Documentation
+* DESCRIPTION : Check of the asynchronous encoder and decoder (async.h) against the synchronous ones
+* •	Encodes the payload into every cover with do_encoding and decodes it again with do_decoding
+* •	Then encodes into all covers at once as AsyncJobs sharing a pool reactor with fewer workers
+*	than jobs, so the steps of the jobs interleave, and compares every stego image byte for byte
+*	with the synchronous one
+* •	Decodes all of those stego images at once the same way and compares every payload byte for
+*	byte with the synchronous one and with the original
+* •	Options are passed to both encoders, so they must keep the output deterministic (--key and
+*	--checksum do, --encrypt picks a random salt); the decoders get --key
+* BUILD (from the Steganography directory) : gcc tools/asynccheck.c $(ls *.c | grep -v '^main.c$') -o asynccheck -pthread -lm
+* USAGE :
+* ./asynccheck <work directory> <payload .txt|.sh|.c> <cover>... [--key KEY] [--checksum]
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "../async.h"
+#include "../common.h"
+#include "../color.h"
+
+#define CHECK_THREADS 3 /* Workers of the reactor, fewer than the jobs */
+#define CHECK_BUF_SIZE 65536
+
+typedef struct _CheckRun
+{
+    char *cover_fname; /*Store the cover image*/
+    char stego_fname[MAX_FILENAME_SIZE]; /*Store the stego image written*/
+    char secret_fname[MAX_FILENAME_SIZE]; /*Store the output name passed to the decoder*/
+    EncodeInfo encInfo; /*Store the encoding of the cover*/
+    DecodeInfo decInfo; /*Store the decoding of the stego image*/
+    AsyncJob job; /*Store the asynchronous job*/
+    Status status; /*Store the result of the last encoding or decoding*/
+} CheckRun;
+
+static int failures;
+
+/* Function Definitions */
+
+static void check_result(int passed, const char *what, const char *cover_fname)
+{
+    if(passed)
+    {
+        printf("ok   %s %s\n", what, cover_fname);
+    }
+    else
+    {
+        printf(RED "FAIL: %s %s\n" RESET, what, cover_fname);
+        failures++;
+    }
+}
+
+static void check_complete(AsyncJob *job)
+{
+    (void) job; // Results are read after pool_wait
+}
+
+/* Compare Two Files
+ * Return Values : Nonzero when both exist and hold the same bytes
+ */
+static int same_file(const char *fname_a, const char *fname_b)
+{
+    FILE *fptr_a = fopen(fname_a, "r"), *fptr_b = fopen(fname_b, "r");
+    int same = fptr_a != NULL && fptr_b != NULL;
+    static char buffer_a[CHECK_BUF_SIZE], buffer_b[CHECK_BUF_SIZE];
+    while(same)
+    {
+        size_t read_a = fread(buffer_a, 1, sizeof(buffer_a), fptr_a);
+        size_t read_b = fread(buffer_b, 1, sizeof(buffer_b), fptr_b);
+        same = read_a == read_b && memcmp(buffer_a, buffer_b, read_a) == 0;
+        if(read_a < sizeof(buffer_a))
+        {
+            break;
+        }
+    }
+    if(fptr_a != NULL)
+    {
+        fclose(fptr_a);
+    }
+    if(fptr_b != NULL)
+    {
+        fclose(fptr_b);
+    }
+    return same;
+}
+/* Function Definitions */
+
+/* Set Up an Encoding
+ * Input: Run with its file names, payload and the options
+ * Output: encInfo validated as for lsb_steg -e
+ * Return Values : e_success and e_failure
+ */
+static Status setup_encode(CheckRun *run, char *payload_fname, char *options[])
+{
+    char *argv[] = { "asynccheck", "-e", run->cover_fname, payload_fname, run->stego_fname, NULL };
+    memset(&run->encInfo, 0, sizeof(run->encInfo));
+    if(read_and_validate_encode_options(options, &run->encInfo) == e_failure)
+    {
+        return e_failure;
+    }
+    return read_and_validate_encode_args(argv, &run->encInfo);
+}
+
+static void finish_encode(CheckRun *run)
+{
+    EncodeInfo *encInfo = &run->encInfo;
+    if(run->status == e_failure)
+    {
+        abort_stego_image(encInfo);
+    }
+    if(encInfo->fptr_src_image != NULL)
+    {
+        fclose(encInfo->fptr_src_image);
+    }
+    if(encInfo->fptr_secret != NULL)
+    {
+        fclose(encInfo->fptr_secret);
+    }
+}
+/* Function Definitions */
+
+/* Set Up a Decoding
+ * Input: Run with its file names and the options
+ * Output: decInfo validated as for lsb_steg -d
+ * Return Values : e_success and e_failure
+ */
+static Status setup_decode(CheckRun *run, char *options[])
+{
+    char *argv[] = { "asynccheck", "-d", run->stego_fname, run->secret_fname, NULL };
+    memset(&run->decInfo, 0, sizeof(run->decInfo));
+    if(read_and_validate_decode_args(argv, &run->decInfo) == e_failure)
+    {
+        return e_failure;
+    }
+    return read_and_validate_decode_options(options, &run->decInfo);
+}
+
+/* Finish a Decoding
+ * Output: Files closed, secret_fname holding the name written (with the decoded extension)
+ */
+static void finish_decode(CheckRun *run)
+{
+    DecodeInfo *decInfo = &run->decInfo;
+    if(run->status == e_failure)
+    {
+        abort_secret_file(decInfo);
+    }
+    else if(decInfo->fptr_secret != NULL && fclose(decInfo->fptr_secret) != 0)
+    {
+        run->status = e_failure;
+    }
+    decInfo->fptr_secret = NULL;
+    if(decInfo->fptr_src_image != NULL)
+    {
+        fclose(decInfo->fptr_src_image);
+    }
+    if(decInfo->secret_fname != NULL)
+    {
+        snprintf(run->secret_fname, sizeof(run->secret_fname), "%s", decInfo->secret_fname);
+    }
+    arena_release(&decInfo->arena);
+}
+/* Function Definitions */
+
+/* Encode or Decode Every Run at Once
+ * Input: Runs set up by setup_encode or setup_decode, reactor on pool
+ * Output: Status of every run, files closed
+ */
+static void run_async(CheckRun *runs, int count, int encode, char *payload_fname, char *options[], AsyncReactor *reactor, WorkerPool *pool)
+{
+    int started[count];
+    for(int i = 0; i < count; i++)
+    {
+        CheckRun *run = &runs[i];
+        run->status = encode ? setup_encode(run, payload_fname, options) : setup_decode(run, options);
+        if(run->status == e_success)
+        {
+            run->status = encode ? async_encode(&run->job, &run->encInfo, reactor, check_complete, run) :
+                                   async_decode(&run->job, &run->decInfo, reactor, check_complete, run);
+        }
+        started[i] = run->status == e_success;
+    }
+    pool_wait(pool);
+    for(int i = 0; i < count; i++)
+    {
+        CheckRun *run = &runs[i];
+        if(started[i])
+        {
+            run->status = run->job.status;
+        }
+        if(encode)
+        {
+            finish_encode(run);
+        }
+        else
+        {
+            finish_decode(run);
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int count = 0;
+    while(3 + count < argc && strncmp(argv[3 + count], "--", 2) != 0)
+    {
+        count++;
+    }
+    if(count == 0)
+    {
+        printf("Usage: %s <work directory> <payload .txt|.sh|.c> <cover>... [--key KEY] [--checksum]\n", argv[0]);
+        return 1;
+    }
+    char *work = argv[1], *payload_fname = argv[2], **options = argv + 3 + count;
+    char *decode_options[3] = { NULL, NULL, NULL }; // The decoder takes the key only
+    for(int i = 0; options[i] != NULL && options[i + 1] != NULL; i++)
+    {
+        if(strcmp(options[i], "--key") == 0)
+        {
+            decode_options[0] = options[i];
+            decode_options[1] = options[i + 1];
+        }
+    }
+    quiet_mode = 1;
+    CheckRun *sync_runs = calloc(count, sizeof(CheckRun)), *async_runs = calloc(count, sizeof(CheckRun));
+    WorkerPool *pool = pool_create(CHECK_THREADS);
+    if(sync_runs == NULL || async_runs == NULL || pool == NULL)
+    {
+        printf(RED "Error: Unable to set up the check\n" RESET);
+        return 1;
+    }
+    for(int i = 0; i < count; i++)
+    {
+        const char *extn = strrchr(argv[3 + i], '.');
+        sync_runs[i].cover_fname = async_runs[i].cover_fname = argv[3 + i];
+        snprintf(sync_runs[i].stego_fname, MAX_FILENAME_SIZE, "%s/sync_%d%s", work, i, extn != NULL ? extn : "");
+        snprintf(sync_runs[i].secret_fname, MAX_FILENAME_SIZE, "%s/sync_%d", work, i);
+        snprintf(async_runs[i].stego_fname, MAX_FILENAME_SIZE, "%s/async_%d%s", work, i, extn != NULL ? extn : "");
+        snprintf(async_runs[i].secret_fname, MAX_FILENAME_SIZE, "%s/async_%d", work, i);
+    }
+
+    /* Synchronous reference */
+    for(int i = 0; i < count; i++)
+    {
+        CheckRun *run = &sync_runs[i];
+        run->status = setup_encode(run, payload_fname, options);
+        run->status = run->status == e_success ? do_encoding(&run->encInfo) : e_failure;
+        finish_encode(run);
+        if(run->status == e_success)
+        {
+            run->status = setup_decode(run, decode_options);
+            run->status = run->status == e_success ? do_decoding(&run->decInfo) : e_failure;
+            finish_decode(run);
+        }
+        check_result(run->status == e_success && same_file(payload_fname, run->secret_fname), "sync round trip", run->cover_fname);
+    }
+
+    /* Every encoding at once, then every decoding */
+    AsyncReactor reactor;
+    async_pool_reactor(&reactor, pool);
+    run_async(async_runs, count, 1, payload_fname, options, &reactor, pool);
+    for(int i = 0; i < count; i++)
+    {
+        check_result(async_runs[i].status == e_success && same_file(sync_runs[i].stego_fname, async_runs[i].stego_fname),
+                     "async encode", async_runs[i].cover_fname);
+    }
+    run_async(async_runs, count, 0, payload_fname, decode_options, &reactor, pool);
+    for(int i = 0; i < count; i++)
+    {
+        check_result(async_runs[i].status == e_success && same_file(sync_runs[i].secret_fname, async_runs[i].secret_fname) &&
+                     same_file(payload_fname, async_runs[i].secret_fname), "async decode", async_runs[i].cover_fname);
+    }
+    pool_destroy(pool);
+    free(sync_runs);
+    free(async_runs);
+    return failures > 0;
+}
@@ -0,0 +1,196 @@
+#!/bin/sh
+#Documentation
+# DESCRIPTION : Round trip and throughput regression gate for lsb_steg
+# •	Builds lsb_steg and gencorpus, then generates the gencorpus set (every cover format)
+# •	Round trips every cover through -e/-d plain, with --checksum, --key, --key --encrypt
+#	--checksum and --verify, comparing the recovered payload byte for byte; then split/join,
+#	archive/extract and batch extraction once each
+# •	Runs tools/asynccheck.c: several asynchronous encodes and decodes at once on one pool,
+#	compared with the synchronous ones
+# •	Times the hot paths (best of CHECK_RUNS) in payload MB/s and fails when one is slower than
+#	its baseline in tools/check_baseline.txt by more than CHECK_TOLERANCE percent; the baseline
+#	belongs to this machine and is not tracked, without one the figures are only printed
+# •	The banners' one second pauses are compiled out, they would dominate every timing
+# USAGE (from the Steganography directory) :
+# sh tools/check.sh [--rebaseline]
+# --rebaseline records the measured throughput as the local baseline
+# ENVIRONMENT : CHECK_TOLERANCE (percent, default 25), CHECK_RUNS (default 5), CC (default gcc)
+
+cd "$(dirname "$0")/.." || exit 1
+baseline=tools/check_baseline.txt
+tolerance=${CHECK_TOLERANCE:-25}
+runs=${CHECK_RUNS:-5}
+key=corpus
+rebaseline=0
+if [ "$1" = "--rebaseline" ]; then
+    rebaseline=1
+elif [ -n "$1" ]; then
+    echo "Usage: $0 [--rebaseline]" >&2
+    exit 1
+fi
+
+work=$(mktemp -d "${TMPDIR:-/tmp}/lsb_check.XXXXXX") || exit 1
+trap 'rm -rf "$work"' EXIT
+export HOME="$work" # Keep the saved --tune result of the user out of the measurements
+failures=0
+
+fail()
+{
+    echo "FAIL: $*"
+    failures=$((failures + 1))
+}
+
+now_ns()
+{
+    date +%s%N
+}
+
+# Build
+printf 'unsigned int sleep(unsigned int seconds) { (void) seconds; return 0; }\n' > "$work/nopause.c" # Takes the place of the libc one
+${CC:-gcc} -O2 *.c "$work/nopause.c" -o "$work/lsb_steg" -pthread -lm || exit 1
+${CC:-gcc} -O2 tools/gencorpus.c -o "$work/gencorpus" || exit 1
+${CC:-gcc} -O2 tools/asynccheck.c $(ls *.c | grep -v '^main.c$') "$work/nopause.c" -o "$work/asynccheck" -pthread -lm || exit 1
+lsb="$work/lsb_steg"
+corpus="$work/corpus"
+"$work/gencorpus" set "$corpus" > /dev/null || exit 1
+mkdir "$work/out"
+
+# Largest corpus payload a cover holds with room to spare (8 cover bytes per payload byte)
+payload_for()
+{
+    size=$(wc -c < "$1")
+    for payload in medium_text.txt small_random.txt tiny_text.txt; do
+        if [ $(($(wc -c < "$corpus/$payload") * 16)) -lt "$size" ]; then
+            echo "$corpus/$payload"
+            return
+        fi
+    done
+    echo "$corpus/tiny_text.txt"
+}
+
+# Round trip: cover, payload, case name, encode options; decodes with the key when one is used
+round_trip()
+{
+    stego="$work/out/$3.${1##*.}"
+    decode_options=
+    case "$4" in
+        *--key*) decode_options="--key $key" ;;
+    esac
+    "$lsb" -e "$1" "$2" "$stego" $4 > "$work/out/$3.log" 2>&1
+    "$lsb" -d "$stego" "$work/out/$3" $decode_options >> "$work/out/$3.log" 2>&1
+    if cmp -s "$2" "$work/out/$3.${2##*.}"; then
+        echo "ok   $3"
+    else
+        fail "$3 ($(basename "$1") $4), see the log below"
+        tail -5 "$work/out/$3.log"
+    fi
+    rm -f "$stego" "$work/out/$3.${2##*.}"
+}
+
+echo "== Round trips"
+for cover in "$corpus"/*.bmp "$corpus"/*.pgm "$corpus"/*.ppm "$corpus"/*.pam "$corpus"/*.tga "$corpus"/*.png "$corpus"/*.y4m; do
+    payload=$(payload_for "$cover")
+    name=$(basename "$cover" | tr . _)
+    round_trip "$cover" "$payload" "$name" ""
+    round_trip "$cover" "$payload" "${name}_checksum" "--checksum"
+    round_trip "$cover" "$payload" "${name}_verify" "--verify --checksum"
+    case "$name" in
+        tiny_*) continue ;; # A keyed scatter needs whole scatter blocks, more than a tiny cover has
+    esac
+    round_trip "$cover" "$payload" "${name}_key" "--key $key"
+    round_trip "$cover" "$payload" "${name}_encrypt" "--key $key --encrypt --checksum"
+done
+
+echo "== Modes"
+"$lsb" -s "$corpus/medium_runs.txt" "$work/out/shard" "$corpus/medium_24.bmp" "$corpus/padded_32.pam" "$corpus/padded_24.png" \
+    "$corpus/medium_12.y4m" > "$work/out/shard.log" 2>&1
+"$lsb" -j "$work/out/joined.txt" "$work/out"/shard_* >> "$work/out/shard.log" 2>&1
+cmp -s "$corpus/medium_runs.txt" "$work/out/joined.txt" && echo "ok   split/join" || fail "split/join"
+"$lsb" -a "$corpus/padded_24.bmp" "$work/out/archive.bmp" "$corpus/tiny_text.txt" "$corpus/small_random.txt" > /dev/null 2>&1
+"$lsb" -x "$work/out/archive.bmp" small_random.txt "$work/out/entry.txt" > /dev/null 2>&1
+cmp -s "$corpus/small_random.txt" "$work/out/entry.txt" && echo "ok   archive/extract" || fail "archive/extract"
+"$lsb" -e "$corpus/padded_24.ppm" "$corpus/small_random.txt" "$work/out/batch.ppm" > /dev/null 2>&1
+(cd "$work/out" && "$lsb" -T batch.tar archive.bmp batch.ppm > /dev/null 2>&1 && mkdir batch && tar xf batch.tar -C batch)
+cmp -s "$corpus/small_random.txt" "$work/out/batch/batch.ppm.txt" && echo "ok   batch extract" || fail "batch extract"
+
+echo "== Async"
+mkdir "$work/async"
+async_covers="$corpus/padded_24.bmp $corpus/padded_24.png $corpus/padded_24.ppm $corpus/padded_24.tga $corpus/padded_32.pam $corpus/medium_12.y4m"
+for async_options in "" "--key $key --checksum"; do
+    "$work/asynccheck" "$work/async" "$corpus/medium_text.txt" $async_covers $async_options > "$work/async/check.log" 2>&1
+    if [ $? -eq 0 ]; then
+        echo "ok   async ${async_options:-plain} ($(grep -c "^ok" "$work/async/check.log") checks)"
+    else
+        fail "async ${async_options:-plain}, see the log below"
+        grep -v "^ok" "$work/async/check.log"
+    fi
+done
+
+# Throughput: name, cover, payload, encode options; appends "<name>_encode MB/s" and "<name>_decode MB/s"
+throughput()
+{
+    stego="$work/out/$1.${2##*.}"
+    decode_options=
+    case "$4" in
+        *--key*) decode_options="--key $key" ;;
+    esac
+    best_encode=0
+    best_decode=0
+    for run in $(seq "$runs"); do
+        start=$(now_ns)
+        "$lsb" -e "$2" "$3" "$stego" $4 > /dev/null 2>&1
+        middle=$(now_ns)
+        "$lsb" -d "$stego" "$work/out/$1" $decode_options > /dev/null 2>&1
+        end=$(now_ns)
+        if ! cmp -s "$3" "$work/out/$1.${3##*.}"; then
+            fail "$1 throughput round trip"
+            return
+        fi
+        encode=$((middle - start))
+        decode=$((end - middle))
+        if [ "$best_encode" -eq 0 ] || [ "$encode" -lt "$best_encode" ]; then best_encode=$encode; fi
+        if [ "$best_decode" -eq 0 ] || [ "$decode" -lt "$best_decode" ]; then best_decode=$decode; fi
+    done
+    size=$(wc -c < "$3")
+    awk -v name="$1" -v size="$size" -v encode="$best_encode" -v decode="$best_decode" \
+        'BEGIN { printf "%s_encode %.2f\n%s_decode %.2f\n", name, size / encode * 1000, name, size / decode * 1000 }' >> "$work/throughput.txt"
+    rm -f "$stego" "$work/out/$1.${3##*.}"
+}
+
+echo "== Throughput (payload MB/s, best of $runs)"
+: > "$work/throughput.txt"
+throughput bmp "$corpus/large_24.bmp" "$corpus/large_random.txt" ""
+throughput bmp_encrypt "$corpus/large_24.bmp" "$corpus/large_random.txt" "--key $key --encrypt --checksum"
+throughput png "$corpus/medium_32.png" "$corpus/medium_runs.txt" ""
+throughput y4m "$corpus/medium_12.y4m" "$corpus/medium_runs.txt" ""
+
+if [ "$failures" -gt 0 ]; then
+    echo "Throughput not compared, the round trips failed"
+elif [ "$rebaseline" -eq 1 ]; then
+    {
+        echo "# Payload MB/s of tools/check.sh on this machine (best of $runs runs), refresh with: sh tools/check.sh --rebaseline"
+        cat "$work/throughput.txt"
+    } > "$baseline"
+    cat "$work/throughput.txt"
+    echo "Baseline written to $baseline"
+elif [ ! -f "$baseline" ]; then
+    cat "$work/throughput.txt"
+    echo "Throughput not compared, no $baseline yet (sh tools/check.sh --rebaseline records one)"
+else
+    awk -v tolerance="$tolerance" '
+        FNR == NR { if($1 !~ /^#/) baseline[$1] = $2; next }
+        {
+            slow = ($1 in baseline) && $2 < baseline[$1] * (100 - tolerance) / 100
+            printf "%s %-20s %8.2f (baseline %s)\n", slow ? "SLOW" : "ok  ", $1, $2, ($1 in baseline) ? baseline[$1] : "none"
+        }' "$baseline" "$work/throughput.txt" | tee "$work/compared.txt"
+    regressions=$(grep -c "^SLOW" "$work/compared.txt")
+    if [ "$regressions" -gt 0 ]; then
+        fail "$regressions throughput figures more than $tolerance% below $baseline"
+    fi
+fi
+
+if [ "$failures" -gt 0 ]; then
+    echo "$failures check(s) failed"
+    exit 1
+fi
+echo "All checks passed"
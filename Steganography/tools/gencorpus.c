@@ -0,0 +1,520 @@
+/*Documentation
+* DESCRIPTION : Deterministic test corpus generator for lsb_steg
+* •	Covers are images of any size (rows written one at a time, so GB sized covers need no memory)
+*	with smooth gradients and a little noise like a photograph, in every cover format lsb_steg reads,
+*	picked by the output extension: BMP at 8 (grayscale palette), 16, 24 and 32 bits per pixel (odd
+*	widths exercise the row padding), PGM (8), PPM (24), PAM and PNG (8, 16, 24, 32), TGA (8, 24, 32)
+*	and Y4M video of Y4M_FRAMES frames (8 mono, 12 for 4:2:0)
+* •	Payloads are text (words and newlines), random bytes or compressible runs
+* •	The same seed always gives the same files
+* BUILD : gcc tools/gencorpus.c -o gencorpus
+* USAGE :
+* ./gencorpus cover <output .bmp|.pgm|.ppm|.pam|.tga|.png|.y4m> <width> <height> <bits per pixel> [seed]
+* ./gencorpus payload <output file> <size> <text|random|runs> [seed]
+* ./gencorpus set <directory> [seed]
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include "../types.h"
+#include "../color.h"
+
+#define BMP_HEADER_SIZE 54
+#define BMP_PALETTE_SIZE 1024
+#define TGA_HEADER_SIZE 18
+#define PNG_STORED_BLOCK_SIZE 65535 /* Largest stored deflate block */
+#define Y4M_FRAMES 8
+#define PAYLOAD_BUF_SIZE 65536
+#define DEFAULT_SEED 1
+
+typedef enum
+{
+    cover_bmp,
+    cover_pgm,
+    cover_ppm,
+    cover_pam,
+    cover_tga,
+    cover_png,
+    cover_y4m,
+    cover_unknown
+} CoverKind;
+
+static const struct { const char *extn; CoverKind kind; } cover_kinds[] =
+{
+    { ".bmp", cover_bmp }, { ".pgm", cover_pgm }, { ".ppm", cover_ppm }, { ".pam", cover_pam },
+    { ".tga", cover_tga }, { ".png", cover_png }, { ".y4m", cover_y4m },
+};
+
+static const unsigned char png_signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+/* IDAT stream of a png cover being written */
+typedef struct _PngStream
+{
+    FILE *fptr_image; /*Store the png image*/
+    unsigned char block[PNG_STORED_BLOCK_SIZE]; /*Store the data of the pending stored block*/
+    long used; /*Store the bytes in block*/
+    unsigned char chunk[PNG_STORED_BLOCK_SIZE + 16]; /*Store the IDAT chunk being written*/
+    long chunks; /*Store the number of IDAT chunks written*/
+    unsigned long adler_a, adler_b; /*Store the Adler-32 sums of the image data*/
+} PngStream;
+
+/* Covers and payloads written by the set command */
+static const struct { const char *name; uint width; uint height; uint bits_per_pixel; } set_covers[] =
+{
+    { "tiny_8.bmp", 64, 48, 8 },
+    { "small_16.bmp", 317, 211, 16 },
+    { "padded_24.bmp", 1023, 769, 24 },
+    { "medium_24.bmp", 2048, 1536, 24 },
+    { "medium_32.bmp", 1920, 1080, 32 },
+    { "large_24.bmp", 6000, 4000, 24 },
+    { "small_8.pgm", 317, 211, 8 },
+    { "padded_24.ppm", 1023, 769, 24 },
+    { "small_16.pam", 317, 211, 16 },
+    { "padded_32.pam", 1023, 769, 32 },
+    { "small_8.tga", 317, 211, 8 },
+    { "padded_24.tga", 1023, 769, 24 },
+    { "small_8.png", 317, 211, 8 },
+    { "padded_24.png", 1023, 769, 24 },
+    { "medium_32.png", 1920, 1080, 32 },
+    { "small_8.y4m", 176, 144, 8 },
+    { "medium_12.y4m", 1280, 720, 12 },
+};
+static const struct { const char *name; long size; const char *kind; } set_payloads[] =
+{
+    { "tiny_text.txt", 100, "text" },
+    { "small_random.txt", 4096, "random" },
+    { "medium_text.txt", 65536, "text" },
+    { "medium_runs.txt", 262144, "runs" },
+    { "large_random.txt", 4 * 1024 * 1024, "random" },
+};
+
+static const char *words[] =
+{
+    "the", "image", "hidden", "least", "significant", "bit", "cover", "payload", "secret",
+    "pixel", "noise", "message", "stream", "header", "carrier", "signal", "of", "and", "a", "in",
+};
+
+/* Function Definitions */
+
+/* Deterministic generator (splitmix64) */
+static unsigned long next_random(unsigned long *state)
+{
+    unsigned long z = (*state += 0x9E3779B97F4A7C15UL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9UL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBUL;
+    return z ^ (z >> 31);
+}
+
+static void put_le(unsigned char *buffer, unsigned long value, int size)
+{
+    for(int i = 0; i < size; i++)
+    {
+        buffer[i] = value >> (8 * i);
+    }
+}
+/* Function Definitions */
+
+/* Sample Value
+ * Description: Two slow gradients per channel plus a few levels of noise, so the
+ * LSB plane looks like the one of a photograph rather than pure noise
+ */
+static unsigned char sample_value(uint x, uint y, int channel, uint width, uint height, unsigned long *state)
+{
+    long value = (x * (96 + 40 * channel)) / (width ? width : 1) + (y * (128 - 30 * channel)) / (height ? height : 1) + 16 * channel;
+    value += (long) (next_random(state) % 7) - 3;
+    return value < 0 ? 0 : value > 255 ? 255 : value;
+}
+
+/* Cover Format
+ * Return Values : Format of the output name's extension, cover_unknown for any other
+ */
+static CoverKind cover_kind(const char *fname)
+{
+    const char *extn = strrchr(fname, '.');
+    for(int i = 0; extn != NULL && i < (int) (sizeof(cover_kinds) / sizeof(cover_kinds[0])); i++)
+    {
+        if(strcmp(extn, cover_kinds[i].extn) == 0)
+        {
+            return cover_kinds[i].kind;
+        }
+    }
+    return cover_unknown;
+}
+
+/* Bits Per Pixel Supported
+ * Description: BMP 8 (gray palette), 16, 24, 32; PGM 8; PPM 24; PAM and PNG 8, 16,
+ * 24, 32 (gray, gray + alpha, RGB, RGBA); TGA 8, 24, 32; Y4M 8 (mono) or 12 (4:2:0)
+ */
+static int cover_bits_supported(CoverKind kind, uint bits_per_pixel)
+{
+    switch(kind)
+    {
+        case cover_pgm:
+            return bits_per_pixel == 8;
+        case cover_ppm:
+            return bits_per_pixel == 24;
+        case cover_tga:
+            return bits_per_pixel == 8 || bits_per_pixel == 24 || bits_per_pixel == 32;
+        case cover_y4m:
+            return bits_per_pixel == 8 || bits_per_pixel == 12;
+        case cover_unknown:
+            return 0;
+        default:
+            return bits_per_pixel == 8 || bits_per_pixel == 16 || bits_per_pixel == 24 || bits_per_pixel == 32;
+    }
+}
+/* Function Definitions */
+
+/* PNG CRC32 over the chunk type and data */
+static uint png_crc(uint crc, const unsigned char *data, long size)
+{
+    crc = ~crc;
+    for(long i = 0; i < size; i++)
+    {
+        crc ^= data[i];
+        for(int bit = 0; bit < 8; bit++)
+        {
+            crc = (crc >> 1) ^ (0xEDB88320U & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+static Status png_write_chunk(FILE *fptr_image, const char *type, const unsigned char *data, long size)
+{
+    unsigned char length[4] = { size >> 24, size >> 16, size >> 8, size }, crc[4];
+    uint value = png_crc(png_crc(0, (const unsigned char *) type, 4), data, size);
+    crc[0] = value >> 24;
+    crc[1] = value >> 16;
+    crc[2] = value >> 8;
+    crc[3] = value;
+    return fwrite(length, 1, 4, fptr_image) == 4 && fwrite(type, 1, 4, fptr_image) == 4 &&
+           fwrite(data, 1, size, fptr_image) == size && fwrite(crc, 1, 4, fptr_image) == 4 ? e_success : e_failure;
+}
+
+/* Flush the Pending IDAT Data
+ * Description: One IDAT chunk per stored deflate block; the first carries the zlib
+ * header and the final one the Adler-32 of the image data
+ */
+static Status png_flush(PngStream *png, int final)
+{
+    unsigned char *chunk = png->chunk;
+    long size = 0;
+    if(png->chunks++ == 0)
+    {
+        chunk[size++] = 0x78; // Deflate, 32K window, no dictionary
+        chunk[size++] = 0x01;
+    }
+    chunk[size++] = final ? 1 : 0; // Stored block
+    put_le(chunk + size, png->used, 2);
+    put_le(chunk + size + 2, ~png->used & 0xFFFF, 2);
+    size += 4;
+    memcpy(chunk + size, png->block, png->used);
+    size += png->used;
+    for(long i = 0; i < png->used; i++)
+    {
+        png->adler_a = (png->adler_a + png->block[i]) % 65521;
+        png->adler_b = (png->adler_b + png->adler_a) % 65521;
+    }
+    if(final)
+    {
+        unsigned long adler = png->adler_b << 16 | png->adler_a;
+        chunk[size++] = adler >> 24;
+        chunk[size++] = adler >> 16;
+        chunk[size++] = adler >> 8;
+        chunk[size++] = adler;
+    }
+    png->used = 0;
+    return png_write_chunk(png->fptr_image, "IDAT", chunk, size);
+}
+
+static Status png_write(PngStream *png, const unsigned char *data, long size)
+{
+    while(size > 0)
+    {
+        long count = PNG_STORED_BLOCK_SIZE - png->used < size ? PNG_STORED_BLOCK_SIZE - png->used : size;
+        memcpy(png->block + png->used, data, count);
+        png->used += count;
+        data += count;
+        size -= count;
+        if(png->used == PNG_STORED_BLOCK_SIZE && png_flush(png, 0) == e_failure)
+        {
+            return e_failure;
+        }
+    }
+    return e_success;
+}
+/* Function Definitions */
+
+/* Write Cover Header
+ * Input: Opened output, format, dimensions, bits per pixel
+ * Output: Everything before the first pixel row
+ * Return Values : e_success and e_failure
+ */
+static Status write_cover_header(FILE *fptr_image, CoverKind kind, uint width, uint height, uint bits_per_pixel, long row_size)
+{
+    static const char *tupltypes[] = { "GRAYSCALE", "GRAYSCALE_ALPHA", "RGB", "RGB_ALPHA" };
+    uint channels = bits_per_pixel / 8;
+    if(kind == cover_bmp)
+    {
+        long palette_size = bits_per_pixel == 8 ? BMP_PALETTE_SIZE : 0;
+        unsigned char header[BMP_HEADER_SIZE] = { 'B', 'M' };
+        put_le(header + 2, BMP_HEADER_SIZE + palette_size + row_size * height, 4);
+        put_le(header + 10, BMP_HEADER_SIZE + palette_size, 4);
+        put_le(header + 14, 40, 4);
+        put_le(header + 18, width, 4);
+        put_le(header + 22, height, 4);
+        put_le(header + 26, 1, 2);
+        put_le(header + 28, bits_per_pixel, 2);
+        put_le(header + 34, row_size * height, 4);
+        put_le(header + 38, 2835, 4); // 72 dpi
+        put_le(header + 42, 2835, 4);
+        Status status = fwrite(header, 1, sizeof(header), fptr_image) == sizeof(header) ? e_success : e_failure;
+        for(int i = 0; status == e_success && i < palette_size / 4; i++) // Grayscale palette for 8 bit images
+        {
+            unsigned char entry[4] = { i, i, i, 0 };
+            status = fwrite(entry, 1, sizeof(entry), fptr_image) == sizeof(entry) ? e_success : e_failure;
+        }
+        return status;
+    }
+    if(kind == cover_tga)
+    {
+        unsigned char header[TGA_HEADER_SIZE] = { 0, 0, channels == 1 ? 3 : 2 }; // Uncompressed gray or true color
+        put_le(header + 12, width, 2);
+        put_le(header + 14, height, 2);
+        header[16] = bits_per_pixel;
+        header[17] = channels == 4 ? 8 : 0; // Alpha bits
+        return fwrite(header, 1, sizeof(header), fptr_image) == sizeof(header) ? e_success : e_failure;
+    }
+    if(kind == cover_png)
+    {
+        static const unsigned char color_types[] = { 0, 4, 2, 6 };
+        unsigned char ihdr[13] = { width >> 24, width >> 16, width >> 8, width, height >> 24, height >> 16, height >> 8, height,
+                                   8, color_types[channels - 1], 0, 0, 0 };
+        return fwrite(png_signature, 1, sizeof(png_signature), fptr_image) == sizeof(png_signature) &&
+               png_write_chunk(fptr_image, "IHDR", ihdr, sizeof(ihdr)) == e_success ? e_success : e_failure;
+    }
+    int written = kind == cover_pgm || kind == cover_ppm ? fprintf(fptr_image, "P%c\n%u %u\n255\n", kind == cover_pgm ? '5' : '6', width, height) :
+                  kind == cover_pam ? fprintf(fptr_image, "P7\nWIDTH %u\nHEIGHT %u\nDEPTH %u\nMAXVAL 255\nTUPLTYPE %s\nENDHDR\n",
+                                              width, height, channels, tupltypes[channels - 1]) :
+                  fprintf(fptr_image, "YUV4MPEG2 W%u H%u F25:1 Ip A1:1 C%s\n", width, height, bits_per_pixel == 8 ? "mono" : "420jpeg");
+    return written > 0 ? e_success : e_failure;
+}
+
+/* Write Cover
+ * Input: Output name, dimensions, bits per pixel, seed
+ * Output: Cover in the format of the name's extension: bottom up BI_RGB bmp with rows
+ * padded to 4 bytes, binary pgm/ppm, pam, uncompressed tga, 8 bit png with stored
+ * (uncompressed) deflate blocks, or y4m of Y4M_FRAMES frames
+ * Return Values : e_success and e_failure
+ */
+static Status write_cover(const char *fname, uint width, uint height, uint bits_per_pixel, unsigned long seed)
+{
+    CoverKind kind = cover_kind(fname);
+    uint channels = kind == cover_y4m ? 1 : bits_per_pixel / 8; // Y4M samples are written plane by plane
+    long row_size = kind == cover_bmp ? ((long) width * channels + 3) & ~3L : (long) width * channels;
+    FILE *fptr_image = fopen(fname, "w");
+    unsigned char *row = calloc(row_size + 1, 1);
+    PngStream *png = kind == cover_png ? calloc(1, sizeof(PngStream)) : NULL;
+    if(fptr_image == NULL || row == NULL || (kind == cover_png && png == NULL))
+    {
+        printf(RED "Error: Unable to create %s\n" RESET, fname);
+        free(row);
+        free(png);
+        if(fptr_image != NULL)
+        {
+            fclose(fptr_image);
+        }
+        return e_failure;
+    }
+    if(png != NULL)
+    {
+        png->fptr_image = fptr_image;
+        png->adler_a = 1;
+    }
+    Status status = write_cover_header(fptr_image, kind, width, height, bits_per_pixel, row_size);
+    unsigned long state = seed;
+    uint chroma_width = (width + 1) / 2, chroma_height = (height + 1) / 2;
+    for(uint frame = 0; status == e_success && frame < (kind == cover_y4m ? Y4M_FRAMES : 1); frame++)
+    {
+        if(kind == cover_y4m)
+        {
+            status = fwrite("FRAME\n", 1, 6, fptr_image) == 6 ? e_success : e_failure;
+        }
+        for(uint y = 0; status == e_success && y < height; y++)
+        {
+            for(uint x = 0; x < width; x++)
+            {
+                for(uint channel = 0; channel < channels; channel++)
+                {
+                    row[x * channels + channel] = sample_value(x, y + frame, channel, width, height, &state);
+                }
+            }
+            if(png != NULL) // Filter type None in front of every row
+            {
+                unsigned char filter = 0;
+                status = png_write(png, &filter, 1) == e_success && png_write(png, row, row_size) == e_success ? e_success : e_failure;
+            }
+            else
+            {
+                status = fwrite(row, 1, row_size, fptr_image) == row_size ? e_success : e_failure;
+            }
+        }
+        for(uint plane = 1; kind == cover_y4m && bits_per_pixel == 12 && plane <= 2; plane++) // Cb and Cr at half resolution
+        {
+            for(uint y = 0; status == e_success && y < chroma_height; y++)
+            {
+                for(uint x = 0; x < chroma_width; x++)
+                {
+                    row[x] = sample_value(x, y, plane, chroma_width, chroma_height, &state);
+                }
+                status = fwrite(row, 1, chroma_width, fptr_image) == chroma_width ? e_success : e_failure;
+            }
+        }
+    }
+    if(png != NULL && status == e_success)
+    {
+        status = png_flush(png, 1) == e_success && png_write_chunk(fptr_image, "IEND", NULL, 0) == e_success ? e_success : e_failure;
+    }
+    free(row);
+    free(png);
+    if(fclose(fptr_image) != 0 || status == e_failure)
+    {
+        printf(RED "Error Writing %s\n" RESET, fname);
+        return e_failure;
+    }
+    return e_success;
+}
+/* Function Definitions */
+
+/* Write Payload
+ * Input: Output name, size, kind (text, random or runs), seed
+ * Output: Payload file of exactly size bytes
+ * Return Values : e_success and e_failure
+ */
+static Status write_payload(const char *fname, long size, const char *kind, unsigned long seed)
+{
+    if(strcmp(kind, "text") != 0 && strcmp(kind, "random") != 0 && strcmp(kind, "runs") != 0)
+    {
+        printf(RED "Error: Unknown payload kind %s (text, random, runs)\n" RESET, kind);
+        return e_failure;
+    }
+    FILE *fptr_payload = fopen(fname, "w");
+    if(fptr_payload == NULL)
+    {
+        printf(RED "Error: Unable to create %s\n" RESET, fname);
+        return e_failure;
+    }
+    unsigned char buffer[PAYLOAD_BUF_SIZE];
+    unsigned long state = seed;
+    long run = 0, column = 0;
+    unsigned char run_value = 0;
+    Status status = e_success;
+    for(long written = 0; status == e_success && written < size;)
+    {
+        long count = size - written < PAYLOAD_BUF_SIZE ? size - written : PAYLOAD_BUF_SIZE;
+        for(long i = 0; i < count;)
+        {
+            if(kind[0] == 'r' && kind[1] == 'a')
+            {
+                buffer[i++] = next_random(&state);
+            }
+            else if(kind[0] == 'r')
+            {
+                if(run == 0)
+                {
+                    run = 16 + next_random(&state) % 240;
+                    run_value = 'a' + next_random(&state) % 4;
+                }
+                buffer[i++] = run_value;
+                run--;
+            }
+            else
+            {
+                const char *word = words[next_random(&state) % (sizeof(words) / sizeof(words[0]))];
+                for(int j = 0; word[j] != '\0' && i < count; j++, column++)
+                {
+                    buffer[i++] = word[j];
+                }
+                if(i < count)
+                {
+                    buffer[i++] = column > 70 ? '\n' : ' ';
+                    column = column > 70 ? 0 : column + 1;
+                }
+            }
+        }
+        status = fwrite(buffer, 1, count, fptr_payload) == count ? e_success : e_failure;
+        written += count;
+    }
+    if(fclose(fptr_payload) != 0 || status == e_failure)
+    {
+        printf(RED "Error Writing %s\n" RESET, fname);
+        return e_failure;
+    }
+    return e_success;
+}
+/* Function Definitions */
+
+/* Write Set
+ * Input: Output directory, seed
+ * Output: The standard covers and payloads, each with its own seed derived from seed
+ * Return Values : e_success and e_failure
+ */
+static Status write_set(const char *directory, unsigned long seed)
+{
+    char fname[4096];
+    mkdir(directory, 0777);
+    for(int i = 0; i < (int) (sizeof(set_covers) / sizeof(set_covers[0])); i++)
+    {
+        snprintf(fname, sizeof(fname), "%s/%s", directory, set_covers[i].name);
+        if(write_cover(fname, set_covers[i].width, set_covers[i].height, set_covers[i].bits_per_pixel, seed + i) == e_failure)
+        {
+            return e_failure;
+        }
+        printf(GRN "INFO: Created %s\n" RESET, fname);
+    }
+    for(int i = 0; i < (int) (sizeof(set_payloads) / sizeof(set_payloads[0])); i++)
+    {
+        snprintf(fname, sizeof(fname), "%s/%s", directory, set_payloads[i].name);
+        if(write_payload(fname, set_payloads[i].size, set_payloads[i].kind, seed + 100 + i) == e_failure)
+        {
+            return e_failure;
+        }
+        printf(GRN "INFO: Created %s\n" RESET, fname);
+    }
+    return e_success;
+}
+
+int main(int argc, char *argv[])
+{
+    if(argc >= 6 && strcmp(argv[1], "cover") == 0)
+    {
+        uint bits_per_pixel = atoi(argv[5]);
+        if(cover_kind(argv[2]) == cover_unknown)
+        {
+            printf(RED "Error: Cover must be .bmp, .pgm, .ppm, .pam, .tga, .png or .y4m\n" RESET);
+            return e_failure;
+        }
+        if(!cover_bits_supported(cover_kind(argv[2]), bits_per_pixel))
+        {
+            printf(RED "Error: %u bits per pixel is not supported for %s\n" RESET, bits_per_pixel, argv[2]);
+            return e_failure;
+        }
+        return write_cover(argv[2], strtoul(argv[3], NULL, 10), strtoul(argv[4], NULL, 10), bits_per_pixel,
+                           argc > 6 ? strtoul(argv[6], NULL, 10) : DEFAULT_SEED);
+    }
+    if(argc >= 5 && strcmp(argv[1], "payload") == 0)
+    {
+        return write_payload(argv[2], strtol(argv[3], NULL, 10), argv[4], argc > 5 ? strtoul(argv[5], NULL, 10) : DEFAULT_SEED);
+    }
+    if(argc >= 3 && strcmp(argv[1], "set") == 0)
+    {
+        return write_set(argv[2], argc > 3 ? strtoul(argv[3], NULL, 10) : DEFAULT_SEED);
+    }
+    printf(RED "Usage: %s cover <output .bmp|.pgm|.ppm|.pam|.tga|.png|.y4m> <width> <height> <bits per pixel> [seed]\n"
+           "       %s payload <output file> <size> <text|random|runs> [seed]\n"
+           "       %s set <directory> [seed]\n" RESET, argv[0], argv[0], argv[0]);
+    return e_failure;
+}
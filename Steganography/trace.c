@@ -0,0 +1,263 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/syscall.h>
+#include "trace.h"
+#include "types.h"
+#include "color.h"
+
+typedef struct _TraceEvent
+{
+    char phase; /*Store B (begin), E (end), X (complete span) or W (wait)*/
+    const char *category; /*Store the category, NULL for the end of a span*/
+    const char *name; /*Store the span name*/
+    long time; /*Store the start, nanoseconds since tracing started*/
+    long duration; /*Store the length of complete spans and waits*/
+    const char *arg_name; /*Store the name of the number shown with the span, NULL for none*/
+    long arg; /*Store the number shown with the span*/
+} TraceEvent;
+
+typedef struct _TraceBlock
+{
+    TraceEvent events[TRACE_BUFFER_EVENTS]; /*Store the events in the order they were recorded*/
+    int count; /*Store the number of events used*/
+    struct _TraceBlock *next; /*Store the block recorded after this one*/
+} TraceBlock;
+
+typedef struct _TraceThread
+{
+    long tid; /*Store the kernel thread id*/
+    const char *name; /*Store the name shown for the thread, NULL for the default*/
+    TraceBlock *first, *last; /*Store the blocks of the thread, written by the thread only*/
+    struct _TraceThread *next; /*Store the thread which started recording before this one*/
+} TraceThread;
+
+int trace_enabled;
+static const char *trace_fname; /* File the trace is written to at exit */
+static struct timespec trace_epoch; /* Time tracing started */
+static TraceThread *trace_threads; /* Every thread which recorded, newest first */
+static __thread TraceThread *trace_self; /* Buffer of the calling thread, NULL until it records */
+
+/* Function Definitions */
+
+long trace_now(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - trace_epoch.tv_sec) * 1000000000L + (now.tv_nsec - trace_epoch.tv_nsec);
+}
+
+/* Buffer of the Calling Thread
+ * Description: The first call of a thread allocates its buffer and pushes it on
+ * the thread list with a compare and swap
+ * Return Values : The buffer, NULL when out of memory
+ */
+static TraceThread *trace_thread(void)
+{
+    TraceThread *self = trace_self;
+    if(self == NULL)
+    {
+        self = calloc(1, sizeof(TraceThread));
+        if(self == NULL)
+        {
+            return NULL;
+        }
+        self->tid = syscall(SYS_gettid);
+        self->next = __atomic_load_n(&trace_threads, __ATOMIC_RELAXED);
+        while(!__atomic_compare_exchange_n(&trace_threads, &self->next, self, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+        {
+            ;
+        }
+        trace_self = self;
+    }
+    return self;
+}
+
+/* Next Event of the Calling Thread
+ * Description: A full block is followed by a new one
+ * Return Values : The event to fill in, NULL when out of memory
+ */
+static TraceEvent *trace_next_event(void)
+{
+    TraceThread *self = trace_thread();
+    if(self == NULL)
+    {
+        return NULL;
+    }
+    if(self->last == NULL || self->last->count == TRACE_BUFFER_EVENTS)
+    {
+        TraceBlock *block = malloc(sizeof(TraceBlock));
+        if(block == NULL)
+        {
+            return NULL;
+        }
+        block->count = 0;
+        block->next = NULL;
+        if(self->last == NULL)
+        {
+            self->first = block;
+        }
+        else
+        {
+            self->last->next = block;
+        }
+        self->last = block;
+    }
+    return &self->last->events[self->last->count++];
+}
+
+static void trace_record(char phase, const char *category, const char *name, long time, long duration, const char *arg_name, long arg)
+{
+    TraceEvent *event = trace_next_event();
+    if(event != NULL)
+    {
+        event->phase = phase;
+        event->category = category;
+        event->name = name;
+        event->time = time;
+        event->duration = duration;
+        event->arg_name = arg_name;
+        event->arg = arg;
+    }
+}
+/* Function Definitions */
+
+void trace_begin(const char *category, const char *name, const char *arg_name, long arg)
+{
+    trace_record('B', category, name, trace_now(), 0, arg_name, arg);
+}
+
+void trace_end(void)
+{
+    trace_record('E', NULL, NULL, trace_now(), 0, NULL, 0);
+}
+
+void trace_span(const char *category, const char *name, long start)
+{
+    trace_record('X', category, name, start, trace_now() - start, NULL, 0);
+}
+
+void trace_wait(const char *category, const char *name, long start)
+{
+    trace_record('W', category, name, start, trace_now() - start, NULL, 0);
+}
+
+void trace_thread_name(const char *name)
+{
+    TraceThread *self = trace_enabled ? trace_thread() : NULL;
+    if(self != NULL)
+    {
+        self->name = name;
+    }
+}
+/* Function Definitions */
+
+Status trace_start(const char *fname)
+{
+    trace_fname = fname;
+    clock_gettime(CLOCK_MONOTONIC, &trace_epoch);
+    if(atexit(trace_write) != 0)
+    {
+        printf(RED "Error: Unable to trace to %s\n" RESET, fname);
+        return e_failure;
+    }
+    trace_enabled = 1;
+    trace_thread_name("main");
+    return e_success;
+}
+
+/* Take the Trace Option
+ * Input: Options separated from the positional arguments
+ * Output: --trace FILE removed from options, tracing started when it was given
+ * Return Values : e_success and e_failure
+ */
+Status trace_apply_options(char *options[])
+{
+    const char *fname = NULL;
+    int kept = 0;
+    for(int i = 0; options[i] != NULL; i++)
+    {
+        if(strcmp(options[i], "--trace") == 0 && options[i + 1] != NULL)
+        {
+            fname = options[++i];
+        }
+        else
+        {
+            options[kept++] = options[i]; // Left for the operation's own option parser
+        }
+    }
+    options[kept] = NULL;
+    return fname != NULL ? trace_start(fname) : e_success;
+}
+/* Function Definitions */
+
+/* Write the Trace
+ * Output: Chrome trace event JSON: a thread name record per thread, B and E
+ * events for nested spans, X events for spans recorded whole and a b/e pair
+ * with an id of its own per wait, which puts waits on separate tracks.
+ * Times are in microseconds
+ * Description: Runs at exit, when the worker pools are gone and no thread records
+ */
+void trace_write(void)
+{
+    if(!trace_enabled)
+    {
+        return;
+    }
+    trace_enabled = 0;
+    FILE *fptr = fopen(trace_fname, "w");
+    if(fptr == NULL)
+    {
+        printf(RED "Error: Unable to open file %s\n" RESET, trace_fname);
+        return;
+    }
+    int pid = getpid(), first = 1;
+    long wait_id = 0;
+    fprintf(fptr, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    for(TraceThread *thread = __atomic_load_n(&trace_threads, __ATOMIC_ACQUIRE); thread != NULL; thread = thread->next)
+    {
+        fprintf(fptr, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%d,\"tid\":%ld,\"args\":{\"name\":\"%s %ld\"}}",
+                first ? "" : ",\n", pid, thread->tid, thread->name != NULL ? thread->name : "thread", thread->tid);
+        first = 0;
+        for(TraceBlock *block = thread->first; block != NULL; block = block->next)
+        {
+            for(int i = 0; i < block->count; i++)
+            {
+                TraceEvent *event = &block->events[i];
+                switch(event->phase)
+                {
+                    case 'E':
+                        fprintf(fptr, ",\n{\"ph\":\"E\",\"pid\":%d,\"tid\":%ld,\"ts\":%.3f}", pid, thread->tid, event->time / 1e3);
+                        break;
+                    case 'W':
+                        wait_id++;
+                        fprintf(fptr, ",\n{\"ph\":\"b\",\"cat\":\"%s\",\"name\":\"%s\",\"id\":%ld,\"pid\":%d,\"tid\":%ld,\"ts\":%.3f}",
+                                event->category, event->name, wait_id, pid, thread->tid, event->time / 1e3);
+                        fprintf(fptr, ",\n{\"ph\":\"e\",\"cat\":\"%s\",\"name\":\"%s\",\"id\":%ld,\"pid\":%d,\"tid\":%ld,\"ts\":%.3f}",
+                                event->category, event->name, wait_id, pid, thread->tid, (event->time + event->duration) / 1e3);
+                        break;
+                    default:
+                        fprintf(fptr, ",\n{\"ph\":\"%c\",\"cat\":\"%s\",\"name\":\"%s\",\"pid\":%d,\"tid\":%ld,\"ts\":%.3f",
+                                event->phase, event->category, event->name, pid, thread->tid, event->time / 1e3);
+                        if(event->phase == 'X')
+                        {
+                            fprintf(fptr, ",\"dur\":%.3f", event->duration / 1e3);
+                        }
+                        if(event->arg_name != NULL)
+                        {
+                            fprintf(fptr, ",\"args\":{\"%s\":%ld}", event->arg_name, event->arg);
+                        }
+                        fputc('}', fptr);
+                        break;
+                }
+            }
+        }
+    }
+    fprintf(fptr, "\n]}\n");
+    if(fclose(fptr) != 0)
+    {
+        printf(RED "Error: Unable to write %s\n" RESET, trace_fname);
+    }
+}
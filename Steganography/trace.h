@@ -0,0 +1,59 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "types.h"
+
+/*
+ * Span tracing (--trace FILE). Every stage of do_encoding and do_decoding,
+ * every chunk read and write, sync and journal checkpoint, and every pool
+ * job with the time it sat in the queue and the time spent waiting for the
+ * pool lock is recorded with the thread it ran on. Each thread appends to its
+ * own buffer, so recording takes no lock; buffers are joined into a list with
+ * a compare and swap the first time a thread records. At exit the buffers are
+ * written as Chrome trace event JSON, which Perfetto and chrome://tracing open.
+ * Names and categories must be string literals. Disabled, a span costs one
+ * load and branch
+ */
+
+#define TRACE_BUFFER_EVENTS 4096 /* Events per buffer block of a thread */
+
+/* Nonzero while tracing */
+extern int trace_enabled;
+
+/* Open a span of category on the calling thread */
+#define TRACE_BEGIN(category, name) (trace_enabled ? trace_begin((category), (name), NULL, 0) : (void) 0)
+
+/* Same, recording a byte count with the span */
+#define TRACE_BEGIN_BYTES(category, name, bytes) (trace_enabled ? trace_begin((category), (name), "bytes", (bytes)) : (void) 0)
+
+/* Close the innermost open span of the calling thread */
+#define TRACE_END() (trace_enabled ? trace_end() : (void) 0)
+
+/* Take --trace FILE out of options and start tracing when given */
+Status trace_apply_options(char *options[]);
+
+/* Start tracing, the trace is written to fname at exit */
+Status trace_start(const char *fname);
+
+/* Nanoseconds since tracing started */
+long trace_now(void);
+
+/* Open a span with a named number shown with it (arg_name NULL for none) */
+void trace_begin(const char *category, const char *name, const char *arg_name, long arg);
+
+/* Close the innermost open span */
+void trace_end(void);
+
+/* Record a span of the calling thread that started at start (from trace_now) and ends now */
+void trace_span(const char *category, const char *name, long start);
+
+/* Record a wait from start until now on a track of its own, like a job sitting in a queue */
+void trace_wait(const char *category, const char *name, long start);
+
+/* Name the calling thread in the trace */
+void trace_thread_name(const char *name);
+
+/* Write the trace file; registered with atexit by trace_start */
+void trace_write(void);
+
+#endif
@@ -0,0 +1,519 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "tune.h"
+#include "encode.h"
+#include "decode.h"
+#include "checksum.h"
+#include "bufpool.h"
+#include "flate.h"
+#include "pool.h"
+#include "output.h"
+#include "types.h"
+#include "common.h"
+#include "color.h"
+
+#define TUNE_CACHE_NAME "lsb_steg.tune"
+#define TUNE_ROUNDS 3 /* Best of this many runs per candidate */
+#define TUNE_KERNEL_BYTES (256 * 1024) /* Payload bytes per kernel run */
+#define TUNE_CHUNK_BYTES (2 * 1024 * 1024) /* Payload bytes per chunk size run */
+#define TUNE_DEFLATE_BYTES (256 * 1024) /* Bytes per deflate job */
+#define TUNE_IO_BYTES (32 * 1024 * 1024) /* Bytes written per I/O run */
+
+TuneConfig tune_config = { TUNE_DEFAULT_CHUNK, 0, tune_kernel_auto, 0 };
+
+static const char *tune_kernel_names[tune_kernel_count] = { "auto", "generic", "sse42" };
+
+/* Function Definitions */
+
+static double tune_now(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/* Cache File Name
+ * Output: $XDG_CACHE_HOME/lsb_steg.tune or $HOME/.cache/lsb_steg.tune, empty when neither is set
+ * Description: Creates $HOME/.cache when it is missing and create is set
+ */
+static void tune_cache_path(char *path, size_t size, int create)
+{
+    const char *dir = getenv("XDG_CACHE_HOME"), *home = getenv("HOME");
+    path[0] = '\0';
+    if(dir != NULL && dir[0] != '\0')
+    {
+        snprintf(path, size, "%s/%s", dir, TUNE_CACHE_NAME);
+    }
+    else if(home != NULL && home[0] != '\0')
+    {
+        snprintf(path, size, "%s/.cache", home);
+        if(create)
+        {
+            mkdir(path, 0700);
+        }
+        snprintf(path, size, "%s/.cache/%s", home, TUNE_CACHE_NAME);
+    }
+}
+
+static int tune_kernel_by_name(const char *name)
+{
+    for(int i = 0; i < tune_kernel_count; i++)
+    {
+        if(strcmp(name, tune_kernel_names[i]) == 0)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int tune_use_sse42(void)
+{
+    return tune_config.kernel != tune_kernel_generic && crc32c_hw_available();
+}
+/* Function Definitions */
+
+/* Load Cache
+ * Description: "name value" lines; unknown names and out of range values are
+ * skipped, so older and newer caches still load
+ * Return Values : e_success, also when there is no cache
+ */
+Status tune_load(void)
+{
+    char path[4096], name[32], value[32];
+    tune_cache_path(path, sizeof(path), 0);
+    FILE *fptr = path[0] != '\0' ? fopen(path, "r") : NULL;
+    if(fptr == NULL)
+    {
+        return e_success;
+    }
+    TuneConfig config = tune_config;
+    long cpus = -1;
+    while(fscanf(fptr, "%31s %31s", name, value) == 2)
+    {
+        long number = atol(value);
+        if(strcmp(name, "cpus") == 0)
+        {
+            cpus = number;
+        }
+        else if(strcmp(name, "chunk") == 0 && number >= TUNE_MIN_CHUNK && number <= TUNE_MAX_CHUNK)
+        {
+            config.chunk_size = number;
+        }
+        else if(strcmp(name, "threads") == 0 && number >= 0)
+        {
+            config.thread_count = number;
+        }
+        else if(strcmp(name, "kernel") == 0 && tune_kernel_by_name(value) >= 0)
+        {
+            config.kernel = tune_kernel_by_name(value);
+        }
+        else if(strcmp(name, "io") == 0)
+        {
+            config.direct = strcmp(value, "direct") == 0;
+        }
+    }
+    fclose(fptr);
+    if(cpus == sysconf(_SC_NPROCESSORS_ONLN)) // Tuned on another machine otherwise
+    {
+        tune_config = config;
+    }
+    return e_success;
+}
+
+/* Save Cache
+ * Description: Written to a temporary name and renamed, so a concurrent run
+ * never loads half a file
+ * Return Values : e_success and e_failure
+ */
+Status tune_save(void)
+{
+    char path[4096], temp[4200];
+    tune_cache_path(path, sizeof(path), 1);
+    if(path[0] == '\0')
+    {
+        printf(RED "Error: Set HOME or XDG_CACHE_HOME to keep the tuning\n" RESET);
+        return e_failure;
+    }
+    snprintf(temp, sizeof(temp), "%s.%d", path, (int) getpid());
+    FILE *fptr = fopen(temp, "w");
+    if(fptr == NULL)
+    {
+        printf(RED "Error: Unable to write %s\n" RESET, path);
+        return e_failure;
+    }
+    fprintf(fptr, "cpus %ld\nchunk %d\nthreads %d\nkernel %s\nio %s\n", sysconf(_SC_NPROCESSORS_ONLN),
+            tune_config.chunk_size, tune_config.thread_count, tune_kernel_names[tune_config.kernel],
+            tune_config.direct ? "direct" : "buffered");
+    if(fclose(fptr) != 0 || rename(temp, path) != 0)
+    {
+        printf(RED "Error: Unable to write %s\n" RESET, path);
+        unlink(temp);
+        return e_failure;
+    }
+    info_printf(YEL "INFO: Saved tuning to %s\n" RESET, path);
+    return e_success;
+}
+/* Function Definitions */
+
+/* Time the Kernels
+ * Description: Encode and decode with a checksum, the path where the variants differ
+ * Return Values : Seconds of the best round
+ */
+static double tune_time_kernels(char *payload, char *image, char *decoded)
+{
+    double best = 1e9;
+    for(int round = 0; round < TUNE_ROUNDS; round++)
+    {
+        uint crc = 0;
+        double start = tune_now();
+        for(int i = 0; i < TUNE_KERNEL_BYTES; i += TUNE_MAX_CHUNK)
+        {
+            encode_chunk_to_lsb(payload + i, TUNE_MAX_CHUNK, image + (long) i * MAX_IMAGE_BUF_SIZE, &crc, NULL);
+            decode_chunk_from_lsb(decoded + i, TUNE_MAX_CHUNK, image + (long) i * MAX_IMAGE_BUF_SIZE, &crc, NULL);
+        }
+        double elapsed = tune_now() - start;
+        best = elapsed < best ? elapsed : best;
+    }
+    return best;
+}
+
+/* Time a Chunk Size
+ * Description: Encode a payload from a cover file to /dev/null and decode it back,
+ * through the same stdio loops as a real run
+ * Return Values : Seconds of the best round, a negative value on I/O errors
+ */
+static double tune_time_chunk(char *payload, FILE *fptr_cover, FILE *fptr_null)
+{
+    double best = 1e9;
+    for(int round = 0; round < TUNE_ROUNDS; round++)
+    {
+        uint crc = 0;
+        double start = tune_now();
+        rewind(fptr_cover);
+        if(encode_payload_to_image(payload, TUNE_CHUNK_BYTES, fptr_cover, fptr_null, &crc, NULL, 0) == e_failure)
+        {
+            return -1;
+        }
+        rewind(fptr_cover);
+        if(decode_payload_from_image(payload, TUNE_CHUNK_BYTES, fptr_cover, &crc, NULL) == e_failure)
+        {
+            return -1;
+        }
+        double elapsed = tune_now() - start;
+        best = elapsed < best ? elapsed : best;
+    }
+    return best;
+}
+
+typedef struct _TuneDeflateJob
+{
+    const unsigned char *input; /*Store the bytes to compress*/
+    unsigned char *output; /*Store the compressed bytes*/
+    long capacity; /*Store the size of output*/
+} TuneDeflateJob;
+
+static Status tune_deflate_job(void *arg)
+{
+    TuneDeflateJob *job = arg;
+    return deflate_chunk(job->input, 0, TUNE_DEFLATE_BYTES, &job->output, &job->capacity) < 0 ? e_failure : e_success;
+}
+
+/* Time a Worker Count
+ * Description: Deflate two jobs per CPU of pixel like data, as a PNG output does
+ * Return Values : Seconds of the best round, a negative value on failure
+ */
+static double tune_time_threads(int thread_count, const unsigned char *input, int job_count)
+{
+    TuneDeflateJob *jobs = calloc(job_count, sizeof(TuneDeflateJob));
+    WorkerPool *pool = pool_create(thread_count);
+    double best = jobs != NULL && pool != NULL ? 1e9 : -1;
+    for(int round = 0; best > 0 && round < TUNE_ROUNDS; round++)
+    {
+        double start = tune_now();
+        Status status = e_success;
+        for(int i = 0; status == e_success && i < job_count; i++)
+        {
+            jobs[i].input = input + (long) i * TUNE_DEFLATE_BYTES;
+            status = pool_submit_node(pool, pool_job_node(pool, i), tune_deflate_job, &jobs[i]);
+        }
+        if(pool_wait(pool) == e_failure || status == e_failure) // Jobs already submitted are waited for either way
+        {
+            best = -1;
+        }
+        double elapsed = tune_now() - start;
+        best = best > 0 && elapsed < best ? elapsed : best;
+        for(int i = 0; i < job_count; i++) // Every round compresses into fresh buffers
+        {
+            buf_free(jobs[i].output, jobs[i].capacity);
+            jobs[i].output = NULL;
+            jobs[i].capacity = 0;
+        }
+    }
+    if(pool != NULL)
+    {
+        pool_destroy(pool);
+    }
+    free(jobs);
+    return best;
+}
+
+/* Time an Output Backend
+ * Description: Write and sync a scratch output in the current directory, where
+ * outputs usually go, through the real output writer; it is removed again
+ * Return Values : Seconds of the best round, a negative value when the directory is not writable
+ */
+static double tune_time_io(int direct, const char *block, long block_size)
+{
+    OutputPolicy policy;
+    output_policy_init(&policy);
+    double best = 1e9;
+    for(int round = 0; round < TUNE_ROUNDS; round++)
+    {
+        OutputFile *output = NULL;
+        double start = tune_now();
+        FILE *fptr = output_open(TUNE_CACHE_NAME, TUNE_IO_BYTES, direct, &policy, &output);
+        Status status = fptr != NULL ? e_success : e_failure;
+        for(long done = 0; status == e_success && done < TUNE_IO_BYTES; done += block_size)
+        {
+            status = fwrite(block, 1, block_size, fptr) == (size_t) block_size ? e_success : e_failure;
+        }
+        if(status == e_success)
+        {
+            status = output_sync(fptr, output);
+        }
+        if(fptr != NULL)
+        {
+            fclose(fptr);
+        }
+        if(output != NULL)
+        {
+            output_abort(output);
+        }
+        if(status == e_failure)
+        {
+            return -1;
+        }
+        double elapsed = tune_now() - start;
+        best = elapsed < best ? elapsed : best;
+    }
+    return best;
+}
+/* Function Definitions */
+
+/* Tune This Machine
+ * Description: Each setting is timed on its own with the others at their current
+ * values. Among worker counts the smallest within 5% of the fastest wins, more
+ * threads than that only cost memory
+ * Return Values : e_success and e_failure
+ */
+Status tune_run(void)
+{
+    info_printf(YEL "INFO: Tuning, this takes a few seconds\n" RESET);
+    long image_size = (long) TUNE_CHUNK_BYTES * MAX_IMAGE_BUF_SIZE;
+    char *payload = buf_alloc(TUNE_CHUNK_BYTES), *decoded = buf_alloc(TUNE_CHUNK_BYTES), *image = buf_alloc(image_size);
+    FILE *fptr_cover = tmpfile(), *fptr_null = fopen("/dev/null", "w");
+    Status status = e_success;
+    if(payload == NULL || decoded == NULL || image == NULL || fptr_cover == NULL || fptr_null == NULL)
+    {
+        printf(RED "Error: Unable to set up the tuning runs\n" RESET);
+        status = e_failure;
+    }
+    else
+    {
+        srand(1);
+        for(long i = 0; i < image_size; i++)
+        {
+            image[i] = (char) (i / 3 + (rand() & 7)); // Smooth ramps with noise, like photos
+        }
+        memcpy(payload, image, TUNE_CHUNK_BYTES);
+        status = fwrite(image, 1, image_size, fptr_cover) == (size_t) image_size ? e_success : e_failure;
+    }
+
+    /* LSB kernel */
+    double best = 1e9;
+    int best_kernel = tune_kernel_auto;
+    for(int kernel = tune_kernel_generic; status == e_success && kernel < tune_kernel_count; kernel++)
+    {
+        tune_config.kernel = kernel;
+        if(kernel == tune_kernel_sse42 && !tune_use_sse42())
+        {
+            continue;
+        }
+        double seconds = tune_time_kernels(payload, image, decoded);
+        info_printf(YEL "INFO: kernel %-8s %7.1f MB/s\n" RESET, tune_kernel_names[kernel], 2 * TUNE_KERNEL_BYTES / seconds / 1e6);
+        if(seconds < best)
+        {
+            best = seconds;
+            best_kernel = kernel;
+        }
+    }
+    tune_config.kernel = best_kernel;
+
+    /* Chunk size */
+    best = 1e9;
+    int best_chunk = tune_config.chunk_size;
+    for(int chunk = TUNE_MIN_CHUNK; status == e_success && chunk <= TUNE_MAX_CHUNK; chunk *= 2)
+    {
+        tune_config.chunk_size = chunk;
+        double seconds = tune_time_chunk(payload, fptr_cover, fptr_null);
+        if(seconds < 0)
+        {
+            status = e_failure;
+            break;
+        }
+        info_printf(YEL "INFO: chunk %6d %7.1f MB/s\n" RESET, chunk, 2 * TUNE_CHUNK_BYTES / seconds / 1e6);
+        if(seconds < best)
+        {
+            best = seconds;
+            best_chunk = chunk;
+        }
+    }
+    tune_config.chunk_size = best_chunk;
+
+    /* Deflate workers */
+    int cpus = sysconf(_SC_NPROCESSORS_ONLN) > 0 ? sysconf(_SC_NPROCESSORS_ONLN) : 1;
+    int job_count = 2 * cpus, best_threads = cpus;
+    unsigned char *input = buf_alloc((long) job_count * TUNE_DEFLATE_BYTES);
+    double times[64];
+    int counts[64], candidates = 0;
+    for(long i = 0; status == e_success && input != NULL && i < (long) job_count * TUNE_DEFLATE_BYTES; i++)
+    {
+        input[i] = image[i % image_size];
+    }
+    for(int threads = 1; input != NULL && status == e_success && candidates < 64; threads = threads * 2 < cpus ? threads * 2 : cpus) // 1, 2, 4, ... and every CPU
+    {
+        counts[candidates] = threads;
+        times[candidates] = tune_time_threads(threads, input, job_count);
+        if(times[candidates] < 0)
+        {
+            status = e_failure;
+            break;
+        }
+        info_printf(YEL "INFO: threads %4d %7.1f MB/s\n" RESET, threads, job_count * (double) TUNE_DEFLATE_BYTES / times[candidates] / 1e6);
+        best = candidates == 0 || times[candidates] < best ? times[candidates] : best;
+        candidates++;
+        if(threads >= cpus)
+        {
+            break;
+        }
+    }
+    for(int i = candidates - 1; i >= 0; i--) // Smallest count close to the best
+    {
+        if(times[i] <= best * 1.05)
+        {
+            best_threads = counts[i];
+        }
+    }
+    tune_config.thread_count = best_threads == cpus ? 0 : best_threads;
+    buf_free(input, (long) job_count * TUNE_DEFLATE_BYTES);
+
+    /* Output backend */
+    double buffered = status == e_success ? tune_time_io(0, image, OUTPUT_DIRECT_WINDOW) : -1;
+    double direct = buffered > 0 ? tune_time_io(1, image, OUTPUT_DIRECT_WINDOW) : -1;
+    if(buffered > 0 && direct > 0)
+    {
+        info_printf(YEL "INFO: io buffered %7.1f MB/s, direct %7.1f MB/s\n" RESET,
+                    TUNE_IO_BYTES / buffered / 1e6, TUNE_IO_BYTES / direct / 1e6);
+        tune_config.direct = direct < buffered;
+    }
+    else if(status == e_success)
+    {
+        info_printf(YEL "INFO: Current directory is not writable, io left as %s\n" RESET, tune_config.direct ? "direct" : "buffered");
+    }
+
+    if(fptr_cover != NULL)
+    {
+        fclose(fptr_cover);
+    }
+    if(fptr_null != NULL)
+    {
+        fclose(fptr_null);
+    }
+    buf_free(payload, TUNE_CHUNK_BYTES);
+    buf_free(decoded, TUNE_CHUNK_BYTES);
+    buf_free(image, image_size);
+    if(status == e_failure)
+    {
+        printf(RED "Error: Tuning run failed\n" RESET);
+        return e_failure;
+    }
+    printf(GRN "INFO: chunk %d, threads %d, kernel %s, io %s\n" RESET, tune_config.chunk_size, tune_config.thread_count,
+           tune_kernel_names[tune_config.kernel], tune_config.direct ? "direct" : "buffered");
+    return tune_save();
+}
+/* Function Definitions */
+
+/* Apply Tuning Options
+ * Input: Options of the command line
+ * Output: Cached configuration loaded, --tune run, overrides applied and all of
+ * them removed from options; *tuned set when --tune ran
+ * Description: Overrides apply to this run only, they are not saved
+ * Return Values : e_success and e_failure
+ */
+Status tune_apply_options(char *options[], int *tuned)
+{
+    int chunk_size = 0, kernel = -1, direct = -1, kept = 0;
+    *tuned = 0;
+    for(int i = 0; options[i] != NULL; i++)
+    {
+        if(strcmp(options[i], "--tune") == 0)
+        {
+            *tuned = 1;
+        }
+        else if(strcmp(options[i], "--chunk") == 0 && options[i + 1] != NULL)
+        {
+            chunk_size = atoi(options[++i]);
+            if(chunk_size < TUNE_MIN_CHUNK || chunk_size > TUNE_MAX_CHUNK)
+            {
+                printf(RED "Invalid Chunk Size %s, expected %d to %d bytes\n" RESET, options[i], TUNE_MIN_CHUNK, TUNE_MAX_CHUNK);
+                return e_failure;
+            }
+        }
+        else if(strcmp(options[i], "--kernel") == 0 && options[i + 1] != NULL)
+        {
+            kernel = tune_kernel_by_name(options[++i]);
+            if(kernel < 0)
+            {
+                printf(RED "Invalid Kernel %s, expected auto, generic or sse42\n" RESET, options[i]);
+                return e_failure;
+            }
+        }
+        else if(strcmp(options[i], "--io") == 0 && options[i + 1] != NULL)
+        {
+            i++;
+            if(strcmp(options[i], "buffered") != 0 && strcmp(options[i], "direct") != 0)
+            {
+                printf(RED "Invalid I/O Backend %s, expected buffered or direct\n" RESET, options[i]);
+                return e_failure;
+            }
+            direct = strcmp(options[i], "direct") == 0;
+        }
+        else
+        {
+            options[kept++] = options[i]; // Left for the operation's own option parser
+        }
+    }
+    options[kept] = NULL;
+    if(tune_load() == e_failure || (*tuned && tune_run() == e_failure))
+    {
+        return e_failure;
+    }
+    if(chunk_size > 0)
+    {
+        tune_config.chunk_size = chunk_size;
+    }
+    if(kernel >= 0)
+    {
+        tune_config.kernel = kernel;
+    }
+    if(direct >= 0)
+    {
+        tune_config.direct = direct;
+    }
+    return e_success;
+}
@@ -0,0 +1,53 @@
+#ifndef TUNE_H
+#define TUNE_H
+
+#include "types.h"
+
+/*
+ * Machine tuning (--tune). Short calibration runs time the LSB kernels, the
+ * chunk size of the encode/decode I/O loops, the deflate worker count and
+ * buffered against O_DIRECT writes, and the winners are saved to
+ * $XDG_CACHE_HOME/lsb_steg.tune (~/.cache/lsb_steg.tune). Every run loads the
+ * file at startup; --chunk BYTES, --kernel NAME and --io NAME override it.
+ * A cache written on a machine with a different CPU count is ignored
+ */
+
+#define TUNE_MIN_CHUNK 1024 /* Smallest payload chunk, in bytes */
+#define TUNE_MAX_CHUNK 65536 /* Largest payload chunk, MAX_SECRET_CHUNK_SIZE */
+#define TUNE_DEFAULT_CHUNK 4096 /* Payload chunk of an untuned machine */
+
+typedef enum
+{
+    tune_kernel_auto, /*Fastest the CPU supports*/
+    tune_kernel_generic, /*Byte at a time, any CPU*/
+    tune_kernel_sse42, /*Eight bytes at a time with the crc32 instruction*/
+    tune_kernel_count
+} TuneKernel;
+
+typedef struct _TuneConfig
+{
+    int chunk_size; /*Store the payload bytes per read, kernel call and write*/
+    int thread_count; /*Store the default number of workers, 0 for one per CPU*/
+    TuneKernel kernel; /*Store the LSB kernel variant*/
+    int direct; /*Write outputs through O_DIRECT unless told otherwise*/
+} TuneConfig;
+
+/* Configuration in effect, defaults until tune_apply_options runs */
+extern TuneConfig tune_config;
+
+/* Load the cache, take --tune, --chunk, --kernel and --io out of options and run --tune when given */
+Status tune_apply_options(char *options[], int *tuned);
+
+/* Load the cached configuration, defaults when there is none */
+Status tune_load(void);
+
+/* Calibrate this machine and save the result */
+Status tune_run(void);
+
+/* Write tune_config to the cache */
+Status tune_save(void);
+
+/* Nonzero when the SSE4.2 kernels may run */
+int tune_use_sse42(void);
+
+#endif
@@ -15,6 +15,14 @@ typedef enum
 {
     e_encode,
     e_decode,
+    e_archive,
+    e_list,
+    e_extract,
+    e_split,
+    e_join,
+    e_analyze,
+    e_watch,
+    e_batch,
     e_unsupported
 } OperationType;
 
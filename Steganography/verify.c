@@ -0,0 +1,142 @@
+#define _GNU_SOURCE /* fopencookie */
+#include <stdio.h>
+#include <stdlib.h>
+#include "verify.h"
+#include "checksum.h"
+#include "types.h"
+
+#define VERIFY_MASK_BUF_SIZE 4096
+
+/* Image stream tapped by a track */
+typedef struct _VerifyStream
+{
+    FILE *fptr_image; /*Store the image the reads and writes go to*/
+    long position; /*Store the stream position*/
+    VerifyTrack *track; /*Store the track hashing the bytes*/
+} VerifyStream;
+
+/* Function Definitions */
+
+void verify_track_init(VerifyTrack *track, const CoverInfo *cover, long end)
+{
+    track->cover = cover;
+    track->crc = 0;
+    track->next = 0;
+    track->end = end;
+}
+
+/* Hash Bytes
+ * Input: Track, bytes read or written at a file offset
+ * Description: Only the next bytes in file order are hashed, so reading the
+ * header again or rewriting a field adds nothing. Pixel bytes are hashed without
+ * their LSB, which is checked against the payload by the kernels
+ */
+static void verify_track(VerifyTrack *track, long position, const char *data, long size)
+{
+    char masked[VERIFY_MASK_BUF_SIZE];
+    long region_start = track->cover->data_offset, region_end = region_start + track->cover->data_size;
+    long end = position + size < track->end ? position + size : track->end;
+    while(track->next >= position && track->next < end)
+    {
+        const char *bytes = data + (track->next - position);
+        long stop;
+        if(track->next >= region_start && track->next < region_end)
+        {
+            stop = region_end < end ? region_end : end;
+            stop = stop - track->next < VERIFY_MASK_BUF_SIZE ? stop : track->next + VERIFY_MASK_BUF_SIZE;
+            for(long i = 0; i < stop - track->next; i++)
+            {
+                masked[i] = bytes[i] & ~1;
+            }
+            bytes = masked;
+        }
+        else
+        {
+            stop = region_start > track->next && region_start < end ? region_start : end;
+        }
+        track->crc = crc32c_update(track->crc, bytes, stop - track->next);
+        track->next = stop;
+    }
+}
+/* Function Definitions */
+
+static ssize_t verify_read(void *cookie, char *buffer, size_t size)
+{
+    VerifyStream *stream = cookie;
+    size_t count = fread(buffer, sizeof(char), size, stream->fptr_image);
+    if(count == 0 && ferror(stream->fptr_image))
+    {
+        return -1;
+    }
+    verify_track(stream->track, stream->position, buffer, count);
+    stream->position += count;
+    return count;
+}
+
+static ssize_t verify_write(void *cookie, const char *buffer, size_t size)
+{
+    VerifyStream *stream = cookie;
+    size_t count = fwrite(buffer, sizeof(char), size, stream->fptr_image);
+    verify_track(stream->track, stream->position, buffer, count);
+    stream->position += count;
+    return count > 0 ? (ssize_t) count : -1;
+}
+
+static int verify_seek(void *cookie, off64_t *offset, int whence)
+{
+    VerifyStream *stream = cookie;
+    if(fseek(stream->fptr_image, *offset, whence) != 0)
+    {
+        return -1;
+    }
+    stream->position = ftell(stream->fptr_image);
+    *offset = stream->position;
+    return 0;
+}
+
+static int verify_close(void *cookie)
+{
+    VerifyStream *stream = cookie;
+    int result = fclose(stream->fptr_image);
+    free(stream);
+    return result;
+}
+
+/* Open Verify Stream
+ * Input: Image file ptr at any position, stream mode, track
+ * Output: FILE ptr at the same position, hashing into track
+ * Return Values : FILE ptr, NULL on failure
+ */
+FILE *verify_open(FILE *fptr_image, const char *mode, VerifyTrack *track)
+{
+    cookie_io_functions_t io = { verify_read, verify_write, verify_seek, verify_close };
+    VerifyStream *stream = malloc(sizeof(VerifyStream));
+    if(stream == NULL)
+    {
+        return NULL;
+    }
+    stream->fptr_image = fptr_image;
+    stream->position = ftell(fptr_image);
+    stream->track = track;
+    FILE *fptr = fopencookie(stream, mode, io);
+    if(fptr == NULL)
+    {
+        free(stream);
+    }
+    return fptr;
+}
+/* Function Definitions */
+
+/* Verify LSB Only
+ * Input: Cover bytes and the stego bytes encoded from them
+ * Return Values : e_success when they differ in the LSB only, e_failure otherwise
+ */
+Status verify_lsb_only(const char *cover_data, const char *image_data, long size)
+{
+    char diff = 0;
+    for(long i = 0; i < size; i++)
+    {
+        diff |= cover_data[i] ^ image_data[i];
+    }
+    return (diff & ~1) == 0 ? e_success : e_failure;
+}
@@ -0,0 +1,34 @@
+#ifndef VERIFY_H
+#define VERIFY_H
+
+#include <stdio.h>
+#include "types.h"
+#include "cover.h"
+
+/*
+ * Encode verification (--verify). The LSB kernels check every buffer they
+ * fill decodes back to the payload. The rest is checked by tapping the cover
+ * and stego image streams, each keeping a running CRC32C of the file in file
+ * order with the LSB of the pixel bytes masked. Once the stego image is closed
+ * both hashes and the number of bytes hashed must match, so headers and tails
+ * are byte identical and no pixel byte changed beyond its LSB
+ */
+
+typedef struct _VerifyTrack
+{
+    const CoverInfo *cover; /*Store the parsed cover, for the pixel region*/
+    uint crc; /*Store the running CRC32C of the file, pixel LSBs masked*/
+    long next; /*Store the file offset of the next byte to hash*/
+    long end; /*Store the file offset where hashing stops*/
+} VerifyTrack;
+
+/* Start a track over the file of cover up to end */
+void verify_track_init(VerifyTrack *track, const CoverInfo *cover, long end);
+
+/* Stream passing reads and writes through to fptr_image and hashing them into track; owns fptr_image */
+FILE *verify_open(FILE *fptr_image, const char *mode, VerifyTrack *track);
+
+/* Check that the pixel bytes differ from the cover bytes in the LSB only */
+Status verify_lsb_only(const char *cover_data, const char *image_data, long size);
+
+#endif
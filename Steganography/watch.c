@@ -0,0 +1,425 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <limits.h>
+#include <stdint.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#include <sys/eventfd.h>
+#include "watch.h"
+#include "decode.h"
+#include "cover.h"
+#include "pool.h"
+#include "bufpool.h"
+#include "types.h"
+#include "common.h"
+#include "color.h"
+
+#define WATCH_EVENT_SIZE (sizeof(struct inotify_event) + NAME_MAX + 1) /* Largest inotify event */
+#define WATCH_EVENTS_PER_READ 16 /* Events read from inotify at once, at most */
+
+typedef struct _WatchFile
+{
+    char name[NAME_MAX + 1]; /*Store the image name inside the watch directory*/
+    double first_event; /*Store when the first event of the image was read, in ms*/
+    double deadline; /*Store when the image is taken unless another event arrives, in ms*/
+    WatchInfo *watchInfo; /*Store the directories and the key*/
+    int wake_fd; /*Store the eventfd told when the extraction finished*/
+    struct _WatchFile *next; /*Store the next image waiting, in arrival order*/
+} WatchFile;
+
+static volatile sig_atomic_t watch_stop; /* Set by SIGINT and SIGTERM */
+
+/* Function Definitions */
+
+static void watch_signal(int signal)
+{
+    (void) signal;
+    watch_stop = 1;
+}
+
+static double watch_now(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1e3 + now.tv_nsec / 1e6;
+}
+/* Function Definitions */
+
+/*
+ * Validate Watch Command Line Arguments
+ * Inputs: Command line arguments: -w <watch dir> <output dir>
+ * Output: Both directories, the queue and debounce defaults
+ * Description: The directories must differ, or the payloads would be watched too
+ * Return Values: e_success or e_failure
+ */
+Status read_and_validate_watch_args(int argc, char *argv[], WatchInfo *watchInfo)
+{
+    struct stat watch_stat, output_stat;
+    if(argc != 4)
+    {
+        printf(RED "Invalid Number of Arguments Passed for Watch\n" RESET);
+        return e_failure;
+    }
+    watchInfo->watch_dir = argv[2];
+    watchInfo->output_dir = argv[3];
+    watchInfo->queue_size = WATCH_QUEUE_SIZE;
+    watchInfo->debounce_ms = WATCH_DEBOUNCE_MS;
+    if(stat(watchInfo->watch_dir, &watch_stat) != 0 || !S_ISDIR(watch_stat.st_mode))
+    {
+        printf(RED "Error: %s is not a directory\n" RESET, watchInfo->watch_dir);
+        return e_failure;
+    }
+    if(stat(watchInfo->output_dir, &output_stat) != 0 || !S_ISDIR(output_stat.st_mode))
+    {
+        printf(RED "Error: %s is not a directory\n" RESET, watchInfo->output_dir);
+        return e_failure;
+    }
+    if(watch_stat.st_dev == output_stat.st_dev && watch_stat.st_ino == output_stat.st_ino)
+    {
+        printf(RED "Error: The output directory must not be the watch directory\n" RESET);
+        return e_failure;
+    }
+    return e_success;
+}
+/* Function Definitions */
+
+/*
+ * Validate Watch Options
+ * Inputs: Options separated from the positional command line arguments
+ * Output: Key, worker thread count, queue bound and debounce time when passed
+ * Return Values: e_success or e_failure
+ */
+Status read_and_validate_watch_options(char *options[], WatchInfo *watchInfo)
+{
+    for(int i = 0; options[i] != NULL; i++)
+    {
+        if(strcmp(options[i], "--key") == 0 && options[i + 1] != NULL)
+        {
+            watchInfo->key = options[++i];
+        }
+        else if(strcmp(options[i], "--threads") == 0 && options[i + 1] != NULL)
+        {
+            watchInfo->thread_count = atoi(options[++i]);
+            if(watchInfo->thread_count <= 0)
+            {
+                printf(RED "Invalid Thread Count %s\n" RESET, options[i]);
+                return e_failure;
+            }
+        }
+        else if(strcmp(options[i], "--queue") == 0 && options[i + 1] != NULL)
+        {
+            watchInfo->queue_size = atoi(options[++i]);
+            if(watchInfo->queue_size <= 0)
+            {
+                printf(RED "Invalid Queue Size %s\n" RESET, options[i]);
+                return e_failure;
+            }
+        }
+        else if(strcmp(options[i], "--debounce") == 0 && options[i + 1] != NULL)
+        {
+            char *end;
+            watchInfo->debounce_ms = strtol(options[++i], &end, 10);
+            if(*end != '\0' || watchInfo->debounce_ms < 0)
+            {
+                printf(RED "Invalid Debounce Time %s ms\n" RESET, options[i]);
+                return e_failure;
+            }
+        }
+        else
+        {
+            printf(RED "Unsupported Watch Option %s\n" RESET, options[i]);
+            return e_failure;
+        }
+    }
+    return e_success;
+}
+/* Function Definitions */
+
+/* Write a Status Record
+ * Input: Watch info, image name, record line
+ * Output: <output dir>/<image>.status, written under a hidden name and renamed into place
+ */
+static void watch_write_status(const WatchInfo *watchInfo, const char *name, const char *record)
+{
+    char temp_fname[PATH_MAX], fname[PATH_MAX];
+    snprintf(temp_fname, sizeof(temp_fname), "%s/.%s.status", watchInfo->output_dir, name);
+    snprintf(fname, sizeof(fname), "%s/%s.status", watchInfo->output_dir, name);
+    FILE *fptr = fopen(temp_fname, "w");
+    if(fptr == NULL)
+    {
+        printf(RED "Error: Unable to open file %s\n" RESET, temp_fname);
+        return;
+    }
+    int failed = fputs(record, fptr) == EOF;
+    if(fclose(fptr) != 0 || failed || rename(temp_fname, fname) != 0)
+    {
+        printf(RED "Error: Unable to write %s\n" RESET, fname);
+        unlink(temp_fname);
+    }
+}
+
+/* Extract an Image (worker job)
+ * Input: Image taken from the watch directory
+ * Output: Secret file in the output directory, status record of the image
+ * Description: Images without the magic string are recorded as carrying no
+ * payload. The secret file is decoded under a hidden name, since its extension
+ * is only known from the image, and renamed once complete
+ * Return Values : e_success, failures are reported in the status record
+ */
+static Status watch_extract(void *arg)
+{
+    WatchFile *file = arg;
+    WatchInfo *watchInfo = file->watchInfo;
+    char image_fname[PATH_MAX], fname[PATH_MAX], record[PATH_MAX + 128];
+    snprintf(image_fname, sizeof(image_fname), "%s/%s", watchInfo->watch_dir, file->name);
+    DecodeInfo decInfo = {0};
+    decInfo.src_image_fname = image_fname;
+    decInfo.key = watchInfo->key;
+    decInfo.secret_fname = arena_alloc(&decInfo.arena, MAX_FILENAME_SIZE);
+    int stem = strrchr(file->name, '.') - file->name;
+    Status status = e_failure;
+    int payload = 1;
+    if(decInfo.secret_fname != NULL &&
+       snprintf(decInfo.secret_fname, MAX_FILENAME_SIZE, "%s/.%.*s", watchInfo->output_dir, stem, file->name) < MAX_FILENAME_SIZE &&
+       open_image_file(&decInfo) == e_success)
+    {
+        if(decode_magic_string(MAGIC_STRING, &decInfo) == e_failure)
+        {
+            payload = 0;
+        }
+        else if(decode_secret_file_extn_size(&decInfo) == e_success &&
+                decode_secret_file_extn(&decInfo) == e_success &&
+                open_secret_file(&decInfo) == e_success &&
+                decode_secret_file_size(&decInfo) == e_success &&
+                decode_secret_file_data(&decInfo) == e_success)
+        {
+            status = e_success;
+        }
+    }
+    if(decInfo.fptr_secret != NULL)
+    {
+        const char *temp_fname = strrchr(decInfo.secret_fname, '/') + 1;
+        snprintf(fname, sizeof(fname), "%s/%s", watchInfo->output_dir, temp_fname + 1); // Without the leading dot
+        if(fclose(decInfo.fptr_secret) != 0 || (status == e_success && rename(decInfo.secret_fname, fname) != 0))
+        {
+            status = e_failure;
+        }
+        if(status == e_failure)
+        {
+            unlink(decInfo.secret_fname);
+        }
+    }
+    if(decInfo.fptr_src_image != NULL)
+    {
+        fclose(decInfo.fptr_src_image);
+    }
+    double latency = watch_now() - file->first_event;
+    if(status == e_success)
+    {
+        printf(GRN "INFO: %s -> %s (%ld bytes, %.1f ms)\n" RESET, file->name, fname, decInfo.size_secret_file, latency);
+        snprintf(record, sizeof(record), "%s ok %s %ld %.1f\n", file->name, strrchr(fname, '/') + 1, decInfo.size_secret_file, latency);
+    }
+    else if(!payload)
+    {
+        printf(YEL "INFO: %s carries no payload\n" RESET, file->name);
+        snprintf(record, sizeof(record), "%s none\n", file->name);
+    }
+    else
+    {
+        printf(RED "Error: Extracting %s failed\n" RESET, file->name);
+        snprintf(record, sizeof(record), "%s failed\n", file->name);
+    }
+    watch_write_status(watchInfo, file->name, record);
+    arena_release(&decInfo.arena);
+    uint64_t finished = 1;
+    if(write(file->wake_fd, &finished, sizeof(finished)) != sizeof(finished))
+    {
+        printf(RED "Error: Unable to wake the watch\n" RESET);
+    }
+    free(file);
+    return e_success;
+}
+/* Function Definitions */
+
+/* Submit an Image
+ * Description: Sized from its header when the pool has a memory budget, so a
+ * gigapixel image waits for room while smaller ones go ahead
+ * Return Values : e_success and e_failure
+ */
+static Status watch_submit(WorkerPool *pool, WatchFile *file)
+{
+    char image_fname[PATH_MAX];
+    CoverInfo cover = {0};
+    long footprint = 0;
+    if(pool->budget > 0)
+    {
+        snprintf(image_fname, sizeof(image_fname), "%s/%s", file->watchInfo->watch_dir, file->name);
+        footprint = cover_file_footprint(image_fname, 0, &cover);
+    }
+    return pool_submit_sized(pool, POOL_ANY_NODE, footprint, watch_extract, file);
+}
+/* Function Definitions */
+
+/* Read Watch Events
+ * Input: inotify descriptor, room left in the queue, list of waiting images
+ * Output: Images with new events added to the list or their deadline pushed back
+ * Description: No more events than there is room for are read, the kernel
+ * keeps the rest. Hidden names and names of no cover format are ignored
+ * Return Values : e_success, e_failure when the watch directory went away
+ */
+static Status watch_read_events(int inotify_fd, int room, WatchInfo *watchInfo, int wake_fd, WatchFile **pending, int *waiting)
+{
+    char buffer[WATCH_EVENTS_PER_READ * WATCH_EVENT_SIZE] __attribute__((aligned(__alignof__(struct inotify_event))));
+    size_t size = (room < WATCH_EVENTS_PER_READ ? room : WATCH_EVENTS_PER_READ) * WATCH_EVENT_SIZE;
+    ssize_t length = read(inotify_fd, buffer, size);
+    if(length < 0)
+    {
+        return errno == EAGAIN || errno == EINTR ? e_success : e_failure;
+    }
+    double now = watch_now();
+    const struct inotify_event *event;
+    for(char *ptr = buffer; ptr < buffer + length; ptr += sizeof(struct inotify_event) + event->len)
+    {
+        event = (const struct inotify_event *) ptr;
+        if(event->mask & IN_Q_OVERFLOW)
+        {
+            printf(RED "Error: Watch events were lost, some images may be missed\n" RESET);
+            continue;
+        }
+        if(event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED))
+        {
+            printf(RED "Error: %s is gone\n" RESET, watchInfo->watch_dir);
+            return e_failure;
+        }
+        if(event->len == 0 || event->name[0] == '.' || cover_format_for_name(event->name) == NULL)
+        {
+            continue;
+        }
+        WatchFile **link = pending;
+        while(*link != NULL && strcmp((*link)->name, event->name) != 0)
+        {
+            link = &(*link)->next;
+        }
+        if(*link == NULL) // First event of the image, queue it behind the others
+        {
+            *link = calloc(1, sizeof(WatchFile));
+            if(*link == NULL)
+            {
+                printf(RED "Error: Memory Allocation Failed\n" RESET);
+                continue;
+            }
+            strcpy((*link)->name, event->name);
+            (*link)->first_event = now;
+            (*link)->watchInfo = watchInfo;
+            (*link)->wake_fd = wake_fd;
+            (*waiting)++;
+        }
+        (*link)->deadline = now + watchInfo->debounce_ms;
+    }
+    return e_success;
+}
+
+/*
+ * Watch Images
+ * Inputs: WatchInfo with both directories
+ * Output: Secret file and status record of every image arriving in the watch directory
+ * Description: One thread reads the events and debounces them, the pool extracts.
+ * Workers report finished images through an eventfd, which wakes the watch
+ * when the queue was full
+ * Return Value: e_success once interrupted, e_failure when the watch cannot go on
+ */
+Status watch_images(WatchInfo *watchInfo)
+{
+    int inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    int wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    WorkerPool *pool = NULL;
+    Status status = e_success;
+    if(inotify_fd < 0 || wake_fd < 0 ||
+       inotify_add_watch(inotify_fd, watchInfo->watch_dir, IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR) < 0 ||
+       (pool = pool_create(watchInfo->thread_count)) == NULL)
+    {
+        printf(RED "Error: Unable to watch %s\n" RESET, watchInfo->watch_dir);
+        status = e_failure;
+    }
+    struct sigaction action = { 0 };
+    action.sa_handler = watch_signal; // No SA_RESTART, poll returns on the signal
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    quiet_mode = 1; // One line per image instead of the stage banners
+    if(status == e_success)
+    {
+        printf(GRN "INFO: Watching %s, extracting into %s (Ctrl-C stops)\n" RESET, watchInfo->watch_dir, watchInfo->output_dir);
+        fflush(stdout);
+    }
+    WatchFile *pending = NULL;
+    int waiting = 0, running = 0;
+    while(status == e_success && !watch_stop)
+    {
+        double now = watch_now(), next = -1;
+        for(WatchFile **link = &pending; *link != NULL;) // Hand the images quiet for long enough to the pool
+        {
+            WatchFile *file = *link;
+            if(file->deadline > now)
+            {
+                next = next < 0 || file->deadline < next ? file->deadline : next;
+                link = &file->next;
+                continue;
+            }
+            *link = file->next;
+            waiting--;
+            if(watch_submit(pool, file) == e_failure)
+            {
+                printf(RED "Error: Extracting %s failed\n" RESET, file->name);
+                free(file);
+                continue;
+            }
+            running++;
+        }
+        int room = watchInfo->queue_size - waiting - running;
+        struct pollfd fds[2] = { { wake_fd, POLLIN, 0 }, { inotify_fd, room > 0 ? POLLIN : 0, 0 } };
+        if(poll(fds, 2, next < 0 ? -1 : (int) (next - now) + 1) < 0)
+        {
+            status = errno == EINTR ? e_success : e_failure;
+            continue;
+        }
+        uint64_t finished;
+        if((fds[0].revents & POLLIN) && read(wake_fd, &finished, sizeof(finished)) == sizeof(finished))
+        {
+            running -= finished;
+        }
+        if(fds[1].revents & POLLIN)
+        {
+            status = watch_read_events(inotify_fd, room, watchInfo, wake_fd, &pending, &waiting);
+        }
+        fflush(stdout);
+    }
+    while(pending != NULL) // Finish the images already seen
+    {
+        WatchFile *file = pending;
+        pending = file->next;
+        if(watch_submit(pool, file) == e_failure)
+        {
+            free(file);
+        }
+    }
+    if(pool != NULL)
+    {
+        pool_wait(pool);
+        pool_destroy(pool);
+    }
+    if(inotify_fd >= 0)
+    {
+        close(inotify_fd);
+    }
+    if(wake_fd >= 0)
+    {
+        close(wake_fd);
+    }
+    return status;
+}
@@ -0,0 +1,39 @@
+#ifndef WATCH_H
+#define WATCH_H
+
+#include "types.h"
+
+/*
+ * Watch folder ingest (-w). inotify reports every image closed after writing
+ * or moved into the watch directory. An image is taken once no event for it
+ * arrived for the debounce time, then a pool worker checks it for the magic
+ * string and extracts the secret file into the output directory. The payload
+ * and a <image>.status record appear there by rename, so readers never see
+ * them half written. At most queue images wait or run at once; past that the
+ * watch stops reading events and the kernel holds them. Ctrl-C stops the
+ * watch after the images already seen are finished
+ */
+
+#define WATCH_DEBOUNCE_MS 20 /* Quiet time after the last event of an image */
+#define WATCH_QUEUE_SIZE 256 /* Images waiting or being extracted, at most */
+
+typedef struct _WatchInfo
+{
+    char *watch_dir; /*Store the directory the images arrive in*/
+    char *output_dir; /*Store the directory the payloads and status records go to*/
+    char *key; /*Store the passphrase of scattered images, NULL for none*/
+    int thread_count; /*Store the number of worker threads, 0 for one per CPU*/
+    int queue_size; /*Store the bound of images waiting or being extracted*/
+    int debounce_ms; /*Store the quiet time after the last event of an image*/
+} WatchInfo;
+
+/* Read and validate watch args: <watch dir> <output dir> */
+Status read_and_validate_watch_args(int argc, char *argv[], WatchInfo *watchInfo);
+
+/* Read and validate watch options (--key KEY, --threads N, --queue N, --debounce MS) */
+Status read_and_validate_watch_options(char *options[], WatchInfo *watchInfo);
+
+/* Extract the images arriving in the watch directory until interrupted */
+Status watch_images(WatchInfo *watchInfo);
+
+#endif
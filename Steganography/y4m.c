@@ -0,0 +1,357 @@
+#define _GNU_SOURCE /* fopencookie */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "y4m.h"
+#include "common.h"
+#include "types.h"
+#include "color.h"
+
+#define Y4M_COPY_BUF_SIZE 65536
+
+/* Stream of the luma planes of a Y4M file */
+typedef struct _Y4mStream
+{
+    FILE *fptr_image; /*Store the image the stream reads or writes*/
+    int fd_image; /*Store the descriptor of fptr_image for pread/pwrite*/
+    int fd_source; /*Store the cover, for the planes copied as is (writer only)*/
+    long header_size; /*Store the size of the stream header*/
+    long plane_size; /*Store the bytes per luma plane*/
+    long frame_stride; /*Store the bytes per frame, marker and chroma planes included*/
+    long frames; /*Store the number of frames*/
+    long position; /*Store the stream position in the luma planes*/
+    long frames_copied; /*Store the frames whose marker and chroma planes are written (writer only)*/
+} Y4mStream;
+
+/* Function Definitions */
+
+/* Y4M Probe
+ * Return Values : Nonzero when the header starts with the YUV4MPEG2 signature
+ */
+int y4m_probe(const unsigned char *header, int size)
+{
+    return size >= Y4M_SIGNATURE_SIZE && memcmp(header, Y4M_SIGNATURE, Y4M_SIGNATURE_SIZE) == 0;
+}
+/* Function Definitions */
+
+/* Chroma Size
+ * Input: Value of the C header parameter, frame dimensions
+ * Return Values : Bytes of the chroma (and alpha) planes of a frame, -1 if unsupported
+ */
+static long y4m_chroma_size(const char *chroma, long width, long height)
+{
+    if(strcmp(chroma, "420") == 0 || strcmp(chroma, "420jpeg") == 0 ||
+       strcmp(chroma, "420paldv") == 0 || strcmp(chroma, "420mpeg2") == 0)
+    {
+        return 2 * ((width + 1) / 2) * ((height + 1) / 2);
+    }
+    if(strcmp(chroma, "411") == 0)
+    {
+        return 2 * ((width + 3) / 4) * height;
+    }
+    if(strcmp(chroma, "422") == 0)
+    {
+        return 2 * ((width + 1) / 2) * height;
+    }
+    if(strcmp(chroma, "444") == 0)
+    {
+        return 2 * width * height;
+    }
+    if(strcmp(chroma, "444alpha") == 0)
+    {
+        return 3 * width * height;
+    }
+    if(strcmp(chroma, "mono") == 0)
+    {
+        return 0;
+    }
+    return -1;
+}
+/* Function Definitions */
+
+/* Parse Y4M Header
+ * Input: Y4M file ptr
+ * Output: Frame dimensions; the pixel region is the luma planes of all the frames,
+ * header_size is the stream header and trailer_offset the end of the last frame
+ * Description: The frame count comes from the file size, so every frame must have
+ * the same size and a "FRAME\n" marker without parameters
+ * Return Values : e_success and e_failure
+ */
+Status y4m_parse_header(FILE *fptr_image, CoverInfo *cover)
+{
+    char header[Y4M_MAX_HEADER_SIZE], *save = NULL;
+    rewind(fptr_image);
+    if(fgets(header, sizeof(header), fptr_image) == NULL || strchr(header, '\n') == NULL)
+    {
+        printf(RED "Error Reading y4m header\n" RESET);
+        return e_failure;
+    }
+    long header_size = strlen(header), width = 0, height = 0;
+    const char *chroma = "420";
+    header[header_size - 1] = '\0';
+    for(char *token = strtok_r(header + Y4M_SIGNATURE_SIZE, " ", &save); token != NULL; token = strtok_r(NULL, " ", &save))
+    {
+        if(token[0] == 'W')
+        {
+            width = strtol(token + 1, NULL, 10);
+        }
+        else if(token[0] == 'H')
+        {
+            height = strtol(token + 1, NULL, 10);
+        }
+        else if(token[0] == 'C')
+        {
+            chroma = token + 1;
+        }
+    }
+    long chroma_size = y4m_chroma_size(chroma, width, height);
+    if(width <= 0 || height <= 0)
+    {
+        printf(RED "Error: Invalid y4m frame size\n" RESET);
+        return e_failure;
+    }
+    if(chroma_size < 0)
+    {
+        printf(RED "Error: y4m chroma format C%s is not supported\n" RESET, chroma);
+        return e_failure;
+    }
+    long frame_stride = Y4M_FRAME_MARKER_SIZE + width * height + chroma_size;
+    char marker[Y4M_FRAME_MARKER_SIZE];
+    if(fseek(fptr_image, 0, SEEK_END) != 0)
+    {
+        return e_failure;
+    }
+    long file_size = ftell(fptr_image), frames = (file_size - header_size) / frame_stride;
+    if(frames <= 0 || (file_size - header_size) % frame_stride != 0 ||
+       fseek(fptr_image, header_size, SEEK_SET) != 0 ||
+       fread(marker, sizeof(char), Y4M_FRAME_MARKER_SIZE, fptr_image) < Y4M_FRAME_MARKER_SIZE ||
+       memcmp(marker, Y4M_FRAME_MARKER, Y4M_FRAME_MARKER_SIZE) != 0)
+    {
+        printf(RED "Error: y4m frames must be complete and have no parameters\n" RESET);
+        return e_failure;
+    }
+    cover->width = width;
+    cover->height = height;
+    cover->channels = 1;
+    cover->data_offset = 0;
+    cover->data_size = frames * width * height;
+    cover->header_size = header_size;
+    cover->trailer_offset = file_size;
+    return e_success;
+}
+/* Function Definitions */
+
+static Y4mStream *y4m_new_stream(FILE *fptr_image, const CoverInfo *cover)
+{
+    Y4mStream *stream = calloc(1, sizeof(Y4mStream));
+    if(stream != NULL)
+    {
+        stream->fptr_image = fptr_image;
+        stream->fd_image = fileno(fptr_image);
+        stream->fd_source = -1;
+        stream->header_size = cover->header_size;
+        stream->plane_size = (long) cover->width * cover->height;
+        stream->frames = cover->data_size / stream->plane_size;
+        stream->frame_stride = (cover->trailer_offset - cover->header_size) / stream->frames;
+    }
+    return stream;
+}
+
+/* File offset of a position in the luma planes */
+static long y4m_file_offset(const Y4mStream *stream, long position)
+{
+    return stream->header_size + position / stream->plane_size * stream->frame_stride +
+           Y4M_FRAME_MARKER_SIZE + position % stream->plane_size;
+}
+
+/* Bytes from position to the end of its luma plane, at most size */
+static size_t y4m_span(const Y4mStream *stream, long position, size_t size)
+{
+    size_t left = stream->plane_size - position % stream->plane_size;
+    return size < left ? size : left;
+}
+/* Function Definitions */
+
+static ssize_t y4m_read(void *cookie, char *buffer, size_t size)
+{
+    Y4mStream *stream = cookie;
+    size_t done = 0;
+    while(done < size && stream->position < stream->frames * stream->plane_size)
+    {
+        ssize_t count = pread(stream->fd_image, buffer + done, y4m_span(stream, stream->position, size - done),
+                              y4m_file_offset(stream, stream->position));
+        if(count < 0)
+        {
+            return -1;
+        }
+        if(count == 0)
+        {
+            break;
+        }
+        done += count;
+        stream->position += count;
+    }
+    return done;
+}
+
+static int y4m_seek(void *cookie, off64_t *offset, int whence)
+{
+    Y4mStream *stream = cookie;
+    long target = (whence == SEEK_SET ? 0 : whence == SEEK_CUR ? stream->position : stream->frames * stream->plane_size) + *offset;
+    if(target < 0)
+    {
+        return -1;
+    }
+    stream->position = target;
+    *offset = target;
+    return 0;
+}
+
+static int y4m_reader_close(void *cookie)
+{
+    Y4mStream *stream = cookie;
+    int result = fclose(stream->fptr_image);
+    free(stream);
+    return result;
+}
+/* Function Definitions */
+
+/* Copy size bytes at offset from the cover to the stego image */
+static Status y4m_copy_range(Y4mStream *stream, long offset, long size)
+{
+    char buffer[Y4M_COPY_BUF_SIZE];
+    while(size > 0)
+    {
+        ssize_t count = pread(stream->fd_source, buffer, size < Y4M_COPY_BUF_SIZE ? size : Y4M_COPY_BUF_SIZE, offset);
+        if(count <= 0 || pwrite(stream->fd_image, buffer, count, offset) < count)
+        {
+            return e_failure;
+        }
+        offset += count;
+        size -= count;
+    }
+    return e_success;
+}
+
+/* Copy the markers and chroma planes of the frames before frame_count, once */
+static Status y4m_copy_frames(Y4mStream *stream, long frame_count)
+{
+    for(; stream->frames_copied < frame_count; stream->frames_copied++)
+    {
+        long frame = stream->header_size + stream->frames_copied * stream->frame_stride;
+        long chroma = frame + Y4M_FRAME_MARKER_SIZE + stream->plane_size;
+        if(y4m_copy_range(stream, frame, Y4M_FRAME_MARKER_SIZE) == e_failure ||
+           y4m_copy_range(stream, chroma, frame + stream->frame_stride - chroma) == e_failure)
+        {
+            return e_failure;
+        }
+    }
+    return e_success;
+}
+
+static ssize_t y4m_write(void *cookie, const char *buffer, size_t size)
+{
+    Y4mStream *stream = cookie;
+    size_t done = 0;
+    while(done < size && stream->position < stream->frames * stream->plane_size)
+    {
+        if(y4m_copy_frames(stream, stream->position / stream->plane_size + 1) == e_failure)
+        {
+            return -1;
+        }
+        ssize_t count = pwrite(stream->fd_image, buffer + done, y4m_span(stream, stream->position, size - done),
+                               y4m_file_offset(stream, stream->position));
+        if(count <= 0)
+        {
+            return -1;
+        }
+        done += count;
+        stream->position += count;
+    }
+    return done;
+}
+
+static int y4m_writer_close(void *cookie)
+{
+    Y4mStream *stream = cookie;
+    Status status = y4m_copy_frames(stream, stream->frames);
+    if(status == e_failure)
+    {
+        printf(RED "Error Writing y4m frames\n" RESET);
+    }
+    if(fclose(stream->fptr_image) != 0)
+    {
+        status = e_failure;
+    }
+    close(stream->fd_source);
+    free(stream);
+    return status == e_success ? 0 : -1;
+}
+/* Function Definitions */
+
+/* Open Y4M Reader
+ * Input: Y4M file ptr and its parsed header
+ * Output: Read only FILE ptr of the luma planes, which closes the image
+ * Return Values : FILE ptr, NULL on failure
+ */
+FILE *y4m_open_reader(FILE *fptr_image, const CoverInfo *cover)
+{
+    cookie_io_functions_t io = { y4m_read, NULL, y4m_seek, y4m_reader_close };
+    Y4mStream *stream = y4m_new_stream(fptr_image, cover);
+    FILE *fptr = stream != NULL ? fopencookie(stream, "r", io) : NULL;
+    if(fptr == NULL)
+    {
+        free(stream);
+        return NULL;
+    }
+    setvbuf(fptr, NULL, _IOFBF, Y4M_STREAM_BUF_SIZE);
+    return fptr;
+}
+
+/* Open Y4M Writer
+ * Input: Cover file ptr, stego file ptr holding the copied stream header, parsed header
+ * Output: Write only FILE ptr of the luma planes, which owns the stego image
+ * Description: Frame markers and chroma planes are copied from the cover as the
+ * luma planes are written, and any frames left on close
+ * Return Values : FILE ptr, NULL on failure
+ */
+FILE *y4m_open_writer(FILE *fptr_src_image, FILE *fptr_dest_image, const CoverInfo *cover)
+{
+    cookie_io_functions_t io = { NULL, y4m_write, y4m_seek, y4m_writer_close };
+    if(fflush(fptr_dest_image) != 0) // The header goes through stdio, the frames through pwrite
+    {
+        return NULL;
+    }
+    Y4mStream *stream = y4m_new_stream(fptr_dest_image, cover);
+    if(stream == NULL)
+    {
+        return NULL;
+    }
+    stream->fd_source = dup(fileno(fptr_src_image));
+    FILE *fptr = stream->fd_source >= 0 ? fopencookie(stream, "w", io) : NULL;
+    if(fptr == NULL)
+    {
+        if(stream->fd_source >= 0)
+        {
+            close(stream->fd_source);
+        }
+        free(stream);
+        return NULL;
+    }
+    setvbuf(fptr, NULL, _IOFBF, Y4M_STREAM_BUF_SIZE);
+    return fptr;
+}
+/* Function Definitions */
+
+/* Y4M Footprint
+ * Description: Constant whatever the frame size or direction, the planes are
+ * moved with pread/pwrite straight from the file, so a stream only holds its
+ * state and its stdio buffer (the copy buffer of the writer is on the stack)
+ */
+long y4m_footprint(const CoverInfo *cover, int writing)
+{
+    (void) cover;
+    (void) writing;
+    return sizeof(Y4mStream) + Y4M_STREAM_BUF_SIZE;
+}
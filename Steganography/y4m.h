@@ -0,0 +1,39 @@
+#ifndef Y4M_H
+#define Y4M_H
+
+#include <stdio.h>
+#include "types.h"
+#include "cover.h"
+
+/*
+ * YUV4MPEG2 (Y4M) video cover backend. The payload is carried by the luma
+ * planes of the frames, so the pixel stream is the Y plane of every frame
+ * one after the other and the stego header lands in the first frame.
+ * Both streams map stream offsets to file offsets and use pread/pwrite with a
+ * fixed buffer, so memory use does not depend on the length of the video.
+ * Only 8 bit streams whose frames all start with a plain "FRAME\n" are accepted
+ */
+
+#define Y4M_SIGNATURE "YUV4MPEG2 "
+#define Y4M_SIGNATURE_SIZE 10
+#define Y4M_MAX_HEADER_SIZE 1024
+#define Y4M_FRAME_MARKER "FRAME\n"
+#define Y4M_FRAME_MARKER_SIZE 6
+#define Y4M_STREAM_BUF_SIZE (1024 * 1024) /* stdio buffer of the plane streams */
+
+/* Nonzero for the YUV4MPEG2 signature */
+int y4m_probe(const unsigned char *header, int size);
+
+/* Parse the stream header: frame size, chroma layout and frame count */
+Status y4m_parse_header(FILE *fptr_image, CoverInfo *cover);
+
+/* Read only stream of the luma planes, owning fptr_image */
+FILE *y4m_open_reader(FILE *fptr_image, const CoverInfo *cover);
+
+/* Write only stream of the luma planes; chroma planes and frame markers are copied from the cover */
+FILE *y4m_open_writer(FILE *fptr_src_image, FILE *fptr_dest_image, const CoverInfo *cover);
+
+/* Bytes of memory a plane stream of the image holds */
+long y4m_footprint(const CoverInfo *cover, int writing);
+
+#endif